@@ -18,10 +18,12 @@ RMLIBSRCS=roadmap_log.c \
           roadmap_math.c \
           roadmap_hash.c \
           roadmap_dbread.c \
+          roadmap_tile_pack.c \
           roadmap_dictionary.c \
           roadmap_square.c \
           roadmap_point.c \
           roadmap_line.c \
+          roadmap_line_index.c \
           roadmap_line_route.c \
           roadmap_line_speed.c \
           roadmap_shape.c \
@@ -144,7 +146,7 @@ ifeq ($(RENDERING),OPENGL)
    RMLIBSRCS+= $(OPENGL_DIR)/roadmap_canvas.c $(OPENGL_DIR)/roadmap_canvas_font.c 
    RMLIBSRCS+= $(OPENGL_DIR)/roadmap_canvas_atlas.c $(OPENGL_DIR)/roadmap_canvas3d.c $(OPENGL_DIR)/roadmap_glmatrix.c  
 else  
-   RMGUISRCS += roadmap_border.c
+   RMGUISRCS += roadmap_border.c roadmap_render.c
 endif
 
 
@@ -174,6 +176,7 @@ RMPLUGINSRCS=roadmap_copy.c \
              editor/track/editor_track_filter.c \
              editor/track/editor_track_known.c \
              editor/track/editor_track_unknown.c \
+             editor/track/editor_track_match.c \
              editor/track/editor_track_util.c \
              editor/track/editor_track_main.c \
              editor/track/editor_track_compress.c \
@@ -190,9 +193,10 @@ RMPLUGINSRCS=roadmap_copy.c \
              navigate/navigate_plugin.c \
              navigate/navigate_traffic.c \
              navigate/navigate_graph.c \
+             navigate/navigate_ch.c \
              navigate/navigate_cost.c \
              navigate/navigate_route_astar.c \
-             navigate/fib-1.1/fib.c \
+             navigate/navigate_queue.c \
              navigate/navigate_route_trans.c \
              navigate/navigate_res_dlg.c \
              navigate/navigate_route_events.c
@@ -214,6 +218,7 @@ RTSRCS=Realtime/Realtime.c \
        Realtime/RealtimeNetRec.c \
        Realtime/RealtimeUsers.c \
        Realtime/RealtimeMath.c \
+       Realtime/RealtimePath.c \
        Realtime/RealtimeDefs.c \
        Realtime/RealtimeSystemMessage.c \
        Realtime/RealtimePrivacy.c \
@@ -271,6 +276,7 @@ SSD_WIDGETS_SRCS=ssd/ssd_dialog.c \
 UNIX_SRCS=unix/roadmap_file.c \
 	      unix/roadmap_library.c \
 	      unix/roadmap_net.c \
+	      unix/roadmap_net_reactor.c \
 	      md5.c \
 	      unix/roadmap_serial.c \
 	      unix/roadmap_device_events.c \
@@ -115,6 +115,8 @@ static   PFN_LOGINTESTRES     gs_pfnOnExportMarkersResult   = NULL;
 static   PFN_LOGINTESTRES     gs_pfnOnExportSegmentsResult  = NULL;
 static   CB_OnWSTCompleted    gs_pfnOnLoginAfterRegister    = NULL;
 static   BOOL                 gs_bWritingOffline            = FALSE;
+static   BOOL                 gs_bOfflinePending            = FALSE;
+static   time_t               gs_LastOfflineDumpTime        = 0;
 static   RTPathInfo*          gs_pPI;
 static	int					  	gs_iCycleTimeSeconds			= 0;
 static	int					  	gs_iCycleRoundoffSeconds	= 0;
@@ -1389,12 +1391,48 @@ void OnTransactionCompleted( void* ctx, roadmap_result rc)
    roadmap_screen_refresh();
 }
 
+// Track data which failed to go out because of the network is journaled to
+// the offline files, and sent in one batch once the server is reachable again.
+// Each dump saves the configuration twice (the crash guard), so while the
+// network is down the data is journaled at most once every
+// RT_MIN_SECONDS_BETWEEN_OFFLINE_DUMPS; in between it stays in the track
+// report, and goes out with the next cycle or the next dump.
+static void OnTrackSendCompleted( roadmap_result rc)
+{
+   time_t now;
+
+   if( succeeded == rc)
+   {
+      if( gs_bOfflinePending)
+      {
+         roadmap_log( ROADMAP_DEBUG, "OnTrackSendCompleted() - Uploading journaled offline data");
+         gs_bOfflinePending = FALSE;
+         editor_sync_upload();
+      }
+   }
+   else if( is_network_error( rc))
+   {
+      now = time(NULL);
+      if( gs_bOfflinePending && (now - gs_LastOfflineDumpTime < RT_MIN_SECONDS_BETWEEN_OFFLINE_DUMPS))
+      {
+         roadmap_log( ROADMAP_DEBUG, "OnTrackSendCompleted() - Network error; track data was journaled %d seconds ago", (int)(now - gs_LastOfflineDumpTime));
+         return;
+      }
+
+      roadmap_log( ROADMAP_WARNING, "OnTrackSendCompleted() - Network error; journaling track data offline");
+      Realtime_DumpOffline();
+      gs_LastOfflineDumpTime = now;
+      gs_bOfflinePending = TRUE;
+   }
+}
+
 void OnAsyncOperationCompleted_AllTogether( void* ctx, roadmap_result rc)
 {
    if( succeeded != rc)
       roadmap_log( ROADMAP_ERROR, "OnAsyncOperationCompleted_AllTogether(POST) - The 'AllTogether' packet-send had failed");
 
    editor_track_report_conclude_export( succeeded == rc);
+   OnTrackSendCompleted( rc);
 
    OnTransactionCompleted( ctx, rc);
 }
@@ -2275,6 +2313,7 @@ void OnAsyncOperationCompleted_AllTogether_Part1( void* ctx, roadmap_result rc)
    {
       roadmap_log( ROADMAP_ERROR, "OnAsyncOperationCompleted_AllTogether_Part1(POST) - 'Part1' had failed");
       editor_track_report_conclude_export( 0);
+      OnTrackSendCompleted( rc);
       OnTransactionCompleted( ctx, rc);
       return;
    }
@@ -2295,6 +2334,7 @@ void OnAsyncOperationCompleted_AllTogether_Part2( void* ctx, roadmap_result rc)
    {
       roadmap_log( ROADMAP_ERROR, "OnAsyncOperationCompleted_AllTogether_Part2(POST) - 'Part2' had failed");
       editor_track_report_conclude_export( 0);
+      OnTrackSendCompleted( rc);
       OnTransactionCompleted( ctx, rc);
       return;
    }
@@ -58,11 +58,13 @@
 #include "../roadmap_res_download.h"
 #include "../roadmap_social_image.h"
 #include "../navigate/navigate_main.h"
+#include "../navigate/navigate_cost.h"
 #include "../roadmap_map_settings.h"
 #include "../roadmap_general_settings.h"
 #include "../roadmap_groups.h"
 #include "../roadmap_message_ticker.h"
 #include "../roadmap_analytics.h"
+#include "../roadmap_hash.h"
 
 #include "RealtimeAlerts.h"
 #include "RealtimeAlertsList.h"
@@ -100,6 +102,13 @@
 #endif //IPHONE
 
 static RTAlerts gAlertsTable;
+
+/* Reroutable alerts indexed by (square, line) for RTAlerts_Penalty(). The
+ * alerts table is compacted on removal, so the index is rebuilt on the first
+ * penalty query after the table changes.
+ */
+static RoadMapHash *gAlertsLineHash = NULL;
+static BOOL gAlertsLineHashDirty = TRUE;
 static int gIterator;
 static int gIdleScrolling;
 static int gThumbsUpScrolling = FALSE;
@@ -627,6 +636,9 @@ void RTAlerts_Clear_All()
     gAlertsTable.iCount = 0;
     gAlertsTable.iGroupCount = 0;
     gAlertsTable.iArchiveCount = 0;
+    gAlertsLineHashDirty = TRUE;
+    navigate_cost_data_changed ();
+    roadmap_alerter_provider_changed (&RoadmapRealTimeAlertProvider);
 
     gThumbsUpTable.iCount = 0;
 }
@@ -903,6 +915,9 @@ BOOL RTAlerts_Add(RTAlert *pAlert)
       gAlertsTable.iArchiveCount++;
 
     gAlertsTable.iCount++;
+    gAlertsLineHashDirty = TRUE;
+    navigate_cost_data_changed ();
+    roadmap_alerter_provider_changed (&RoadmapRealTimeAlertProvider);
 
     OnAlertAdd(gAlertsTable.alert[gAlertsTable.iCount-1]);
 
@@ -1132,6 +1147,9 @@ BOOL RTAlerts_Remove(int iID)
         gAlertsTable.iCount--;
 
         gAlertsTable.alert[gAlertsTable.iCount] = NULL;
+        gAlertsLineHashDirty = TRUE;
+        navigate_cost_data_changed ();
+        roadmap_alerter_provider_changed (&RoadmapRealTimeAlertProvider);
 
         OnAlertRemove();
     }
@@ -2553,6 +2571,9 @@ void RTAlerts_Sort_List(alert_sort_method sort_method)
     PluginLine line;
     int Direction, distance;
     int i;
+#ifndef J2ME
+    static RTAlert *previous_order[RT_MAXIMUM_ALERT_COUNT];
+#endif
     gState = STATE_OLD;
     for (i=0; i < gAlertsTable.iCount; i++)
     {
@@ -2601,12 +2622,23 @@ void RTAlerts_Sort_List(alert_sort_method sort_method)
     }
 
 #ifndef J2ME
+    memcpy (previous_order, gAlertsTable.alert, gAlertsTable.iCount * sizeof(RTAlert *));
+
     if (sort_method == sort_proximity)
     	qsort((void *) &gAlertsTable.alert[0], gAlertsTable.iCount, sizeof(void *), compare_proximity);
     else if (sort_method == sort_recency)
     	qsort((void *) &gAlertsTable.alert[0], gAlertsTable.iCount, sizeof(void *), compare_recency);
     else if (sort_method == sort_priority)
       qsort((void *) &gAlertsTable.alert[0], gAlertsTable.iCount, sizeof(void *), compare_priority);
+
+    // the line index and the alerter index refer to alerts by table position,
+    // and the first alert of a line in table order decides its penalty
+    if (memcmp (previous_order, gAlertsTable.alert, gAlertsTable.iCount * sizeof(RTAlert *)))
+    {
+        gAlertsLineHashDirty = TRUE;
+        navigate_cost_data_changed ();
+        roadmap_alerter_provider_changed (&RoadmapRealTimeAlertProvider);
+    }
 #endif
 }
 
@@ -5395,41 +5427,90 @@ BOOL real_time_remove_alert(int iAlertId)
     return Realtime_Remove_Alert(iAlertId);
 }
 
+/**
+ * Notify that the position of an alert was updated in place
+ * @param None
+ * @return None
+ */
+void RTAlerts_Location_Changed(void)
+{
+    roadmap_alerter_provider_changed (&RoadmapRealTimeAlertProvider);
+}
+
 /**
  * Checks the penalty of an alert if it is on the line.
  * @param line_id- the line ID to check, against_dir -the direction of the travel
  * @param the penalty of the alert, 0 if no alert is on that line.
  * @return void
  */
+static int RTAlerts_LineKey(int line_id, int square)
+{
+    return (int)(((unsigned int)square * 65599U + (unsigned int)line_id) & 0x7fffffff);
+}
+
+static void RTAlerts_IndexLines(void)
+{
+    int i;
+
+    if (gAlertsLineHash == NULL)
+        gAlertsLineHash = roadmap_hash_new ("RTAlertsLines", RT_MAXIMUM_ALERT_COUNT);
+    else
+        roadmap_hash_clean (gAlertsLineHash);
+
+    for (i=0; i<gAlertsTable.iCount; i++)
+    {
+        if (RTAlerts_Is_Reroutable(gAlertsTable.alert[i]) &&
+            gAlertsTable.alert[i]->iLineId != -1)
+        {
+            roadmap_hash_add (gAlertsLineHash,
+                              RTAlerts_LineKey (gAlertsTable.alert[i]->iLineId, gAlertsTable.alert[i]->iSquare),
+                              i);
+        }
+    }
+
+    gAlertsLineHashDirty = FALSE;
+}
+
 int RTAlerts_Penalty(int line_id, int against_dir)
 {
     int i;
     int line_from_point;
     int line_to_point;
-    int square = roadmap_square_active ();
+    int square;
+    int found = -1;
 
     if (gAlertsTable.iCount == 0)
         return FALSE;
-    for (i=0; i<gAlertsTable.iCount; i++)
+
+    if (gAlertsLineHashDirty)
+        RTAlerts_IndexLines();
+
+    square = roadmap_square_active ();
+
+    // the first matching alert in table order decides, as before
+    for (i = roadmap_hash_get_first (gAlertsLineHash, RTAlerts_LineKey (line_id, square));
+         i >= 0;
+         i = roadmap_hash_get_next (gAlertsLineHash, i))
     {
-        if (RTAlerts_Is_Reroutable(gAlertsTable.alert[i]))
+        if (found >= 0 && i > found)
+            continue;
+
+        if (gAlertsTable.alert[i]->iLineId == line_id &&
+				gAlertsTable.alert[i]->iSquare == square)
         {
-            if (gAlertsTable.alert[i]->iLineId == line_id &&
-					 gAlertsTable.alert[i]->iSquare == square)
+            roadmap_line_points(line_id, &line_from_point, &line_to_point);
+            if (((line_from_point == gAlertsTable.alert[i]->iNode1)
+                    && (!against_dir)) || ((line_to_point
+                    == gAlertsTable.alert[i]->iNode1) && (against_dir)))
             {
-                roadmap_line_points(line_id, &line_from_point, &line_to_point);
-                if (((line_from_point == gAlertsTable.alert[i]->iNode1)
-                        && (!against_dir)) || ((line_to_point
-                        == gAlertsTable.alert[i]->iNode1) && (against_dir)))
-                {
-                    if (gAlertsTable.alert[i]->iType == RT_ALERT_TYPE_ACCIDENT)
-                        return 3600;
-                    else
-                        return 0;
-                }
+                found = i;
             }
         }
     }
+
+    if (found >= 0 && gAlertsTable.alert[found]->iType == RT_ALERT_TYPE_ACCIDENT)
+        return 3600;
+
     return 0;
 }
 
@@ -293,6 +293,7 @@ void RTAlerts_Clear_All(void);
 void RTAlerts_Init(void);
 void RTAlerts_Term(void);
 BOOL RTAlerts_Add(RTAlert *alert);
+void RTAlerts_Location_Changed(void);
 BOOL RTAlerts_Remove(int iID);
 void RTAlerts_RefreshOnMap(void);
 int RTAlerts_Count(void);
@@ -334,6 +334,14 @@ BOOL RealtimeAltRoutes_Route_Request(int iTripId, const RoadMapPosition *from_po
    return TRUE;
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Routes calculated on the device, shown as the results of a request
+void RealtimeAltRoutes_Local_Routes(int num_res, const NavigateRouteResult *res, BOOL showListFirst){
+   cancelled = FALSE;
+   gShowListFirst = showListFirst;
+   RealtimeAltRoutes_OnRouteResults (route_succeeded, num_res, res);
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////
 void RealtimeAltRoutes_OnTripRouteRC (NavigateRouteRC rc, int protocol_rc, const char *description){
    if ((protocol_rc != 200) || (rc != route_succeeded)){
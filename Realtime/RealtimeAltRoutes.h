@@ -52,6 +52,7 @@ void RealtimeAltRoutes_Init_Record (AltRouteTrip *route);
 AltRouteTrip *RealtimeAltRoutes_Get_Record (int index);
 BOOL RealtimeAltRoutes_Add_Route (AltRouteTrip *route);
 BOOL RealtimeAltRoutes_Route_Request(int iTripId, const RoadMapPosition *from_pos, const RoadMapPosition *to_pos, int max_routes, BOOL showListFirst);
+void RealtimeAltRoutes_Local_Routes(int num_res, const NavigateRouteResult *res, BOOL showListFirst);
 BOOL RealtimeAltRoutes_TripRoute_Request(int iTripId, const RoadMapPosition *from_pos, const RoadMapPosition *to_pos, int max_routes);
 NavigateRouteResult *RealtimeAltRoutes_Get_Route_Result(int index);
 int RealtimeAltRoutes_Get_Num_Routes();
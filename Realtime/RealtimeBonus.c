@@ -140,6 +140,7 @@ void RealTimeBonus_SegmentChangedCB (PluginLine *current, int direction){
 
    gBonusTable.bonus[g_CustomIndex]->position.latitude = pos.latitude;
    gBonusTable.bonus[g_CustomIndex]->position.longitude = pos.longitude;
+   roadmap_alerter_provider_changed (&RoadmapRealTimeMapbonusnsProvider);
    //Adding the custom bonus
    if (roadmap_map_settings_road_goodies()){
       static RoadMapSoundList list;
@@ -277,6 +278,7 @@ void RealtimeBonus_RemoveFromTable (int iID) {
          for (j = i; j < MAX_ADD_ONS-1; j++) {
                gBonusTable.bonus[j] = gBonusTable.bonus[j+1];
          }
+         roadmap_alerter_provider_changed (&RoadmapRealTimeMapbonusnsProvider);
          return;
       }
    }
@@ -863,6 +865,9 @@ BOOL RealtimeBonus_Add (RTBonus *pbonus) {
       g_CustomIndex = index;
    }
 
+   // After the custom bonus radius is set, as the alerter index keeps the distances
+   roadmap_alerter_provider_changed (&RoadmapRealTimeMapbonusnsProvider);
+
    if (gBonusTable.bonus[index]->pCollectIcon && roadmap_res_get(RES_BITMAP,RES_SKIN, gBonusTable.bonus[index]->pCollectIcon) == NULL){
       roadmap_res_download(RES_DOWNLOAD_IMAGE, gBonusTable.bonus[index]->pCollectIcon,NULL, "",FALSE,0, NULL, NULL );
    }
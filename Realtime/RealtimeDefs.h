@@ -35,6 +35,7 @@
 #define  RT_THRESHOLD_TO_DISABLE_SERVICE__MAX_NETWORK_ERRORS_SUCCESSIVE       (100)
 #define  RT_THRESHOLD_TO_DISABLE_SERVICE__MAX_SECONDS_FROM_LAST_SESSION       (20*60)
 #define  RT_THRESHOLD_TO_ENTER_SILENT_MODE__MAX_NETWORK_ERRORS_SUCCESSIVE     (5)
+#define  RT_MIN_SECONDS_BETWEEN_OFFLINE_DUMPS                                 (2*60)
 
 // Warning initialization timeout in milli-seconds
 #define  RT_WARNING_INIT_TO			(30000)
@@ -28,6 +28,7 @@
 #include "Realtime.h"
 #include "RealtimeSystemMessage.h"
 #include "RealtimeExternalPoiNotifier.h"
+#include "RealtimePath.h"
 
 #include "../roadmap_gps.h"
 #include "../roadmap_start.h"
@@ -167,6 +168,14 @@ BOOL  RTNet_Init()
    gs_WST_Routing = wst_init( gs_WebServiceAddress, gs_WebServiceSecuredAddress, gs_WebServiceSecuredAddressResolved, gs_WebServiceV2Suffix, "binary/octet-stream");
    assert( gs_WST_Routing);
 
+   // Build the tag lookup tables of the common parsers up front:
+   wst_register_parsers( gs_WST, login_parser, sizeof(login_parser)/sizeof(wst_parser));
+   wst_register_parsers( gs_WST, general_parser, sizeof(general_parser)/sizeof(wst_parser));
+   wst_register_parsers( gs_WST_Routing, general_parser, sizeof(general_parser)/sizeof(wst_parser));
+
+   // Road info geometry can be longer than the receive buffer:
+   wst_register_partial_lines_parser( RoadInfoGeom);
+
    return (NULL != gs_WST);
 }
 
@@ -876,53 +885,13 @@ BOOL RTNet_CreateNewRoads( LPRTConnectionInfo   pCI,
    return bRes;
 }
 
-
-void RTNet_GPSPath_BuildCommand( char*             Packet,
-                                 LPGPSPointInTime  points,
-                                 int               count,
-                                 BOOL					end_track)
+static BOOL CompactPathSupported( LPRTConnectionInfo pCI, const char* packet_only)
 {
-   int      i;
-   char     temp[RTNET_GPSPATH_BUFFERSIZE_single_row+1];
-
-   if( (count >= 2) && (RTTRK_GPSPATH_MAX_POINTS >= count))
-   {
-	   sprintf( Packet, "GPSPath,%u,%u", (uint32_t)points->GPS_time, (3 * count));
-
-	   for( i=0; i<count; i++)
-	   {
-	      char  gps_point[RoadMapPosition_STRING_MAXSIZE+1];
-	      int   seconds_gap = 0;
-
-	      if( i)
-	         seconds_gap = (int)(points[i].GPS_time - points[i-1].GPS_time);
+   //   Packets kept for later (offline) may be sent in another session
+   if( packet_only)
+      return FALSE;
 
-	      assert( !GPSPOINTINTIME_IS_INVALID(points[i]));
-/*
-	      if (points[i].Position.longitude < 20000000 ||
-	      	 points[i].Position.longitude > 40000000 ||
-	      	 points[i].Position.latitude < 20000000 ||
-	      	 points[i].Position.latitude > 40000000 ||
-	      	 seconds_gap < 0 ||
-	      	 seconds_gap > 1000) {
-
-	      	roadmap_log (ROADMAP_ERROR, "Invalid GPS sequence: %d,%d,%d",
-	      					 points[i].Position.longitude,
-	      					 points[i].Position.latitude,
-	      					 seconds_gap);
-	      }
-*/
-	      format_RoadMapPosition_string( gps_point, &(points[i].Position));
-	      sprintf( temp, ",%s,%d,%d", gps_point, points[i].altitude, seconds_gap);
-	      strcat( Packet, temp);
-	   }
-	   strcat( Packet, "\n");
-   }
-
-   if (end_track)
-   {
-   	strcat( Packet, "GPSDisconnect\n");
-   }
+   return (RTNET_PROTOCOL_VERSION_COMPACT_PATH <= pCI->iServerMaxProtocol);
 }
 
 BOOL RTNet_GPSPath(  LPRTConnectionInfo   pCI,
@@ -933,7 +902,11 @@ BOOL RTNet_GPSPath(  LPRTConnectionInfo   pCI,
                      char*                packet_only)
 {
    ebuffer Packet;
+   ebuffer Data;
    char*    GPSPathBuffer = NULL;
+   char*    Buffer;
+   unsigned char* DataBuffer = NULL;
+   BOOL     bCompact = CompactPathSupported( pCI, packet_only);
    int      iRangeBegin;
    BOOL     bRes;
    int      i;
@@ -942,6 +915,7 @@ BOOL RTNet_GPSPath(  LPRTConnectionInfo   pCI,
       return FALSE;
 
    ebuffer_init( &Packet);
+   ebuffer_init( &Data);
 
    if( RTTRK_GPSPATH_MAX_POINTS < count) {
       roadmap_log (ROADMAP_ERROR, "GPSPath too long, dropping first %d points", count - RTTRK_GPSPATH_MAX_POINTS);
@@ -954,6 +928,10 @@ BOOL RTNet_GPSPath(  LPRTConnectionInfo   pCI,
 
    GPSPathBuffer = ebuffer_alloc( &Packet, RTNET_GPSPATH_BUFFERSIZE__dynamic(count));
    memset( GPSPathBuffer, 0, RTNET_GPSPATH_BUFFERSIZE__dynamic(count));
+   Buffer = GPSPathBuffer;
+
+   if( bCompact)
+      DataBuffer = (unsigned char*)ebuffer_alloc( &Data, RTNET_COMPACT_PATH_POINT_MAXSIZE * (count + 1));
 
    iRangeBegin = 0;
    for( i=0; i<count; i++)
@@ -962,12 +940,14 @@ BOOL RTNet_GPSPath(  LPRTConnectionInfo   pCI,
       {
          int               iPointsCount= i - iRangeBegin;
          LPGPSPointInTime  FirstPoint  = points + iRangeBegin;
-         char* Buffer = GPSPathBuffer + strlen(GPSPathBuffer);
 
          roadmap_log(ROADMAP_DEBUG,
                      "RTNet_GPSPath(GPS-DISCONNECTION TAG) - Adding %d points to packet. Range offset: %d",
                      iPointsCount, iRangeBegin);
-         RTNet_GPSPath_BuildCommand( Buffer, FirstPoint, iPointsCount, TRUE);
+         if( bCompact)
+            Buffer = RTNet_GPSPath_BuildCompactCommand( Buffer, DataBuffer, FirstPoint, iPointsCount, TRUE);
+         else
+            Buffer = RTNet_GPSPath_BuildCommand( Buffer, FirstPoint, iPointsCount, TRUE);
          iRangeBegin = i+1;
       }
    }
@@ -976,12 +956,14 @@ BOOL RTNet_GPSPath(  LPRTConnectionInfo   pCI,
    {
       LPGPSPointInTime  FirstPoint  = points + iRangeBegin;
       int               iPointsCount= count - iRangeBegin;
-      char*             Buffer      = GPSPathBuffer + strlen(GPSPathBuffer);
 
       roadmap_log(ROADMAP_DEBUG,
                   "RTNet_GPSPath() - Adding range to packet. Range begin: %d; Range end: %d (count-1)",
                   iRangeBegin, (count - 1));
-      RTNet_GPSPath_BuildCommand( Buffer, FirstPoint, iPointsCount, FALSE);
+      if( bCompact)
+         Buffer = RTNet_GPSPath_BuildCompactCommand( Buffer, DataBuffer, FirstPoint, iPointsCount, FALSE);
+      else
+         Buffer = RTNet_GPSPath_BuildCommand( Buffer, FirstPoint, iPointsCount, FALSE);
    }
 
    assert(*GPSPathBuffer);
@@ -1001,6 +983,7 @@ BOOL RTNet_GPSPath(  LPRTConnectionInfo   pCI,
                               pCI,
                               GPSPathBuffer);      //   Custom data
 
+   ebuffer_free( &Data);
    ebuffer_free( &Packet);
    return bRes;
 }
@@ -1016,8 +999,8 @@ BOOL RTNet_NodePath( LPRTConnectionInfo   pCI,
 {
    ebuffer Packet;
    char*    NodePathBuffer = NULL;
+   char*    Buffer;
    int      i;
-   char     temp[RTNET_NODEPATH_BUFFERSIZE_temp+1];
    BOOL     bRes;
    BOOL     bAddUserPoints = FALSE;
 
@@ -1047,35 +1030,45 @@ BOOL RTNet_NodePath( LPRTConnectionInfo   pCI,
 
    NodePathBuffer = ebuffer_alloc( &Packet, RTNET_GPSPATH_BUFFERSIZE__dynamic(count));
 
-   memset( NodePathBuffer, 0, sizeof(NodePathBuffer));
-   sprintf( NodePathBuffer, "NodePath,%d,", (unsigned int)period_begin);//(period_end-period_begin));
-   sprintf( temp, "%d", 2 * count);
-   strcat( NodePathBuffer, temp);
-
-   for( i=0; i<count; i++)
+   if( CompactPathSupported( pCI, packet_only))
    {
-      int   seconds_gap = 0;
+      ebuffer        Data;
+      unsigned char* DataBuffer;
 
-      if( i)
-         seconds_gap = (int)(nodes[i].GPS_time - nodes[i-1].GPS_time);
+      ebuffer_init( &Data);
+      DataBuffer = (unsigned char*)ebuffer_alloc( &Data, RTNET_COMPACT_PATH_POINT_MAXSIZE * (count + 1));
 
-      sprintf( temp, ",%d,%d", nodes[i].node, seconds_gap);
-      strcat( NodePathBuffer, temp);
+      RTNet_NodePath_BuildCompactCommand( NodePathBuffer, DataBuffer, period_begin,
+                                          nodes, count, user_points, bAddUserPoints);
+      ebuffer_free( &Data);
    }
-
-   if (bAddUserPoints) {
-      sprintf( temp, ",%d", EDITOR_POINT_TYPE_MUNCHING);
-      strcat( NodePathBuffer, temp);
+   else
+   {
+      Buffer = NodePathBuffer;
+      Buffer += sprintf( Buffer, "NodePath,%d,%d", (unsigned int)period_begin, 2 * count);//(period_end-period_begin));
 
       for( i=0; i<count; i++)
       {
-         int version_gap = user_points[i].version;
+         int   seconds_gap = 0;
 
          if( i)
-            version_gap = user_points[i].version - user_points[i-1].version;
+            seconds_gap = (int)(nodes[i].GPS_time - nodes[i-1].GPS_time);
 
-         sprintf( temp, ",%d,%d", user_points[i].points, version_gap);
-         strcat( NodePathBuffer, temp);
+         Buffer += sprintf( Buffer, ",%d,%d", nodes[i].node, seconds_gap);
+      }
+
+      if (bAddUserPoints) {
+         Buffer += sprintf( Buffer, ",%d", EDITOR_POINT_TYPE_MUNCHING);
+
+         for( i=0; i<count; i++)
+         {
+            int version_gap = user_points[i].version;
+
+            if( i)
+               version_gap = user_points[i].version - user_points[i-1].version;
+
+            Buffer += sprintf( Buffer, ",%d,%d", user_points[i].points, version_gap);
+         }
       }
    }
 
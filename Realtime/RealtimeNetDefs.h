@@ -36,6 +36,7 @@
 #define  RTNET_SERVERCOOKIE_MAXSIZE             (63)
 #define  RTNET_WEBSERVICE_ADDRESS               ("")
 #define  RTNET_PROTOCOL_VERSION                 (150)
+#define  RTNET_PROTOCOL_VERSION_COMPACT_PATH    (151)  /* Server accepts 'GPSPathZ' and 'NodePathZ' */
 #define  RTNET_PACKET_MAXSIZE                   MESSAGE_MAX_SIZE__AllTogether
 #define  RTNET_PACKET_MAXSIZE__dynamic(_GPSPointsCount_,_NodesPointsCount_)      \
                MESSAGE_MAX_SIZE__AllTogether__dynamic(_GPSPointsCount_,_NodesPointsCount_)
@@ -43,6 +44,7 @@
 //efine  RTNET_HTTP_STATUS_STRING_MAXSIZE       (63)
 #define  RTTRK_GPSPATH_MAX_POINTS               (100)
 #define  RTTRK_NODEPATH_MAX_POINTS              (60)
+#define  RTNET_COMPACT_PATH_POINT_MAXSIZE       (20)   /* Four 5-byte varints */
 #define  RTTRK_CREATENEWROADS_MAX_TOGGLES       (40)
 #define  RTTRK_MIN_VARIANT_THRESHOLD            (5)
 #define  RTTRK_MIN_DISTANCE_BETWEEN_POINTS      (2)
@@ -1254,7 +1254,6 @@ const char* AddAlert(   /* IN  */   const char*       pNext,
 {
    RTAlert  alert;
    int      iBufferSize;
-   char     tempBuff[5];
 
    //   Initialize structure:
    RTAlerts_Alert_Init(&alert);
@@ -1437,13 +1436,11 @@ const char* AddAlert(   /* IN  */   const char*       pNext,
     }
 
    //   Read If the alert was reported by me
-   iBufferSize = sizeof(tempBuff);
-   pNext       = ExtractNetworkString(
-                  pNext,             // [in]     Source string
-                  tempBuff,//   [out]   Output buffer
-                  &iBufferSize,      // [in,out] Buffer size / Size of extracted string
-                  ",",          //   [in]   Array of chars to terminate the copy operation
-                  1);   // [in]     Remove additional termination chars
+   pNext = ReadBoolFromString(
+                  pNext,            //   [in]      Source string
+                  ",",              //   [in]      Value termination
+                  &alert.bAlertByMe,//   [out]     Put it here
+                  1);               //   [in]      Remove additional termination CHARS
 
     if( !pNext)
     {
@@ -1452,12 +1449,6 @@ const char* AddAlert(   /* IN  */   const char*       pNext,
          return NULL;
     }
 
-
-   if (tempBuff[0] == 'T')
-     alert.bAlertByMe = TRUE;
-   else
-     alert.bAlertByMe = FALSE;
-
   	//   Read near Str
    iBufferSize = RT_ALERT_LOCATION_MAX_SIZE;
    pNext = ExtractNetworkString(
@@ -1526,14 +1517,11 @@ const char* AddAlert(   /* IN  */   const char*       pNext,
                   1);   //   [in]   Remove additional termination chars
 
    //   Read If the alert is a ping for me
-   iBufferSize = sizeof(tempBuff);
-   tempBuff[0] = 0;
-   pNext       = ExtractNetworkString(
-                   pNext,             // [in]     Source string
-                   tempBuff,//   [out]   Output buffer
-                   &iBufferSize,      // [in,out] Buffer size / Size of extracted string
-                   ",",          //   [in]   Array of chars to terminate the copy operation
-                   1);   // [in]     Remove additional termination chars
+   pNext = ReadBoolFromString(
+                  pNext,            //   [in]      Source string
+                  ",",              //   [in]      Value termination
+                  &alert.bPingWazer,//   [out]     Put it here
+                  1);               //   [in]      Remove additional termination CHARS
 
    if( !pNext)
    {
@@ -1542,20 +1530,12 @@ const char* AddAlert(   /* IN  */   const char*       pNext,
        return NULL;
    }
 
-   if (tempBuff[0] == 'T')
-      alert.bPingWazer = TRUE;
-   else
-      alert.bPingWazer = FALSE;
-
    //   Read If the alert is on my route
-   iBufferSize = sizeof(tempBuff);
-   tempBuff[0] = 0;
-   pNext       = ExtractNetworkString(
-                    pNext,             // [in]     Source string
-                    tempBuff,//   [out]   Output buffer
-                    &iBufferSize,      // [in,out] Buffer size / Size of extracted string
-                    ",",          //   [in]   Array of chars to terminate the copy operation
-                    1);   // [in]     Remove additional termination chars
+   pNext = ReadBoolFromString(
+                  pNext,            //   [in]      Source string
+                  ",",              //   [in]      Value termination
+                  &alert.bAlertIsOnRoute,//   [out]     Put it here
+                  1);               //   [in]      Remove additional termination CHARS
 
     if( !pNext)
     {
@@ -1564,11 +1544,6 @@ const char* AddAlert(   /* IN  */   const char*       pNext,
         return NULL;
     }
 
-    if (tempBuff[0] == 'T'){
-       alert.bAlertIsOnRoute = TRUE;
-    }else
-       alert.bAlertIsOnRoute = FALSE;
-
    //   Alert Type - Optional
    if(',' == (*pNext))
    {
@@ -1643,14 +1618,11 @@ const char* AddAlert(   /* IN  */   const char*       pNext,
    }
 
    //  Show Facebook Image
-   iBufferSize = sizeof(tempBuff);
-   tempBuff[0] = 0;
-   pNext       = ExtractNetworkString(
-                    pNext,             // [in]     Source string
-                    tempBuff,//   [out]   Output buffer
-                    &iBufferSize,      // [in,out] Buffer size / Size of extracted string
-                    ",",          //   [in]   Array of chars to terminate the copy operation
-                    1);   // [in]     Remove additional termination chars
+   pNext = ReadBoolFromString(
+                  pNext,            //   [in]      Source string
+                  ",",              //   [in]      Value termination
+                  &alert.bShowFacebookPicture,//   [out]     Put it here
+                  1);               //   [in]      Remove additional termination CHARS
 
     if( !pNext)
     {
@@ -1659,11 +1631,6 @@ const char* AddAlert(   /* IN  */   const char*       pNext,
         return NULL;
     }
 
-    if (tempBuff[0] == 'T')
-       alert.bShowFacebookPicture = TRUE;
-    else
-       alert.bShowFacebookPicture = FALSE;
-
     //   group
     iBufferSize = RT_ALERT_GROUP_MAXSIZE;
     pNext       = ExtractNetworkString(
@@ -1730,14 +1697,11 @@ const char* AddAlert(   /* IN  */   const char*       pNext,
 
     // Is this an archive alert
 
-    iBufferSize = sizeof(tempBuff);
-    tempBuff[0] = 0;
-    pNext       = ExtractNetworkString(
-                    pNext,             // [in]     Source string
-                    tempBuff,//   [out]   Output buffer
-                    &iBufferSize,      // [in,out] Buffer size / Size of extracted string
-                    ",",          //   [in]   Array of chars to terminate the copy operation
-                    1);   // [in]     Remove additional termination chars
+    pNext = ReadBoolFromString(
+                   pNext,            //   [in]      Source string
+                   ",",              //   [in]      Value termination
+                   &alert.bArchive,  //   [out]     Put it here
+                   1);               //   [in]      Remove additional termination CHARS
 
     if( !pNext)
     {
@@ -1746,12 +1710,6 @@ const char* AddAlert(   /* IN  */   const char*       pNext,
         return NULL;
     }
 
-    if (tempBuff[0] == 'T') {
-       alert.bArchive = TRUE;
-    } else {
-       alert.bArchive = FALSE;
-    }
-
     //   Subtype
      pNext = ReadIntFromString(
               pNext,            //   [in]      Source string
@@ -1784,14 +1742,11 @@ const char* AddAlert(   /* IN  */   const char*       pNext,
 
 
     //  Thumbs Up by Me
-    iBufferSize = sizeof(tempBuff);
-    tempBuff[0] = 0;
-    pNext       = ExtractNetworkString(
-                     pNext,             // [in]     Source string
-                     tempBuff,//   [out]   Output buffer
-                     &iBufferSize,      // [in,out] Buffer size / Size of extracted string
-                     ",",          //   [in]   Array of chars to terminate the copy operation
-                     1);   // [in]     Remove additional termination chars
+    pNext = ReadBoolFromString(
+                   pNext,            //   [in]      Source string
+                   ",",              //   [in]      Value termination
+                   &alert.bThumbsUpByMe,//   [out]     Put it here
+                   1);               //   [in]      Remove additional termination CHARS
 
      if( !pNext)
      {
@@ -1800,11 +1755,6 @@ const char* AddAlert(   /* IN  */   const char*       pNext,
          return NULL;
      }
 
-     if (tempBuff[0] == 'T')
-        alert.bThumbsUpByMe = TRUE;
-     else
-        alert.bThumbsUpByMe = FALSE;
-
    //   Read voice ID:
    iBufferSize = RT_ALERT_VOICEID_MAXSIZE;
    pNext = ExtractNetworkString(
@@ -1952,7 +1902,6 @@ const char* AddAlertComment(  /* IN  */   const char*       pNext,
    int                  iBufferSize;
    char                 reportedBy[5];
    char                 Displayed[5];
-   char                 tempBuff[5];
 
    //   Initialize structure:
    RTAlerts_Comment_Init(&comment);
@@ -2135,14 +2084,11 @@ const char* AddAlertComment(  /* IN  */   const char*       pNext,
    }
 
    //  Show Facebook Image
-   iBufferSize = sizeof(tempBuff);
-   tempBuff[0] = 0;
-   pNext       = ExtractNetworkString(
-                    pNext,             // [in]     Source string
-                    tempBuff,//   [out]   Output buffer
-                    &iBufferSize,      // [in,out] Buffer size / Size of extracted string
-                    ",\r\n",          //   [in]   Array of chars to terminate the copy operation
-                    TRIM_ALL_CHARS);   // [in]     Remove additional termination chars
+   pNext = ReadBoolFromString(
+                  pNext,            //   [in]      Source string
+                  ",\r\n",          //   [in]      Value termination
+                  &comment.bShowFacebookPicture,//   [out]     Put it here
+                  TRIM_ALL_CHARS);  //   [in]      Remove additional termination CHARS
 
     if( !pNext)
     {
@@ -2151,11 +2097,6 @@ const char* AddAlertComment(  /* IN  */   const char*       pNext,
         return NULL;
     }
 
-    if (tempBuff[0] == 'T')
-       comment.bShowFacebookPicture = TRUE;
-    else
-       comment.bShowFacebookPicture = FALSE;
-
 
    //   Add the Comment
    if( !RTAlerts_Comment_Add(&comment))
@@ -2213,7 +2154,6 @@ const char* AddRoadInfo(/* IN  */   const char*       pNext,
    RTTrafficInfo  trafficInfo;
    int            iBufferSize;
    int				iSpeedTimes10;
-   char           tempBuff[5];
    //   Initialize structure:
    RTTrafficInfo_InitRecord(&trafficInfo);
 
@@ -2369,14 +2309,11 @@ const char* AddRoadInfo(/* IN  */   const char*       pNext,
    trafficInfo.iNumGeometryPoints = 0;
 
    //   Read If the alert is on my route
-   iBufferSize = sizeof(tempBuff);
-   tempBuff[0] = 0;
-   pNext       = ExtractNetworkString(
-                    pNext,             // [in]     Source string
-                    tempBuff,//   [out]   Output buffer
-                    &iBufferSize,      // [in,out] Buffer size / Size of extracted string
-                    ",",          //   [in]   Array of chars to terminate the copy operation
-                    1);   // [in]     Remove additional termination chars
+   pNext = ReadBoolFromString(
+                  pNext,            //   [in]      Source string
+                  ",",              //   [in]      Value termination
+                  &trafficInfo.bIsOnRoute,//   [out]     Put it here
+                  1);               //   [in]      Remove additional termination CHARS
 
     if( !pNext)
     {
@@ -2385,20 +2322,12 @@ const char* AddRoadInfo(/* IN  */   const char*       pNext,
         return NULL;
     }
 
-    if (tempBuff[0] == 'T')
-       trafficInfo.bIsOnRoute = TRUE;
-    else
-       trafficInfo.bIsOnRoute = FALSE;
-
     //   Read If the jam is alertable
-    iBufferSize = sizeof(tempBuff);
-    tempBuff[0] = 0;
-    pNext       = ExtractNetworkString(
-                     pNext,             // [in]     Source string
-                     tempBuff,//   [out]   Output buffer
-                     &iBufferSize,      // [in,out] Buffer size / Size of extracted string
-                     ",\r\n",          //   [in]   Array of chars to terminate the copy operation
-                     TRIM_ALL_CHARS);   // [in]     Remove additional termination chars
+    pNext = ReadBoolFromString(
+                   pNext,            //   [in]      Source string
+                   ",\r\n",          //   [in]      Value termination
+                   &trafficInfo.bIsAlertable,//   [out]     Put it here
+                   TRIM_ALL_CHARS);  //   [in]      Remove additional termination CHARS
 
      if( !pNext)
      {
@@ -2407,11 +2336,6 @@ const char* AddRoadInfo(/* IN  */   const char*       pNext,
          return NULL;
      }
 
-     if (tempBuff[0] == 'T')
-        trafficInfo.bIsAlertable = TRUE;
-     else
-        trafficInfo.bIsAlertable = FALSE;
-
     //   Add the RoadInfo
     if( !RTTrafficInfo_Add(&trafficInfo))
     {
@@ -2428,110 +2352,148 @@ const char* AddRoadInfo(/* IN  */   const char*       pNext,
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
+//   <ID><num_coords> <longitude_diff><latitude_diff> ...
+//
+//   Geometry lines can be longer than the receive buffer, thus they are parsed
+//   as they arrive (see 'wst_register_partial_lines_parser'). The state of the
+//   line being parsed is kept between the calls; only the realtime session
+//   sends geometry, so one line is parsed at a time.
+typedef struct tag_road_info_geom_state
+{
+   RTTrafficInfo     *pTrafficInfo;
+   int               iID;
+   int               iNumCoords;
+   int               iCoord;
+   RoadMapPosition   lastPosition;
+
+}  road_info_geom_state;
+
+static road_info_geom_state gs_RoadInfoGeom;
+
 const char* RoadInfoGeom(/* IN  */   const char*       pNext,
                          /* IN  */   void*             pContext,
-                         /* OUT */   BOOL*             more_data_needed,
+                         /* IN,OUT */BOOL*             more_data_needed,
                          /* OUT */   roadmap_result*   rc)
 {
-	int					iID;
-	RTTrafficInfo		*pTrafficInfo;
-	int					iNumCoords;
-	RoadMapPosition	lastPosition;
-	RoadMapPosition	diffPosition;
-	int					iCoord;
+   road_info_geom_state *pState = &gs_RoadInfoGeom;
+	RoadMapPosition		diffPosition;
+	string_field			Field;
+	const char*				pField;
 
-   //   1.   Read RoadInfo ID:
-   pNext = ReadIntFromString( pNext,         // [in]     Source string
-                              ",",       		// [in,opt] Value termination
-                              NULL,          // [in,opt] Allowed padding
-                              &iID,          // [out]    Put it here
-                              1);  // [in]     Remove additional termination CHARS
-
-   if( !pNext || (-1 == iID))
+   if( !(*more_data_needed))
    {
-      roadmap_log( ROADMAP_ERROR, "RoadInfoGeom() - Failed to read  ID");
-      (*rc) = err_parser_unexpected_data;
-      return NULL;
+      //   New line:
+      memset( pState, 0, sizeof(road_info_geom_state));
    }
 
-	// Get RoadInfo record
-	pTrafficInfo = RTTrafficInfo_RecordByID (iID);
-	if (pTrafficInfo == NULL)
-	{
-      roadmap_log( ROADMAP_ERROR, "RoadInfoGeom() - ID not matching a road info");
-      (*rc) = err_parser_failed;
-      return NULL;
-	}
+   (*more_data_needed) = FALSE;
 
-   //   2.   Read Number of points:
-   pNext = ReadIntFromString( pNext,         // [in]     Source string
-                              ",",       		// [in,opt] Value termination
-                              NULL,          // [in,opt] Allowed padding
-                              &iNumCoords,          // [out]    Put it here
-                              1);  // [in]     Remove additional termination CHARS
-
-   if( !pNext )
+   if( !pState->pTrafficInfo)
    {
-      roadmap_log( ROADMAP_ERROR, "RoadInfoGeom() - Failed to read  iNumCoords");
-      (*rc) = err_parser_unexpected_data;
-      return NULL;
-   }
+      //   1.   Read RoadInfo ID:
+      pField = ReadFieldFromString( pNext, ",\r\n", &Field, 1);
+      if( pField && !StringFieldToInt( &Field, &pState->iID))
+         pState->iID = -1;
 
-	if (iNumCoords < 2 || iNumCoords % 2 != 0)
-	{
-      roadmap_log( ROADMAP_ERROR, "RoadInfoGeom() - Invalid value %d for  iNumCoords", iNumCoords);
-      (*rc) = err_parser_unexpected_data;
-      return NULL;
-   }
+      //   2.   Read Number of points:
+      if( pField)
+         pField = ReadFieldFromString( pField, ",\r\n", &Field, 1);
 
-   iNumCoords /= 2;
-   lastPosition.latitude = 0;
-   lastPosition.longitude = 0;
+      if( !pField)
+      {
+         //   Header did not arrive yet
+         (*more_data_needed) = TRUE;
+         return pNext;
+      }
 
-   if (iNumCoords > RT_TRAFFIC_INFO_MAX_GEOM)
-   {
-   	roadmap_log (ROADMAP_WARNING, "Too many coords (%d) for road info %d", iNumCoords, iID);
+      if( -1 == pState->iID)
+      {
+         roadmap_log( ROADMAP_ERROR, "RoadInfoGeom() - Failed to read  ID");
+         (*rc) = err_parser_unexpected_data;
+         return NULL;
+      }
+
+      if( !StringFieldToInt( &Field, &pState->iNumCoords))
+      {
+         roadmap_log( ROADMAP_ERROR, "RoadInfoGeom() - Failed to read  iNumCoords");
+         (*rc) = err_parser_unexpected_data;
+         return NULL;
+      }
+
+	   // Get RoadInfo record
+	   pState->pTrafficInfo = RTTrafficInfo_RecordByID (pState->iID);
+	   if (pState->pTrafficInfo == NULL)
+	   {
+         roadmap_log( ROADMAP_ERROR, "RoadInfoGeom() - ID not matching a road info");
+         (*rc) = err_parser_failed;
+         return NULL;
+	   }
+
+	   if (pState->iNumCoords < 2 || pState->iNumCoords % 2 != 0)
+	   {
+         roadmap_log( ROADMAP_ERROR, "RoadInfoGeom() - Invalid value %d for  iNumCoords", pState->iNumCoords);
+         pState->pTrafficInfo = NULL;
+         (*rc) = err_parser_unexpected_data;
+         return NULL;
+      }
+
+      pState->iNumCoords /= 2;
+
+      if (pState->iNumCoords > RT_TRAFFIC_INFO_MAX_GEOM)
+      {
+   	   roadmap_log (ROADMAP_WARNING, "Too many coords (%d) for road info %d", pState->iNumCoords, pState->iID);
+      }
+
+      pState->pTrafficInfo->iNumGeometryPoints = 0;
+      pNext = pField;
    }
 
-   pTrafficInfo->iNumGeometryPoints = 0;
-   for (iCoord = 0; iCoord < iNumCoords; iCoord++)
+   for (; pState->iCoord < pState->iNumCoords; pState->iCoord++)
    {
-	   pNext = ReadIntFromString( pNext,         // [in]     Source string
-	                              ",",       		// [in,opt] Value termination
-	                              NULL,          // [in,opt] Allowed padding
-	                              &diffPosition.longitude,          // [out]    Put it here
-	                              1);  // [in]     Remove additional termination CHARS
+      BOOL bLastCoord = (pState->iCoord == pState->iNumCoords - 1);
 
-	   if( !pNext )
+      //   Both values of the coordinate must be complete:
+	   pField = ReadFieldFromString( pNext, ",", &Field, 1);
+	   if( pField && !StringFieldToInt( &Field, &diffPosition.longitude))
 	   {
-	      roadmap_log( ROADMAP_ERROR, "RoadInfoGeom() - Failed to read coordinate %d", iCoord);
+	      roadmap_log( ROADMAP_ERROR, "RoadInfoGeom() - Failed to read coordinate %d", pState->iCoord);
 	      (*rc) = err_parser_unexpected_data;
 	      return NULL;
 	   }
 
-	   pNext = ReadIntFromString( pNext,         // [in]     Source string
-	                              ",\r\n",       		// [in,opt] Value termination
-	                              NULL,          // [in,opt] Allowed padding
-	                              &diffPosition.latitude,          // [out]    Put it here
-	                              iCoord < iNumCoords - 1 ? 1 : TRIM_ALL_CHARS);  // [in]     Remove additional termination CHARS
+	   if( pField)
+	      pField = ReadFieldFromString( pField, ",\r\n", &Field, bLastCoord ? TRIM_ALL_CHARS : 1);
 
-	   if( !pNext )
+	   //   The line ends with "\r\n", make sure it is all here:
+	   if( pField && bLastCoord && ('\n' != pField[-1]))
+	      pField = NULL;
+
+	   if( !pField)
 	   {
-	      roadmap_log( ROADMAP_ERROR, "RoadInfoGeom() - Failed to read coordinate %d", iCoord);
+	      (*more_data_needed) = TRUE;
+	      return pNext;
+	   }
+
+	   if( !StringFieldToInt( &Field, &diffPosition.latitude))
+	   {
+	      roadmap_log( ROADMAP_ERROR, "RoadInfoGeom() - Failed to read coordinate %d", pState->iCoord);
 	      (*rc) = err_parser_unexpected_data;
 	      return NULL;
 	   }
 
-   	lastPosition.latitude += diffPosition.latitude;
-   	lastPosition.longitude += diffPosition.longitude;
-   	if (iCoord < RT_TRAFFIC_INFO_MAX_GEOM)
+	   pNext = pField;
+
+   	pState->lastPosition.latitude += diffPosition.latitude;
+   	pState->lastPosition.longitude += diffPosition.longitude;
+   	if (pState->iCoord < RT_TRAFFIC_INFO_MAX_GEOM)
    	{
-   		pTrafficInfo->geometry[iCoord] = lastPosition;
-   		pTrafficInfo->iNumGeometryPoints++;
+   		pState->pTrafficInfo->geometry[pState->iCoord] = pState->lastPosition;
+   		pState->pTrafficInfo->iNumGeometryPoints++;
    	}
    }
 
-   RTTrafficInfo_UpdateGeometry (pTrafficInfo);
+   RTTrafficInfo_UpdateGeometry (pState->pTrafficInfo);
+   pState->pTrafficInfo = NULL;
    return pNext;
 }
 
@@ -27,10 +27,27 @@
 #include "roadmap_file.h"
 #include "roadmap_path.h"
 #include "roadmap_dbread.h"
+#include <stdlib.h>
 #include <string.h>
 
+/* The offline files are an append only journal of text commands, one per
+ * line, which is uploaded to the server as is. Each line is written with a
+ * single write, so a crash can only leave a torn last line; it is dropped
+ * when the files are batched for upload.
+ */
+#define RT_OFFLINE_SUFFIX				".wud"
+#define RT_OFFLINE_BATCH_SUFFIX		".tmp"
+#define RT_OFFLINE_BATCH_MAXSIZE		(256 * 1024)
+#define RT_OFFLINE_LINE_MAXSIZE		(16 * 1024)
+
+typedef struct {
+	char	last_auth[256];
+	BOOL	last_disconnect;
+} RTOfflineState;
+
 static RoadMapFile	OfflineFile = ROADMAP_INVALID_FILE;
 static const char 	*OfflineFileName = NULL;
+static RTOfflineState OfflineState;
 
 
 static const char						*gs_OfflinePrefix[] = {
@@ -63,6 +80,7 @@ static void Realtime_OfflineOpenFile (void) {
 		
 		OfflineFile = roadmap_file_open (OfflineFileName, "a");
 		if (ROADMAP_FILE_IS_VALID (OfflineFile)) {
+			memset (&OfflineState, 0, sizeof (OfflineState));
 			RealTime_Auth ();
 		}
 	}
@@ -83,19 +101,79 @@ void		Realtime_OfflineClose (void) {
 }
 
 
-static void	Realtime_OfflineWriteLine (const char *line, int len) {
+static BOOL Realtime_OfflineIsJournaled (const char *line) {
 
 	int i;
-	
+
 	for (i = 0; i < NUM_OFFLINE_PREFIX; i++) {
 		if (strncmp (line, gs_OfflinePrefix[i], strlen (gs_OfflinePrefix[i])) == 0) {
-		
-			Realtime_OfflineOpenFile ();
-			if (!ROADMAP_FILE_IS_VALID (OfflineFile)) return;
-			roadmap_file_write (OfflineFile, line, len);
-			roadmap_file_write (OfflineFile, "\n", 1);
-		} 
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+
+/* Drops lines which repeat the previous state: the same Auth again, or a
+ * GPSDisconnect with no GPS data since the last one.
+ */
+static BOOL Realtime_OfflineIsRedundant (RTOfflineState *state, const char *line, int len) {
+
+	if (strncmp (line, "Auth", 4) == 0) {
+
+		if (len < (int)sizeof (state->last_auth) &&
+			 (int)strlen (state->last_auth) == len &&
+			 strncmp (state->last_auth, line, len) == 0) {
+			return TRUE;
+		}
+
+		if (len < (int)sizeof (state->last_auth)) {
+			memcpy (state->last_auth, line, len);
+			state->last_auth[len] = '\0';
+		} else {
+			state->last_auth[0] = '\0';
+		}
+		return FALSE;
+	}
+
+	if (strncmp (line, "GPSDisconnect", 13) == 0) {
+
+		if (state->last_disconnect) return TRUE;
+		state->last_disconnect = TRUE;
+		return FALSE;
 	}
+
+	if (strncmp (line, "GPSPath", 7) == 0) {
+		state->last_disconnect = FALSE;
+	}
+
+	return FALSE;
+}
+
+
+static void	Realtime_OfflineWriteLine (const char *line, int len) {
+
+	char	buffer[RT_OFFLINE_LINE_MAXSIZE];
+	char	*record = buffer;
+
+	if (!Realtime_OfflineIsJournaled (line)) return;
+
+	Realtime_OfflineOpenFile ();
+	if (!ROADMAP_FILE_IS_VALID (OfflineFile)) return;
+
+	if (Realtime_OfflineIsRedundant (&OfflineState, line, len)) return;
+
+	if (len + 1 > (int)sizeof (buffer)) {
+		record = malloc (len + 1);
+		roadmap_check_allocated (record);
+	}
+
+	memcpy (record, line, len);
+	record[len] = '\n';
+	roadmap_file_write (OfflineFile, record, len + 1);
+
+	if (record != buffer) free (record);
 }
 
 
@@ -115,3 +193,157 @@ void		Realtime_OfflineWrite (const char *packet) {
 		Realtime_OfflineWriteLine (packet, strlen (packet));
 	}
 }
+
+
+static char *Realtime_OfflineReadFile (const char *full_path, int *size) {
+
+	RoadMapFile	file;
+	char			*data;
+	int			length = roadmap_file_length (NULL, full_path);
+
+	if (length <= 0) return NULL;
+
+	file = roadmap_file_open (full_path, "r");
+	if (!ROADMAP_FILE_IS_VALID (file)) return NULL;
+
+	data = malloc (length);
+	roadmap_check_allocated (data);
+
+	if (roadmap_file_read (file, data, length) != length) {
+		roadmap_log (ROADMAP_ERROR, "Realtime_OfflineBatch() - Failed to read %s", full_path);
+		free (data);
+		data = NULL;
+	}
+
+	roadmap_file_close (file);
+
+	/* Drop a torn last line */
+	while (data && length > 0 && data[length - 1] != '\n') length--;
+
+	*size = length;
+	return data;
+}
+
+
+static void Realtime_OfflineCommitBatch (const char *batch_name, char **sources, int count) {
+
+	char	*final_name;
+	int	i;
+	int	len = strlen (batch_name) - strlen (RT_OFFLINE_BATCH_SUFFIX);
+
+	/* The batch replaces the first of its sources */
+	final_name = malloc (len + 1);
+	roadmap_check_allocated (final_name);
+	memcpy (final_name, batch_name, len);
+	final_name[len] = '\0';
+
+	/* The other sources are removed only once the batch is in place */
+	if (roadmap_file_rename (batch_name, final_name) == 0) {
+		for (i = 0; i < count; i++) {
+			if (strcmp (sources[i], final_name)) {
+				roadmap_file_remove (NULL, sources[i]);
+			}
+		}
+	} else {
+		roadmap_log (ROADMAP_ERROR, "Realtime_OfflineBatch() - Failed to rename %s", batch_name);
+		roadmap_file_remove (NULL, batch_name);
+	}
+
+	free (final_name);
+}
+
+
+void		Realtime_OfflineBatch (const char *path) {
+
+	char				**files;
+	char				**cursor;
+	char				**sources;
+	int				sources_count = 0;
+	int				count = 0;
+	char				*batch_name = NULL;
+	RoadMapFile		batch = ROADMAP_INVALID_FILE;
+	int				batch_size = 0;
+	RTOfflineState	state;
+	int				i;
+
+	files = roadmap_path_list (path, RT_OFFLINE_SUFFIX);
+	for (cursor = files; *cursor != NULL; ++cursor) count++;
+
+	sources = calloc (count + 1, sizeof (char *));
+	roadmap_check_allocated (sources);
+
+	for (cursor = files; *cursor != NULL; ++cursor) {
+
+		char	*full_path = roadmap_path_join (path, *cursor);
+		char	*data;
+		char	*line;
+		int	size = 0;
+
+		/* The file being written now goes in a later batch */
+		if ((OfflineFileName && !strcmp (full_path, OfflineFileName)) ||
+			 roadmap_file_length (NULL, full_path) >= RT_OFFLINE_BATCH_MAXSIZE) {
+			roadmap_path_free (full_path);
+			continue;
+		}
+
+		data = Realtime_OfflineReadFile (full_path, &size);
+		if (!data && roadmap_file_length (NULL, full_path) > 0) {
+			roadmap_path_free (full_path);
+			continue;
+		}
+
+		if (ROADMAP_FILE_IS_VALID (batch) && batch_size + size > RT_OFFLINE_BATCH_MAXSIZE) {
+			roadmap_file_close (batch);
+			batch = ROADMAP_INVALID_FILE;
+			Realtime_OfflineCommitBatch (batch_name, sources, sources_count);
+			for (i = 0; i < sources_count; i++) roadmap_path_free (sources[i]);
+			sources_count = 0;
+			free (batch_name);
+		}
+
+		if (!ROADMAP_FILE_IS_VALID (batch)) {
+
+			batch_name = malloc (strlen (full_path) + strlen (RT_OFFLINE_BATCH_SUFFIX) + 1);
+			roadmap_check_allocated (batch_name);
+			sprintf (batch_name, "%s%s", full_path, RT_OFFLINE_BATCH_SUFFIX);
+
+			batch = roadmap_file_open (batch_name, "w");
+			if (!ROADMAP_FILE_IS_VALID (batch)) {
+				roadmap_log (ROADMAP_ERROR, "Realtime_OfflineBatch() - Cannot create %s", batch_name);
+				free (batch_name);
+				free (data);
+				roadmap_path_free (full_path);
+				break;
+			}
+
+			batch_size = 0;
+			memset (&state, 0, sizeof (state));
+		}
+
+		for (line = data; line && line < data + size; ) {
+
+			char	*end = memchr (line, '\n', data + size - line);
+			int	len = end - line;
+
+			if (!Realtime_OfflineIsRedundant (&state, line, len)) {
+				roadmap_file_write (batch, line, len + 1);
+				batch_size += len + 1;
+			}
+			line = end + 1;
+		}
+
+		free (data);
+		sources[sources_count++] = full_path;
+	}
+
+	if (ROADMAP_FILE_IS_VALID (batch)) {
+		roadmap_file_close (batch);
+		Realtime_OfflineCommitBatch (batch_name, sources, sources_count);
+		free (batch_name);
+	}
+
+	for (i = 0; i < sources_count; i++) roadmap_path_free (sources[i]);
+	free (sources);
+
+	roadmap_path_list_free (files);
+}
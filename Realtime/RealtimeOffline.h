@@ -32,4 +32,10 @@ void		Realtime_OfflineClose (void);
 void		Realtime_OfflineWrite (const char *packet);
 void 		Realtime_OfflineWriteServerCookie (const char *cookie);
 
+/* Merges the small offline files in path into fewer, larger files, so
+ * they can be uploaded in fewer requests. The file currently open for
+ * writing is left as is.
+ */
+void		Realtime_OfflineBatch (const char *path);
+
 #endif	//	__REALTIME_OFFLINE_H__
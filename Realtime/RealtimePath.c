@@ -0,0 +1,202 @@
+/*
+ * LICENSE:
+ *
+ *   Copyright 2008 PazO
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License V2 as published by
+ *   the Free Software Foundation.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "RealtimeDefs.h"
+#include "RealtimePath.h"
+
+#include "../roadmap_base64.h"
+#include "../editor/db/editor_point.h"
+
+extern void format_RoadMapPosition_string( char* buffer, const RoadMapPosition* position);
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//   Compact path commands ('GPSPathZ', 'NodePathZ'):
+//   Each value is written as the delta from the previous item, zigzag mapped so that small
+//   negative deltas stay small, in 7-bit varint bytes. The bytes are sent in base64 so the
+//   command remains a single text line. Used only when the server of the session accepts it.
+#define  RTNET_ZIGZAG(_v_)    ((((unsigned int)(_v_)) << 1) ^ (unsigned int)((_v_) >> 31))
+
+static unsigned char* PutVarint( unsigned char* p, unsigned int value)
+{
+   while( 0x80 <= value)
+   {
+      *p++   = (unsigned char)(value | 0x80);
+      value >>= 7;
+   }
+
+   *p++ = (unsigned char)value;
+   return p;
+}
+
+static char* AppendCompactCommand(  char*                Packet,
+                                    const char*          command,
+                                    uint32_t             time_offset,
+                                    int                  count,
+                                    const unsigned char* data,
+                                    int                  size)
+{
+   int   text_size = roadmap_base64_get_buffer_size( size);
+
+   Packet += sprintf( Packet, "%s,%u,%d,", command, time_offset, count);
+   roadmap_base64_encode( data, size, &Packet, text_size);
+
+   return Packet + text_size - 1;
+}
+
+char* RTNet_GPSPath_BuildCommand(   char*             Packet,
+                                    LPGPSPointInTime  points,
+                                    int               count,
+                                    BOOL					end_track)
+{
+   int      i;
+
+   if( (count >= 2) && (RTTRK_GPSPATH_MAX_POINTS >= count))
+   {
+	   Packet += sprintf( Packet, "GPSPath,%u,%u", (uint32_t)points->GPS_time, (3 * count));
+
+	   for( i=0; i<count; i++)
+	   {
+	      char  gps_point[RoadMapPosition_STRING_MAXSIZE+1];
+	      int   seconds_gap = 0;
+
+	      if( i)
+	         seconds_gap = (int)(points[i].GPS_time - points[i-1].GPS_time);
+
+	      assert( !GPSPOINTINTIME_IS_INVALID(points[i]));
+/*
+	      if (points[i].Position.longitude < 20000000 ||
+	      	 points[i].Position.longitude > 40000000 ||
+	      	 points[i].Position.latitude < 20000000 ||
+	      	 points[i].Position.latitude > 40000000 ||
+	      	 seconds_gap < 0 ||
+	      	 seconds_gap > 1000) {
+
+	      	roadmap_log (ROADMAP_ERROR, "Invalid GPS sequence: %d,%d,%d",
+	      					 points[i].Position.longitude,
+	      					 points[i].Position.latitude,
+	      					 seconds_gap);
+	      }
+*/
+	      format_RoadMapPosition_string( gps_point, &(points[i].Position));
+	      Packet += sprintf( Packet, ",%s,%d,%d", gps_point, points[i].altitude, seconds_gap);
+	   }
+	   Packet += sprintf( Packet, "\n");
+   }
+
+   if (end_track)
+   {
+   	Packet += sprintf( Packet, "GPSDisconnect\n");
+   }
+
+   return Packet;
+}
+
+//   <time:uint>,<count:int>,<base64 of (longitude,latitude,altitude,seconds-gap) deltas>
+char* RTNet_GPSPath_BuildCompactCommand( char*             Packet,
+                                         unsigned char*    Data,
+                                         LPGPSPointInTime  points,
+                                         int               count,
+                                         BOOL              end_track)
+{
+   int            i;
+   unsigned char* p = Data;
+
+   if( (count >= 2) && (RTTRK_GPSPATH_MAX_POINTS >= count))
+   {
+      for( i=0; i<count; i++)
+      {
+         assert( !GPSPOINTINTIME_IS_INVALID(points[i]));
+
+         if( i)
+         {
+            p = PutVarint( p, RTNET_ZIGZAG( points[i].Position.longitude - points[i-1].Position.longitude));
+            p = PutVarint( p, RTNET_ZIGZAG( points[i].Position.latitude  - points[i-1].Position.latitude));
+            p = PutVarint( p, RTNET_ZIGZAG( points[i].altitude           - points[i-1].altitude));
+            p = PutVarint( p, RTNET_ZIGZAG( (int)(points[i].GPS_time     - points[i-1].GPS_time)));
+         }
+         else
+         {
+            p = PutVarint( p, RTNET_ZIGZAG( points[i].Position.longitude));
+            p = PutVarint( p, RTNET_ZIGZAG( points[i].Position.latitude));
+            p = PutVarint( p, RTNET_ZIGZAG( points[i].altitude));
+            p = PutVarint( p, 0);
+         }
+      }
+
+      Packet = AppendCompactCommand( Packet, "GPSPathZ", (uint32_t)points->GPS_time, count,
+                                     Data, (int)(p - Data));
+      Packet += sprintf( Packet, "\n");
+   }
+
+   if( end_track)
+      Packet += sprintf( Packet, "GPSDisconnect\n");
+
+   return Packet;
+}
+
+//   <time:uint>,<count:int>,<base64 of (node,seconds-gap) deltas [,munching type,(points,version-gap)...]>
+void RTNet_NodePath_BuildCompactCommand( char*             Packet,
+                                         unsigned char*    Data,
+                                         time_t            period_begin,
+                                         LPNodeInTime      nodes,
+                                         int               count,
+                                         LPUserPointsVer   user_points,
+                                         BOOL              bAddUserPoints)
+{
+   int            i;
+   unsigned char* p = Data;
+
+   for( i=0; i<count; i++)
+   {
+      if( i)
+      {
+         p = PutVarint( p, RTNET_ZIGZAG( nodes[i].node - nodes[i-1].node));
+         p = PutVarint( p, RTNET_ZIGZAG( (int)(nodes[i].GPS_time - nodes[i-1].GPS_time)));
+      }
+      else
+      {
+         p = PutVarint( p, RTNET_ZIGZAG( nodes[i].node));
+         p = PutVarint( p, 0);
+      }
+   }
+
+   if( bAddUserPoints)
+   {
+      p = PutVarint( p, EDITOR_POINT_TYPE_MUNCHING);
+
+      for( i=0; i<count; i++)
+      {
+         int version_gap = user_points[i].version;
+
+         if( i)
+            version_gap = user_points[i].version - user_points[i-1].version;
+
+         p = PutVarint( p, RTNET_ZIGZAG( user_points[i].points));
+         p = PutVarint( p, RTNET_ZIGZAG( version_gap));
+      }
+   }
+
+   AppendCompactCommand( Packet, "NodePathZ", (uint32_t)period_begin, count, Data, (int)(p - Data));
+}
+
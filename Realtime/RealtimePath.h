@@ -0,0 +1,56 @@
+/*
+ * LICENSE:
+ *
+ *   Copyright 2008 PazO
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License V2 as published by
+ *   the Free Software Foundation.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef	__FREEMAP_REALTIMEPATH_H__
+#define	__FREEMAP_REALTIMEPATH_H__
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <time.h>
+#include "RealtimeNetDefs.h"
+#include "../editor/track/editor_track_report.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//   'GPSPath' / 'GPSPathZ' commands for a range of valid points; 'GPSDisconnect' if end_track.
+//   Data is work space of RTNET_COMPACT_PATH_POINT_MAXSIZE bytes per point.
+//   Both return the end of the text written to Packet.
+char* RTNet_GPSPath_BuildCommand(         char*             Packet,
+                                          LPGPSPointInTime  points,
+                                          int               count,
+                                          BOOL              end_track);
+
+char* RTNet_GPSPath_BuildCompactCommand(  char*             Packet,
+                                          unsigned char*    Data,
+                                          LPGPSPointInTime  points,
+                                          int               count,
+                                          BOOL              end_track);
+
+//   'NodePathZ' command, with the munching user points if bAddUserPoints
+void  RTNet_NodePath_BuildCompactCommand( char*             Packet,
+                                          unsigned char*    Data,
+                                          time_t            period_begin,
+                                          LPNodeInTime      nodes,
+                                          int               count,
+                                          LPUserPointsVer   user_points,
+                                          BOOL              bAddUserPoints);
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+#endif	//	__FREEMAP_REALTIMEPATH_H__
@@ -47,6 +47,7 @@
 #include "../editor/editor_points.h"
 #include "../roadmap_ticker.h"
 #include "../navigate/navigate_main.h"
+#include "../navigate/navigate_cost.h"
 
 #include "roadmap_tile.h"
 #include "roadmap_tile_manager.h"
@@ -63,6 +64,7 @@
 
 static RTTrafficInfos gTrafficInfoTable;
 static RTTrafficLines gRTTrafficInfoLinesTable;
+static RoadMapHash   *gRTTrafficInfoLinesHash = NULL;
 static RoadMapTileCallback 		TileCbNext = NULL;
 static RoadMapUnitChangeCallback sNextUnitChangeCb = NULL;
 
@@ -75,6 +77,32 @@ static BOOL RTTrafficInfo_InstrumentSegment(int iLine);
 static void RTTrafficInfo_TileRequest( int tile_id, int version );
 static void RTTrafficInfo_UnitChangeCb (void);
 
+/* The lines table is indexed by (square, line), with the table position as
+ * the hash index, so the routing cost lookups do not scan every segment.
+ */
+static int RTTrafficInfo_LineKey (int line, int square) {
+
+	return (int)(((unsigned int)square * 65599U + (unsigned int)line) & 0x7fffffff);
+}
+
+static void RTTrafficInfo_IndexLine (int index) {
+
+	RTTrafficInfoLines *pLine = gRTTrafficInfoLinesTable.pRTTrafficInfoLines[index];
+
+	roadmap_hash_add (gRTTrafficInfoLinesHash,
+							RTTrafficInfo_LineKey (pLine->iLine, pLine->iSquare), index);
+	navigate_cost_data_changed ();
+}
+
+static void RTTrafficInfo_UnindexLine (int index) {
+
+	RTTrafficInfoLines *pLine = gRTTrafficInfoLinesTable.pRTTrafficInfoLines[index];
+
+	roadmap_hash_remove (gRTTrafficInfoLinesHash,
+								RTTrafficInfo_LineKey (pLine->iLine, pLine->iSquare), index);
+	navigate_cost_data_changed ();
+}
+
  /**
  * Initialize the Traffic info structure
  * @param pTrafficInfo - pointer to the Traffic info
@@ -123,6 +151,11 @@ void RTTrafficInfo_Init()
 		gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i] = NULL;
 	}
 
+	if (gRTTrafficInfoLinesHash == NULL)
+		gRTTrafficInfoLinesHash = roadmap_hash_new ("RTTrafficInfoLines", RT_TRAFFIC_INFO_MAX_LINES);
+	else
+		roadmap_hash_clean (gRTTrafficInfoLinesHash);
+
    TileCbNext = roadmap_tile_register_callback( RTTrafficInfo_TileReceivedCb );
 
    RealtimeTrafficInfoPluginInit();
@@ -185,6 +218,10 @@ void RTTrafficInfo_ClearAll()
    	gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i] = NULL;
    }
 
+	if (gRTTrafficInfoLinesHash)
+		roadmap_hash_clean (gRTTrafficInfoLinesHash);
+
+	navigate_cost_data_changed ();
 }
 
 /**
@@ -360,6 +397,7 @@ BOOL RTTrafficInfo_AddSegments( int iTrafficInfoID, int iSquare, int iVersion, i
 		pLine->iSpeed = pTrafficInfo->iSpeed;
 		pLine->iTrafficInfoId = iTrafficInfoID;
 		pLine->pTrafficInfo = pTrafficInfo;
+		RTTrafficInfo_IndexLine (index);
 
 		if (pTrafficInfo->bIsOnRoute && !pTrafficInfo->bUpdated &&
           roadmap_square_set_current (pLine->iSquare)){
@@ -386,6 +424,7 @@ BOOL RTTrafficInfo_AddSegments( int iTrafficInfoID, int iSquare, int iVersion, i
 		         pAlert->location_info.line_id = pLine->iLine ;
 		         pAlert->location_info.square_id = pLine->iSquare;
 		         pAlert->location_info.time_stamp = pLine->iVersion;
+		         RTAlerts_Location_Changed ();
 
 		         pTrafficInfo->bUpdated = TRUE;
 		      }
@@ -422,10 +461,18 @@ static BOOL RTTraficInfo_DeleteSegments(int iTrafficInfoID){
 
     while (i< gRTTrafficInfoLinesTable.iCount){
     	if (gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i]->iTrafficInfoId == iTrafficInfoID){
+    		RTTrafficInfo_UnindexLine (i);
     		gRTTrafficInfoLinesTable.iCount--;
+    		if (i != gRTTrafficInfoLinesTable.iCount) {
+    			// the last line moves into the freed position
+    			RTTrafficInfo_UnindexLine (gRTTrafficInfoLinesTable.iCount);
+    		}
     		tmp = gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i];
     		gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i] = gRTTrafficInfoLinesTable.pRTTrafficInfoLines[gRTTrafficInfoLinesTable.iCount];
     		gRTTrafficInfoLinesTable.pRTTrafficInfoLines[gRTTrafficInfoLinesTable.iCount] = tmp;
+    		if (i != gRTTrafficInfoLinesTable.iCount) {
+    			RTTrafficInfo_IndexLine (i);
+    		}
     		found = TRUE;
     	}
     	else
@@ -687,6 +734,7 @@ RTTrafficInfoLines *RTTrafficInfo_GetLine(int Record)
  int RTTrafficInfo_Get_Line(int line, int square,  int against_dir){
 	int i;
 	int direction;
+	int found = -1;
 
 	if (gRTTrafficInfoLinesTable.iCount == 0)
 		return -1;
@@ -696,15 +744,19 @@ RTTrafficInfoLines *RTTrafficInfo_GetLine(int Record)
 	else
 		direction = ROUTE_DIRECTION_WITH_LINE;
 
-	for (i = 0; i < gRTTrafficInfoLinesTable.iCount; i++){
+	// keep the lowest matching index, as the former linear scan did
+	for (i = roadmap_hash_get_first (gRTTrafficInfoLinesHash, RTTrafficInfo_LineKey (line, square));
+		  i >= 0;
+		  i = roadmap_hash_get_next (gRTTrafficInfoLinesHash, i)){
 		if (gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i]->isInstrumented &&
 			 gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i]->iLine == line &&
 			 gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i]->iDirection == direction &&
-			 gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i]->iSquare == square)
-			return i;
+			 gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i]->iSquare == square &&
+			 (found < 0 || i < found))
+			found = i;
 	}
 
-	return -1;
+	return found;
 }
 
 /**
@@ -715,18 +767,22 @@ RTTrafficInfoLines *RTTrafficInfo_GetLine(int Record)
  */
 static int RTTrafficInfo_Get_LineNoDirection(int line, int square){
 	int i;
+	int found = -1;
 
 	if (gRTTrafficInfoLinesTable.iCount == 0)
 		return -1;
 
-	for (i = 0; i < gRTTrafficInfoLinesTable.iCount; i++){
+	for (i = roadmap_hash_get_first (gRTTrafficInfoLinesHash, RTTrafficInfo_LineKey (line, square));
+		  i >= 0;
+		  i = roadmap_hash_get_next (gRTTrafficInfoLinesHash, i)){
 		if (gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i]->isInstrumented &&
 			 gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i]->iLine == line &&
-			 gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i]->iSquare == square)
-			return i;
+			 gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i]->iSquare == square &&
+			 (found < 0 || i < found))
+			found = i;
 	}
 
-	return -1;
+	return found;
 }
 
 /**
@@ -31,6 +31,9 @@
 #include <C:\Program Files\Windows CE Tools\Common\Platman\sdk\wce500\include\cecap.h>
 #endif
 
+#ifdef USE_LIBPNG
+#include <png.h>
+#endif
 #ifndef __SYMBIAN32__
 #include <wchar.h>
 #endif
@@ -686,8 +689,73 @@ int roadmap_canvas_height (void) {
 }
 
 
+int roadmap_canvas_buffer_pixel_size (void) {
+   return pixfmt::pix_width;
+}
+
+
 void roadmap_canvas_save_screenshot (const char* filename) {
-   /* NOT IMPLEMENTED. */
+
+#ifdef USE_LIBPNG
+   int width = agg_renb.width();
+   int height = agg_renb.height();
+   png_structp png_ptr;
+   png_infop info_ptr;
+   png_bytep row;
+   FILE *file;
+   int x, y;
+
+   file = roadmap_file_fopen (NULL, filename, "wb");
+   if (!file) {
+      roadmap_log (ROADMAP_ERROR, "Cannot create screenshot file %s", filename);
+      return;
+   }
+
+   png_ptr = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+   info_ptr = png_ptr ? png_create_info_struct (png_ptr) : NULL;
+
+   if (!info_ptr) {
+      png_destroy_write_struct (&png_ptr, NULL);
+      fclose (file);
+      return;
+   }
+
+   row = (png_bytep) malloc (width * 3);
+   roadmap_check_allocated(row);
+
+   if (setjmp (png_jmpbuf (png_ptr))) {
+      roadmap_log (ROADMAP_ERROR, "Failed writing screenshot file %s", filename);
+      png_destroy_write_struct (&png_ptr, &info_ptr);
+      free (row);
+      fclose (file);
+      return;
+   }
+
+   png_init_io (png_ptr, file);
+   png_set_IHDR (png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+   png_write_info (png_ptr, info_ptr);
+
+   /* Going through the pixel format works for both RGB565 and BGRA */
+   for (y = 0; y < height; y++) {
+      for (x = 0; x < width; x++) {
+         agg::rgba8 color = agg_pixf.pixel (x, y);
+         row[x * 3]     = color.r;
+         row[x * 3 + 1] = color.g;
+         row[x * 3 + 2] = color.b;
+      }
+      png_write_row (png_ptr, row);
+   }
+
+   png_write_end (png_ptr, info_ptr);
+   png_destroy_write_struct (&png_ptr, &info_ptr);
+
+   free (row);
+   fclose (file);
+#else
+   roadmap_log (ROADMAP_ERROR, "Screenshots need a build with USE_LIBPNG (%s)", filename);
+#endif
 }
 
 
@@ -923,14 +991,27 @@ static int roadmap_canvas_agg_get_screen_type( int width, int height )
 	return screen_type;
 }
 
-void roadmap_canvas_agg_configure (unsigned char *buf, int width, int height, int stride) {
+void roadmap_canvas_draw_to_buffer (unsigned char *buf, int width, int height, int stride) {
 
-   roadmap_log( ROADMAP_ERROR, "roadmap_canvas_agg_configure, height =%d width=%d",height, width);
    agg_rbuf.attach(buf, width, height, stride);
 
    agg_renb.attach(agg_pixf);
    agg_renb.reset_clipping(true);
    ras.clip_box(0, 0, agg_renb.width() - 1, agg_renb.height() - 1);
+}
+
+void roadmap_canvas_get_buffer (unsigned char **buf, int *width, int *height, int *stride) {
+
+   *buf = agg_rbuf.buf();
+   *width = agg_rbuf.width();
+   *height = agg_rbuf.height();
+   *stride = agg_rbuf.stride();
+}
+
+void roadmap_canvas_agg_configure (unsigned char *buf, int width, int height, int stride) {
+
+   roadmap_log( ROADMAP_ERROR, "roadmap_canvas_agg_configure, height =%d width=%d",height, width);
+   roadmap_canvas_draw_to_buffer (buf, width, height, stride);
 
    agg::glyph_rendering gren = agg::glyph_ren_outline;
    agg::glyph_rendering image_gren = agg::glyph_ren_agg_gray8;
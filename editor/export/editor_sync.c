@@ -72,6 +72,7 @@ static int SyncUploadNumMessages = 0;
 static char SyncUploadMessages[MAX_MSGS][MAX_SIZEOF_RESPONSE_MSG];
 
 static char SyncProgressLabel[100];
+static BOOL SyncUploadInProgress = FALSE;
 
 static int upload_file_size_callback( void *context, size_t aSize );
 static void upload_progress_callback(void *context, char *data, size_t size);
@@ -227,6 +228,14 @@ static int sync_do_upload () {
    int size;
    const char *header;
 
+   if (SyncUploadInProgress) {
+      roadmap_log (ROADMAP_DEBUG, "editor_sync upload already in progress");
+      return 1;
+   }
+
+   /* Send the pending offline files in as few requests as possible */
+   Realtime_OfflineBatch (directory);
+
    files = roadmap_path_list (directory, ".wud");
 
    count = 0;
@@ -234,6 +243,11 @@ static int sync_do_upload () {
       count++;
    }
 
+   if (count == 0) {
+      roadmap_path_list_free (files);
+      return 1;
+   }
+
    //
    cursor = files;
 	count = 0;
@@ -263,6 +277,7 @@ static int sync_do_upload () {
 	  return 0;
 	}
 
+   SyncUploadInProgress = TRUE;
    return 1;
 }
 
@@ -406,6 +421,7 @@ static void upload_progress_callback(void *context, char *data, size_t size) {
 
 static void upload_error_callback( void *context, int connection_failure, const char *format, ...) {
 	upload_context *  uContext = (upload_context *)context;
+	SyncUploadInProgress = FALSE;
 	roadmap_path_list_free(uContext->files);
 	roadmap_path_free(uContext->full_path);
 	free(uContext);
@@ -438,6 +454,7 @@ static void upload_done( void *context, char *last_modified, const char *format,
 
 	if( (*new_cursor == NULL )  || ( SyncUploadNumMessages == MAX_MSGS ) ) {
 		roadmap_path_list_free(uContext->files);
+		SyncUploadInProgress = FALSE;
 		roadmap_log(ROADMAP_DEBUG, "finished uploading editor_sync files");
 
 	}else{
@@ -458,6 +475,7 @@ static void upload_done( void *context, char *last_modified, const char *format,
 		  roadmap_path_free(new_full_path);
 		  roadmap_path_list_free (new_context->files);
 		  free(new_context);
+		  SyncUploadInProgress = FALSE;
 		}
 	}
 
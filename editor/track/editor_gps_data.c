@@ -29,6 +29,7 @@
  *   See editor_gps_data.h
  */
 
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -37,10 +38,15 @@
 #include "roadmap_path.h"
 #include "roadmap_file.h"
 #include "roadmap_gps.h"
+#include "roadmap_nmea.h"
+#include "roadmap_lang.h"
+#include "roadmap_messagebox.h"
 
+#include "editor_track_match.h"
 #include "editor_gps_data.h"
 
 #define DATA_ACTIVE_FILE "current.nmea"
+#define DATA_ACTIVE_NAME "current"
 
 static RoadMapConfigDescriptor ConfigSaveGpsData =
                         ROADMAP_CONFIG_ITEM("FreeMap", "Save GPS data");
@@ -49,6 +55,13 @@ static RoadMapFile GpsDataFile = ROADMAP_INVALID_FILE;
 static int GpsRegistered;
 static int GpsDataActive;
 
+/* The fixes of a recorded file, as decoded by editor_gps_data_match () */
+static RoadMapNmeaAccount GpsDataAccount;
+static RoadMapGpsPosition *GpsDataFixes;
+static time_t *GpsDataTimes;
+static int GpsDataFixesCount;
+static int GpsDataFixesSize;
+
 static char *get_data_dir (void) {
    char *dir = roadmap_path_join (roadmap_path_user (), "GPS");
    return dir;
@@ -168,3 +181,151 @@ void editor_gps_data_export (const char *name) {
    gps_data_status ();
 }
 
+
+
+static void gps_data_rmc (void *context, const RoadMapNmeaFields *fields) {
+
+   RoadMapGpsPosition *fix;
+
+   if (fields->rmc.status != 'A') return;
+
+   if (GpsDataFixesCount == GpsDataFixesSize) {
+      GpsDataFixesSize = GpsDataFixesSize ? GpsDataFixesSize * 2 : 1024;
+      GpsDataFixes = realloc (GpsDataFixes,
+                              GpsDataFixesSize * sizeof(RoadMapGpsPosition));
+      roadmap_check_allocated(GpsDataFixes);
+      GpsDataTimes = realloc (GpsDataTimes, GpsDataFixesSize * sizeof(time_t));
+      roadmap_check_allocated(GpsDataTimes);
+   }
+
+   fix = GpsDataFixes + GpsDataFixesCount;
+   fix->longitude = fields->rmc.longitude;
+   fix->latitude = fields->rmc.latitude;
+   fix->altitude = 0;
+   fix->speed = fields->rmc.speed;
+   fix->steering = fields->rmc.steering;
+   fix->accuracy = 0;
+
+   GpsDataTimes[GpsDataFixesCount++] = fields->rmc.fixtime;
+}
+
+
+static void gps_data_free_fixes (void) {
+
+   free (GpsDataFixes);
+   free (GpsDataTimes);
+   GpsDataFixes = NULL;
+   GpsDataTimes = NULL;
+   GpsDataFixesCount = 0;
+   GpsDataFixesSize = 0;
+}
+
+
+int editor_gps_data_match (const char *name, int *fixes) {
+
+   EditorTrackMatch *matches;
+   char file_name[255];
+   char line[256];
+   char *dir;
+   FILE *file;
+   int matched;
+   int i;
+
+   if (fixes) *fixes = 0;
+   if (!name) name = DATA_ACTIVE_NAME;
+
+   if (!GpsDataAccount) {
+      GpsDataAccount = roadmap_nmea_create ("GPS data");
+      roadmap_nmea_subscribe (NULL, "RMC", gps_data_rmc, GpsDataAccount);
+   }
+
+   dir = get_data_dir ();
+   snprintf (file_name, sizeof(file_name), "%s.nmea", name);
+
+   file = roadmap_file_fopen (dir, file_name, "r");
+   if (!file) {
+      roadmap_log (ROADMAP_ERROR, "Can't open GPS data file: %s", file_name);
+      roadmap_path_free (dir);
+      return -1;
+   }
+
+   while (fgets (line, sizeof(line), file)) {
+
+      int length = strlen (line);
+
+      while (length > 0 &&
+             (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+         line[--length] = 0;
+      }
+
+      if (line[0] != '$') continue;
+
+      roadmap_nmea_decode (NULL, GpsDataAccount, line, length);
+   }
+
+   fclose (file);
+
+   if (!GpsDataFixesCount) {
+      roadmap_path_free (dir);
+      return 0;
+   }
+
+   matches = malloc (GpsDataFixesCount * sizeof(EditorTrackMatch));
+   roadmap_check_allocated(matches);
+
+   matched = editor_track_match (GpsDataFixes, GpsDataFixesCount, matches);
+
+   snprintf (file_name, sizeof(file_name), "%s.match", name);
+   file = roadmap_file_fopen (dir, file_name, "w");
+
+   if (!file) {
+      roadmap_log (ROADMAP_ERROR, "Can't create GPS match file: %s", file_name);
+      matched = -1;
+   } else {
+
+      /* time,longitude,latitude,square,line,direction,distance */
+      for (i = 0; i < GpsDataFixesCount; i++) {
+
+         const EditorTrackMatch *match = matches + i;
+
+         if (matched < 0 || match->line.line_id < 0) {
+            fprintf (file, "%ld,%d,%d,-1,-1,0,-1\n",
+                     (long) GpsDataTimes[i],
+                     GpsDataFixes[i].longitude, GpsDataFixes[i].latitude);
+         } else {
+            fprintf (file, "%ld,%d,%d,%d,%d,%d,%d\n",
+                     (long) GpsDataTimes[i],
+                     GpsDataFixes[i].longitude, GpsDataFixes[i].latitude,
+                     match->line.square, match->line.line_id,
+                     match->line_direction, match->distance);
+         }
+      }
+
+      fclose (file);
+   }
+
+   if (fixes) *fixes = GpsDataFixesCount;
+
+   free (matches);
+   gps_data_free_fixes ();
+   roadmap_path_free (dir);
+
+   return matched;
+}
+
+
+void editor_gps_data_match_active (void) {
+
+   char message[100];
+   int fixes;
+   int matched = editor_gps_data_match (DATA_ACTIVE_NAME, &fixes);
+
+   if (matched < 0) {
+      roadmap_messagebox ("Error", "Can't match the recorded GPS data");
+      return;
+   }
+
+   snprintf (message, sizeof(message), roadmap_lang_get ("%d of %d GPS fixes matched"),
+             matched, fixes);
+   roadmap_messagebox ("Info", message);
+}
@@ -28,6 +28,13 @@ void editor_gps_data_initialize (void);
 void editor_gps_data_shutdown (void);
 void editor_gps_data_export (const char *name);
 
+/* Matches the recorded GPS/<name>.nmea file (NULL for the active one) to
+ * the map, and writes one line per fix to GPS/<name>.match. Returns the
+ * number of matched fixes, or -1 on error.
+ */
+int editor_gps_data_match (const char *name, int *fixes);
+void editor_gps_data_match_active (void);
+
 
 #endif // INCLUDE__EDITOR_GPS_DATA__H
 
@@ -0,0 +1,517 @@
+/* editor_track_match.c - batch map matching of recorded GPS tracks
+ *
+ * LICENSE:
+ *
+ *   Copyright 2005 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * SYNOPSYS:
+ *
+ *   See editor_track_match.h
+ *
+ *   Each GPS point has a few candidate states: a nearby line and a travel
+ *   direction on it. A state is scored by its distance from the point
+ *   (gaussian GPS noise) and by the heading when the car is moving. Moving
+ *   between the states of two consecutive points is scored by how much the
+ *   route between the two projections differs from the straight distance
+ *   between the GPS points. The routes are found with a small Dijkstra
+ *   search on the navigation graph, bounded by the straight distance.
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+
+#include "roadmap.h"
+#include "roadmap_math.h"
+#include "roadmap_gps.h"
+#include "roadmap_hash.h"
+#include "roadmap_layer.h"
+#include "roadmap_line.h"
+#include "roadmap_line_route.h"
+#include "roadmap_square.h"
+#include "roadmap_street.h"
+#include "roadmap_plugin.h"
+#include "navigate/navigate_graph.h"
+#include "navigate/navigate_queue.h"
+
+#include "editor_track_match.h"
+
+#define MATCH_MAX_CANDIDATES  8
+#define MATCH_MAX_STATES      (MATCH_MAX_CANDIDATES * 2)
+#define MATCH_SEARCH_RADIUS   50      /* Meters */
+#define MATCH_SIGMA           10.0    /* GPS noise, meters */
+#define MATCH_BETA            30.0    /* Route vs. straight distance, meters */
+#define MATCH_HEADING_SPEED   5       /* Knots */
+#define MATCH_HEADING_SCALE   45.0    /* Degrees */
+#define MATCH_ROUTE_FACTOR    3
+#define MATCH_ROUTE_SLACK     300     /* Meters */
+#define MATCH_MAX_NODES       2048
+#define MATCH_MAX_SUCCESSORS  32
+
+#define MATCH_IMPOSSIBLE      (-1e30)
+
+typedef struct {
+
+   PluginLine line;
+   int direction;
+   RoadMapPosition position;
+   int distance;     /* Display units, as reported */
+   int offset;       /* From the start of the line, in the travel direction */
+   int remaining;    /* To the end of the line, in the travel direction */
+   double emission;
+   double score;
+   int back;         /* State of the previous point, -1 starts a chain */
+
+} MatchState;
+
+typedef struct {
+
+   int square;
+   int line;
+   int reversed;
+   int to_point;
+   int start;        /* Route length when entering the line, meters */
+   int settled;
+
+} MatchNode;
+
+static MatchState *MatchStates;
+static int MatchStatesCount;
+static int MatchStatesSize;
+
+static MatchNode MatchNodes[MATCH_MAX_NODES];
+static int MatchNodesCount;
+static RoadMapHash *MatchNodesHash;
+static NavigateQueue *MatchQueue;
+
+
+/* roadmap_math_distance () and the line lengths are in display units (feet
+ * or meters), while all the MATCH_* limits and the matching are in meters.
+ */
+static int match_meters (int distance) {
+
+   return roadmap_math_to_cm (distance) / 100;
+}
+
+
+static MatchState *match_new_state (void) {
+
+   if (MatchStatesCount == MatchStatesSize) {
+      MatchStatesSize = MatchStatesSize ? MatchStatesSize * 2 : 256;
+      MatchStates = realloc (MatchStates, MatchStatesSize * sizeof(MatchState));
+      roadmap_check_allocated(MatchStates);
+   }
+
+   return MatchStates + MatchStatesCount++;
+}
+
+
+static void match_focus (const RoadMapPosition *position, int meters,
+                         RoadMapArea *focus) {
+
+   RoadMapPosition other;
+   int lon_units;
+   int lat_units;
+
+   other = *position;
+   other.longitude += 10000;
+   lon_units = (int)((long long)meters * 10000 /
+                        (match_meters (roadmap_math_distance (position, &other)) + 1)) + 1;
+
+   other = *position;
+   other.latitude += 10000;
+   lat_units = (int)((long long)meters * 10000 /
+                        (match_meters (roadmap_math_distance (position, &other)) + 1)) + 1;
+
+   focus->west = position->longitude - lon_units;
+   focus->east = position->longitude + lon_units;
+   focus->north = position->latitude + lat_units;
+   focus->south = position->latitude - lat_units;
+}
+
+
+static void match_add_state (const RoadMapGpsPosition *gps,
+                             const RoadMapNeighbour *neighbour,
+                             int direction, int offset, int total) {
+
+   MatchState *state = match_new_state ();
+   double noise = match_meters (neighbour->distance) / MATCH_SIGMA;
+
+   state->line = neighbour->line;
+   state->direction = direction;
+   state->position = neighbour->intersection;
+   state->distance = neighbour->distance;
+   state->back = -1;
+
+   if (direction == ROUTE_DIRECTION_WITH_LINE) {
+      state->offset = offset;
+   } else {
+      state->offset = total - offset;
+   }
+   state->remaining = total - state->offset;
+
+   state->emission = -0.5 * noise * noise;
+
+   if (gps->speed >= MATCH_HEADING_SPEED) {
+
+      int azymuth;
+
+      if (direction == ROUTE_DIRECTION_WITH_LINE) {
+         azymuth = roadmap_math_azymuth (&neighbour->from, &neighbour->to);
+      } else {
+         azymuth = roadmap_math_azymuth (&neighbour->to, &neighbour->from);
+      }
+
+      state->emission -=
+         roadmap_math_delta_direction (azymuth, gps->steering) /
+            MATCH_HEADING_SCALE;
+   }
+
+   state->score = state->emission;
+}
+
+
+/* Adds the states of one GPS point and returns their count */
+static int match_add_candidates (const RoadMapGpsPosition *gps) {
+
+   RoadMapNeighbour neighbours[MATCH_MAX_CANDIDATES];
+   RoadMapPosition position;
+   RoadMapArea focus;
+   int layers[128];
+   int layer_count;
+   int first = MatchStatesCount;
+   int count;
+   int i;
+
+   layer_count = roadmap_layer_all_roads (layers, 128);
+   if (layer_count <= 0) return 0;
+
+   position.longitude = gps->longitude;
+   position.latitude = gps->latitude;
+
+   match_focus (&position, MATCH_SEARCH_RADIUS, &focus);
+
+   roadmap_math_set_focus (&focus);
+   count = roadmap_street_get_closest
+               (&position, 0, layers, layer_count, 1,
+                neighbours, MATCH_MAX_CANDIDATES);
+   roadmap_math_release_focus ();
+
+   for (i = 0; i < count; i++) {
+
+      RoadMapNeighbour *neighbour = neighbours + i;
+      int direction;
+      int offset;
+      int total;
+
+      /* Only lines of the map take part in the navigation graph */
+      if (neighbour->line.plugin_id != ROADMAP_PLUGIN_ID) continue;
+      if (match_meters (neighbour->distance) > MATCH_SEARCH_RADIUS) continue;
+
+      direction = roadmap_plugin_get_direction (&neighbour->line, ROUTE_CAR_ALLOWED);
+      if (direction == ROUTE_DIRECTION_NONE) continue;
+
+      offset = roadmap_plugin_calc_length
+                  (&neighbour->intersection, &neighbour->line, &total);
+      offset = match_meters (offset);
+      total = match_meters (total);
+
+      if (direction & ROUTE_DIRECTION_WITH_LINE) {
+         match_add_state (gps, neighbour, ROUTE_DIRECTION_WITH_LINE, offset, total);
+      }
+
+      if (direction & ROUTE_DIRECTION_AGAINST_LINE) {
+         match_add_state (gps, neighbour, ROUTE_DIRECTION_AGAINST_LINE, offset, total);
+      }
+   }
+
+   return MatchStatesCount - first;
+}
+
+
+static MatchNode *match_get_node (int square, int line, int reversed) {
+
+   int key = (square << 16) ^ (line << 1) ^ reversed;
+   MatchNode *node;
+   int i;
+
+   for (i = roadmap_hash_get_first (MatchNodesHash, key);
+        i >= 0;
+        i = roadmap_hash_get_next (MatchNodesHash, i)) {
+
+      node = MatchNodes + i;
+      if (node->square == square && node->line == line &&
+          node->reversed == reversed) {
+         return node;
+      }
+   }
+
+   if (MatchNodesCount == MATCH_MAX_NODES) return NULL;
+
+   node = MatchNodes + MatchNodesCount;
+   node->square = square;
+   node->line = line;
+   node->reversed = reversed;
+   node->start = INT_MAX;
+   node->settled = 0;
+
+   roadmap_hash_add (MatchNodesHash, key, MatchNodesCount++);
+
+   return node;
+}
+
+
+static void match_expand (int square, int line, int reversed,
+                          int node_id, int cost) {
+
+   struct successor successors[MATCH_MAX_SUCCESSORS];
+   int count;
+   int i;
+
+   count = get_connected_segments (square, line, reversed, node_id,
+                                   successors, MATCH_MAX_SUCCESSORS, 1, 1);
+
+   for (i = 0; i < count; i++) {
+
+      MatchNode *node = match_get_node (successors[i].square_id,
+                                        successors[i].line_id,
+                                        successors[i].reversed);
+
+      if (!node || node->settled || node->start <= cost) continue;
+
+      node->start = cost;
+      node->to_point = successors[i].to_point;
+      navigate_queue_insert (MatchQueue, cost, node);
+   }
+}
+
+
+/* Finds the route length from one state to each of the states of the next
+ * point. Targets which cannot be reached within the limit get -1.
+ */
+static void match_routes (const MatchState *from,
+                          const MatchState *to, int to_count,
+                          int limit, int *routes) {
+
+   int found = 0;
+   int from_point;
+   int to_point;
+   int i;
+
+   for (i = 0; i < to_count; i++) {
+
+      routes[i] = -1;
+
+      if (to[i].line.square == from->line.square &&
+          to[i].line.line_id == from->line.line_id &&
+          to[i].direction == from->direction) {
+
+         /* Small moves backwards along the line are GPS noise */
+         routes[i] = abs (to[i].offset - from->offset);
+         found++;
+      }
+   }
+
+   if (found == to_count || from->remaining > limit) return;
+
+   MatchNodesCount = 0;
+   roadmap_hash_clean (MatchNodesHash);
+   navigate_queue_reset (MatchQueue);
+
+   roadmap_square_set_current (from->line.square);
+   roadmap_line_points (from->line.line_id, &from_point, &to_point);
+
+   if (from->direction == ROUTE_DIRECTION_WITH_LINE) {
+      match_expand (from->line.square, from->line.line_id, 0,
+                    to_point, from->remaining);
+   } else {
+      match_expand (from->line.square, from->line.line_id, 1,
+                    from_point, from->remaining);
+   }
+
+   while (!navigate_queue_empty (MatchQueue)) {
+
+      MatchNode *node = (MatchNode *) navigate_queue_extract_min (MatchQueue);
+      int reversed;
+      int end;
+
+      if (node->settled) continue;
+      node->settled = 1;
+
+      if (node->start > limit) break;
+
+      for (i = 0; i < to_count; i++) {
+
+         reversed = (to[i].direction == ROUTE_DIRECTION_AGAINST_LINE);
+
+         if (routes[i] < 0 &&
+             to[i].line.square == node->square &&
+             to[i].line.line_id == node->line &&
+             reversed == node->reversed) {
+
+            routes[i] = node->start + to[i].offset;
+            found++;
+         }
+      }
+
+      if (found == to_count) break;
+
+      roadmap_square_set_current (node->square);
+      end = node->start + match_meters (roadmap_line_length (node->line));
+
+      if (end <= limit) {
+         match_expand (node->square, node->line, node->reversed,
+                       node->to_point, end);
+      }
+   }
+}
+
+
+static void match_report (const MatchState *state, EditorTrackMatch *match) {
+
+   match->line = state->line;
+   match->line_direction = state->direction;
+   match->position = state->position;
+   match->distance = state->distance;
+}
+
+
+int editor_track_match (const RoadMapGpsPosition *points, int count,
+                        EditorTrackMatch *matches) {
+
+   int routes[MATCH_MAX_STATES];
+   int *first;
+   int matched = 0;
+   int i;
+   int j;
+   int k;
+
+   if (count <= 0) return 0;
+   if (!points || !matches) return -1;
+
+   if (!MatchNodesHash) {
+      MatchNodesHash = roadmap_hash_new ("track_match", MATCH_MAX_NODES);
+      MatchQueue = navigate_queue_new (NAVIGATE_QUEUE_HEAP, MATCH_MAX_NODES);
+   }
+
+   first = malloc ((count + 1) * sizeof(int));
+   roadmap_check_allocated(first);
+
+   MatchStatesCount = 0;
+
+   for (i = 0; i < count; i++) {
+
+      RoadMapPosition from;
+      RoadMapPosition to;
+      int prev_count;
+      int states;
+      int straight;
+      int limit;
+      int connected = 0;
+
+      first[i] = MatchStatesCount;
+      states = match_add_candidates (points + i);
+
+      if (!i || !states) continue;
+
+      prev_count = first[i] - first[i - 1];
+      if (!prev_count) continue;
+
+      from.longitude = points[i - 1].longitude;
+      from.latitude = points[i - 1].latitude;
+      to.longitude = points[i].longitude;
+      to.latitude = points[i].latitude;
+
+      straight = match_meters (roadmap_math_distance (&from, &to));
+      limit = straight * MATCH_ROUTE_FACTOR + MATCH_ROUTE_SLACK;
+
+      for (j = first[i]; j < first[i] + states; j++) {
+         MatchStates[j].score = MATCH_IMPOSSIBLE;
+      }
+
+      for (k = first[i - 1]; k < first[i]; k++) {
+
+         if (MatchStates[k].score <= MATCH_IMPOSSIBLE) continue;
+
+         match_routes (MatchStates + k, MatchStates + first[i], states,
+                       limit, routes);
+
+         for (j = 0; j < states; j++) {
+
+            MatchState *state = MatchStates + first[i] + j;
+            double score;
+
+            if (routes[j] < 0) continue;
+
+            score = MatchStates[k].score + state->emission -
+                       abs (routes[j] - straight) / MATCH_BETA;
+
+            if (score > state->score) {
+               state->score = score;
+               state->back = k;
+               connected = 1;
+            }
+         }
+      }
+
+      if (!connected) {
+
+         /* No route between the points, start a new chain */
+         for (j = first[i]; j < first[i] + states; j++) {
+            MatchStates[j].score = MatchStates[j].emission;
+            MatchStates[j].back = -1;
+         }
+      }
+   }
+
+   first[count] = MatchStatesCount;
+
+   /* Walk back from the best end state of each chain */
+   for (i = count - 1; i >= 0; ) {
+
+      int best = -1;
+
+      for (j = first[i]; j < first[i + 1]; j++) {
+         if (best < 0 || MatchStates[j].score > MatchStates[best].score) {
+            best = j;
+         }
+      }
+
+      if (best < 0) {
+         matches[i].line.line_id = -1;
+         i--;
+         continue;
+      }
+
+      while (best >= 0) {
+         match_report (MatchStates + best, matches + i);
+         matched++;
+         best = MatchStates[best].back;
+         i--;
+      }
+   }
+
+   free (first);
+
+   free (MatchStates);
+   MatchStates = NULL;
+   MatchStatesSize = 0;
+   MatchStatesCount = 0;
+
+   return matched;
+}
@@ -0,0 +1,52 @@
+/* editor_track_match.h - batch map matching of recorded GPS tracks
+ *
+ * LICENSE:
+ *
+ *   Copyright 2005 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef INCLUDE__EDITOR_TRACK_MATCH__H
+#define INCLUDE__EDITOR_TRACK_MATCH__H
+
+#include "roadmap_gps.h"
+#include "roadmap_plugin.h"
+
+typedef struct {
+
+   PluginLine line;           /* line_id is -1 when the point is not matched */
+   int line_direction;        /* ROUTE_DIRECTION_WITH_LINE or _AGAINST_LINE */
+   RoadMapPosition position;  /* the point projected on the line */
+   int distance;              /* from the GPS point to the line */
+
+} EditorTrackMatch;
+
+/* Matches a complete recorded track against the road network.
+ *
+ * Unlike the live tracking, which has to decide on each point as it
+ * arrives, this looks at the whole track and picks the most likely
+ * sequence of lines (hidden Markov model, solved with Viterbi). The
+ * track is split where no route connects two consecutive points.
+ *
+ * Fills one match per point and returns the number of matched points,
+ * or -1 on error. This uses the global map state and is not reentrant.
+ */
+int editor_track_match (const RoadMapGpsPosition *points, int count,
+                        EditorTrackMatch *matches);
+
+#endif // INCLUDE__EDITOR_TRACK_MATCH__H
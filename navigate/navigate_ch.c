@@ -0,0 +1,1100 @@
+/* navigate_ch.c - contraction hierarchies route calculation
+ *
+ * LICENSE:
+ *
+ *   Copyright 2007 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * SYNOPSYS:
+ *
+ *   See navigate_ch.h
+ *
+ *   The graph nodes are directed line segments, the same as the A* search
+ *   items, so turn restrictions and turn dependent costs are kept intact.
+ *
+ *   Every square is contracted on its own. Segments which continue into
+ *   another square (lines with a fake end point) are never contracted and
+ *   form the core of the hierarchy. The query runs an upward search from
+ *   the goal limited to the goal square, then an A* search from the start
+ *   which climbs up its square, moves over the core and meets the goal
+ *   search.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_config.h"
+#include "roadmap_point.h"
+#include "roadmap_line.h"
+#include "roadmap_square.h"
+#include "roadmap_math.h"
+#include "roadmap_hash.h"
+
+#include "navigate_graph.h"
+#include "navigate_cost.h"
+#include "navigate_ch.h"
+
+#include "navigate_queue.h"
+
+#define HU_SPEED 28 /* Meters per second */
+#define MAX_SUCCESSORS 100
+
+#define CH_MIDDLE_NONE  -1
+#define CH_MIDDLE_CROSS -2
+
+#define CH_NODE_CORE       1
+#define CH_NODE_CONTRACTED 2
+
+#define CH_WITNESS_SETTLE_LIMIT 64
+
+#define CH_BLOCK_SIZE 4096
+#define CH_MAX_BLOCKS 40
+#define MAX_CH_ITEMS (CH_BLOCK_SIZE * CH_MAX_BLOCKS)
+
+#ifdef J2ME
+#define CH_SQUARES_BLOCK 64
+#define MAX_CH_MEM 300000
+#else
+#define CH_SQUARES_BLOCK 256
+#define MAX_CH_MEM 8000000
+#endif
+
+#define CH_INFINITY 0x7fffffff
+
+static RoadMapConfigDescriptor ChEnabledCfg =
+                  ROADMAP_CONFIG_ITEM("Routing", "Contraction hierarchies");
+
+typedef struct {
+   int target;    /* local node, or a cross table index for cross edges */
+   int cost;
+   int middle;    /* the contracted local node, or CH_MIDDLE_* */
+} ChEdge;
+
+typedef struct {
+   int square;
+   int line_id;
+   int reversed;
+} ChCrossNode;
+
+typedef struct {
+   ChEdge *edges;
+   int count;
+   int size;
+} ChEdgeList;
+
+typedef struct {
+   int square_id;
+   int first_line;
+   int nodes_count;
+   unsigned char *flags;
+   RoadMapPosition *positions;
+   int *fwd_index;
+   ChEdge *fwd;
+   int *bwd_index;
+   ChEdge *bwd;
+   ChCrossNode *cross;
+   int cross_count;
+   int mem_size;
+} ChSquare;
+
+static ChSquare **ChSquares;
+static int ChSquaresSize;
+static RoadMapHash *ChSquaresHash;
+static int ChSquaresMem;
+static NavigateCostFn ChCostFn;
+static int ChCostSignature;
+static int ChCostDataVersion;
+
+/* Reused by all the witness searches of one square build */
+static NavigateQueue *ChWitnessQueue;
+
+typedef struct {
+   int square;
+   int node;
+   int dist[2];
+   int parent[2];
+   int middle[2];
+   unsigned char settled[2];
+} ChSearchItem;
+
+static ChSearchItem *ChItems[CH_MAX_BLOCKS];
+static int ChNumItems;
+static RoadMapHash *ChItemsHash;
+
+
+static int node_id (int line_id, int reversed) {
+
+   return line_id * 2 + (reversed != 0);
+}
+
+
+static void edge_list_add (ChEdgeList *list, int target, int cost, int middle) {
+
+   int i;
+
+   /* Cross edges index the cross table, keep them apart from local edges */
+   for (i = 0; middle != CH_MIDDLE_CROSS && i < list->count; i++) {
+      if (list->edges[i].target == target && list->edges[i].middle != CH_MIDDLE_CROSS) {
+         if (cost < list->edges[i].cost) {
+            list->edges[i].cost = cost;
+            list->edges[i].middle = middle;
+         }
+         return;
+      }
+   }
+
+   if (list->count == list->size) {
+      list->size = list->size ? list->size * 2 : 4;
+      list->edges = realloc (list->edges, list->size * sizeof(ChEdge));
+      roadmap_check_allocated(list->edges);
+   }
+
+   list->edges[list->count].target = target;
+   list->edges[list->count].cost = cost;
+   list->edges[list->count].middle = middle;
+   list->count++;
+}
+
+
+static void add_edge (ChEdgeList *out, ChEdgeList *in,
+                      int from, int to, int cost, int middle) {
+
+   edge_list_add (out + from, to, cost, middle);
+   edge_list_add (in + to, from, cost, middle);
+}
+
+
+static int add_cross (ChCrossNode **cross, int *count, int *size,
+                      int square, int line_id, int reversed) {
+
+   if (*count == *size) {
+      *size = *size ? *size * 2 : 16;
+      *cross = realloc (*cross, *size * sizeof(ChCrossNode));
+      roadmap_check_allocated(*cross);
+   }
+
+   (*cross)[*count].square = square;
+   (*cross)[*count].line_id = line_id;
+   (*cross)[*count].reversed = reversed;
+
+   return (*count)++;
+}
+
+
+static int cost_signature (void) {
+
+   return navigate_cost_type () |
+          (navigate_cost_avoid_primaries () << 2) |
+          (navigate_cost_avoid_trails () << 3) |
+          (navigate_cost_prefer_same_street () << 5) |
+          (navigate_cost_allow_unknowns () << 6) |
+          (navigate_cost_use_traffic () << 7);
+}
+
+
+/* Bounded Dijkstra over the not yet contracted nodes, used to decide
+ * whether a shortcut is needed. Leaves the distances in dist, valid where
+ * stamp equals the given stamp.
+ */
+static void witness_search (ChEdgeList *out, const unsigned char *flags,
+                            int *dist, int *stamp, int cur_stamp,
+                            int source, int skip, int max_cost) {
+
+   NavigateQueue *q = ChWitnessQueue;
+   int settled = 0;
+
+   navigate_queue_reset (q);
+
+   dist[source] = 0;
+   stamp[source] = cur_stamp;
+   navigate_queue_insert (q, 0, (void *)(long)source);
+
+   while (!navigate_queue_empty (q) && settled < CH_WITNESS_SETTLE_LIMIT) {
+
+      int cost = navigate_queue_min_key (q);
+      int node = (int)(long)navigate_queue_extract_min (q);
+      int i;
+
+      if (cost > dist[node]) continue;
+      if (cost > max_cost) break;
+      settled++;
+
+      for (i = 0; i < out[node].count; i++) {
+
+         const ChEdge *edge = out[node].edges + i;
+         int new_cost;
+
+         if (edge->middle == CH_MIDDLE_CROSS) continue;
+         if (edge->target == skip) continue;
+         if (flags[edge->target] & CH_NODE_CONTRACTED) continue;
+
+         new_cost = cost + edge->cost;
+         if (stamp[edge->target] != cur_stamp || new_cost < dist[edge->target]) {
+            dist[edge->target] = new_cost;
+            stamp[edge->target] = cur_stamp;
+            navigate_queue_insert (q, new_cost, (void *)(long)edge->target);
+         }
+      }
+   }
+}
+
+
+/* Contracts node v, or only counts the needed shortcuts when simulate
+ * is set. Returns the number of shortcuts.
+ */
+static int contract_node (ChEdgeList *out, ChEdgeList *in, unsigned char *flags,
+                          int *dist, int *stamp, int *cur_stamp,
+                          int v, int simulate) {
+
+   int shortcuts = 0;
+   int i;
+   int j;
+
+   for (i = 0; i < in[v].count; i++) {
+
+      ChEdge in_edge = in[v].edges[i];
+      int u = in_edge.target;
+      int max_cost = 0;
+
+      if (in_edge.middle == CH_MIDDLE_CROSS) continue;
+      if (flags[u] & CH_NODE_CONTRACTED) continue;
+
+      for (j = 0; j < out[v].count; j++) {
+         const ChEdge *out_edge = out[v].edges + j;
+         if (out_edge->middle == CH_MIDDLE_CROSS) continue;
+         if (in_edge.cost + out_edge->cost > max_cost) {
+            max_cost = in_edge.cost + out_edge->cost;
+         }
+      }
+
+      (*cur_stamp)++;
+      witness_search (out, flags, dist, stamp, *cur_stamp, u, v, max_cost);
+
+      for (j = 0; j < out[v].count; j++) {
+
+         ChEdge out_edge = out[v].edges[j];
+         int w = out_edge.target;
+         int cost = in_edge.cost + out_edge.cost;
+
+         if (out_edge.middle == CH_MIDDLE_CROSS) continue;
+         if (w == u || (flags[w] & CH_NODE_CONTRACTED)) continue;
+         if (stamp[w] == *cur_stamp && dist[w] <= cost) continue;
+
+         shortcuts++;
+         if (!simulate) add_edge (out, in, u, w, cost, v);
+      }
+   }
+
+   return shortcuts;
+}
+
+
+static int node_priority (ChEdgeList *out, ChEdgeList *in, unsigned char *flags,
+                          int *dist, int *stamp, int *cur_stamp,
+                          int *deleted_neighbours, int v) {
+
+   int shortcuts = contract_node (out, in, flags, dist, stamp, cur_stamp, v, 1);
+
+   return shortcuts - in[v].count - out[v].count + deleted_neighbours[v];
+}
+
+
+/* Keeps the edges of a node which lead to nodes that were not contracted
+ * yet, that is the upward edges in the hierarchy.
+ */
+static int build_index (ChEdgeList *lists, int count,
+                        int **index, ChEdge **edges) {
+
+   int total = 0;
+   int i;
+   int j;
+
+   for (i = 0; i < count; i++) {
+      total += lists[i].count;
+   }
+
+   *index = malloc ((count + 1) * sizeof(int));
+   roadmap_check_allocated(*index);
+   *edges = malloc ((total ? total : 1) * sizeof(ChEdge));
+   roadmap_check_allocated(*edges);
+
+   total = 0;
+   for (i = 0; i < count; i++) {
+      (*index)[i] = total;
+      for (j = 0; j < lists[i].count; j++) {
+         (*edges)[total++] = lists[i].edges[j];
+      }
+   }
+   (*index)[count] = total;
+
+   return total;
+}
+
+
+static void free_ch_square (ChSquare *ch) {
+
+   free (ch->flags);
+   free (ch->positions);
+   free (ch->fwd_index);
+   free (ch->fwd);
+   free (ch->bwd_index);
+   free (ch->bwd);
+   free (ch->cross);
+   ChSquaresMem -= ch->mem_size;
+   free (ch);
+}
+
+
+static ChSquare *build_ch_square (int square_id) {
+
+   ChSquare *ch;
+   ChEdgeList *out;
+   ChEdgeList *in;
+   ChEdgeList *up_out;
+   ChEdgeList *up_in;
+   int *dist;
+   int *stamp;
+   int *deleted_neighbours;
+   int cur_stamp = 0;
+   int first_line = -1;
+   int last_line = -1;
+   int cross_size = 0;
+   int contracted = 0;
+   int count;
+   int i;
+   int j;
+   NavigateQueue *q;
+   struct successor successors[MAX_SUCCESSORS];
+
+   ch = calloc (1, sizeof(ChSquare));
+   roadmap_check_allocated(ch);
+   ch->square_id = square_id;
+
+   for (i = ROADMAP_ROAD_FIRST; i <= ROADMAP_ROAD_LAST; ++i) {
+
+      int first;
+      int last;
+
+      if (roadmap_line_in_square (square_id, i, &first, &last) > 0) {
+         if (first_line < 0 || first < first_line) first_line = first;
+         if (last > last_line) last_line = last;
+      }
+   }
+
+   ch->first_line = first_line < 0 ? 0 : first_line;
+   ch->nodes_count = first_line < 0 ? 0 : (last_line - first_line + 1) * 2;
+   count = ch->nodes_count;
+
+   ch->flags = calloc (count + 1, sizeof(unsigned char));
+   ch->positions = calloc (count + 1, sizeof(RoadMapPosition));
+   out = calloc (count + 1, sizeof(ChEdgeList));
+   in = calloc (count + 1, sizeof(ChEdgeList));
+   up_out = calloc (count + 1, sizeof(ChEdgeList));
+   up_in = calloc (count + 1, sizeof(ChEdgeList));
+   dist = calloc (count + 1, sizeof(int));
+   stamp = calloc (count + 1, sizeof(int));
+   deleted_neighbours = calloc (count + 1, sizeof(int));
+   ChWitnessQueue = navigate_queue_new (NAVIGATE_QUEUE_RADIX, CH_WITNESS_SETTLE_LIMIT);
+   roadmap_check_allocated(ch->flags);
+   roadmap_check_allocated(ch->positions);
+   roadmap_check_allocated(out);
+   roadmap_check_allocated(in);
+   roadmap_check_allocated(up_out);
+   roadmap_check_allocated(up_in);
+   roadmap_check_allocated(dist);
+   roadmap_check_allocated(stamp);
+   roadmap_check_allocated(deleted_neighbours);
+
+   /* Collect the original edges */
+   for (i = 0; i < count; i++) {
+
+      int line = ch->first_line + i / 2;
+      int reversed = i & 1;
+      int from_point;
+      int to_point;
+      int no_successors;
+
+      roadmap_square_set_current (square_id);
+      if (roadmap_line_cfcc (line) < ROADMAP_ROAD_FIRST ||
+          roadmap_line_cfcc (line) > ROADMAP_ROAD_LAST) {
+         continue;
+      }
+
+      roadmap_line_points (line, &from_point, &to_point);
+      if (reversed) to_point = from_point;
+      roadmap_point_position (to_point, ch->positions + i);
+
+      no_successors = get_connected_segments (square_id, line, reversed, to_point,
+                                              successors, MAX_SUCCESSORS, 1, 1);
+
+      for (j = 0; j < no_successors; j++) {
+
+         int cost;
+
+         roadmap_square_set_current (successors[j].square_id);
+         cost = ChCostFn (successors[j].line_id, successors[j].reversed, 0,
+                          line, reversed,
+                          successors[j].square_id == square_id ? to_point : -1);
+         if (cost < 0) continue;
+
+         if (successors[j].square_id == square_id) {
+
+            add_edge (out, in, i,
+                      node_id (successors[j].line_id - ch->first_line, successors[j].reversed),
+                      cost, CH_MIDDLE_NONE);
+         } else {
+
+            /* The segment continues in another square. The opposite
+             * direction enters this square from the same neighbour.
+             */
+            int entry = node_id (line - ch->first_line, !reversed);
+            int cross;
+            int entry_cost;
+
+            cross = add_cross (&ch->cross, &ch->cross_count, &cross_size,
+                               successors[j].square_id, successors[j].line_id,
+                               successors[j].reversed);
+            edge_list_add (out + i, cross, cost, CH_MIDDLE_CROSS);
+
+            roadmap_square_set_current (square_id);
+            entry_cost = ChCostFn (line, !reversed, 0,
+                                   successors[j].line_id, !successors[j].reversed, -1);
+            if (entry_cost >= 0) {
+               cross = add_cross (&ch->cross, &ch->cross_count, &cross_size,
+                                  successors[j].square_id, successors[j].line_id,
+                                  !successors[j].reversed);
+               edge_list_add (in + entry, cross, entry_cost, CH_MIDDLE_CROSS);
+            }
+
+            ch->flags[i] |= CH_NODE_CORE;
+            ch->flags[entry] |= CH_NODE_CORE;
+         }
+      }
+   }
+
+   /* Contract all the nodes which are not part of the core */
+   q = navigate_queue_new (NAVIGATE_QUEUE_HEAP, count);
+   for (i = 0; i < count; i++) {
+      if (ch->flags[i] & CH_NODE_CORE) continue;
+      navigate_queue_insert (q, node_priority (out, in, ch->flags, dist, stamp, &cur_stamp,
+                                               deleted_neighbours, i),
+                             (void *)(long)i);
+   }
+
+   while (!navigate_queue_empty (q)) {
+
+      int v = (int)(long)navigate_queue_extract_min (q);
+      int priority = node_priority (out, in, ch->flags, dist, stamp, &cur_stamp,
+                                    deleted_neighbours, v);
+
+      if (!navigate_queue_empty (q) && priority > navigate_queue_min_key (q)) {
+         navigate_queue_insert (q, priority, (void *)(long)v);
+         continue;
+      }
+
+      contract_node (out, in, ch->flags, dist, stamp, &cur_stamp, v, 0);
+      ch->flags[v] |= CH_NODE_CONTRACTED;
+      contracted++;
+
+      for (j = 0; j < out[v].count; j++) {
+         if (out[v].edges[j].middle == CH_MIDDLE_CROSS) continue;
+         if (ch->flags[out[v].edges[j].target] & CH_NODE_CONTRACTED) continue;
+         deleted_neighbours[out[v].edges[j].target]++;
+         edge_list_add (up_out + v, out[v].edges[j].target,
+                        out[v].edges[j].cost, out[v].edges[j].middle);
+      }
+      for (j = 0; j < in[v].count; j++) {
+         if (in[v].edges[j].middle == CH_MIDDLE_CROSS) continue;
+         if (ch->flags[in[v].edges[j].target] & CH_NODE_CONTRACTED) continue;
+         deleted_neighbours[in[v].edges[j].target]++;
+         edge_list_add (up_in + v, in[v].edges[j].target,
+                        in[v].edges[j].cost, in[v].edges[j].middle);
+      }
+   }
+   navigate_queue_free (q);
+
+   /* The core keeps its remaining edges and the edges to other squares */
+   for (i = 0; i < count; i++) {
+
+      if (!(ch->flags[i] & CH_NODE_CORE)) continue;
+
+      for (j = 0; j < out[i].count; j++) {
+         const ChEdge *edge = out[i].edges + j;
+         if (edge->middle != CH_MIDDLE_CROSS &&
+             (ch->flags[edge->target] & CH_NODE_CONTRACTED)) continue;
+         edge_list_add (up_out + i, edge->target, edge->cost, edge->middle);
+      }
+      for (j = 0; j < in[i].count; j++) {
+         const ChEdge *edge = in[i].edges + j;
+         if (edge->middle != CH_MIDDLE_CROSS &&
+             (ch->flags[edge->target] & CH_NODE_CONTRACTED)) continue;
+         edge_list_add (up_in + i, edge->target, edge->cost, edge->middle);
+      }
+   }
+
+   ch->mem_size = sizeof(ChSquare) +
+                  count * (sizeof(unsigned char) + sizeof(RoadMapPosition) + 2 * sizeof(int)) +
+                  ch->cross_count * sizeof(ChCrossNode);
+   ch->mem_size += build_index (up_out, count, &ch->fwd_index, &ch->fwd) * sizeof(ChEdge);
+   ch->mem_size += build_index (up_in, count, &ch->bwd_index, &ch->bwd) * sizeof(ChEdge);
+   ChSquaresMem += ch->mem_size;
+
+   for (i = 0; i < count; i++) {
+      free (out[i].edges);
+      free (in[i].edges);
+      free (up_out[i].edges);
+      free (up_in[i].edges);
+   }
+   free (out);
+   free (in);
+   free (up_out);
+   free (up_in);
+   free (dist);
+   free (stamp);
+   free (deleted_neighbours);
+   navigate_queue_free (ChWitnessQueue);
+   ChWitnessQueue = NULL;
+
+   roadmap_log (ROADMAP_DEBUG, "CH square %d: %d nodes, %d contracted, %d bytes",
+                square_id, count, contracted, ch->mem_size);
+
+   return ch;
+}
+
+
+static ChSquare *find_ch_square (int square_id) {
+
+   int slot;
+
+   if (!ChSquaresHash) return NULL;
+
+   for (slot = roadmap_hash_get_first (ChSquaresHash, square_id);
+        slot >= 0;
+        slot = roadmap_hash_get_next (ChSquaresHash, slot)) {
+
+      if (ChSquares[slot] && ChSquares[slot]->square_id == square_id) {
+         return ChSquares[slot];
+      }
+   }
+
+   return NULL;
+}
+
+
+/* Returns NULL when the store is full, in which case the caller must not
+ * use a partial search: the route is left to A*.
+ */
+static ChSquare *get_ch_square (int square_id) {
+
+   ChSquare *ch = find_ch_square (square_id);
+   int slot;
+
+   if (ch) return ch;
+
+   if (ChSquaresMem > MAX_CH_MEM) {
+      roadmap_log (ROADMAP_WARNING, "CH store is full (%d bytes), square %d not built",
+                   ChSquaresMem, square_id);
+      return NULL;
+   }
+
+   if (!ChSquaresHash) {
+      ChSquaresHash = roadmap_hash_new ("ch_squares", CH_SQUARES_BLOCK);
+   }
+
+   for (slot = 0; slot < ChSquaresSize && ChSquares[slot]; slot++)
+      ;
+
+   if (slot == ChSquaresSize) {
+      ChSquaresSize += CH_SQUARES_BLOCK;
+      ChSquares = realloc (ChSquares, ChSquaresSize * sizeof(ChSquare *));
+      roadmap_check_allocated(ChSquares);
+      memset (ChSquares + slot, 0, CH_SQUARES_BLOCK * sizeof(ChSquare *));
+      roadmap_hash_resize (ChSquaresHash, ChSquaresSize);
+   }
+
+   ch = build_ch_square (square_id);
+   ChSquares[slot] = ch;
+   roadmap_hash_add (ChSquaresHash, square_id, slot);
+
+   return ch;
+}
+
+
+/* The shortcut costs are only valid for the cost function, options and
+ * live data (traffic, alerts) they were built with.
+ */
+static void check_cost_function (void) {
+
+   NavigateCostFn cost_fn = navigate_cost_get ();
+   int signature = cost_signature ();
+   int data_version = navigate_cost_data_version ();
+
+   if (cost_fn != ChCostFn || signature != ChCostSignature ||
+       data_version != ChCostDataVersion || ChSquaresMem > MAX_CH_MEM) {
+
+      navigate_ch_clear (-1);
+      ChCostFn = cost_fn;
+      ChCostSignature = signature;
+      ChCostDataVersion = data_version;
+   }
+}
+
+
+static ChSearchItem *get_item (int index) {
+
+   return ChItems[index / CH_BLOCK_SIZE] + (index % CH_BLOCK_SIZE);
+}
+
+
+static int find_item (int square, int node, int create) {
+
+   int key = (square << 16) ^ node;
+   int index;
+   ChSearchItem *item;
+
+   for (index = roadmap_hash_get_first (ChItemsHash, key);
+        index >= 0;
+        index = roadmap_hash_get_next (ChItemsHash, index)) {
+
+      item = get_item (index);
+      if (item->square == square && item->node == node) return index;
+   }
+
+   if (!create) return -1;
+
+   if (ChNumItems >= MAX_CH_ITEMS) {
+      roadmap_log (ROADMAP_ERROR, "Too many nodes in CH route calculation");
+      return -1;
+   }
+
+   if (ChNumItems % CH_BLOCK_SIZE == 0) {
+      if (ChNumItems) roadmap_hash_resize (ChItemsHash, ChNumItems + CH_BLOCK_SIZE);
+      ChItems[ChNumItems / CH_BLOCK_SIZE] =
+         (ChSearchItem *)malloc (CH_BLOCK_SIZE * sizeof (ChSearchItem));
+      roadmap_check_allocated(ChItems[ChNumItems / CH_BLOCK_SIZE]);
+   }
+
+   index = ChNumItems++;
+   item = get_item (index);
+   item->square = square;
+   item->node = node;
+   item->dist[0] = item->dist[1] = CH_INFINITY;
+   item->parent[0] = item->parent[1] = -1;
+   item->middle[0] = item->middle[1] = CH_MIDDLE_NONE;
+   item->settled[0] = item->settled[1] = 0;
+
+   roadmap_hash_add (ChItemsHash, key, index);
+
+   return index;
+}
+
+
+static void free_items (void) {
+
+   int i;
+
+   if (ChItemsHash) {
+      roadmap_hash_free (ChItemsHash);
+      ChItemsHash = NULL;
+   }
+
+   if (ChNumItems) {
+      for (i = (ChNumItems - 1) / CH_BLOCK_SIZE; i >= 0; i--) {
+         free (ChItems[i]);
+      }
+      ChNumItems = 0;
+   }
+}
+
+
+/* The goal line may be entered from either end, so the distance is taken
+ * to the nearer end to keep the estimate a lower bound.
+ */
+static int heuristic (const ChSquare *ch, int node, const RoadMapPosition *goal) {
+
+   int dis = roadmap_math_distance (ch->positions + node, goal);
+   int dis2 = roadmap_math_distance (ch->positions + node, goal + 1);
+
+   if (dis2 < dis) dis = dis2;
+
+   if (navigate_cost_type () == COST_FASTEST) dis = dis / HU_SPEED;
+
+   return dis;
+}
+
+
+/* Relaxes an edge of the search in the given direction (0 forward,
+ * 1 backward). Returns the relaxed item or -1. Sets failed when the edge
+ * cannot be followed, as the search result would not be the shortest.
+ */
+static int relax_edge (int dir, int from_index, const ChSquare *from_ch,
+                       const ChEdge *edge, NavigateQueue *q,
+                       const RoadMapPosition *goal, int *failed) {
+
+   ChSearchItem *from = get_item (from_index);
+   ChSquare *to_ch;
+   ChSearchItem *to;
+   int to_node;
+   int to_index;
+   int cost = from->dist[dir] + edge->cost;
+
+   if (edge->middle == CH_MIDDLE_CROSS) {
+
+      const ChCrossNode *cross = from_ch->cross + edge->target;
+
+      to_ch = get_ch_square (cross->square);
+      if (!to_ch) {
+         *failed = 1;
+         return -1;
+      }
+      to_node = node_id (cross->line_id - to_ch->first_line, cross->reversed);
+      if (to_node < 0 || to_node >= to_ch->nodes_count) {
+         *failed = 1;
+         return -1;
+      }
+   } else {
+      to_ch = (ChSquare *)from_ch;
+      to_node = edge->target;
+   }
+
+   to_index = find_item (to_ch->square_id, to_node, 1);
+   if (to_index < 0) {
+      *failed = 1;
+      return -1;
+   }
+
+   to = get_item (to_index);
+   if (to->settled[dir] || cost >= to->dist[dir]) return -1;
+
+   to->dist[dir] = cost;
+   to->parent[dir] = from_index;
+   to->middle[dir] = edge->middle;
+
+   if (dir == 0) {
+      navigate_queue_insert (q, cost + heuristic (to_ch, to_node, goal), (void *)(long)to_index);
+   } else {
+      navigate_queue_insert (q, cost, (void *)(long)to_index);
+   }
+
+   return to_index;
+}
+
+
+static const ChEdge *find_edge (const ChEdge *edges, int first, int last, int target) {
+
+   const ChEdge *best = NULL;
+   int i;
+
+   for (i = first; i < last; i++) {
+      if (edges[i].middle != CH_MIDDLE_CROSS && edges[i].target == target &&
+          (!best || edges[i].cost < best->cost)) {
+         best = edges + i;
+      }
+   }
+
+   return best;
+}
+
+
+typedef struct {
+   NavigateChPathCB cb;
+   void *context;
+   int square;
+   int line_id;
+   int reversed;
+   int ok;
+} ChPathContext;
+
+
+static void emit_node (ChPathContext *path, int square, int first_line, int node) {
+
+   int line_id = first_line + node / 2;
+   int reversed = node & 1;
+
+   if (path->ok &&
+       !path->cb (path->context, square, line_id, reversed,
+                  path->square, path->line_id, path->reversed)) {
+      path->ok = 0;
+   }
+
+   path->square = square;
+   path->line_id = line_id;
+   path->reversed = reversed;
+}
+
+
+static void unpack_edge (ChPathContext *path, const ChSquare *ch,
+                         int from, int to, int middle) {
+
+   const ChEdge *edge;
+
+   if (middle < 0) {
+      emit_node (path, ch->square_id, ch->first_line, to);
+      return;
+   }
+
+   edge = find_edge (ch->bwd, ch->bwd_index[middle], ch->bwd_index[middle + 1], from);
+   if (!edge) {
+      roadmap_log (ROADMAP_ERROR, "Inconsistency in CH shortcut unpacking");
+      path->ok = 0;
+      return;
+   }
+   unpack_edge (path, ch, from, middle, edge->middle);
+
+   edge = find_edge (ch->fwd, ch->fwd_index[middle], ch->fwd_index[middle + 1], to);
+   if (!edge) {
+      roadmap_log (ROADMAP_ERROR, "Inconsistency in CH shortcut unpacking");
+      path->ok = 0;
+      return;
+   }
+   unpack_edge (path, ch, middle, to, edge->middle);
+}
+
+
+/* Unpacks the hop between two adjacent search items */
+static void unpack_hop (ChPathContext *path, int from_index, int to_index, int middle) {
+
+   ChSearchItem *from = get_item (from_index);
+   ChSearchItem *to = get_item (to_index);
+   ChSquare *ch = find_ch_square (to->square);
+
+   if (middle == CH_MIDDLE_CROSS) {
+      emit_node (path, to->square, ch->first_line, to->node);
+   } else {
+      unpack_edge (path, ch, from->node, to->node, middle);
+   }
+}
+
+
+static int build_path (int meet, int start_index, NavigateChPathCB cb, void *context,
+                       int *goal_reversed) {
+
+   ChPathContext path;
+   int *hops;
+   int count = 0;
+   int index;
+   int i;
+   ChSearchItem *start = get_item (start_index);
+   ChSquare *ch = find_ch_square (start->square);
+
+   hops = malloc (ChNumItems * sizeof(int));
+   roadmap_check_allocated(hops);
+
+   for (index = meet; index != start_index; index = get_item (index)->parent[0]) {
+      hops[count++] = index;
+   }
+
+   path.cb = cb;
+   path.context = context;
+   path.ok = 1;
+   path.square = start->square;
+   path.line_id = ch->first_line + start->node / 2;
+   path.reversed = start->node & 1;
+   emit_node (&path, start->square, ch->first_line, start->node);
+
+   for (i = count - 1; i >= 0; i--) {
+      ChSearchItem *item = get_item (hops[i]);
+      unpack_hop (&path, item->parent[0], hops[i], item->middle[0]);
+   }
+
+   for (index = meet; get_item (index)->parent[1] >= 0; ) {
+      ChSearchItem *item = get_item (index);
+      /* The backward tree stores the edge from this item to its parent */
+      unpack_hop (&path, index, item->parent[1], item->middle[1]);
+      index = item->parent[1];
+   }
+
+   *goal_reversed = get_item (index)->node & 1;
+
+   free (hops);
+
+   return path.ok ? 0 : -1;
+}
+
+
+int navigate_ch_route (int start_square, int start_line, int start_reversed,
+                       int goal_square, int goal_line,
+                       NavigateChPathCB cb, void *context,
+                       int *route_total_cost, int *goal_reversed) {
+
+   ChSquare *start_ch;
+   ChSquare *goal_ch;
+   NavigateQueue *q;
+   RoadMapPosition goal_pos[2];
+   int start_index;
+   int meet = -1;
+   int best = CH_INFINITY;
+   int settled = 0;
+   int failed = 0;
+   int index;
+   int i;
+   int rc = -1;
+
+   check_cost_function ();
+
+   start_ch = get_ch_square (start_square);
+   goal_ch = get_ch_square (goal_square);
+   if (!start_ch || !goal_ch) return -1;
+
+   if (start_line - start_ch->first_line < 0 ||
+       node_id (start_line - start_ch->first_line, 1) >= start_ch->nodes_count ||
+       goal_line - goal_ch->first_line < 0 ||
+       node_id (goal_line - goal_ch->first_line, 1) >= goal_ch->nodes_count) {
+      return -1;
+   }
+
+   ChItemsHash = roadmap_hash_new ("ch_search", CH_BLOCK_SIZE);
+   ChNumItems = 0;
+
+   /* Backward search: climb up the goal square from both directions of
+    * the goal line, stopping at the core.
+    */
+   q = navigate_queue_new (NAVIGATE_QUEUE_RADIX, 0);
+   for (i = 0; i <= 1; i++) {
+      index = find_item (goal_square, node_id (goal_line - goal_ch->first_line, i), 1);
+      get_item (index)->dist[1] = 0;
+      navigate_queue_insert (q, 0, (void *)(long)index);
+   }
+
+   while (!navigate_queue_empty (q) && !failed) {
+
+      int cost = navigate_queue_min_key (q);
+      ChSearchItem *item;
+
+      index = (int)(long)navigate_queue_extract_min (q);
+      item = get_item (index);
+      if (item->settled[1] || cost > item->dist[1]) continue;
+      item->settled[1] = 1;
+      settled++;
+
+      if (goal_ch->flags[item->node] & CH_NODE_CORE) continue;
+
+      for (i = goal_ch->bwd_index[item->node]; i < goal_ch->bwd_index[item->node + 1]; i++) {
+         relax_edge (1, index, goal_ch, goal_ch->bwd + i, q, NULL, &failed);
+      }
+   }
+   navigate_queue_free (q);
+
+   /* Forward search */
+   goal_pos[0] = goal_ch->positions[node_id (goal_line - goal_ch->first_line, 0)];
+   goal_pos[1] = goal_ch->positions[node_id (goal_line - goal_ch->first_line, 1)];
+   start_index = find_item (start_square, node_id (start_line - start_ch->first_line, start_reversed), 1);
+   if (start_index < 0) {
+      free_items ();
+      return -1;
+   }
+   get_item (start_index)->dist[0] = 0;
+
+   /* The heuristic keys are not strictly monotone, so use the general heap */
+   q = navigate_queue_new (NAVIGATE_QUEUE_HEAP, 0);
+   navigate_queue_insert (q, 0, (void *)(long)start_index);
+
+   while (!navigate_queue_empty (q) && !failed) {
+
+      int key = navigate_queue_min_key (q);
+      ChSearchItem *item;
+      ChSquare *ch;
+
+      if (key >= best) break;
+
+      index = (int)(long)navigate_queue_extract_min (q);
+      item = get_item (index);
+      if (item->settled[0]) continue;
+      item->settled[0] = 1;
+      settled++;
+
+      if (item->dist[1] != CH_INFINITY && item->dist[0] + item->dist[1] < best) {
+         best = item->dist[0] + item->dist[1];
+         meet = index;
+      }
+
+      ch = find_ch_square (item->square);
+      for (i = ch->fwd_index[item->node]; i < ch->fwd_index[item->node + 1]; i++) {
+
+         relax_edge (0, index, ch, ch->fwd + i, q, goal_pos, &failed);
+         if (failed) break;
+      }
+   }
+   navigate_queue_free (q);
+
+   roadmap_log (ROADMAP_DEBUG, "CH route: settled %d nodes, %d items", settled, ChNumItems);
+
+   if (failed) {
+      roadmap_log (ROADMAP_WARNING, "CH route failed, leaving it to A*");
+   } else if (meet >= 0) {
+      *route_total_cost = best;
+      rc = build_path (meet, start_index, cb, context, goal_reversed);
+   }
+
+   free_items ();
+
+   return rc;
+}
+
+
+int navigate_ch_preprocess (const int *squares, int count) {
+
+   int built = 0;
+   int i;
+
+   check_cost_function ();
+
+   for (i = 0; i < count; i++) {
+      if (find_ch_square (squares[i])) continue;
+      if (get_ch_square (squares[i])) built++;
+   }
+
+   roadmap_log (ROADMAP_INFO, "CH preprocessing: built %d squares, %d bytes total",
+                built, ChSquaresMem);
+
+   return built;
+}
+
+
+void navigate_ch_clear (int square) {
+
+   int slot;
+
+   if (!ChSquaresHash) return;
+
+   for (slot = 0; slot < ChSquaresSize; slot++) {
+
+      if (ChSquares[slot] &&
+          (square == -1 || ChSquares[slot]->square_id == square)) {
+
+         roadmap_hash_remove (ChSquaresHash, ChSquares[slot]->square_id, slot);
+         free_ch_square (ChSquares[slot]);
+         ChSquares[slot] = NULL;
+      }
+   }
+}
+
+
+int navigate_ch_enabled (void) {
+
+   return roadmap_config_match (&ChEnabledCfg, "yes");
+}
+
+
+void navigate_ch_initialize (void) {
+
+   roadmap_config_declare_enumeration
+      ("preferences", &ChEnabledCfg, NULL, "no", "yes", NULL);
+}
@@ -0,0 +1,51 @@
+/* navigate_ch.h - contraction hierarchies route calculation
+ *
+ * LICENSE:
+ *
+ *   Copyright 2007 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef _NAVIGATE_CH_H_
+#define _NAVIGATE_CH_H_
+
+/* Called for every segment of the resulting route, from the start segment
+ * to the goal segment. The start segment is reported as its own previous.
+ * Returning 0 aborts the route reconstruction.
+ */
+typedef int (*NavigateChPathCB) (void *context,
+                                 int square, int line_id, int reversed,
+                                 int prev_square, int prev_line_id, int prev_reversed);
+
+void navigate_ch_initialize (void);
+int  navigate_ch_enabled    (void);
+
+/* Build the per square shortcut tables ahead of time. Squares which are
+ * already preprocessed are skipped. Returns the number of squares built.
+ */
+int  navigate_ch_preprocess (const int *squares, int count);
+
+int  navigate_ch_route (int start_square, int start_line, int start_reversed,
+                        int goal_square, int goal_line,
+                        NavigateChPathCB cb, void *context,
+                        int *route_total_cost, int *goal_reversed);
+
+void navigate_ch_clear (int square);
+
+#endif /* _NAVIGATE_CH_H_ */
@@ -62,6 +62,7 @@
 #define PENALTY_AVOID 2
 
 static time_t start_time;
+static int data_version;
 
 static RoadMapConfigDescriptor CostTypeCfg =
                   ROADMAP_CONFIG_ITEM("Routing", "Type");
@@ -376,13 +377,14 @@ static int cost_fastest_no_traffic (int line_id, int is_reversed, int cur_cost,
    int cfcc = roadmap_line_cfcc (line_id);
    int penalty = PENALTY_NONE;
 
-   if (node_id != -1) penalty = calc_penalty (line_id, cfcc, prev_line_id);
-
   cross_time = roadmap_line_speed_get_cross_time_at (line_id, is_reversed,
                        (start_time + (time_t)cur_cost));
 
-   if (!cross_time) cross_time =
-         roadmap_line_speed_get_avg_cross_time (line_id, is_reversed);
+   /* No speed for this time of day: use the regular fastest cost */
+   if (cross_time <= 0) return cost_fastest (line_id, is_reversed, cur_cost,
+                                             prev_line_id, is_prev_reversed, node_id);
+
+   if (node_id != -1) penalty = calc_penalty (line_id, cfcc, prev_line_id);
 
    switch (penalty) {
       case PENALTY_AVOID:
@@ -400,6 +402,27 @@ void navigate_cost_reset (void) {
    start_time = time(NULL);
 }
 
+void navigate_cost_data_changed (void) {
+   data_version++;
+}
+
+int navigate_cost_data_version (void) {
+   return data_version;
+}
+
+void navigate_cost_set_departure (time_t departure) {
+   start_time = departure;
+}
+
+time_t navigate_cost_get_departure (void) {
+   return start_time;
+}
+
+NavigateCostFn navigate_cost_get_time_dependent (void) {
+
+   return &cost_fastest_no_traffic;
+}
+
 NavigateCostFn navigate_cost_get (void) {
 
    if (navigate_cost_type () == COST_FASTEST) {
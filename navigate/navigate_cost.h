@@ -25,6 +25,8 @@
 #ifndef _NAVIGATE_COST_H_
 #define _NAVIGATE_COST_H_
 
+#include <time.h>
+
 #define COST_FASTEST 1
 #define COST_SHORTEST 2
 
@@ -51,6 +53,19 @@ typedef int (*NavigateCostFn) (int line_id, int is_reversed, int cur_cost,
 void navigate_cost_reset (void);
 NavigateCostFn navigate_cost_get (void);
 
+/* The live data the costs use (traffic speeds, alert penalties) changed.
+ * Results kept across route calculations are checked against the version.
+ */
+void navigate_cost_data_changed (void);
+int navigate_cost_data_version (void);
+
+/* Cost by the historical speed profiles at the time each line is reached,
+ * counting from the given departure time.
+ */
+void navigate_cost_set_departure (time_t departure);
+time_t navigate_cost_get_departure (void);
+NavigateCostFn navigate_cost_get_time_dependent (void);
+
 int navigate_cost_time (int line_id, int is_reversed, int cur_cost,
                         int prev_line_id, int is_prev_reversed);
 
@@ -44,8 +44,10 @@
 #include "roadmap_line_route.h"
 #include "roadmap_plugin.h"
 #include "roadmap_navigate.h"
+#include "roadmap_hash.h"
 
 #include "navigate_graph.h"
+#include "navigate_ch.h"
 
 #ifdef J2ME
 #define MAX_GRAPH_CACHE 75
@@ -57,6 +59,7 @@
 
 struct SquareGraphItem {
    int square_id;
+   unsigned int last_use;
    unsigned short lines_count;
    unsigned short nodes_count;
    unsigned short *nodes_index;
@@ -65,10 +68,20 @@ struct SquareGraphItem {
    int mem_size;
 };
 
-static struct SquareGraphItem *SquareGraphCache[MAX_GRAPH_CACHE];
-static int SquareCacheSize = 0;
+/* A lookup which finds its square only stamps the slot, the hash and the
+ * slots are changed by a miss alone. A miss evicts the slot with the
+ * oldest stamp; free slots have a square_id of -1 and a stamp of 0, so
+ * they are reused first.
+ */
+static struct SquareGraphItem SquareGraphCache[MAX_GRAPH_CACHE];
+static RoadMapHash *SquareGraphHash;
+static unsigned int cache_clock;
 static int cache_total_mem;
 
+static int cache_hits;
+static int cache_misses;
+static int cache_evictions;
+
 static inline void add_graph_node(struct SquareGraphItem *cache,
                                   int line,
                                   int point_id,
@@ -96,15 +109,93 @@ static inline void add_graph_node(struct SquareGraphItem *cache,
 }
 
 
+/* The least recently used slot other than skip, only among the used
+ * slots when used_only is set. Returns -1 when there is none.
+ */
+static int cache_oldest (int skip, int used_only) {
+
+   int oldest = -1;
+   int slot;
+
+   for (slot = 0; slot < MAX_GRAPH_CACHE; slot++) {
+
+      if (slot == skip) continue;
+      if (used_only && SquareGraphCache[slot].square_id < 0) continue;
+
+      if (oldest < 0 ||
+          SquareGraphCache[slot].last_use < SquareGraphCache[oldest].last_use) {
+         oldest = slot;
+      }
+   }
+
+   return oldest;
+}
+
+
+static void cache_touch (int slot) {
+
+   int i;
+
+   if (++cache_clock == 0) {
+
+      /* The clock wrapped, start the order again */
+      for (i = 0; i < MAX_GRAPH_CACHE; i++) {
+         if (SquareGraphCache[i].square_id >= 0) SquareGraphCache[i].last_use = 1;
+      }
+      cache_clock = 2;
+   }
+
+   SquareGraphCache[slot].last_use = cache_clock;
+}
+
+
+static void cache_init (void) {
+
+   int i;
+
+   for (i = 0; i < MAX_GRAPH_CACHE; i++) {
+      SquareGraphCache[i].square_id = -1;
+      SquareGraphCache[i].last_use = 0;
+   }
+
+   SquareGraphHash = roadmap_hash_new ("graph", MAX_GRAPH_CACHE);
+}
+
+
 static void free_cache_slot (int slot) {
-   free (SquareGraphCache[slot]->nodes_index);
-   free (SquareGraphCache[slot]->lines);
-   free (SquareGraphCache[slot]->lines_index);
-   cache_total_mem -= SquareGraphCache[slot]->mem_size;
+
+   struct SquareGraphItem *cache = SquareGraphCache + slot;
+
+   if (cache->square_id < 0) return;
+
+   roadmap_hash_remove (SquareGraphHash, cache->square_id, slot);
+
+   free (cache->nodes_index);
+   free (cache->lines);
+   free (cache->lines_index);
+   cache_total_mem -= cache->mem_size;
+   cache->square_id = -1;
+   cache->last_use = 0;
+}
+
+
+static int find_cache_slot (int square_id) {
+
+   int slot;
+
+   for (slot = roadmap_hash_get_first (SquareGraphHash, square_id);
+        slot >= 0;
+        slot = roadmap_hash_get_next (SquareGraphHash, slot)) {
+
+      if (SquareGraphCache[slot].square_id == square_id) {
+         return slot;
+      }
+   }
+
+   return -1;
 }
 
 
-//TODO arrange as LRU list
 static struct SquareGraphItem *get_square_graph (int square_id) {
 
    int i;
@@ -114,35 +205,27 @@ static struct SquareGraphItem *get_square_graph (int square_id) {
    int lines2_count;
    struct SquareGraphItem *cache;
    int cur_line = 0;
-   int found = 0;
-
-   for (slot = 0; slot < SquareCacheSize; slot++) {
-     	if (SquareGraphCache[slot]->square_id == square_id) {
-     		found = 1;
-     		//printf ("get_square_graph: found square %d in slot %d\n", square_id, slot);
-     		break;
-     	}
+
+   if (!SquareGraphHash) cache_init ();
+
+   slot = find_cache_slot (square_id);
+
+   if (slot >= 0) {
+      cache_hits++;
+      cache_touch (slot);
+      return SquareGraphCache + slot;
    }
 
-	if (!found) {
-		if (SquareCacheSize == MAX_GRAPH_CACHE) {
-			slot--;
-			free_cache_slot (slot);
-			cache = SquareGraphCache[slot];
-		} else {
-			cache = (struct SquareGraphItem *)malloc(sizeof(struct SquareGraphItem));
-			SquareCacheSize++;
-		}
-	} else {
-		cache = SquareGraphCache[slot];
-	}
+   cache_misses++;
 
-	for (i = slot; i > 0; i--) {
-		SquareGraphCache[i] = SquareGraphCache[i - 1];
-	}
-	SquareGraphCache[0] = cache;
+   /* Reuse the least recently used slot */
+   slot = cache_oldest (-1, 0);
+   if (SquareGraphCache[slot].square_id >= 0) cache_evictions++;
+   free_cache_slot (slot);
+
+   cache_touch (slot);
 
-	if (found) return cache;
+   cache = SquareGraphCache + slot;
 
 	//printf ("get_square_graph: adding square %d to slot %d\n", square_id, slot);
 	
@@ -172,14 +255,15 @@ static struct SquareGraphItem *get_square_graph (int square_id) {
                      cache->lines_count * sizeof(unsigned short) +
                      cache->nodes_count * sizeof(unsigned short);
 
+   /* Keep within the memory budget, evicting the oldest squares */
    while (cache_total_mem &&
-          ((cache_total_mem + cache->mem_size) > MAX_MEM_CACHE) &&
-          SquareCacheSize > 1) {
+          ((cache_total_mem + cache->mem_size) > MAX_MEM_CACHE)) {
 
-		SquareCacheSize--;
-      free_cache_slot(SquareCacheSize);
-      free (SquareGraphCache[SquareCacheSize]);
-      SquareGraphCache[SquareCacheSize] = NULL;
+      int victim = cache_oldest (slot, 1);
+
+      if (victim < 0) break;
+      free_cache_slot (victim);
+      cache_evictions++;
    }
 
    cache->lines = malloc(cache->lines_count * sizeof(int));
@@ -221,6 +305,8 @@ static struct SquareGraphItem *get_square_graph (int square_id) {
 
    assert(cur_line <= cache->lines_count);
 
+   roadmap_hash_add (SquareGraphHash, square_id, slot);
+
    return cache;
 }
 
@@ -385,33 +471,50 @@ int navigate_graph_get_line (int node, int line_no) {
 static void navigate_graph_clear_all (void) {
 	
 	int slot;
-	for (slot = SquareCacheSize - 1; slot >= 0; slot--) {
+
+	if (!SquareGraphHash) return;
+
+	for (slot = 0; slot < MAX_GRAPH_CACHE; slot++) {
 		
 		free_cache_slot (slot);
 	}
-	SquareCacheSize = 0;	
 }
 
 void navigate_graph_clear (int square) {
 
 	int slot;
 	
+	navigate_ch_clear (square);
+
 	if (square == -1) {
 		navigate_graph_clear_all ();
 		return;
 	}
+
+	if (!SquareGraphHash) return;
 	
-	for (slot = SquareCacheSize - 1; slot >= 0 && SquareGraphCache[slot]->square_id != square; slot--)
-		;
+	slot = find_cache_slot (square);
 	
 	if (slot >= 0) {
 		
-		SquareCacheSize--;
 		free_cache_slot (slot);
-		
-		while (slot < SquareCacheSize) {
-			SquareGraphCache[slot] = SquareGraphCache[slot + 1];
-			slot++;	
-		}
 	}	
 }
+
+
+void navigate_graph_get_stats (NavigateGraphStats *stats) {
+
+	int slot;
+
+	stats->hits = cache_hits;
+	stats->misses = cache_misses;
+	stats->evictions = cache_evictions;
+	stats->mem_size = cache_total_mem;
+	stats->squares = 0;
+
+	if (!SquareGraphHash) return;
+
+	for (slot = 0; slot < MAX_GRAPH_CACHE; slot++) {
+		if (SquareGraphCache[slot].square_id >= 0) stats->squares++;
+	}
+}
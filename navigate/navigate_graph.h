@@ -39,8 +39,17 @@ int get_connected_segments (int square,
                             int node_id, struct successor *successors,
                             int max, int use_restrictions, int use_directions);
 
+typedef struct {
+   int hits;
+   int misses;
+   int evictions;
+   int squares;
+   int mem_size;
+} NavigateGraphStats;
+
 int navigate_graph_get_line (int node, int line_no);
 void navigate_graph_clear (int square);
+void navigate_graph_get_stats (NavigateGraphStats *stats);
 
 #endif /* _NAVIGATE_GRAPH_H_ */
 
@@ -96,6 +96,7 @@
 #include "navigate_instr.h"
 #include "navigate_traffic.h"
 #include "navigate_cost.h"
+#include "navigate_ch.h"
 #include "navigate_route.h"
 #include "navigate_zoom.h"
 #include "navigate_route_trans.h"
@@ -123,6 +124,9 @@
 
 #define MAX_MINUTES_TO_RESUME_NAV   120
 
+#define DEPARTURE_SWEEP_COUNT       25    /* departures over the next two hours */
+#define DEPARTURE_SWEEP_INTERVAL    300   /* seconds */
+
 #define MAX_ALT_ROUTES 3
 
 static RoadMapConfigDescriptor NavigateConfigRouteColor =
@@ -289,6 +293,13 @@ static int NavigateNumOutlinePoints[MAX_ALT_ROUTES] = {0,0,0};
 static RoadMapPosition *NavigateOriginalRoutePoints = NULL;
 static int NavigateNumOriginalRoutePoints = 0;
 
+/* Alternative routes calculated on the device, see recalc_alt_route() */
+static NavigateRouteAlternative NavigateLocalAlts[MAX_ROUTES];
+static NavigateRouteResult NavigateLocalAltResults[MAX_ROUTES];
+static char NavigateLocalAltVia[MAX_ROUTES][128];
+static int NavigateNumLocalAlts = 0;
+static NavigateSegment *NavigateLocalAltSegments = NULL;
+
 static RoadMapCallback NavigateNextLoginCb = NULL;
 static BOOL            NavigateResumeNoConfirmation = FALSE;
 static BOOL            NavigateAllowTweet = TRUE;
@@ -2904,6 +2915,7 @@ void navigate_main_initialize (void) {
    navigate_main_init_pens ();
 
    navigate_cost_initialize ();
+   navigate_ch_initialize ();
 
    NavigatePluginID = navigate_plugin_register ();
    navigate_traffic_initialize ();
@@ -3191,6 +3203,217 @@ void navigate_main_prepare_for_request (void) {
 void navigate_main_set_src_pos(RoadMapPosition *position){
    NavigateSrcPos = *position;
 }
+static NavigateSegment *local_alt_segment (int i) {
+
+   return NavigateLocalAltSegments + i;
+}
+
+/* The points of a route, in driving order, for its outline */
+static RoadMapPosition *local_alt_outline (const NavigateSegment *segments, int num_segments, int *num_points) {
+
+   RoadMapPosition *points;
+   RoadMapPosition position;
+   int max_points = 0;
+   int count = 0;
+   int i;
+
+   for (i = 0; i < num_segments; i++) {
+      max_points += 2;
+      if (segments[i].first_shape > -1) max_points += segments[i].last_shape - segments[i].first_shape + 1;
+   }
+
+   points = malloc (max_points * sizeof (RoadMapPosition));
+   roadmap_check_allocated (points);
+
+   for (i = 0; i < num_segments; i++) {
+
+      const NavigateSegment *segment = segments + i;
+      int first = count;
+      int shape;
+      int j;
+
+      points[count++] = segment->from_pos;
+
+      if (segment->first_shape > -1) {
+         roadmap_square_set_current (segment->square);
+         position = segment->shape_initial_pos;
+         for (shape = segment->first_shape; shape <= segment->last_shape; shape++) {
+            roadmap_shape_get_position (shape, &position);
+            points[count++] = position;
+         }
+      }
+
+      points[count++] = segment->to_pos;
+
+      if (segment->line_direction != ROUTE_DIRECTION_WITH_LINE) {
+         for (j = 0; j < (count - first) / 2; j++) {
+            position = points[first + j];
+            points[first + j] = points[count - 1 - j];
+            points[count - 1 - j] = position;
+         }
+      }
+
+      /* The segment starts where the previous one ended */
+      if (first > 0 &&
+          points[first - 1].longitude == points[first].longitude &&
+          points[first - 1].latitude == points[first].latitude) {
+         memmove (points + first, points + first + 1, (count - first - 1) * sizeof (RoadMapPosition));
+         count--;
+      }
+   }
+
+   *num_points = count;
+   return points;
+}
+
+/* The street on which the route drives the longest stretch */
+static void local_alt_via (const NavigateSegment *segments, int num_segments, char *via, int size) {
+
+   PluginStreetProperties properties;
+   PluginLine segment_line;
+   int best = 0;
+   int run = 0;
+   int i;
+
+   via[0] = 0;
+
+   for (i = 0; i < num_segments; i++) {
+
+      navigate_main_get_plugin_line (&segment_line, segments + i);
+      roadmap_plugin_get_street_properties (&segment_line, &properties, 0);
+
+      if (!properties.street || !properties.street[0]) {
+         run = 0;
+         continue;
+      }
+
+      if (i > 0 && segments[i - 1].street == segments[i].street) run += segments[i].distance;
+      else run = segments[i].distance;
+
+      if (run > best) {
+         best = run;
+         strncpy_safe (via, properties.street, size);
+      }
+   }
+}
+
+static void free_local_alts (void) {
+
+   int i;
+
+   for (i = 0; i < NavigateNumLocalAlts; i++) {
+
+      if (NavigateSegments == NavigateLocalAlts[i].segments) {
+         NavigateSegments = NULL;
+         NavigateNumSegments = 0;
+      }
+      free (NavigateLocalAltResults[i].geometry.points);
+      NavigateLocalAltResults[i].geometry.points = NULL;
+   }
+
+   for (i = 0; i < MAX_ALT_ROUTES; i++)
+      NavigateNumOutlinePoints[i] = 0;
+
+   navigate_route_alternatives_free (NavigateLocalAlts, NavigateNumLocalAlts);
+   NavigateNumLocalAlts = 0;
+}
+
+/* When the routing service can't be asked, the alternative routes dialog
+ * offers routes calculated here. They are kept until the next request, as
+ * the selected one becomes the navigated route.
+ */
+static void local_alt_routes (void) {
+
+   static NavigateRouteSearch *search = NULL;
+   PluginLine from_line;
+   int from_point;
+   int from_direction;
+   int i;
+   int j;
+
+   free_local_alts ();
+
+   if (navigate_route_load_data () < 0) {
+
+      ssd_progress_msg_dialog_hide ();
+      roadmap_messagebox("Error", "Error loading navigation data.");
+      return;
+   }
+
+   if (navigate_find_track_points_in_scale
+         (&from_line, &from_point, &NavigateDestination, &NavigateDestPoint, &from_direction, 0, 0, 1)) {
+
+      ssd_progress_msg_dialog_hide ();
+      return;
+   }
+
+   NavigateFromLinePending = from_line;
+   NavigateFromPointPending = from_point;
+
+   navigate_cost_reset ();
+   if (!search) search = navigate_route_search_new ();
+
+   roadmap_log (ROADMAP_INFO, "Calculating alternative routes..");
+   NavigateNumLocalAlts = navigate_route_search_alternatives (search, &from_line, from_point,
+                                                              &NavigateDestination, NavigateDestPoint,
+                                                              MAX_ROUTES, NavigateLocalAlts);
+   ssd_progress_msg_dialog_hide ();
+
+   if (NavigateNumLocalAlts == 0) {
+      roadmap_messagebox("Oops", "Can't find a route.");
+      return;
+   }
+
+   for (i = 0; i < NavigateNumLocalAlts; i++) {
+
+      NavigateRouteAlternative *route = NavigateLocalAlts + i;
+      NavigateRouteResult *result = NavigateLocalAltResults + i;
+
+      NavigateLocalAltSegments = route->segments;
+      navigate_instr_prepare_segments (local_alt_segment, route->num_segments, route->num_segments,
+                                       &NavigateSrcPos, &NavigateDestPos);
+
+      memset (result, 0, sizeof (NavigateRouteResult));
+      for (j = 0; j < route->num_segments; j++) {
+         result->total_length += route->segments[j].distance;
+         result->total_time += route->segments[j].cross_time;
+      }
+
+      local_alt_via (route->segments, route->num_segments, NavigateLocalAltVia[i], sizeof (NavigateLocalAltVia[i]));
+
+      result->flags = NEW_ROUTE;
+      result->num_segments = route->num_segments;
+      result->alt_id = i + 1;
+      result->description = NavigateLocalAltVia[i];
+      result->origin = origin_local;
+      result->geometry.points = local_alt_outline (route->segments, route->num_segments, &result->geometry.num_points);
+      result->geometry.valid_points = result->geometry.num_points;
+   }
+   NavigateLocalAltSegments = NULL;
+
+   RealtimeAltRoutes_Local_Routes (NavigateNumLocalAlts, NavigateLocalAltResults, FALSE);
+}
+
+void navigate_main_on_local_alt_route (int alt_id) {
+
+   NavigateRouteAlternative *route;
+   NavigateRouteResult *result;
+
+   if (alt_id < 1 || alt_id > NavigateNumLocalAlts) {
+      roadmap_log (ROADMAP_ERROR, "navigate_main_on_local_alt_route() : invalid alt_id %d", alt_id);
+      return;
+   }
+
+   route = NavigateLocalAlts + alt_id - 1;
+   result = NavigateLocalAltResults + alt_id - 1;
+
+   NavigateIsByServer = 0;
+   navigate_main_on_route (result->flags, result->total_length, result->total_time,
+                           route->segments, route->num_segments, route->num_segments,
+                           result->geometry.points, result->geometry.num_points,
+                           result->description, TRUE);
+}
+
 static void recalc_alt_route(void){
    const RoadMapPosition *from;
    RoadMapGpsPosition pos;
@@ -3224,6 +3447,12 @@ static void recalc_alt_route(void){
    roadmap_trip_set_point ("Destination", &route.destPosition);
    roadmap_trip_set_point ("Departure", &route.srcPosition);
    RealtimeAltRoutes_Add_Route(&route);
+
+   if (!RealTimeLoginState ()) {
+      local_alt_routes ();
+      return;
+   }
+
    RealtimeAltRoutes_Route_Request (-1, from, &to, MAX_ROUTES, FALSE);
 }
 
@@ -3237,6 +3466,65 @@ void navigate_main_alt_recalculate_route(void){
       recalc_alt_route();
  }
 
+/* Travel times of the current route by the historical speeds, for departures
+ * every DEPARTURE_SWEEP_INTERVAL seconds over the next two hours.
+ */
+void navigate_main_departure_times(void){
+
+   static NavigateRouteSearch *search = NULL;
+   PluginLine from_line;
+   int from_point;
+   int travel_times[DEPARTURE_SWEEP_COUNT];
+   time_t now = time (NULL);
+   time_t best_departure;
+   char leave_at[20];
+   char msg[256];
+   int best;
+
+   if (navigate_main_state() != 0)
+      return;
+
+   if (navigate_find_track_points_in_scale
+         (&from_line, &from_point,
+          &NavigateDestination, &NavigateDestPoint, NULL, 1, 0, 1) < 0) {
+
+      roadmap_messagebox("Error", "Current position is unknown");
+      return;
+   }
+
+   if (!search) search = navigate_route_search_new ();
+
+   roadmap_main_set_cursor (ROADMAP_CURSOR_WAIT);
+   best = navigate_route_search_eta_sweep (search, &from_line, from_point,
+                                           &NavigateDestination, NavigateDestPoint,
+                                           now, DEPARTURE_SWEEP_INTERVAL,
+                                           DEPARTURE_SWEEP_COUNT, travel_times);
+   roadmap_main_set_cursor (ROADMAP_CURSOR_NORMAL);
+
+   if (best < 0) {
+      roadmap_messagebox("Oops", "Error calculating route.");
+      return;
+   }
+
+   best_departure = now + (time_t)best * DEPARTURE_SWEEP_INTERVAL;
+   strftime (leave_at, sizeof (leave_at), "%H:%M", localtime (&best_departure));
+
+   msg[0] = 0;
+   if (travel_times[0] >= 0) {
+      snprintf (msg, sizeof (msg), "%s: %d %s\n",
+                roadmap_lang_get ("Leaving now"),
+                (travel_times[0] + 59) / 60,
+                roadmap_lang_get ("min."));
+   }
+
+   snprintf (msg + strlen (msg), sizeof (msg) - strlen (msg), "%s %s: %d %s",
+             roadmap_lang_get ("Fastest, leaving at"), leave_at,
+             (travel_times[best] + 59) / 60,
+             roadmap_lang_get ("min."));
+
+   roadmap_messagebox ("Departure time", msg);
+}
+
 int navigate_main_calc_route ( int add_flags  /* additional flags */ ) {
 
    int track_time;
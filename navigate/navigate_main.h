@@ -202,6 +202,8 @@ int navigate_main_is_alt_routes(void);
 void navigate_main_set_dest_pos(RoadMapPosition *position);
 void navigate_main_recalculate_route(void);
 void navigate_main_alt_recalculate_route(void);
+void navigate_main_on_local_alt_route (int alt_id);
+void navigate_main_departure_times(void);
 
 void navigate_main_start_navigating (void);
 int navigate_main_tts_prepare_route( void );
@@ -0,0 +1,281 @@
+/* navigate_queue.c - priority queues for route calculation
+ *
+ * LICENSE:
+ *
+ *   Copyright 2007 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * SYNOPSYS:
+ *
+ *   See navigate_queue.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+
+#include "navigate_queue.h"
+
+#define HEAP_ARITY 4
+#define RADIX_BUCKETS 33
+
+typedef struct {
+   int key;
+   void *data;
+} QueueEntry;
+
+typedef struct {
+   QueueEntry *entries;
+   int count;
+   int size;
+} QueueArray;
+
+struct NavigateQueue {
+   int type;
+   int count;
+
+   /* NAVIGATE_QUEUE_HEAP */
+   QueueArray heap;
+
+   /* NAVIGATE_QUEUE_RADIX */
+   int last_key;
+   QueueArray buckets[RADIX_BUCKETS];
+};
+
+
+static void array_push (QueueArray *array, int key, void *data) {
+
+   if (array->count == array->size) {
+      array->size = array->size ? array->size * 2 : 16;
+      array->entries = realloc (array->entries, array->size * sizeof(QueueEntry));
+      roadmap_check_allocated(array->entries);
+   }
+
+   array->entries[array->count].key = key;
+   array->entries[array->count].data = data;
+   array->count++;
+}
+
+
+static void heap_insert (QueueArray *heap, int key, void *data) {
+
+   QueueEntry *entries;
+   int i;
+
+   array_push (heap, key, data);
+   entries = heap->entries;
+
+   for (i = heap->count - 1; i > 0; ) {
+
+      int parent = (i - 1) / HEAP_ARITY;
+      QueueEntry tmp;
+
+      if (entries[parent].key <= entries[i].key) break;
+
+      tmp = entries[parent];
+      entries[parent] = entries[i];
+      entries[i] = tmp;
+      i = parent;
+   }
+}
+
+
+static void *heap_extract_min (QueueArray *heap) {
+
+   QueueEntry *entries = heap->entries;
+   QueueEntry last;
+   void *data = entries[0].data;
+   int i = 0;
+
+   heap->count--;
+   if (!heap->count) return data;
+
+   last = entries[heap->count];
+
+   while (1) {
+
+      int first_child = i * HEAP_ARITY + 1;
+      int last_child = first_child + HEAP_ARITY;
+      int best = -1;
+      int child;
+
+      if (last_child > heap->count) last_child = heap->count;
+
+      for (child = first_child; child < last_child; child++) {
+         if (entries[child].key < (best < 0 ? last.key : entries[best].key)) {
+            best = child;
+         }
+      }
+
+      if (best < 0) break;
+
+      entries[i] = entries[best];
+      i = best;
+   }
+
+   entries[i] = last;
+
+   return data;
+}
+
+
+static int radix_bucket (int key, int last_key) {
+
+   unsigned int diff = (unsigned int)(key ^ last_key);
+   int bucket = 0;
+
+   while (diff) {
+      bucket++;
+      diff >>= 1;
+   }
+
+   return bucket;
+}
+
+
+/* Make sure bucket 0 holds the items with the minimal key */
+static void radix_normalize (NavigateQueue *queue) {
+
+   QueueArray *bucket;
+   int i;
+   int min_key;
+
+   if (queue->buckets[0].count || !queue->count) return;
+
+   for (i = 1; !queue->buckets[i].count; i++)
+      ;
+
+   bucket = queue->buckets + i;
+   min_key = bucket->entries[0].key;
+   for (i = 1; i < bucket->count; i++) {
+      if (bucket->entries[i].key < min_key) min_key = bucket->entries[i].key;
+   }
+
+   queue->last_key = min_key;
+
+   /* Every item moves to a lower bucket, so the source is never appended to */
+   for (i = 0; i < bucket->count; i++) {
+      QueueEntry *entry = bucket->entries + i;
+      array_push (queue->buckets + radix_bucket (entry->key, min_key),
+                  entry->key, entry->data);
+   }
+   bucket->count = 0;
+}
+
+
+NavigateQueue *navigate_queue_new (int type, int initial_size) {
+
+   NavigateQueue *queue = calloc (1, sizeof(NavigateQueue));
+
+   roadmap_check_allocated(queue);
+   queue->type = type;
+
+   if (initial_size > 0) {
+      QueueArray *array = (type == NAVIGATE_QUEUE_RADIX) ? queue->buckets : &queue->heap;
+      array->size = initial_size;
+      array->entries = malloc (initial_size * sizeof(QueueEntry));
+      roadmap_check_allocated(array->entries);
+   }
+
+   return queue;
+}
+
+
+void navigate_queue_free (NavigateQueue *queue) {
+
+   int i;
+
+   free (queue->heap.entries);
+   for (i = 0; i < RADIX_BUCKETS; i++) {
+      free (queue->buckets[i].entries);
+   }
+   free (queue);
+}
+
+
+void navigate_queue_reset (NavigateQueue *queue) {
+
+   int i;
+
+   queue->count = 0;
+   queue->heap.count = 0;
+   queue->last_key = 0;
+   for (i = 0; i < RADIX_BUCKETS; i++) {
+      queue->buckets[i].count = 0;
+   }
+}
+
+
+void navigate_queue_insert (NavigateQueue *queue, int key, void *data) {
+
+   queue->count++;
+
+   if (queue->type == NAVIGATE_QUEUE_RADIX) {
+
+      if (key < queue->last_key) key = queue->last_key;
+      array_push (queue->buckets + radix_bucket (key, queue->last_key), key, data);
+   } else {
+
+      heap_insert (&queue->heap, key, data);
+   }
+}
+
+
+int navigate_queue_empty (NavigateQueue *queue) {
+
+   return queue->count == 0;
+}
+
+
+int navigate_queue_count (NavigateQueue *queue) {
+
+   return queue->count;
+}
+
+
+int navigate_queue_min_key (NavigateQueue *queue) {
+
+   if (!queue->count) return 0;
+
+   if (queue->type == NAVIGATE_QUEUE_RADIX) {
+      radix_normalize (queue);
+      return queue->last_key;
+   }
+
+   return queue->heap.entries[0].key;
+}
+
+
+void *navigate_queue_extract_min (NavigateQueue *queue) {
+
+   QueueArray *bucket;
+
+   if (!queue->count) return NULL;
+
+   if (queue->type != NAVIGATE_QUEUE_RADIX) {
+      queue->count--;
+      return heap_extract_min (&queue->heap);
+   }
+
+   radix_normalize (queue);
+   queue->count--;
+   bucket = queue->buckets;
+
+   return bucket->entries[--bucket->count].data;
+}
@@ -0,0 +1,53 @@
+/* navigate_queue.h - priority queues for route calculation
+ *
+ * LICENSE:
+ *
+ *   Copyright 2007 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef _NAVIGATE_QUEUE_H_
+#define _NAVIGATE_QUEUE_H_
+
+/* NAVIGATE_QUEUE_HEAP is a 4-ary implicit heap which accepts any key.
+ *
+ * NAVIGATE_QUEUE_RADIX is a monotone radix heap: keys must not be negative
+ * and must not be lower than the last extracted key. Lower keys are
+ * raised to the last extracted key, the same way A* clamps its costs.
+ *
+ * Both keep their items in arrays which only grow, so inserting does not
+ * allocate once the queue has warmed up. Items with equal keys may be
+ * extracted in any order.
+ */
+#define NAVIGATE_QUEUE_HEAP   0
+#define NAVIGATE_QUEUE_RADIX  1
+
+typedef struct NavigateQueue NavigateQueue;
+
+NavigateQueue *navigate_queue_new (int type, int initial_size);
+void navigate_queue_free  (NavigateQueue *queue);
+void navigate_queue_reset (NavigateQueue *queue);
+
+void  navigate_queue_insert      (NavigateQueue *queue, int key, void *data);
+int   navigate_queue_empty       (NavigateQueue *queue);
+int   navigate_queue_min_key     (NavigateQueue *queue);
+void *navigate_queue_extract_min (NavigateQueue *queue);
+int   navigate_queue_count       (NavigateQueue *queue);
+
+#endif /* _NAVIGATE_QUEUE_H_ */
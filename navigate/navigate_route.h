@@ -25,6 +25,7 @@
 #ifndef _NAVIGATE_ROUTE_H_
 #define _NAVIGATE_ROUTE_H_
 
+#include <time.h>
 #include "navigate_main.h"
 
 
@@ -43,6 +44,8 @@
 #define CHANGED_DESTINATION		128 
 #define GRAPH_IGNORE_TURNS 		64
 
+typedef struct NavigateRouteSearch NavigateRouteSearch;
+
 int navigate_route_reload_data (void);
 int navigate_route_load_data   (void);
 
@@ -57,5 +60,84 @@ int navigate_route_get_segments (PluginLine *from_line,
                                  const NavigateSegment *prev_segments,
                                  int num_prev_segments);
 
+/* Route calculation on a private search context. The segments returned
+ * point into the context and are valid until its next search.
+ * navigate_route_get_segments () uses a default context. The contexts
+ * share the map and the graph caches, so all the searches run on the
+ * main thread, one at a time.
+ */
+NavigateRouteSearch *navigate_route_search_new (void);
+void navigate_route_search_free (NavigateRouteSearch *search);
+
+int navigate_route_search_get_segments (NavigateRouteSearch *search,
+                                        PluginLine *from_line,
+                                        int from_point,
+                                        PluginLine *to_line,
+                                        int *to_point,
+                                        NavigateSegment **segments,
+                                        int *num_total,
+                                        int *num_new,
+                                        int *flags,
+                                        const NavigateSegment *prev_segments,
+                                        int num_prev_segments);
+
+/* Time dependent travel time (seconds) from the given departure time, by the
+ * historical speed profiles of the lines. Returns -1 if there is no route.
+ */
+int navigate_route_search_eta (NavigateRouteSearch *search,
+                               PluginLine *from_line,
+                               int from_point,
+                               const PluginLine *to_line,
+                               int to_point,
+                               time_t departure);
+
+/* Travel times for count departures, every interval seconds starting at
+ * first_departure (e.g. count 25, interval 300 for the next two hours).
+ * Fills travel_times (-1 where there is no route) and returns the index of
+ * the fastest departure, or -1.
+ */
+int navigate_route_search_eta_sweep (NavigateRouteSearch *search,
+                                     PluginLine *from_line,
+                                     int from_point,
+                                     const PluginLine *to_line,
+                                     int to_point,
+                                     time_t first_departure,
+                                     int interval,
+                                     int count,
+                                     int *travel_times);
+
+/* Travel cost matrix from every origin to every destination, one search per
+ * origin and without UI progress. costs is num_origins rows of
+ * num_destinations entries, -1 where the destination was not reached.
+ */
+int navigate_route_search_matrix (NavigateRouteSearch *search,
+                                  const PluginLine *origins,
+                                  const int *origin_points,
+                                  int num_origins,
+                                  const PluginLine *destinations,
+                                  int num_destinations,
+                                  int *costs);
+
+typedef struct {
+   NavigateSegment *segments;  /* see navigate_route_alternatives_free () */
+   int num_segments;
+   int cost;                   /* without the alternatives penalties */
+   int length;
+} NavigateRouteAlternative;
+
+/* Up to max_routes diverse routes, the best route first. Each search
+ * penalizes the lines of the routes found so far. Returns the number of
+ * routes filled.
+ */
+int navigate_route_search_alternatives (NavigateRouteSearch *search,
+                                        PluginLine *from_line,
+                                        int from_point,
+                                        const PluginLine *to_line,
+                                        int to_point,
+                                        int max_routes,
+                                        NavigateRouteAlternative *routes);
+
+void navigate_route_alternatives_free (NavigateRouteAlternative *routes, int count);
+
 #endif /* _NAVIGATE_ROUTE_H_ */
 
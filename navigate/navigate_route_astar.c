@@ -42,6 +42,7 @@
 #include "roadmap_turns.h"
 #include "roadmap_main.h"
 #include "roadmap_line_route.h"
+#include "roadmap_line_speed.h"
 #include "roadmap_hash.h"
 #include "roadmap_navigate.h"
 
@@ -55,8 +56,9 @@
 #include "navigate_traffic.h"
 #include "navigate_graph.h"
 #include "navigate_cost.h"
+#include "navigate_ch.h"
 
-#include "fib-1.1/fib.h"
+#include "navigate_queue.h"
 #include "navigate_route.h"
 
 #define LOCKED_ROUTE (1 << 7)
@@ -74,12 +76,18 @@
 #define HASH_BLOCK_SIZE 4096
 #define HASH_MAX_BLOCKS 40
 #define MAX_ASTAR_LINES (HASH_BLOCK_SIZE * HASH_MAX_BLOCKS)
-static int RouteNumNodes = 0;
 
 #define MAX_REROUTE_ATTEMPS	100
 
-static RoadMapHash *RouteGraph;
-static RoadMapPosition GoalPos;
+/* Alternative routes: every use of a line raises its cost by PENALTY_STEP
+ * percent. Candidates are kept when they are at most MAX_ALT_STRETCH
+ * percent of the best route cost and share at most MAX_ALT_OVERLAP percent
+ * of their length with the routes already kept.
+ */
+#define PENALTY_STEP			40
+#define MAX_ALT_STRETCH		150
+#define MAX_ALT_OVERLAP		70
+#define MAX_ALT_ATTEMPTS	3
 
 typedef struct {
 	int					line_square;
@@ -87,7 +95,6 @@ typedef struct {
 	unsigned short		line_id;
 	unsigned short		prev_id;
 } NavItem;
-static NavItem *NavNode[HASH_MAX_BLOCKS];
 
 typedef struct {
 	int square;
@@ -107,7 +114,43 @@ typedef struct {
 #define MAX_NAV_SEGEMENTS 2500
 #endif
 
-static NavigateSegment NavigateSegments[MAX_NAV_SEGEMENTS];
+/* The state of one route calculation. The segments returned by a search
+ * stay valid until the next search on the same context.
+ *
+ * A context lets searches be interleaved on the main thread, e.g. a
+ * matrix row between two legs of a route. It does not make them thread
+ * safe: every search reads the map through the current square of
+ * roadmap_square.c, and may build squares in the graph cache of
+ * navigate_graph.c and the hierarchies of navigate_ch.c, and the cost
+ * functions of navigate_cost.c keep their departure time. All the
+ * searches must run on the main thread, one at a time.
+ */
+struct NavigateRouteSearch {
+	RoadMapHash			*route_graph;
+	NavItem				*nav_node[HASH_MAX_BLOCKS];
+	int					num_nodes;
+	RoadMapPosition	goal_pos;
+	NavigateQueue		*queue;
+	NavigateSegment	segments[MAX_NAV_SEGEMENTS];
+	int					busy;
+
+	/* cost from the start of each previous route segment to the destination */
+	int					prev_costs[MAX_NAV_SEGEMENTS];
+
+	/* lines penalized by the alternative routes search */
+	RoadMapHash			*penalty_hash;
+	int					*penalty_square;
+	int					*penalty_line;
+	unsigned char		*penalty_count;
+	unsigned char		*penalty_kept;
+	int					num_penalties;
+	int					max_penalties;
+
+	/* time dependent mode, see navigate_route_search_eta () */
+	int					time_dependent;
+};
+
+static NavigateRouteSearch *DefaultSearch;
 
 int navigate_route_reload_data (void) {
 
@@ -125,22 +168,22 @@ static int hash_key (int square, int line, int reversed) {
 }
 
 
-static NavItem *make_path (int square_id, int line_id, int line_reversed,
+static NavItem *make_path (NavigateRouteSearch *search, int square_id, int line_id, int line_reversed,
 							  		int prev_square, int prev_line, int prev_reversed) {
 
    NavItem *item;
 
-	if (RouteNumNodes >= MAX_ASTAR_LINES) {
+	if (search->num_nodes >= MAX_ASTAR_LINES) {
 		roadmap_log (ROADMAP_ERROR, "Too many nodes in route calculation");
 		return NULL;
 	}
 
-	if (RouteNumNodes % HASH_BLOCK_SIZE == 0) {
-		if (RouteNumNodes) roadmap_hash_resize (RouteGraph, RouteNumNodes + HASH_BLOCK_SIZE);
-		NavNode[RouteNumNodes / HASH_BLOCK_SIZE] = (NavItem *)malloc (HASH_BLOCK_SIZE * sizeof (NavItem));
+	if (search->num_nodes % HASH_BLOCK_SIZE == 0) {
+		if (search->num_nodes) roadmap_hash_resize (search->route_graph, search->num_nodes + HASH_BLOCK_SIZE);
+		search->nav_node[search->num_nodes / HASH_BLOCK_SIZE] = (NavItem *)malloc (HASH_BLOCK_SIZE * sizeof (NavItem));
 	}
 
-	item = NavNode[RouteNumNodes / HASH_BLOCK_SIZE] + (RouteNumNodes % HASH_BLOCK_SIZE);
+	item = search->nav_node[search->num_nodes / HASH_BLOCK_SIZE] + (search->num_nodes % HASH_BLOCK_SIZE);
 	item->prev_square = prev_square | (prev_reversed ? REVERSED : 0);
 	item->prev_id = prev_line;
 	item->line_square = square_id | (line_reversed ? REVERSED : 0);
@@ -150,33 +193,59 @@ static NavItem *make_path (int square_id, int line_id, int line_reversed,
 	//			item->prev_square & ~REVERSED, item->prev_id, item->prev_square & REVERSED ? "'" : "",
 	//			item->line_square & ~REVERSED, item->line_id, item->line_square & REVERSED ? "'" : "");
 
-	roadmap_hash_add (RouteGraph, hash_key (square_id, line_id, line_reversed), RouteNumNodes);
-	RouteNumNodes++;
+	roadmap_hash_add (search->route_graph, hash_key (square_id, line_id, line_reversed), search->num_nodes);
+	search->num_nodes++;
 
 	return item;
 }
 
 
-static NavItem *find_prev (int square_id, int line_id, int line_reversed) {
+static int find_index (NavigateRouteSearch *search, int square_id, int line_id, int line_reversed) {
 
 	int key = hash_key (square_id, line_id, line_reversed);
-	int index = roadmap_hash_get_first (RouteGraph, key);
+	int index = roadmap_hash_get_first (search->route_graph, key);
 
 	if (line_reversed) {
 		square_id = square_id | REVERSED;
 	}
 
 	while (index >= 0) {
-		NavItem *item = NavNode[index / HASH_BLOCK_SIZE] + (index % HASH_BLOCK_SIZE);
+		NavItem *item = search->nav_node[index / HASH_BLOCK_SIZE] + (index % HASH_BLOCK_SIZE);
 		if (item->line_square == square_id &&
 			 item->line_id == line_id) {
 
-			return item;
+			return index;
 		}
-		index = roadmap_hash_get_next (RouteGraph, index);
+		index = roadmap_hash_get_next (search->route_graph, index);
 	}
 
-	return NULL;
+	return -1;
+}
+
+
+static NavItem *find_prev (NavigateRouteSearch *search, int square_id, int line_id, int line_reversed) {
+
+	int index = find_index (search, square_id, line_id, line_reversed);
+
+	if (index < 0) return NULL;
+
+	return search->nav_node[index / HASH_BLOCK_SIZE] + (index % HASH_BLOCK_SIZE);
+}
+
+
+/* Admissible estimate of the cost from a point at the given distance */
+static int goal_cost (NavigateRouteSearch *search, int navigate_type, int distance) {
+
+	/* Tiles are mapped while the search runs, so the bound must hold for
+	 * the speeds of any tile rather than of the tiles mapped so far.
+	 */
+	if (search->time_dependent) {
+		return (int)(roadmap_math_to_cm (distance) / 100 * 3.6 / ROADMAP_LINE_SPEED_MAX);
+	}
+
+	if (navigate_type == COST_FASTEST) return distance / HU_SPEED;
+
+	return distance;
 }
 
 
@@ -193,15 +262,17 @@ static void get_to_node (int square, int line_id, int reversed, int *node, RoadM
 
 
 
-struct fibheap * make_queue (int square, int line_id, int reversed) {
+static NavigateQueue *make_queue (NavigateRouteSearch *search, int square, int line_id, int reversed) {
+
+   NavItem *item = make_path (search, square, line_id, reversed, square, line_id, reversed);
 
-   struct fibheap *fh;
-   NavItem *item = make_path (square, line_id, reversed, square, line_id, reversed);
-   fh = fh_makekeyheap();
+   /* A* keys never go below the last extracted key, see astar () */
+   if (!search->queue) search->queue = navigate_queue_new (NAVIGATE_QUEUE_RADIX, HASH_BLOCK_SIZE);
+   navigate_queue_reset (search->queue);
 
-   fh_insertkey (fh, 0, item);
+   navigate_queue_insert (search->queue, 0, item);
 
-   return fh;
+   return search->queue;
 }
 
 static void update_progress (int progress) {
@@ -223,18 +294,146 @@ static void update_progress (int progress) {
    roadmap_main_flush ();
 }
 
-static int prepare_prev_list (const NavigateSegment *prev_route, int num_prev) {
+/* The cost of a route, and optionally the remaining cost from the start of
+ * each of its segments.
+ */
+static int route_cost (const NavigateSegment *prev_route, int num_prev, int *costs) {
 
+   NavigateCostFn cost_fn = navigate_cost_get ();
+   int total = 0;
    int i;
 
-   RouteGraph = roadmap_hash_new ("astar", HASH_BLOCK_SIZE);
-   RouteNumNodes = 0;
+   for (i = num_prev - 1; i >= 0; i--) {
+
+      int reversed = prev_route[i].line_direction != ROUTE_DIRECTION_WITH_LINE;
+      int node = -1;
+      int cost;
+
+      roadmap_square_set_current (prev_route[i].square);
+
+      if (i > 0 && prev_route[i - 1].square == prev_route[i].square) {
+         if (reversed) roadmap_line_to_point (prev_route[i].line, &node);
+         else roadmap_line_from_point (prev_route[i].line, &node);
+      }
+
+      cost = cost_fn (prev_route[i].line, reversed, 0,
+                      i > 0 ? prev_route[i - 1].line : -1,
+                      i > 0 ? prev_route[i - 1].line_direction != ROUTE_DIRECTION_WITH_LINE : 0,
+                      node);
+      if (cost > 0) total += cost;
+
+      if (costs) costs[i] = total;
+   }
+
+   return total;
+}
+
+/* Labels the previous route with its remaining cost, so a recalculation
+ * can rejoin it wherever the total is the lowest.
+ */
+static void prepare_prev_costs (NavigateRouteSearch *search, const NavigateSegment *prev_route, int num_prev) {
+
+   if (num_prev > MAX_NAV_SEGEMENTS) num_prev = MAX_NAV_SEGEMENTS;
+
+   route_cost (prev_route, num_prev, search->prev_costs);
+}
+
+
+static int find_penalty (NavigateRouteSearch *search, int square, int line_id) {
+
+	int i;
+
+	for (i = roadmap_hash_get_first (search->penalty_hash, hash_key (square, line_id, 0));
+		  i >= 0;
+		  i = roadmap_hash_get_next (search->penalty_hash, i)) {
+
+		if (search->penalty_square[i] == square &&
+			 search->penalty_line[i] == line_id) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+
+static int add_penalty (NavigateRouteSearch *search, int square, int line_id) {
+
+	int i = find_penalty (search, square, line_id);
+
+	if (i >= 0) {
+		if (search->penalty_count[i] < 255) search->penalty_count[i]++;
+		return i;
+	}
+
+	if (search->num_penalties == search->max_penalties) {
+		search->max_penalties += HASH_BLOCK_SIZE;
+		roadmap_hash_resize (search->penalty_hash, search->max_penalties);
+		search->penalty_square = realloc (search->penalty_square, search->max_penalties * sizeof (int));
+		search->penalty_line = realloc (search->penalty_line, search->max_penalties * sizeof (int));
+		search->penalty_count = realloc (search->penalty_count, search->max_penalties);
+		search->penalty_kept = realloc (search->penalty_kept, search->max_penalties);
+		roadmap_check_allocated(search->penalty_square);
+		roadmap_check_allocated(search->penalty_line);
+		roadmap_check_allocated(search->penalty_count);
+		roadmap_check_allocated(search->penalty_kept);
+	}
+
+	i = search->num_penalties++;
+	search->penalty_square[i] = square;
+	search->penalty_line[i] = line_id;
+	search->penalty_count[i] = 1;
+	search->penalty_kept[i] = 0;
+	roadmap_hash_add (search->penalty_hash, hash_key (square, line_id, 0), i);
+
+	return i;
+}
+
+
+static int penalized_cost (NavigateRouteSearch *search, int square, int line_id, int cost) {
+
+	int i = find_penalty (search, square, line_id);
+
+	if (i < 0) return cost;
+
+	return cost + cost * PENALTY_STEP * search->penalty_count[i] / 100;
+}
+
+
+static void free_penalties (NavigateRouteSearch *search) {
+
+	if (!search->penalty_hash) return;
+
+	roadmap_hash_free (search->penalty_hash);
+	free (search->penalty_square);
+	free (search->penalty_line);
+	free (search->penalty_count);
+	free (search->penalty_kept);
+
+	search->penalty_hash = NULL;
+	search->penalty_square = NULL;
+	search->penalty_line = NULL;
+	search->penalty_count = NULL;
+	search->penalty_kept = NULL;
+	search->num_penalties = 0;
+	search->max_penalties = 0;
+}
+
+static int prepare_prev_list (NavigateRouteSearch *search, const NavigateSegment *prev_route, int num_prev) {
+
+   int i;
+
+   search->route_graph = roadmap_hash_new ("astar", HASH_BLOCK_SIZE);
+   search->num_nodes = 0;
+
+   if (num_prev > 0) prepare_prev_costs (search, prev_route, num_prev);
 
    for (i = 0; i < num_prev; i++) {
    	if (prev_route[i].context != SEG_ROUNDABOUT &&
    		 (i == 0 || prev_route[i - 1].context != SEG_ROUNDABOUT)) {
    		// making sure roundabout is not split between old and new route segments
-	   	make_path (prev_route[i].square,
+	   	make_path (search,
+	   				  prev_route[i].square,
 	   				  prev_route[i].line,
 	   				  prev_route[i].line_direction != ROUTE_DIRECTION_WITH_LINE,
 	   				  -1,
@@ -246,24 +445,33 @@ static int prepare_prev_list (const NavigateSegment *prev_route, int num_prev) {
    return 0;
 }
 
-static void free_prev_list(void) {
+static void free_prev_list(NavigateRouteSearch *search) {
 
    int i;
 
-   if (RouteGraph) {
-	   roadmap_hash_free (RouteGraph);
-	   RouteGraph = NULL;
+   if (search->route_graph) {
+	   roadmap_hash_free (search->route_graph);
+	   search->route_graph = NULL;
    }
-   if (RouteNumNodes) {
-   	for (i = (RouteNumNodes - 1) / HASH_BLOCK_SIZE; i >= 0; i--) {
-   		free (NavNode[i]);
+   if (search->num_nodes) {
+   	for (i = (search->num_nodes - 1) / HASH_BLOCK_SIZE; i >= 0; i--) {
+   		free (search->nav_node[i]);
    	}
-   	RouteNumNodes = 0;
+   	search->num_nodes = 0;
    }
 }
 
 
-static int astar(int *start_square, int start_node, int *start_segment, int *start_reversed,
+static int ch_add_path (void *context,
+                        int square, int line_id, int reversed,
+                        int prev_square, int prev_line_id, int prev_reversed) {
+
+	return make_path ((NavigateRouteSearch *)context,
+							square, line_id, reversed, prev_square, prev_line_id, prev_reversed) != NULL;
+}
+
+
+static int astar(NavigateRouteSearch *search, int *start_square, int start_node, int *start_segment, int *start_reversed,
                  PluginLine *goal, int *goal_node, int *route_total_cost, int *flags,
                  int *first_prev_segment, int *last_is_reversed)
 {
@@ -301,16 +509,22 @@ static int astar(int *start_square, int start_node, int *start_segment, int *sta
    RoadMapPosition start_position;
    int out_of_memory;
 
-   struct fibheap *q;
-   NavigateCostFn cost_fn = navigate_cost_get ();
+   NavItem *join_item = NULL;
+   int join_cost = 0;
+   int join_square = 0;
+   int join_line = 0;
+
+   NavigateQueue *q;
+   NavigateCostFn cost_fn = search->time_dependent ?
+   									navigate_cost_get_time_dependent () : navigate_cost_get ();
    int navigate_type = navigate_cost_type ();
 
 	*first_prev_segment = -1;
 	roadmap_square_set_current (goal_square);
-   roadmap_point_position (*goal_node, &GoalPos);
+   roadmap_point_position (*goal_node, &search->goal_pos);
    roadmap_square_set_current (*start_square);
    roadmap_point_position (start_node, &position);
-   goal_distance = (float)roadmap_math_distance (&position, &GoalPos);
+   goal_distance = (float)roadmap_math_distance (&position, &search->goal_pos);
    start_position = position;
    cur_max_progress = 0;
 
@@ -362,11 +576,11 @@ static int astar(int *start_square, int start_node, int *start_segment, int *sta
 	   last_line = *start_segment;
 	   last_line_reversed = *start_reversed;
 
-	   q = make_queue (last_square, last_line, last_line_reversed);
+	   q = make_queue (search, last_square, last_line, last_line_reversed);
 		num_heap_gets = 0;
 
 		out_of_memory = 0;
-	   while (fh_min(q) != NULL && !out_of_memory) {
+	   while (!navigate_queue_empty (q) && !out_of_memory) {
 
 			if (((*flags) & USE_LAST_RESULTS) &&
 				 num_heap_gets >= MAX_REROUTE_ATTEMPS) {
@@ -375,8 +589,12 @@ static int astar(int *start_square, int start_node, int *start_segment, int *sta
 			}
 	      num_heap_gets++;
 
-	      cur_cost = fh_minkey(q);
-	      item = (NavItem *)fh_extractmin(q);
+	      cur_cost = navigate_queue_min_key (q);
+
+	      /* no cheaper way back to the previous route can remain */
+	      if (join_item && cur_cost >= join_cost) break;
+
+	      item = (NavItem *)navigate_queue_extract_min (q);
 	      last_square = item->line_square & ~REVERSED;
 	      last_line = item->line_id;
 	      last_line_reversed = item->line_square & REVERSED;
@@ -385,15 +603,14 @@ static int astar(int *start_square, int start_node, int *start_segment, int *sta
 
 	      prev_cost = cur_cost;
 	      if (cur_cost) {
-	         int dis = roadmap_math_distance (&position, &GoalPos);
-	         if (navigate_type == COST_FASTEST) dis = (dis / HU_SPEED);
-	         cur_cost -= dis;
+	         cur_cost -= goal_cost (search, navigate_type,
+	         							  roadmap_math_distance (&position, &search->goal_pos));
 	      }
 
 	      if (last_square == goal_square &&
-	      	 last_line == goal_line) {
+	      	 last_line == goal_line &&
+	      	 (!join_item || cur_cost < join_cost)) {
 	         *route_total_cost = cur_cost;
-	         fh_deleteheap(q);
 	         //printf("Total no. of heap gets in this search: %d\n", num_heap_gets);
 	         //printf ("Final cost for track is %d\n", cur_cost);
 	         *last_is_reversed = last_line_reversed;
@@ -436,14 +653,20 @@ static int astar(int *start_square, int start_node, int *start_segment, int *sta
 	         segment = successors[i].line_id;
 	         is_reversed = successors[i].reversed;
 
-				prev_ptr = find_prev (square, segment, is_reversed);
+				prev_ptr = find_prev (search, square, segment, is_reversed);
 				if (prev_ptr != NULL) {
 					if (prev_ptr->prev_square == -1) {
-						*first_prev_segment = prev_ptr->prev_id;
-						prev_ptr->prev_square = last_square | (last_line_reversed ? REVERSED : 0);
-						prev_ptr->prev_id = last_line;
-						fh_deleteheap(q);
-						return 0;
+						/* remember the cheapest rejoin, and keep searching
+						 * while a cheaper one is still possible
+						 */
+						int cost = cur_cost + search->prev_costs[prev_ptr->prev_id];
+
+						if (!join_item || cost < join_cost) {
+							join_item = prev_ptr;
+							join_cost = cost;
+							join_square = last_square | (last_line_reversed ? REVERSED : 0);
+							join_line = last_line;
+						}
 					}
 					continue;
 				}
@@ -455,9 +678,13 @@ static int astar(int *start_square, int start_node, int *start_segment, int *sta
 
 	         if (segment_cost < 0) continue;
 
+	         if (search->penalty_hash) {
+	         	segment_cost = penalized_cost (search, square, segment, segment_cost);
+	         }
+
 	         path_cost = segment_cost + cur_cost;
 	         roadmap_point_position (successors[i].to_point, &to_pos);
-	         distance_to_goal = roadmap_math_distance (&to_pos, &GoalPos);
+	         distance_to_goal = roadmap_math_distance (&to_pos, &search->goal_pos);
 
 	         if (distance_to_goal < best_distance) {
 
@@ -473,18 +700,14 @@ static int astar(int *start_square, int start_node, int *start_segment, int *sta
 	         //		  square, segment, successors[i].to_point,
 	         //		  to_pos.longitude, to_pos.latitude, distance_to_goal);
 
-	         if (navigate_type == COST_FASTEST) {
-	            cost_to_goal = (distance_to_goal / HU_SPEED);
-	         } else {
-	            cost_to_goal = distance_to_goal;
-	         }
+	         cost_to_goal = goal_cost (search, navigate_type, distance_to_goal);
 
 	         total_cost = path_cost + cost_to_goal + 1;
 	         if (total_cost < prev_cost) {
 	            total_cost = prev_cost;
 	         }
 
-	         prev_ptr = make_path (square, segment, is_reversed,
+	         prev_ptr = make_path (search, square, segment, is_reversed,
 	         				  	   	 last_square, last_line, last_line_reversed);
 
 				if (!prev_ptr) {
@@ -493,7 +716,7 @@ static int astar(int *start_square, int start_node, int *start_segment, int *sta
 					break;
 				}
 
-	         fh_insertkey(q, total_cost, prev_ptr);
+	         navigate_queue_insert (q, total_cost, prev_ptr);
 
 				progress = (int)(100 * (1 - sqrt ((float)distance_to_goal / goal_distance)));
 	         if ((progress >> 2 ) > (cur_max_progress >> 2)) {
@@ -503,7 +726,14 @@ static int astar(int *start_square, int start_node, int *start_segment, int *sta
 
 	      }
 	   }
-	   fh_deleteheap(q);
+
+	   if (join_item) {
+			*first_prev_segment = join_item->prev_id;
+			join_item->prev_square = join_square;
+			join_item->prev_id = join_line;
+			*route_total_cost = join_cost;
+			return 0;
+	   }
 	}
 
 	if (((*flags) & ALLOW_DESTINATION_CHANGE) &&
@@ -521,7 +751,8 @@ static int astar(int *start_square, int start_node, int *start_segment, int *sta
 }
 
 
-static int navigate_route_calc_segments (PluginLine *from_line,
+static int navigate_route_calc_segments (NavigateRouteSearch *search,
+                                         PluginLine *from_line,
                                          int from_point,
                                          PluginLine *to_line,
                                          int *to_point,
@@ -554,15 +785,34 @@ static int navigate_route_calc_segments (PluginLine *from_line,
    else if (from_point == line_from_point) start_line_reversed = REVERSED;
    else start_line_reversed = 0;
 
-   rc = astar (&start_square, from_point, &start_line, &start_line_reversed,
-   				  to_line, to_point, &total_cost, flags, &first_prev_segment, &line_reversed);
+   rc = -1;
+   if (navigate_ch_enabled () && !((*flags) & USE_LAST_RESULTS) &&
+       !search->time_dependent && !search->penalty_hash) {
+
+   	first_prev_segment = -1;
+   	rc = navigate_ch_route (start_square, start_line, start_line_reversed != 0,
+   									to_line->square, to_line->line_id,
+   									ch_add_path, search, &total_cost, &line_reversed);
+   	if (rc == -1) {
+   		/* fall back to A*, which can also replace the departure or destination */
+   		free_prev_list (search);
+   		prepare_prev_list (search, prev_segments, 0);
+   	} else if (line_reversed) {
+   		line_reversed = REVERSED;
+   	}
+   }
+
+   if (rc == -1) {
+   	rc = astar (search, &start_square, from_point, &start_line, &start_line_reversed,
+   					to_line, to_point, &total_cost, flags, &first_prev_segment, &line_reversed);
+   }
 
    if (rc == -1) {
       return -1;
    }
 
    i = 0;
-   curr_segment = NavigateSegments + MAX_NAV_SEGEMENTS;
+   curr_segment = search->segments + MAX_NAV_SEGEMENTS;
 
 
    //printf("Route: ");
@@ -573,7 +823,8 @@ static int navigate_route_calc_segments (PluginLine *from_line,
 
    	const NavigateSegment *prev_segment = prev_segments + first_prev_segment;
 
-		prev_item = find_prev (prev_segment->square,
+		prev_item = find_prev (search,
+									  prev_segment->square,
 									  prev_segment->line,
 									  prev_segment->line_direction != ROUTE_DIRECTION_WITH_LINE);
 		if (!prev_item) {
@@ -616,7 +867,7 @@ static int navigate_route_calc_segments (PluginLine *from_line,
       	 (square == start_square) &&
           (line_reversed == start_line_reversed)) break;
 
-		prev_item = find_prev (square, line, line_reversed);
+		prev_item = find_prev (search, square, line, line_reversed);
 		if (!prev_item) {
 			roadmap_log (ROADMAP_ERROR, "Inconsistency in route calculation");
 			return -1;
@@ -665,7 +916,7 @@ static int navigate_route_calc_segments (PluginLine *from_line,
       }
    }
 
-   assert(curr_segment >= NavigateSegments);
+   assert(curr_segment >= search->segments);
 
 	*segments = curr_segment;
 
@@ -680,35 +931,56 @@ static int navigate_route_calc_segments (PluginLine *from_line,
 }
 
 
-int navigate_route_get_segments (PluginLine *from_line,
-                                 int from_point,
-                                 PluginLine *to_line,
-                                 int *to_point,
-                                 NavigateSegment **segments,
-                                 int *num_total,
-                                 int *num_new,
-                                 int *flags,
-                                 const NavigateSegment *prev_segments,
-                                 int num_prev_segments) {
+NavigateRouteSearch *navigate_route_search_new (void) {
+
+	NavigateRouteSearch *search = calloc (1, sizeof (NavigateRouteSearch));
+
+	roadmap_check_allocated(search);
+
+	return search;
+}
+
+
+void navigate_route_search_free (NavigateRouteSearch *search) {
+
+	if (!search) return;
+
+	free_prev_list (search);
+	free_penalties (search);
+	if (search->queue) navigate_queue_free (search->queue);
+	free (search);
+}
+
+
+int navigate_route_search_get_segments (NavigateRouteSearch *search,
+                                        PluginLine *from_line,
+                                        int from_point,
+                                        PluginLine *to_line,
+                                        int *to_point,
+                                        NavigateSegment **segments,
+                                        int *num_total,
+                                        int *num_new,
+                                        int *flags,
+                                        const NavigateSegment *prev_segments,
+                                        int num_prev_segments) {
 
-   static int inside_route = 0;
    int reuse = (*flags & USE_LAST_RESULTS);
    int rc;
    int prev_scale = roadmap_square_get_screen_scale ();
 
-   if (inside_route) {
+   if (search->busy) {
       roadmap_log (ROADMAP_ERROR, "re-entering navigate_route_get_segments");
       return -1;
    }
-   inside_route = 1;
+   search->busy = 1;
 
-   if (prepare_prev_list (prev_segments, reuse ? num_prev_segments : 0)) {
-      inside_route = 0;
+   if (prepare_prev_list (search, prev_segments, reuse ? num_prev_segments : 0)) {
+      search->busy = 0;
       return -1;
    }
 
 	roadmap_square_set_screen_scale (0);
-   rc = navigate_route_calc_segments(from_line, from_point, to_line, to_point, segments,
+   rc = navigate_route_calc_segments(search, from_line, from_point, to_line, to_point, segments,
    											 num_total, num_new, flags,
    											 prev_segments, num_prev_segments);
    if (rc > 0)
@@ -716,9 +988,397 @@ int navigate_route_get_segments (PluginLine *from_line,
 
    roadmap_square_set_screen_scale (prev_scale);
 
-   free_prev_list();
+   free_prev_list(search);
 
-   inside_route = 0;
+   search->busy = 0;
    return rc;
 }
 
+
+int navigate_route_get_segments (PluginLine *from_line,
+                                 int from_point,
+                                 PluginLine *to_line,
+                                 int *to_point,
+                                 NavigateSegment **segments,
+                                 int *num_total,
+                                 int *num_new,
+                                 int *flags,
+                                 const NavigateSegment *prev_segments,
+                                 int num_prev_segments) {
+
+   if (!DefaultSearch) DefaultSearch = navigate_route_search_new ();
+
+   return navigate_route_search_get_segments (DefaultSearch, from_line, from_point,
+                                              to_line, to_point, segments,
+                                              num_total, num_new, flags,
+                                              prev_segments, num_prev_segments);
+}
+
+
+static int route_eta (NavigateRouteSearch *search,
+							 PluginLine *from_line,
+							 int from_point,
+							 const PluginLine *to_line,
+							 int to_point,
+							 time_t departure) {
+
+	PluginLine goal = *to_line;
+	int goal_point = to_point;
+	NavigateSegment *segments;
+	int num_total;
+	int num_new;
+	int flags = RECALC_ROUTE;
+	int rc;
+	time_t start_time = navigate_cost_get_departure ();
+
+	navigate_cost_set_departure (departure);
+
+	search->time_dependent = 1;
+	rc = navigate_route_search_get_segments (search, from_line, from_point,
+														  &goal, &goal_point, &segments,
+														  &num_total, &num_new, &flags, NULL, 0);
+	search->time_dependent = 0;
+
+	/* The regular routes keep costing from their own start time */
+	navigate_cost_set_departure (start_time);
+
+	if (rc <= 0) return -1;
+
+	return rc - 1;
+}
+
+
+int navigate_route_search_eta (NavigateRouteSearch *search,
+										 PluginLine *from_line,
+										 int from_point,
+										 const PluginLine *to_line,
+										 int to_point,
+										 time_t departure) {
+
+	return route_eta (search, from_line, from_point, to_line, to_point, departure);
+}
+
+
+int navigate_route_search_eta_sweep (NavigateRouteSearch *search,
+												 PluginLine *from_line,
+												 int from_point,
+												 const PluginLine *to_line,
+												 int to_point,
+												 time_t first_departure,
+												 int interval,
+												 int count,
+												 int *travel_times) {
+
+	int best = -1;
+	int i;
+
+	for (i = 0; i < count; i++) {
+
+		travel_times[i] = route_eta (search, from_line, from_point, to_line, to_point,
+											  first_departure + (time_t)i * interval);
+
+		if (travel_times[i] >= 0 &&
+			 (best < 0 || travel_times[i] < travel_times[best])) {
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+
+/* One to many search from a single origin, without heuristic and without
+ * UI progress. Stops when all the destinations are reached.
+ *
+ * The cost of a line depends on the line it is entered from, so the first
+ * arrival at a line is not always the cheapest. Every line keeps the cost
+ * of its best arrival so far, a cheaper arrival relabels it and queues it
+ * again, and the stale queue entries are skipped when they come out.
+ */
+static void matrix_row (NavigateRouteSearch *search,
+								const PluginLine *origin,
+								int origin_point,
+								const PluginLine *destinations,
+								int num_destinations,
+								RoadMapHash *dest_hash,
+								int *costs) {
+
+	struct successor successors[MAX_SUCCESSORS];
+	NavigateCostFn cost_fn = navigate_cost_get ();
+	NavigateQueue *q;
+	NavItem *item;
+	int *label_cost = NULL;
+	int max_labels = 0;
+	int line_from_point;
+	int line_to_point;
+	int reversed;
+	int remaining = num_destinations;
+	int i;
+
+	for (i = 0; i < num_destinations; i++) costs[i] = -1;
+
+	roadmap_square_set_current (origin->square);
+	roadmap_line_points (origin->line_id, &line_from_point, &line_to_point);
+	reversed = (origin_point == line_from_point && origin_point != line_to_point) ? REVERSED : 0;
+
+	prepare_prev_list (search, NULL, 0);
+	q = make_queue (search, origin->square, origin->line_id, reversed);
+
+	while (remaining && !navigate_queue_empty (q)) {
+
+		int cur_cost = navigate_queue_min_key (q);
+		int last_square;
+		int last_line;
+		int last_reversed;
+		int node;
+		int count;
+		RoadMapPosition position;
+
+		item = (NavItem *)navigate_queue_extract_min (q);
+		last_square = item->line_square & ~REVERSED;
+		last_line = item->line_id;
+		last_reversed = item->line_square & REVERSED;
+
+		if (label_cost) {
+			int index = find_index (search, last_square, last_line, last_reversed);
+
+			/* queued again since, at a lower cost */
+			if (index > 0 && label_cost[index] < cur_cost) continue;
+		}
+
+		for (i = roadmap_hash_get_first (dest_hash, hash_key (last_square, last_line, 0));
+			  i >= 0;
+			  i = roadmap_hash_get_next (dest_hash, i)) {
+
+			if (costs[i] < 0 &&
+				 destinations[i].square == last_square &&
+				 destinations[i].line_id == last_line) {
+
+				costs[i] = cur_cost;
+				remaining--;
+			}
+		}
+
+		get_to_node (last_square, last_line, last_reversed, &node, &position);
+
+		count = get_connected_segments (last_square, last_line, last_reversed, node,
+												  successors, MAX_SUCCESSORS, 1, 1);
+
+		for (i = 0; i < count; i++) {
+
+			int square = successors[i].square_id;
+			int segment = successors[i].line_id;
+			int is_reversed = successors[i].reversed;
+			int segment_cost;
+			int index;
+
+			roadmap_square_set_current (square);
+			segment_cost = cost_fn (segment, is_reversed, cur_cost,
+											last_line, last_reversed,
+											square == last_square ? node : -1);
+
+			if (segment_cost < 0) continue;
+
+			index = find_index (search, square, segment, is_reversed);
+
+			if (index == 0) continue; /* the origin */
+
+			if (index > 0) {
+				if (label_cost[index] <= cur_cost + segment_cost) continue;
+
+				item = search->nav_node[index / HASH_BLOCK_SIZE] + (index % HASH_BLOCK_SIZE);
+				item->prev_square = last_square | last_reversed;
+				item->prev_id = last_line;
+			} else {
+				item = make_path (search, square, segment, is_reversed,
+										last_square, last_line, last_reversed);
+				if (!item) {
+					remaining = 0;
+					break;
+				}
+
+				index = search->num_nodes - 1;
+				if (index >= max_labels) {
+					max_labels += HASH_BLOCK_SIZE;
+					label_cost = realloc (label_cost, max_labels * sizeof (int));
+					roadmap_check_allocated(label_cost);
+				}
+			}
+
+			label_cost[index] = cur_cost + segment_cost;
+			navigate_queue_insert (q, label_cost[index], item);
+		}
+	}
+
+	free (label_cost);
+	free_prev_list (search);
+}
+
+
+int navigate_route_search_matrix (NavigateRouteSearch *search,
+											 const PluginLine *origins,
+											 const int *origin_points,
+											 int num_origins,
+											 const PluginLine *destinations,
+											 int num_destinations,
+											 int *costs) {
+
+	RoadMapHash *dest_hash;
+	int prev_scale;
+	int i;
+
+	if (num_origins <= 0 || num_destinations <= 0) return 0;
+
+	if (search->busy) {
+		roadmap_log (ROADMAP_ERROR, "re-entering navigate_route_search_matrix");
+		return -1;
+	}
+	search->busy = 1;
+
+	dest_hash = roadmap_hash_new ("matrix", num_destinations);
+	for (i = 0; i < num_destinations; i++) {
+		roadmap_hash_add (dest_hash, hash_key (destinations[i].square, destinations[i].line_id, 0), i);
+	}
+
+	prev_scale = roadmap_square_get_screen_scale ();
+	roadmap_square_set_screen_scale (0);
+
+	for (i = 0; i < num_origins; i++) {
+		matrix_row (search, origins + i, origin_points[i],
+						destinations, num_destinations, dest_hash,
+						costs + i * num_destinations);
+	}
+
+	roadmap_square_set_screen_scale (prev_scale);
+	roadmap_hash_free (dest_hash);
+
+	search->busy = 0;
+	return 0;
+}
+
+
+static int route_length (const NavigateSegment *segments, int count) {
+
+	int length = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		roadmap_square_set_current (segments[i].square);
+		length += roadmap_line_length (segments[i].line);
+	}
+
+	return length;
+}
+
+
+/* Percent of the route length on lines of the routes already kept */
+static int route_overlap (NavigateRouteSearch *search, const NavigateSegment *segments, int count, int length) {
+
+	int shared = 0;
+	int i;
+
+	if (length <= 0) return 100;
+
+	for (i = 0; i < count; i++) {
+
+		int index = find_penalty (search, segments[i].square, segments[i].line);
+
+		if (index >= 0 && search->penalty_kept[index]) {
+			roadmap_square_set_current (segments[i].square);
+			shared += roadmap_line_length (segments[i].line);
+		}
+	}
+
+	return (int)((double)shared * 100 / length);
+}
+
+
+int navigate_route_search_alternatives (NavigateRouteSearch *search,
+													 PluginLine *from_line,
+													 int from_point,
+													 const PluginLine *to_line,
+													 int to_point,
+													 int max_routes,
+													 NavigateRouteAlternative *routes) {
+
+	int count = 0;
+	int best_cost = 0;
+	int attempt;
+
+	if (max_routes <= 0) return 0;
+
+	for (attempt = 0; attempt < max_routes * MAX_ALT_ATTEMPTS && count < max_routes; attempt++) {
+
+		PluginLine goal = *to_line;
+		int goal_point = to_point;
+		NavigateSegment *segments;
+		int num_total;
+		int num_new;
+		int flags = RECALC_ROUTE;
+		int cost;
+		int length;
+		int keep;
+		int i;
+
+		if (navigate_route_search_get_segments (search, from_line, from_point,
+															 &goal, &goal_point, &segments,
+															 &num_total, &num_new, &flags, NULL, 0) <= 0) {
+			break;
+		}
+
+		cost = route_cost (segments, num_total, NULL);
+		length = route_length (segments, num_total);
+
+		if (count == 0) {
+			best_cost = cost;
+			keep = 1;
+		} else {
+			keep = cost * 100 <= best_cost * MAX_ALT_STRETCH &&
+					 route_overlap (search, segments, num_total, length) <= MAX_ALT_OVERLAP;
+		}
+
+		if (!search->penalty_hash) {
+			search->penalty_hash = roadmap_hash_new ("alternatives", HASH_BLOCK_SIZE);
+			search->max_penalties = HASH_BLOCK_SIZE;
+			search->penalty_square = malloc (HASH_BLOCK_SIZE * sizeof (int));
+			search->penalty_line = malloc (HASH_BLOCK_SIZE * sizeof (int));
+			search->penalty_count = malloc (HASH_BLOCK_SIZE);
+			search->penalty_kept = malloc (HASH_BLOCK_SIZE);
+			roadmap_check_allocated(search->penalty_square);
+			roadmap_check_allocated(search->penalty_line);
+			roadmap_check_allocated(search->penalty_count);
+			roadmap_check_allocated(search->penalty_kept);
+		}
+
+		/* the next search avoids this route, kept or not */
+		for (i = 0; i < num_total; i++) {
+			int index = add_penalty (search, segments[i].square, segments[i].line);
+			if (keep) search->penalty_kept[index] = 1;
+		}
+
+		if (!keep) continue;
+
+		routes[count].segments = malloc (num_total * sizeof (NavigateSegment));
+		roadmap_check_allocated(routes[count].segments);
+		memcpy (routes[count].segments, segments, num_total * sizeof (NavigateSegment));
+		routes[count].num_segments = num_total;
+		routes[count].cost = cost;
+		routes[count].length = length;
+		count++;
+	}
+
+	free_penalties (search);
+
+	return count;
+}
+
+
+void navigate_route_alternatives_free (NavigateRouteAlternative *routes, int count) {
+
+	int i;
+
+	for (i = 0; i < count; i++) {
+		free (routes[i].segments);
+		routes[i].segments = NULL;
+	}
+}
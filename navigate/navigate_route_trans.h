@@ -55,6 +55,7 @@ typedef struct {
 typedef enum {
    origin_server,
    origin_trip,
+   origin_local,     /* calculated on the device, see navigate_route_search_alternatives () */
 }  NavigateResponseOrigin;
 
 typedef struct {
@@ -65,6 +65,7 @@
 #include "ssd/ssd_popup.h"
 #include "navigate/navigate_main.h"
 #include "roadmap_tile.h"
+#include "roadmap_hash.h"
 
 
 static RoadMapConfigDescriptor AlertsEnabledCfg =
@@ -89,6 +90,34 @@ typedef struct {
 static int alert_active;
 static roadmap_alert_providers RoadMapAlertProviders;
 
+/* Grid of the alerts of a provider which is not square dependent, so a GPS
+ * fix only visits the alerts of the cells within alert distance. Providers
+ * opt in by calling roadmap_alerter_provider_changed() when their alerts
+ * change.
+ */
+#define ALERTER_CELL_SIZE        20000   /* 1/50 degree */
+#define ALERTER_MAX_QUERY_CELLS  64
+
+typedef struct {
+   int            enabled;
+   int            dirty;
+   int            count;
+   int            size;
+   int            max_distance;
+   RoadMapHash    *cells;
+   int            *cell_x;
+   int            *cell_y;
+   int            *longitude;
+   int            *latitude;
+   int            *limit;
+   int            *candidates;
+   int            *candidate_longitude;
+   int            *candidate_latitude;
+   int            *candidate_distance;
+} AlerterIndex;
+
+static AlerterIndex RoadMapAlerterIndex[20];
+
 static active_alert_st  the_active_alert, prev_alert;
 static BOOL alert_should_be_visible;
 static int g_seconds = 0;
@@ -127,6 +156,177 @@ void roadmap_alerter_register(roadmap_alert_provider *provider){
 }
 
 
+void roadmap_alerter_provider_changed (roadmap_alert_provider *provider) {
+
+   int i;
+
+   for (i = 0; i < RoadMapAlertProviders.count; i++) {
+      if (RoadMapAlertProviders.provider[i] == provider) {
+         RoadMapAlerterIndex[i].enabled = TRUE;
+         RoadMapAlerterIndex[i].dirty = TRUE;
+         return;
+      }
+   }
+}
+
+
+static int alerter_cell (int coordinate) {
+
+   if (coordinate < 0) return (coordinate + 1) / ALERTER_CELL_SIZE - 1;
+
+   return coordinate / ALERTER_CELL_SIZE;
+}
+
+
+static int alerter_cell_key (int x, int y) {
+
+   return (int)(((unsigned int)x * 4099U + (unsigned int)y) & 0x7fffffff);
+}
+
+
+static void alerter_index_build (AlerterIndex *index, roadmap_alert_provider *provider, int count) {
+
+   RoadMapPosition pos;
+   int steering;
+   int distance;
+   int i;
+
+   if (!index->cells) {
+      index->cells = roadmap_hash_new ("alerter", count > 0 ? count : 1);
+      index->size = count > 0 ? count : 1;
+   } else {
+      roadmap_hash_clean (index->cells);
+   }
+
+   if (count > index->size) {
+      roadmap_hash_resize (index->cells, count);
+      index->size = count;
+   }
+
+   index->cell_x = realloc (index->cell_x, index->size * sizeof(int));
+   index->cell_y = realloc (index->cell_y, index->size * sizeof(int));
+   index->longitude = realloc (index->longitude, index->size * sizeof(int));
+   index->latitude = realloc (index->latitude, index->size * sizeof(int));
+   index->limit = realloc (index->limit, index->size * sizeof(int));
+   index->candidates = realloc (index->candidates, index->size * sizeof(int));
+   index->candidate_longitude = realloc (index->candidate_longitude, index->size * sizeof(int));
+   index->candidate_latitude = realloc (index->candidate_latitude, index->size * sizeof(int));
+   index->candidate_distance = realloc (index->candidate_distance, index->size * sizeof(int));
+   roadmap_check_allocated(index->cell_x);
+   roadmap_check_allocated(index->cell_y);
+   roadmap_check_allocated(index->longitude);
+   roadmap_check_allocated(index->latitude);
+   roadmap_check_allocated(index->limit);
+   roadmap_check_allocated(index->candidates);
+   roadmap_check_allocated(index->candidate_longitude);
+   roadmap_check_allocated(index->candidate_latitude);
+   roadmap_check_allocated(index->candidate_distance);
+
+   index->max_distance = 0;
+
+   for (i = 0; i < count; i++) {
+
+      (* (provider->get_position)) (i, &pos, &steering);
+
+      index->cell_x[i] = alerter_cell (pos.longitude);
+      index->cell_y[i] = alerter_cell (pos.latitude);
+      roadmap_hash_add (index->cells, alerter_cell_key (index->cell_x[i], index->cell_y[i]), i);
+
+      index->longitude[i] = pos.longitude;
+      index->latitude[i] = pos.latitude;
+
+      distance = (*(provider->get_distance))(i);
+      index->limit[i] = distance;
+      if (distance > index->max_distance) index->max_distance = distance;
+   }
+
+   index->count = count;
+   index->dirty = FALSE;
+}
+
+
+static int compare_candidates (const void *a, const void *b) {
+
+   return *(const int *)a - *(const int *)b;
+}
+
+
+/* Returns the alerts within their alert distance of the position, in
+ * provider order, or -1 when the provider is not indexed or the area is
+ * too large.
+ */
+static int alerter_index_query (int provider_index, const RoadMapPosition *gps_pos, int count, int **candidates) {
+
+   AlerterIndex *index = RoadMapAlerterIndex + provider_index;
+   RoadMapPosition corner;
+   int cell_width;
+   int cell_height;
+   int range_x;
+   int range_y;
+   int x;
+   int y;
+   int i;
+   int found = 0;
+   int in_range;
+
+   if (!index->enabled) return -1;
+
+   if (index->dirty || index->count != count) {
+      alerter_index_build (index, RoadMapAlertProviders.provider[provider_index], count);
+   }
+
+   corner.longitude = gps_pos->longitude + ALERTER_CELL_SIZE;
+   corner.latitude = gps_pos->latitude;
+   cell_width = roadmap_math_distance (gps_pos, &corner);
+
+   corner.longitude = gps_pos->longitude;
+   corner.latitude = gps_pos->latitude + ALERTER_CELL_SIZE;
+   cell_height = roadmap_math_distance (gps_pos, &corner);
+
+   if (cell_width <= 0 || cell_height <= 0) return -1;
+
+   range_x = index->max_distance / cell_width + 1;
+   range_y = index->max_distance / cell_height + 1;
+
+   if ((2 * range_x + 1) * (2 * range_y + 1) > ALERTER_MAX_QUERY_CELLS) return -1;
+
+   for (x = alerter_cell (gps_pos->longitude) - range_x; x <= alerter_cell (gps_pos->longitude) + range_x; x++) {
+      for (y = alerter_cell (gps_pos->latitude) - range_y; y <= alerter_cell (gps_pos->latitude) + range_y; y++) {
+
+         for (i = roadmap_hash_get_first (index->cells, alerter_cell_key (x, y));
+              i >= 0;
+              i = roadmap_hash_get_next (index->cells, i)) {
+
+            if (index->cell_x[i] == x && index->cell_y[i] == y) {
+               index->candidates[found++] = i;
+            }
+         }
+      }
+   }
+
+   qsort (index->candidates, found, sizeof(int), compare_candidates);
+
+   /* Keep only the alerts which are within their alert distance */
+   for (i = 0; i < found; i++) {
+      index->candidate_longitude[i] = index->longitude[index->candidates[i]];
+      index->candidate_latitude[i] = index->latitude[index->candidates[i]];
+   }
+
+   roadmap_math_distances (gps_pos, found, index->candidate_longitude,
+                           index->candidate_latitude, index->candidate_distance);
+
+   in_range = 0;
+   for (i = 0; i < found; i++) {
+      if (index->candidate_distance[i] <= index->limit[index->candidates[i]]) {
+         index->candidates[in_range++] = index->candidates[i];
+      }
+   }
+
+   *candidates = index->candidates;
+   return in_range;
+}
+
+
 void roadmap_alerter_initialize(void) {
 
    //minimum speed to check alerts
@@ -316,9 +516,13 @@ BOOL get_alert_location_info(const RoadMapPosition *alert_position, int alert_st
 /*
  * searches for relevant alerts in the given param provider - D.F.
  */
-static BOOL is_alert_in_range_provider(roadmap_alert_provider* provider,
+static BOOL is_alert_in_range_provider(int provider_index,
       const RoadMapGpsPosition *gps_position, const PluginLine* line,
       int * pAlert_index, int * pDistance, const char* cur_street_name){
+   roadmap_alert_provider* provider = RoadMapAlertProviders.provider[provider_index];
+   int *candidates = NULL;
+   int num_candidates;
+   int c;
    int i;
    int steering;
    RoadMapPosition pos;
@@ -340,7 +544,15 @@ static BOOL is_alert_in_range_provider(roadmap_alert_provider* provider,
       return FALSE;
    }
 
-   for (i=0; i<count; i++) {
+   num_candidates = -1;
+   if (!(* (provider->is_square_dependent))()) {
+      num_candidates = alerter_index_query (provider_index, &gps_pos, count, &candidates);
+   }
+   if (num_candidates < 0) num_candidates = count;
+
+   for (c=0; c<num_candidates; c++) {
+
+      i = candidates ? candidates[c] : c;
 
       roadmap_square_set_current (square_current);
       // if the alert is not alertable, continue. (dummy speed cams, etc.)
@@ -473,7 +685,7 @@ static int is_alert_in_range(const RoadMapGpsPosition *gps_position, const Plugi
 			*/
 	         for (square = 0; ((square < count_squares)&&(!found_alert)); square++) {
 	            roadmap_square_set_current(squares[square]);
-	            if(is_alert_in_range_provider(RoadMapAlertProviders.provider[i],
+	            if(is_alert_in_range_provider(i,
 	                     gps_position, line, &alert_index,&distance, current_street_name))
 	            {
 	               square_ind = square;
@@ -483,7 +695,7 @@ static int is_alert_in_range(const RoadMapGpsPosition *gps_position, const Plugi
 	         }
 
 	      } else {
-	           if(is_alert_in_range_provider(RoadMapAlertProviders.provider[i],
+	           if(is_alert_in_range_provider(i,
 	                   gps_position, line, &alert_index,&distance,current_street_name))
 	           {
 	             	square_ind = -1;
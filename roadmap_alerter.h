@@ -107,6 +107,10 @@ typedef struct {
 void 		roadmap_alerter_initialize(void) ;
 int 		roadmap_alerter_get_active_alert_id();
 void 		roadmap_alerter_register(roadmap_alert_provider *provider);
+/* Called by a provider whose alerts were added or removed, which also lets
+ * the alerter index its alerts by position (not for square dependent ones).
+ */
+void 		roadmap_alerter_provider_changed(roadmap_alert_provider *provider);
 void 		roadmap_alerter_check(const RoadMapGpsPosition *gps_position, const PluginLine *line);
 void 		roadmap_alerter_display();
 int      roadmap_alerter_get_priority();
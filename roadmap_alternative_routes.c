@@ -360,10 +360,16 @@ static int route_select (AltRoutingContext *context) {
    roadmap_math_set_min_zoom(-1);
    navigate_main_set_route(context->nav_result->alt_id);
    roadmap_analytics_log_event (ANALYTICS_EVENT_NAVIGATE, ANALYTICS_EVENT_INFO_SOURCE,  "TRIP_SRV" );
-   navigate_route_select(context->nav_result->alt_id);
-   ssd_dialog_hide_all (dec_close);
-   roadmap_log (ROADMAP_INFO,"on_route_selected selecting route alt_id=%d" , pAltRoute->pRouteResults[0].alt_id);
-   ssd_progress_msg_dialog_show( roadmap_lang_get( "Please wait..." ) );
+   if (context->nav_result->origin == origin_local){
+      // The segments are already here
+      ssd_dialog_hide_all (dec_close);
+      navigate_main_on_local_alt_route(context->nav_result->alt_id);
+   } else {
+      navigate_route_select(context->nav_result->alt_id);
+      ssd_dialog_hide_all (dec_close);
+      roadmap_log (ROADMAP_INFO,"on_route_selected selecting route alt_id=%d" , pAltRoute->pRouteResults[0].alt_id);
+      ssd_progress_msg_dialog_show( roadmap_lang_get( "Please wait..." ) );
+   }
 
    ai.city = NULL;
    ai.country = NULL;
@@ -1846,7 +1852,7 @@ void roadmap_alternative_routes_routes_dialog (BOOL showListFirst) {
       ssd_widget_add (icon_container, bitmap);
       ssd_widget_add (title_container, icon_container);
 
-      if (nav_result->origin){
+      if (nav_result->origin == origin_trip){
             bitmap = ssd_bitmap_new("star", "star_route", SSD_ALIGN_RIGHT);
             ssd_widget_add(icon_container, bitmap);
             if (ssd_widget_rtl(NULL))
@@ -246,6 +246,11 @@ void roadmap_canvas_shutdown();
 void roadmap_canvas_begin_draw_to_image (RoadMapImage image);
 void roadmap_canvas_stop_draw_to_image (void);
 
+/* AGG only: draw into a memory buffer, in the canvas pixel format */
+void roadmap_canvas_draw_to_buffer (unsigned char *buf, int width, int height, int stride);
+void roadmap_canvas_get_buffer (unsigned char **buf, int *width, int *height, int *stride);
+int  roadmap_canvas_buffer_pixel_size (void);
+
 #if defined(IPHONE) || defined(ANDROID)
 void roadmap_canvas_get_cording_pt (RoadMapGuiPoint points[MAX_CORDING_POINTS]);
 int roadmap_canvas_is_cording();
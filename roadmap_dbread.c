@@ -66,6 +66,7 @@
 #include "roadmap_path.h"
 #include "roadmap_data_format.h"
 #include "roadmap_tile_storage.h"
+#include "roadmap_tile_pack.h"
 #include "roadmap_dbread.h"
 
 #ifdef IPHONE
@@ -85,6 +86,7 @@ typedef struct roadmap_db_database_s {
 
    int fips;
    int tile_index;
+   int mapped;    /* data points into the tile pack of the fips */
 
    roadmap_db_data_file data;
 
@@ -215,12 +217,19 @@ static void roadmap_db_close_database (roadmap_db_database *database) {
 
    roadmap_db_call_unmap (database);
 
+#ifdef ROADMAP_TILE_PACK
+   if (database->mapped) {
+      roadmap_tile_pack_release (database->fips);
+   } else
+#endif
+   {
 #ifdef NO_MAP_COMPRESSION
 	unsigned char *ptr = (unsigned char *)(database->data.header) - sizeof(roadmap_data_file_header);
 	free (ptr);
 #else
 	free (database->data.header);
 #endif
+   }
 	
    if (database->next != NULL) {
       database->next->previous = database->previous;
@@ -274,6 +283,8 @@ roadmap_db_database *roadmap_db_find (int fips, int tile_index) {
 }
 
 
+static int roadmap_db_fill_raw_data (roadmap_db_database *database, unsigned char *raw_data, unsigned long raw_data_size);
+
 static int roadmap_db_fill_data (roadmap_db_database *database, void *base, unsigned int size) {
 
 	roadmap_tile_file_header *tile_header = (roadmap_tile_file_header *) base;
@@ -340,6 +351,17 @@ static int roadmap_db_fill_data (roadmap_db_database *database, void *base, unsi
 	}
 #endif
 
+	return roadmap_db_fill_raw_data (database, raw_data, raw_data_size);
+}
+
+
+static int roadmap_db_fill_raw_data (roadmap_db_database *database, unsigned char *raw_data, unsigned long raw_data_size) {
+
+	if (raw_data_size < sizeof (roadmap_data_header)) {
+	   roadmap_log (ROADMAP_ERROR, "data file open: size %lu cannot contain header", raw_data_size);
+	   return 0;
+	}
+
 	database->data.header = (roadmap_data_header *) raw_data;
 		
 	database->data.byte_alignment_add = (1 << database->data.header->byte_alignment_bits) - 1;
@@ -400,6 +422,31 @@ int roadmap_db_open (int fips, int tile_index, roadmap_db_model *model,
       return 1; /* Already open. */
    }
 
+#ifdef ROADMAP_TILE_PACK
+   if (roadmap_tile_pack_get (fips, tile_index, &base, &size) == 0) {
+
+      database = malloc(sizeof(*database));
+      roadmap_check_allocated(database);
+
+      database->fips = fips;
+      database->tile_index = tile_index;
+      database->mapped = 1;
+
+      if (roadmap_db_fill_raw_data (database, (unsigned char *) base, (unsigned long) size)) {
+
+         database->model = model;
+         database->context = NULL;
+
+         return add_db_and_map(database);
+      }
+
+      roadmap_log (ROADMAP_ERROR, "tile %d (fips %d) has invalid format in tile pack", tile_index, fips);
+      roadmap_tile_pack_release (fips);
+      roadmap_tile_pack_invalidate (fips, tile_index);
+      free (database);
+   }
+#endif
+
    if (roadmap_tile_load(fips, tile_index, &base, &size) != 0) {
    
 	  return 0;
@@ -411,6 +458,7 @@ int roadmap_db_open (int fips, int tile_index, roadmap_db_model *model,
 
    database->fips = fips;
    database->tile_index = tile_index;
+   database->mapped = 0;
 	
 	if (!roadmap_db_fill_data (database, base, (unsigned int) size)) {
 	      
@@ -448,6 +496,7 @@ int roadmap_db_open_mem (int fips, int tile_index, roadmap_db_model *model,
 
    database->fips = fips;
    database->tile_index = tile_index;
+   database->mapped = 0;
 	
 #ifdef NO_MAP_COMPRESSION
    {
@@ -523,6 +572,19 @@ int	roadmap_db_get_data (const roadmap_db_data_file *file,
 }
 
 
+unsigned int roadmap_db_get_size (const roadmap_db_data_file *file) {
+
+	unsigned int size = sizeof (roadmap_data_header) +
+							  file->header->num_sections * sizeof (roadmap_data_entry);
+
+	if (file->header->num_sections > 0) {
+		size += file->index[file->header->num_sections - 1].end_offset;
+	}
+
+	return size;
+}
+
+
 int roadmap_db_close (int fips, int tile_index) {
 
    roadmap_db_database *database = roadmap_db_find (fips, tile_index);
@@ -553,6 +615,10 @@ void roadmap_db_end (void) {
       roadmap_db_close_database (database);
       database = next;
    }
+
+#ifdef ROADMAP_TILE_PACK
+   roadmap_tile_pack_shutdown ();
+#endif
 }
 
 const char *roadmap_db_map_path (void) {
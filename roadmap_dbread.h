@@ -84,6 +84,8 @@ int	roadmap_db_get_data (const roadmap_db_data_file *file,
 									void 			 **data, 
 									int 			 *num_items);
 
+unsigned int roadmap_db_get_size (const roadmap_db_data_file *file);
+
 int  roadmap_db_close (int fips, int tile_index);
 void roadmap_db_remove (int fips, int tile_index);
 void roadmap_db_end   (void);
@@ -35,9 +35,13 @@
 #include "roadmap_file.h"
 #include "roadmap_path.h"
 #include "roadmap_main.h"
+#include "roadmap_net_reactor.h"
 #include "roadmap_base64.h"
+#include "roadmap_start.h"
 
 #include "editor/editor_main.h"
+#include "websvc_trans/websvc_address.h"
+#include "websvc_trans/web_date_format.h"
 #include "roadmap_httpcopy_async.h"
 
 
@@ -48,6 +52,7 @@
 #endif
 
 #define ROADMAP_HTTP_MAX_UPLOAD_CHUNK 4096
+#define ROADMAP_HTTP_PIPE_MAX_RETRIES 1    /* re-sends after the server closed */
 #define ROADMAP_HTTP_MP_BOUNDARY   "---------------------------10424402741337131014341297293" 
 
 typedef enum
@@ -77,6 +82,35 @@ struct HttpAsyncContext_st {
    int write_buf_read;
    int write_buf_sent;
    int flags;
+   HttpAsyncPipe *pipe;
+   HttpAsyncContext *next;      /* next request on the pipe */
+   char *request;               /* the pipelined request text */
+   int retries;
+   int aborted;                 /* the response is read and dropped */
+};
+
+typedef enum
+{
+   _http_pipe_state__closed,
+   _http_pipe_state__connecting,
+   _http_pipe_state__connected
+} HttpPipeState;
+
+/* A keep-alive connection to one server. The requests are kept in the
+ * order of their responses; the ones from 'unsent' on are not written
+ * yet.
+ */
+struct HttpAsyncPipe_st {
+   HttpPipeState state;
+   RoadMapIO io;
+   char server[WSA_SERVER_URL_MAXSIZE + 16];
+   HttpAsyncContext *first;
+   HttpAsyncContext *last;
+   HttpAsyncContext *unsent;
+   int close_after;             /* the server closes after this response */
+   int freed;                   /* freed while connecting */
+   char buffer[ROADMAP_HTTP_MAX_CHUNK + 1];
+   int buffer_len;
 };
 
 
@@ -240,7 +274,7 @@ static void roadmap_http_async_has_data_cb (RoadMapIO *io) {
          strncpy_safe( context->error_buffer, buffer, sizeof( context->error_buffer ) );
          res = roadmap_http_async_decode_header(context, buffer, res + leftover_size);
          if (res == -2){
-            roadmap_main_remove_input(io);
+            roadmap_net_io_remove_input(io);
             roadmap_io_close(&context->io);
             
             if (context->method == _http_async_method__post_file)
@@ -297,7 +331,7 @@ static void roadmap_http_async_has_data_cb (RoadMapIO *io) {
    }
 
    if ((res <= 0) || (context->download_size_current >= context->content_length && !ignore_content_len)) {
-      roadmap_main_remove_input(io);
+      roadmap_net_io_remove_input(io);
       roadmap_io_close(&context->io);
 
 //      if ( context->error_buffer[0] )
@@ -344,7 +378,7 @@ static void roadmap_http_async_write_cb (RoadMapIO *io) {
          return;
       }
       
-      roadmap_main_remove_input(io);
+      roadmap_net_io_remove_input(io);
       roadmap_http_async_prepare_input(hcontext);
       
       return;
@@ -390,7 +424,7 @@ static void roadmap_http_async_prepare_input (HttpAsyncContext *hcontext) {
    hcontext->received_status = 0;
    hcontext->content_length = -1;
    
-   roadmap_main_set_input(&hcontext->io, roadmap_http_async_has_data_cb);
+   roadmap_net_io_set_input(&hcontext->io, roadmap_http_async_has_data_cb);
 }
 
 static void roadmap_http_async_prepare_output (HttpAsyncContext *hcontext) {
@@ -476,6 +510,7 @@ HttpAsyncContext * roadmap_http_async_post_file( RoadMapHttpAsyncCallbacks *call
    hcontext->write_buf_sent = 0;
    hcontext->method = _http_async_method__post_file;
    hcontext->flags = HTTPCOPY_FLAG_NONE;
+   hcontext->pipe = NULL;
    
    if ( header != NULL )
       strncpy( hcontext->header_buffer, header, sizeof( hcontext->header_buffer ) );
@@ -579,6 +614,7 @@ HttpAsyncContext * roadmap_http_async_post( RoadMapHttpAsyncCallbacks *callbacks
    hcontext->data_len = data_length;
    hcontext->method = _http_async_method__post;
    hcontext->flags = flags;
+   hcontext->pipe = NULL;
 
    if ( header != NULL )
       strncpy( hcontext->header_buffer, header, sizeof( hcontext->header_buffer ) );
@@ -623,7 +659,8 @@ HttpAsyncContext * roadmap_http_async_copy (RoadMapHttpAsyncCallbacks *callbacks
    hcontext->data_len = 0;
 	hcontext->method = _http_async_method__get;
 	hcontext->flags = HTTPCOPY_FLAG_NONE;
-	
+	hcontext->pipe = NULL;
+
    if (roadmap_net_connect_async("http_get", source, source, update_time, 80, 0,
             roadmap_http_async_connect_cb, hcontext) == NULL) {
       callbacks->error(context, 1, "Can't create http connection.");
@@ -635,16 +672,530 @@ HttpAsyncContext * roadmap_http_async_copy (RoadMapHttpAsyncCallbacks *callbacks
 }
 
 
+/*
+ * Keep-alive connections. The GET requests of a pipe are written together
+ * on one connection, and the responses are read back in the same order,
+ * framed by their Content-Length.
+ */
+
+static void pipe_connect (HttpAsyncPipe *pipe);
+
+
+static void pipe_free_context (HttpAsyncContext *context) {
+
+   free (context->request);
+   free (context);
+}
+
+
+static void pipe_unlink (HttpAsyncPipe *pipe, HttpAsyncContext *context) {
+
+   HttpAsyncContext *prev = NULL;
+   HttpAsyncContext *cur;
+
+   for (cur = pipe->first; cur != context; cur = cur->next) prev = cur;
+
+   if (prev) prev->next = context->next;
+   else pipe->first = context->next;
+
+   if (pipe->last == context) pipe->last = prev;
+   if (pipe->unsent == context) pipe->unsent = context->next;
+}
+
+
+static void pipe_close_connection (HttpAsyncPipe *pipe) {
+
+   if (pipe->state == _http_pipe_state__connected) {
+      roadmap_net_io_remove_input (&pipe->io);
+      roadmap_io_close (&pipe->io);
+   }
+
+   pipe->state = _http_pipe_state__closed;
+   pipe->buffer_len = 0;
+   pipe->close_after = 0;
+}
+
+
+/* Fails all the requests of the pipe */
+static void pipe_fail (HttpAsyncPipe *pipe, const char *error) {
+
+   HttpAsyncContext *context = pipe->first;
+
+   pipe->first = pipe->last = pipe->unsent = NULL;
+
+   while (context) {
+
+      HttpAsyncContext *next = context->next;
+
+      if (!context->aborted) {
+         context->callbacks->error (context->cb_context, 1, "%s", error);
+      }
+      pipe_free_context (context);
+      context = next;
+   }
+}
+
+
+/* The connection is lost. A response which was partly received fails;
+ * the other requests are sent again on a new connection, a limited
+ * number of times.
+ */
+static void pipe_restart (HttpAsyncPipe *pipe) {
+
+   HttpAsyncContext *context = pipe->first;
+   int partial = context && context != pipe->unsent &&
+                 (!context->is_parsing_headers || pipe->buffer_len > 0);
+
+   pipe_close_connection (pipe);
+
+   if (partial) {
+      pipe_unlink (pipe, context);
+      if (!context->aborted) {
+         context->callbacks->error (context->cb_context, 0, "Connection closed during the response");
+      }
+      pipe_free_context (context);
+   }
+
+   for (context = pipe->first; context != NULL && context != pipe->unsent; ) {
+
+      HttpAsyncContext *next = context->next;
+
+      if (context->aborted) {
+         pipe_unlink (pipe, context);
+         pipe_free_context (context);
+      } else if (++context->retries > ROADMAP_HTTP_PIPE_MAX_RETRIES) {
+         pipe_unlink (pipe, context);
+         context->callbacks->error (context->cb_context, 1, "Connection closed by the server");
+         pipe_free_context (context);
+      }
+      context = next;
+   }
+
+   pipe->unsent = pipe->first;
+   if (pipe->first) pipe_connect (pipe);
+}
+
+
+/* Parses the header of the first response. Returns 1 when it is complete,
+ * 0 when more data is needed, -1 on an error.
+ */
+static int pipe_parse_header (HttpAsyncPipe *pipe, HttpAsyncContext *context) {
+
+   char *end;
+   char *line;
+   char *next;
+   int header_size;
+   int version = 1;
+
+   pipe->buffer[pipe->buffer_len] = '\0';
+
+   end = strstr (pipe->buffer, "\r\n\r\n");
+   if (end == NULL) {
+      if (pipe->buffer_len >= ROADMAP_HTTP_MAX_CHUNK) {
+         roadmap_log (ROADMAP_ERROR, "HTTP response header is too long");
+         return -1;
+      }
+      return 0;
+   }
+
+   *end = '\0';
+   header_size = (int)(end - pipe->buffer) + 4;
+
+   if (sscanf (pipe->buffer, "HTTP/1.%d %d", &version, &context->received_status) != 2) {
+      roadmap_log (ROADMAP_ERROR, "Bad HTTP status line: %.64s", pipe->buffer);
+      return -1;
+   }
+   strncpy_safe (context->error_buffer, pipe->buffer, sizeof (context->error_buffer));
+   next = strstr (context->error_buffer, "\r\n");
+   if (next) *next = '\0';
+
+   /* Without keep-alive, an HTTP/1.0 server closes after the response */
+   if (version == 0) pipe->close_after = 1;
+
+   if (context->received_status == 204 || context->received_status == 304) {
+      context->content_length = 0;
+   }
+
+   for (line = strstr (pipe->buffer, "\r\n"); line != NULL; line = next) {
+
+      char *value;
+
+      line += 2;
+      next = strstr (line, "\r\n");
+      if (next) *next = '\0';
+
+      value = strchr (line, ':');
+      if (value == NULL) continue;
+      while (*(++value) == ' ') ;
+
+      if (strncasecmp (line, "Content-Length", sizeof ("Content-Length") - 1) == 0) {
+         context->content_length = atoi (value);
+      } else if (strncasecmp (line, "Connection", sizeof ("Connection") - 1) == 0) {
+         pipe->close_after = strncasecmp (value, "close", 5) == 0;
+      } else if (strncasecmp (line, "Last-Modified", sizeof ("Last-Modified") - 1) == 0) {
+         strncpy_safe (context->last_modified_buffer, value, sizeof (context->last_modified_buffer));
+      }
+   }
+
+   if (context->content_length < 0) {
+      /* The next response could not be found */
+      roadmap_log (ROADMAP_ERROR, "HTTP response without Content-Length on a keep-alive connection");
+      return -1;
+   }
+
+   pipe->buffer_len -= header_size;
+   memmove (pipe->buffer, pipe->buffer + header_size, pipe->buffer_len);
+   context->is_parsing_headers = 0;
+
+   if (context->aborted) return 1;
+
+   if (context->received_status != 200) {
+      context->aborted = 1;
+      context->callbacks->error (context->cb_context, 0, "HTTP Error: %s", context->error_buffer);
+   } else if (!context->callbacks->size (context->cb_context, context->content_length)) {
+      context->aborted = 1;
+      context->callbacks->error (context->cb_context, 0, "roadmap_http_async_has_data_cb() failed");
+   }
+
+   return 1;
+}
+
+
+/* Consumes the buffered data of the first response. Returns 1 when the
+ * response is complete, 0 when more data is needed, -1 on an error.
+ */
+static int pipe_parse (HttpAsyncPipe *pipe) {
+
+   HttpAsyncContext *context = pipe->first;
+   int size;
+
+   if (context->is_parsing_headers) {
+
+      int res = pipe_parse_header (pipe, context);
+
+      if (res <= 0) return res;
+   }
+
+   size = context->content_length - context->download_size_current;
+   if (size > pipe->buffer_len) size = pipe->buffer_len;
+
+   if (size > 0) {
+      context->download_size_current += size;
+      if (!context->aborted) {
+         context->callbacks->progress (context->cb_context, pipe->buffer, size);
+      }
+      pipe->buffer_len -= size;
+      memmove (pipe->buffer, pipe->buffer + size, pipe->buffer_len);
+   }
+
+   if (context->download_size_current < context->content_length) return 0;
+
+   pipe_unlink (pipe, context);
+   if (!context->aborted) {
+      context->callbacks->done (context->cb_context, context->last_modified_buffer, NULL);
+   }
+   pipe_free_context (context);
+
+   return 1;
+}
+
+
+static void pipe_has_data_cb (RoadMapIO *io) {
+
+   HttpAsyncPipe *pipe = (HttpAsyncPipe *)io->context;
+   int res;
+
+   res = roadmap_io_read (io, pipe->buffer + pipe->buffer_len,
+                          ROADMAP_HTTP_MAX_CHUNK - pipe->buffer_len);
+
+   if (res <= 0) {
+      /* An idle connection is simply closed by the server */
+      pipe_restart (pipe);
+      return;
+   }
+
+   pipe->buffer_len += res;
+
+   while (pipe->state == _http_pipe_state__connected &&
+          pipe->first != NULL && pipe->first != pipe->unsent) {
+
+      res = pipe_parse (pipe);
+
+      if (res < 0) {
+         pipe_restart (pipe);
+         return;
+      }
+
+      if (res == 0) break;
+
+      if (pipe->close_after) {
+         pipe_restart (pipe);
+         return;
+      }
+   }
+
+   if (pipe->state == _http_pipe_state__connected &&
+       pipe->buffer_len > 0 && (pipe->first == NULL || pipe->first == pipe->unsent)) {
+      roadmap_log (ROADMAP_ERROR, "Unexpected data on HTTP keep-alive connection");
+      pipe_restart (pipe);
+   }
+}
+
+
+/* Writes all the unsent requests at once */
+static void pipe_write_requests (HttpAsyncPipe *pipe) {
+
+   char buffer[ROADMAP_HTTP_MAX_CHUNK];
+   HttpAsyncContext *context;
+   HttpAsyncContext *written = pipe->unsent;
+   int len = 0;
+
+   if (pipe->state != _http_pipe_state__connected) return;
+
+   for (context = pipe->unsent; context != NULL; ) {
+
+      HttpAsyncContext *next = context->next;
+      int size;
+
+      if (context->aborted) {
+         pipe_unlink (pipe, context);
+         if (written == context) written = next;
+         pipe_free_context (context);
+         context = next;
+         continue;
+      }
+
+      size = strlen (context->request);
+
+      if (len + size > (int)sizeof (buffer)) {
+         if (roadmap_io_write (&pipe->io, buffer, len, 0) != len) break;
+         len = 0;
+      }
+
+      memcpy (buffer + len, context->request, size);
+      len += size;
+      context = next;
+   }
+
+   if (context != NULL || (len && roadmap_io_write (&pipe->io, buffer, len, 0) != len)) {
+      roadmap_log (ROADMAP_ERROR, "Error sending HTTP requests");
+      pipe_restart (pipe);
+      return;
+   }
+
+   pipe->unsent = NULL;
+
+   for (context = written; context != NULL; context = context->next) {
+      context->callbacks->progress (context->cb_context, NULL, 0);
+   }
+}
+
+
+static void pipe_connect_cb (RoadMapSocket socket, void *context, roadmap_result err) {
+
+   HttpAsyncPipe *pipe = (HttpAsyncPipe *)context;
+
+   if (pipe->freed) {
+      pipe->state = _http_pipe_state__closed;
+      if (ROADMAP_NET_IS_VALID(socket)) roadmap_net_close (socket);
+      roadmap_http_async_pipe_free (pipe);
+      return;
+   }
+
+   if (!ROADMAP_NET_IS_VALID(socket)) {
+      pipe->state = _http_pipe_state__closed;
+      pipe_fail (pipe, "Can't connect to server.");
+      return;
+   }
+
+   pipe->io.subsystem = ROADMAP_IO_NET;
+   pipe->io.context = pipe;
+   pipe->io.os.socket = socket;
+   pipe->state = _http_pipe_state__connected;
+   pipe->buffer_len = 0;
+   pipe->close_after = 0;
+
+   roadmap_net_io_set_input (&pipe->io, pipe_has_data_cb);
+
+   pipe_write_requests (pipe);
+}
+
+
+static void pipe_connect (HttpAsyncPipe *pipe) {
+
+   pipe->state = _http_pipe_state__connecting;
+
+   if (roadmap_net_connect_async ("tcp", pipe->server, pipe->server, 0, 80, 0,
+                                  pipe_connect_cb, pipe) == NULL) {
+      pipe->state = _http_pipe_state__closed;
+      pipe_fail (pipe, "Can't create http connection.");
+   }
+}
+
+
+static void pipe_abort (HttpAsyncContext *context) {
+
+   HttpAsyncPipe *pipe = context->pipe;
+
+   context->aborted = 1;
+
+   /* A response which is being received can only be stopped by closing
+    * the connection. Aborted requests which were not written are dropped
+    * when the requests are written.
+    */
+   if (pipe->state == _http_pipe_state__connected &&
+       context == pipe->first && context != pipe->unsent) {
+      pipe_restart (pipe);
+   }
+}
+
+
+HttpAsyncPipe *roadmap_http_async_pipe_new (void) {
+
+   HttpAsyncPipe *pipe = calloc (1, sizeof (HttpAsyncPipe));
+
+   roadmap_check_allocated (pipe);
+   pipe->state = _http_pipe_state__closed;
+
+   return pipe;
+}
+
+
+void roadmap_http_async_pipe_free (HttpAsyncPipe *pipe) {
+
+   HttpAsyncContext *context;
+
+   if (pipe == NULL) return;
+
+   if (pipe->state == _http_pipe_state__connecting) {
+      /* The connect callback still refers to the pipe, and frees it */
+      for (context = pipe->first; context != NULL; context = context->next) {
+         context->aborted = 1;
+      }
+      pipe->freed = 1;
+      return;
+   }
+
+   pipe_close_connection (pipe);
+
+   while ((context = pipe->first) != NULL) {
+      pipe->first = context->next;
+      pipe_free_context (context);
+   }
+
+   free (pipe);
+}
+
+
+HttpAsyncContext *roadmap_http_async_pipe_copy (HttpAsyncPipe *pipe,
+                                                RoadMapHttpAsyncCallbacks *callbacks,
+                                                void *context,
+                                                const char *source,
+                                                time_t update_time) {
+
+   char server_url[WSA_SERVER_URL_MAXSIZE + 1];
+   char service_name[WSA_SERVICE_NAME_MAXSIZE + 1];
+   char server[sizeof (pipe->server)];
+   char update_since[WDF_MODIFIED_HEADER_SIZE + 1];
+   char request[WSA_SERVICE_NAME_MAXSIZE + WSA_SERVER_URL_MAXSIZE + WDF_MODIFIED_HEADER_SIZE + 128];
+   HttpAsyncContext *hcontext;
+   int server_port;
+
+   if (!WSA_ExtractParams (source, server_url, &server_port, service_name) ||
+       server_port == 443
+#ifdef IPHONE
+       || roadmap_main_get_proxy (source) != NULL
+#endif
+       ) {
+      /* Secured and proxied downloads are left to roadmap_net */
+      return roadmap_http_async_copy (callbacks, context, source, update_time);
+   }
+
+   if (strchr (server_url, ':')) {
+      strncpy_safe (server, server_url, sizeof (server));
+   } else {
+      snprintf (server, sizeof (server), "%s:%d", server_url, server_port);
+   }
+
+   if (strcmp (server, pipe->server)) {
+
+      /* One server per connection */
+      if (pipe->first != NULL) {
+         return roadmap_http_async_copy (callbacks, context, source, update_time);
+      }
+      pipe_close_connection (pipe);
+      strncpy_safe (pipe->server, server, sizeof (pipe->server));
+   }
+
+   WDF_FormatHttpIfModifiedSince (update_time, update_since);
+   snprintf (request, sizeof (request),
+             "GET %s HTTP/1.1\r\n"
+             "Host: %s\r\n"
+             "User-Agent: FreeMap/%s\r\n"
+             "Connection: keep-alive\r\n"
+             "%s"
+             "\r\n",
+             service_name, server_url, roadmap_start_version (), update_since);
+
+   hcontext = calloc (1, sizeof (HttpAsyncContext));
+   roadmap_check_allocated (hcontext);
+   hcontext->callbacks = callbacks;
+   hcontext->cb_context = context;
+   hcontext->io.os.socket = ROADMAP_INVALID_SOCKET;
+   hcontext->method = _http_async_method__get;
+   hcontext->flags = HTTPCOPY_FLAG_NONE;
+   hcontext->is_parsing_headers = 1;
+   hcontext->content_length = -1;
+   hcontext->pipe = pipe;
+   hcontext->request = strdup (request);
+   roadmap_check_allocated (hcontext->request);
+
+   if (pipe->last) pipe->last->next = hcontext;
+   else pipe->first = hcontext;
+   pipe->last = hcontext;
+   if (pipe->unsent == NULL) pipe->unsent = hcontext;
+
+   return hcontext;
+}
+
+
+void roadmap_http_async_pipe_flush (HttpAsyncPipe *pipe) {
+
+   if (pipe->unsent == NULL) return;
+
+   if (pipe->state == _http_pipe_state__closed) {
+      pipe_connect (pipe);
+   } else {
+      pipe_write_requests (pipe);
+   }
+}
+
+
+int roadmap_http_async_pipe_pending (const HttpAsyncPipe *pipe) {
+
+   const HttpAsyncContext *context;
+   int count = 0;
+
+   for (context = pipe->first; context != NULL; context = context->next) count++;
+
+   return count;
+}
+
+
 void roadmap_http_async_copy_abort (HttpAsyncContext *context) {
    /*
     * The context can be deallocated earlier by callback, however this function
     * can be called with no consideration on the callback execution.
     * The responsibility of the API callbacks to null the pointer on error
     */
-   if ( context != NULL )
+   if ( context != NULL && context->pipe != NULL )
+   {
+      pipe_abort (context);
+   }
+   else if ( context != NULL )
    {
       if (ROADMAP_NET_IS_VALID(context->io.os.socket)) {
-	   roadmap_main_remove_input(&context->io);
+	   roadmap_net_io_remove_input(&context->io);
 	   roadmap_io_close (&context->io);
 	  }
       free (context);
@@ -53,6 +53,29 @@ HttpAsyncContext *roadmap_http_async_copy (RoadMapHttpAsyncCallbacks *callbacks,
 
 void	roadmap_http_async_copy_abort (HttpAsyncContext *context);
 
+/* Keep-alive connection for downloads from one server. The requests are
+ * written together by roadmap_http_async_pipe_flush (), and answered in
+ * order; the callbacks are the same as for roadmap_http_async_copy ().
+ * When the server closes the connection, the requests which were not
+ * answered are sent again on a new connection. A request is cancelled
+ * with roadmap_http_async_copy_abort ().
+ */
+struct HttpAsyncPipe_st;
+typedef struct HttpAsyncPipe_st HttpAsyncPipe;
+
+HttpAsyncPipe *roadmap_http_async_pipe_new (void);
+void roadmap_http_async_pipe_free (HttpAsyncPipe *pipe);
+
+HttpAsyncContext *roadmap_http_async_pipe_copy (HttpAsyncPipe *pipe,
+                                                RoadMapHttpAsyncCallbacks *callbacks,
+                                                void *context,
+                                                const char *source,
+                                                time_t update_time);
+void roadmap_http_async_pipe_flush (HttpAsyncPipe *pipe);
+
+/* Requests which were not answered yet, including the aborted ones */
+int  roadmap_http_async_pipe_pending (const HttpAsyncPipe *pipe);
+
 HttpAsyncContext * roadmap_http_async_post( RoadMapHttpAsyncCallbacks *callbacks, void *context,
                                                  const char *source, const char* header, const void* data, int data_length, int flags );
 
@@ -0,0 +1,259 @@
+/* roadmap_line_index.c - Grid of the line bounding boxes of a square.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * SYNOPSYS:
+ *
+ *   See roadmap_line_index.h
+ *
+ *   The square is divided in a uniform grid, sized for a few lines per
+ *   cell. Each cell lists the lines whose bounding box overlaps it, so a
+ *   query only looks at the lines of the cells covering its area.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_line.h"
+#include "roadmap_shape.h"
+
+#include "roadmap_line_index.h"
+
+#define LINE_INDEX_MAX_GRID		32
+#define LINE_INDEX_LINES_PER_CELL	4
+
+struct RoadMapLineIndex_t {
+
+   RoadMapArea    edges;
+   int            grid;
+
+   int            line_count;
+   RoadMapArea    *boxes;
+
+   int            *cell_first;   /* grid * grid + 1 entries */
+   int            *cell_lines;
+
+   int            *stamp;        /* last query which visited the line */
+   int            query;
+   int            *result;
+};
+
+
+static int roadmap_line_index_cell (int coordinate, int min, int max, int grid) {
+
+   int cell;
+
+   if (coordinate <= min) return 0;
+   if (coordinate >= max) return grid - 1;
+
+   cell = (int)((double)(coordinate - min) * grid / (max - min));
+   if (cell >= grid) cell = grid - 1;
+
+   return cell;
+}
+
+
+static void roadmap_line_index_cells (const RoadMapLineIndex *index,
+                                      const RoadMapArea *area,
+                                      int *x0, int *x1, int *y0, int *y1) {
+
+   *x0 = roadmap_line_index_cell (area->west, index->edges.west, index->edges.east, index->grid);
+   *x1 = roadmap_line_index_cell (area->east, index->edges.west, index->edges.east, index->grid);
+   *y0 = roadmap_line_index_cell (area->south, index->edges.south, index->edges.north, index->grid);
+   *y1 = roadmap_line_index_cell (area->north, index->edges.south, index->edges.north, index->grid);
+}
+
+
+static void roadmap_line_index_extend (RoadMapArea *box, const RoadMapPosition *position) {
+
+   if (position->longitude < box->west) box->west = position->longitude;
+   if (position->longitude > box->east) box->east = position->longitude;
+   if (position->latitude < box->south) box->south = position->latitude;
+   if (position->latitude > box->north) box->north = position->latitude;
+}
+
+
+RoadMapLineIndex *roadmap_line_index_new (const RoadMapArea *edges) {
+
+   RoadMapLineIndex *index;
+   RoadMapPosition position;
+   int has_shapes = roadmap_shape_count () > 0;
+   int *cursor;
+   int first_shape;
+   int last_shape;
+   int cells;
+   int line;
+   int i;
+   int x;
+   int y;
+   int x0;
+   int x1;
+   int y0;
+   int y1;
+
+   index = calloc (1, sizeof(RoadMapLineIndex));
+   roadmap_check_allocated(index);
+
+   index->edges = *edges;
+   index->line_count = roadmap_line_count ();
+
+   for (index->grid = 1;
+        index->grid < LINE_INDEX_MAX_GRID &&
+        index->grid * index->grid * LINE_INDEX_LINES_PER_CELL < index->line_count;
+        index->grid *= 2)
+      ;
+
+   cells = index->grid * index->grid;
+
+   index->boxes = malloc ((index->line_count + 1) * sizeof(RoadMapArea));
+   index->stamp = calloc (index->line_count + 1, sizeof(int));
+   index->result = malloc ((index->line_count + 1) * sizeof(int));
+   index->cell_first = calloc (cells + 1, sizeof(int));
+   roadmap_check_allocated(index->boxes);
+   roadmap_check_allocated(index->stamp);
+   roadmap_check_allocated(index->result);
+   roadmap_check_allocated(index->cell_first);
+
+   /* Bounding boxes, and the number of lines in each cell */
+   for (line = 0; line < index->line_count; line++) {
+
+      RoadMapArea *box = index->boxes + line;
+
+      roadmap_line_from (line, &position);
+      box->west = box->east = position.longitude;
+      box->south = box->north = position.latitude;
+
+      if (has_shapes &&
+          roadmap_line_shapes (line, &first_shape, &last_shape) > 0) {
+
+         for (i = first_shape; i <= last_shape; i++) {
+            roadmap_shape_get_position (i, &position);
+            roadmap_line_index_extend (box, &position);
+         }
+      }
+
+      roadmap_line_to (line, &position);
+      roadmap_line_index_extend (box, &position);
+
+      roadmap_line_index_cells (index, box, &x0, &x1, &y0, &y1);
+      for (y = y0; y <= y1; y++) {
+         for (x = x0; x <= x1; x++) {
+            index->cell_first[y * index->grid + x + 1]++;
+         }
+      }
+   }
+
+   for (i = 0; i < cells; i++) {
+      index->cell_first[i + 1] += index->cell_first[i];
+   }
+
+   index->cell_lines = malloc ((index->cell_first[cells] + 1) * sizeof(int));
+   roadmap_check_allocated(index->cell_lines);
+
+   cursor = calloc (cells, sizeof(int));
+   roadmap_check_allocated(cursor);
+
+   for (line = 0; line < index->line_count; line++) {
+
+      roadmap_line_index_cells (index, index->boxes + line, &x0, &x1, &y0, &y1);
+      for (y = y0; y <= y1; y++) {
+         for (x = x0; x <= x1; x++) {
+            int cell = y * index->grid + x;
+            index->cell_lines[index->cell_first[cell] + cursor[cell]++] = line;
+         }
+      }
+   }
+
+   free (cursor);
+
+   return index;
+}
+
+
+void roadmap_line_index_free (RoadMapLineIndex *index) {
+
+   if (!index) return;
+
+   free (index->boxes);
+   free (index->stamp);
+   free (index->result);
+   free (index->cell_first);
+   free (index->cell_lines);
+   free (index);
+}
+
+
+static int roadmap_line_index_compare (const void *a, const void *b) {
+
+   return *(const int *)a - *(const int *)b;
+}
+
+
+int roadmap_line_index_query (RoadMapLineIndex *index,
+                              const RoadMapArea *area,
+                              int **lines) {
+
+   int count = 0;
+   int x0;
+   int x1;
+   int y0;
+   int y1;
+   int x;
+   int y;
+   int i;
+
+   *lines = index->result;
+
+   if (++index->query <= 0) {
+      memset (index->stamp, 0, (index->line_count + 1) * sizeof(int));
+      index->query = 1;
+   }
+
+   roadmap_line_index_cells (index, area, &x0, &x1, &y0, &y1);
+
+   for (y = y0; y <= y1; y++) {
+      for (x = x0; x <= x1; x++) {
+
+         int cell = y * index->grid + x;
+
+         for (i = index->cell_first[cell]; i < index->cell_first[cell + 1]; i++) {
+
+            int line = index->cell_lines[i];
+            const RoadMapArea *box = index->boxes + line;
+
+            if (index->stamp[line] == index->query) continue;
+            index->stamp[line] = index->query;
+
+            if (box->west > area->east || box->east < area->west ||
+                box->south > area->north || box->north < area->south) {
+               continue;
+            }
+
+            index->result[count++] = line;
+         }
+      }
+   }
+
+   qsort (index->result, count, sizeof(int), roadmap_line_index_compare);
+
+   return count;
+}
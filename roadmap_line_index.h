@@ -0,0 +1,46 @@
+/* roadmap_line_index.h - Grid of the line bounding boxes of a square.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _ROADMAP_LINE_INDEX__H_
+#define _ROADMAP_LINE_INDEX__H_
+
+#include "roadmap_types.h"
+
+typedef struct RoadMapLineIndex_t RoadMapLineIndex;
+
+/* Builds the index of the lines of the active square. The edges are the
+ * square's area, shape points outside of it go to the border cells.
+ */
+RoadMapLineIndex *roadmap_line_index_new (const RoadMapArea *edges);
+
+void roadmap_line_index_free (RoadMapLineIndex *index);
+
+/* Returns the lines whose bounding box (shape included) intersects the
+ * area, sorted by line id. The array belongs to the index and is valid
+ * until the next query.
+ */
+int roadmap_line_index_query (RoadMapLineIndex *index,
+                              const RoadMapArea *area,
+                              int **lines);
+
+#endif // _ROADMAP_LINE_INDEX__H_
@@ -58,6 +58,11 @@ typedef struct {
 
 static RoadMapLineSpeedContext *RoadMapLineSpeedActive = NULL;
 
+/* The half hour window of the last time slot lookup */
+static time_t  RoadMapTimeSlotStart = 0;
+static time_t  RoadMapTimeSlotEnd = 0;
+static int     RoadMapTimeSlot = 0;
+
 
 static void *roadmap_line_speed_map (const roadmap_db_data_file *file) {
 
@@ -148,12 +153,23 @@ static int get_time_slot (time_t when) {
    return 24;
 #else
    int time_slot;
-   struct tm *t = localtime (&when);
+   struct tm *t;
+
+   /* Route calculation asks for many times within the same half hour */
+   if (when >= RoadMapTimeSlotStart && when < RoadMapTimeSlotEnd) {
+      return RoadMapTimeSlot;
+   }
+
+   t = localtime (&when);
 
    time_slot = t->tm_hour * 2;
 
    if (t->tm_min >= 30) time_slot++;
 
+   RoadMapTimeSlotStart = when - (t->tm_min % 30) * 60 - t->tm_sec;
+   RoadMapTimeSlotEnd = RoadMapTimeSlotStart + 30 * 60;
+   RoadMapTimeSlot = time_slot;
+
    //time_slot = 18;
    return time_slot;
 #endif
@@ -363,4 +379,3 @@ int roadmap_line_speed_get_avg_speed (int line, int against_dir) {
    return roadmap_line_speed_get_avg (speed_ref);
 }
 
-
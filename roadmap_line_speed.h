@@ -47,6 +47,9 @@ int roadmap_line_speed_get_speed (int line, int against_dir);
 
 int roadmap_line_speed_get_avg_speed (int line, int against_dir);
 
+/* Speeds are stored in km/h in one byte, so no line of any tile is faster */
+#define ROADMAP_LINE_SPEED_MAX 255
+
 
 #endif // _ROADMAP_LINE_SPEED__H_
 
@@ -52,6 +52,15 @@
 
 #include "roadmap_trigonometry.h"
 
+#if defined(__SSE2__) && !defined(ROADMAP_MATH_NO_SIMD)
+#define ROADMAP_MATH_SSE2
+#include <emmintrin.h>
+#if defined(__AVX__)
+#define ROADMAP_MATH_AVX
+#include <immintrin.h>
+#endif
+#endif
+
 #include "roadmap_math.h"
 #ifdef OPENGL
 #include "roadmap_canvas3d.h" // roadmap_canvas3_ogl_updateScale
@@ -952,6 +961,35 @@ void roadmap_math_release_focus (void) {
 }
 
 
+/* Returns the area outside of which no point or segment is visible, or 0
+ * when the visibility is not bounded by the focus (3D perspective).
+ */
+int roadmap_math_get_visible_area (RoadMapArea *area) {
+
+   int visibility_distance;
+
+   if (RoadMapContext._is3D_projection == PROJECTION_MODE_3D && !RoadMapMathTileMode) {
+      return 0;
+   }
+
+   if (!RoadMapMathTileMode) {
+      visibility_distance = ROADMAP_VISIBILITY_DISTANCE;
+   } else {
+      visibility_distance = ROADMAP_VISIBILITY_FACTOR * (int)RoadMapContext.zoom;
+   }
+
+   /* Intersections with the edges are accepted one unit off the segment */
+   visibility_distance++;
+
+   area->west = RoadMapContext.focus.west - visibility_distance;
+   area->east = RoadMapContext.focus.east + visibility_distance;
+   area->north = RoadMapContext.focus.north + visibility_distance;
+   area->south = RoadMapContext.focus.south - visibility_distance;
+
+   return 1;
+}
+
+
 int roadmap_math_get_visible_coordinates (const RoadMapPosition *from,
                                           const RoadMapPosition *to,
                                           RoadMapGuiPoint *point0,
@@ -1512,6 +1550,203 @@ int roadmap_math_distance
 }
 
 
+/* Batch variants of roadmap_math_coordinate, roadmap_math_point_is_visible
+ * and roadmap_math_distance. The positions are given as separate longitude
+ * and latitude arrays, so that several points are handled at once when
+ * SSE2 / AVX are available. The results are the same as the single point
+ * functions.
+ */
+void roadmap_math_coordinates (int count,
+                               const int *longitudes,
+                               const int *latitudes,
+                               RoadMapGuiPoint *points) {
+
+   int i = 0;
+
+#if defined(ROADMAP_MATH_SSE2) && defined(OPENGL)
+   __m128i west = _mm_set1_epi32 (RoadMapContext.upright_screen.west);
+   __m128i north = _mm_set1_epi32 (RoadMapContext.upright_screen.north);
+   __m128 zoom_x = _mm_set1_ps (RoadMapContext.zoom_x);
+   __m128 zoom_y = _mm_set1_ps (RoadMapContext.zoom_y);
+
+   for (; i + 4 <= count; i += 4) {
+
+      __m128i dx = _mm_sub_epi32 (_mm_loadu_si128 ((const __m128i *)(longitudes + i)), west);
+      __m128i dy = _mm_sub_epi32 (north, _mm_loadu_si128 ((const __m128i *)(latitudes + i)));
+      __m128i x = _mm_cvttps_epi32 (_mm_div_ps (_mm_cvtepi32_ps (dx), zoom_x));
+      __m128i y = _mm_cvttps_epi32 (_mm_div_ps (_mm_cvtepi32_ps (dy), zoom_y));
+
+      _mm_storeu_si128 ((__m128i *)(points + i), _mm_unpacklo_epi32 (x, y));
+      _mm_storeu_si128 ((__m128i *)(points + i + 2), _mm_unpackhi_epi32 (x, y));
+   }
+#elif defined(ROADMAP_MATH_AVX)
+   /* The integer division is done in double precision, which is exact
+    * for 32 bits operands.
+    */
+   __m128i west = _mm_set1_epi32 (RoadMapContext.upright_screen.west);
+   __m128i north = _mm_set1_epi32 (RoadMapContext.upright_screen.north);
+   __m256d zoom_x = _mm256_set1_pd ((double)RoadMapContext.zoom_x);
+   __m256d zoom_y = _mm256_set1_pd ((double)RoadMapContext.zoom_y);
+
+   for (; i + 4 <= count; i += 4) {
+
+      __m128i dx = _mm_sub_epi32 (_mm_loadu_si128 ((const __m128i *)(longitudes + i)), west);
+      __m128i dy = _mm_sub_epi32 (north, _mm_loadu_si128 ((const __m128i *)(latitudes + i)));
+      __m128i x = _mm256_cvttpd_epi32 (_mm256_div_pd (_mm256_cvtepi32_pd (dx), zoom_x));
+      __m128i y = _mm256_cvttpd_epi32 (_mm256_div_pd (_mm256_cvtepi32_pd (dy), zoom_y));
+
+      _mm_storeu_si128 ((__m128i *)(points + i), _mm_unpacklo_epi32 (x, y));
+      _mm_storeu_si128 ((__m128i *)(points + i + 2), _mm_unpackhi_epi32 (x, y));
+   }
+#elif defined(ROADMAP_MATH_SSE2)
+   __m128i west = _mm_set1_epi32 (RoadMapContext.upright_screen.west);
+   __m128i north = _mm_set1_epi32 (RoadMapContext.upright_screen.north);
+   __m128d zoom_x = _mm_set1_pd ((double)RoadMapContext.zoom_x);
+   __m128d zoom_y = _mm_set1_pd ((double)RoadMapContext.zoom_y);
+
+   for (; i + 2 <= count; i += 2) {
+
+      __m128i dx = _mm_sub_epi32 (_mm_loadl_epi64 ((const __m128i *)(longitudes + i)), west);
+      __m128i dy = _mm_sub_epi32 (north, _mm_loadl_epi64 ((const __m128i *)(latitudes + i)));
+      __m128i x = _mm_cvttpd_epi32 (_mm_div_pd (_mm_cvtepi32_pd (dx), zoom_x));
+      __m128i y = _mm_cvttpd_epi32 (_mm_div_pd (_mm_cvtepi32_pd (dy), zoom_y));
+
+      _mm_storeu_si128 ((__m128i *)(points + i), _mm_unpacklo_epi32 (x, y));
+   }
+#endif
+
+   for (; i < count; i++) {
+
+      points[i].x =
+         ((longitudes[i] - RoadMapContext.upright_screen.west)
+                / RoadMapContext.zoom_x);
+
+      points[i].y =
+         ((RoadMapContext.upright_screen.north - latitudes[i])
+                / RoadMapContext.zoom_y);
+   }
+}
+
+
+void roadmap_math_points_visible (int count,
+                                  const int *longitudes,
+                                  const int *latitudes,
+                                  unsigned char *visible) {
+
+   int i = 0;
+   int visibility_distance;
+
+#if defined(OPENGL) && defined(VIEW_MODE_3D_OGL)
+   if (!RoadMapMathTileMode) {
+
+      /* The perspective edges are only checked by the single point version */
+      for (i = 0; i < count; i++) {
+
+         RoadMapPosition position;
+
+         position.longitude = longitudes[i];
+         position.latitude = latitudes[i];
+         visible[i] = (unsigned char)roadmap_math_point_is_visible (&position);
+      }
+      return;
+   }
+#endif
+
+   if (!RoadMapMathTileMode) {
+      visibility_distance = ROADMAP_VISIBILITY_DISTANCE;
+   } else {
+      visibility_distance = ROADMAP_VISIBILITY_FACTOR * (int)RoadMapContext.zoom;
+   }
+
+#ifdef ROADMAP_MATH_SSE2
+   {
+      __m128i east = _mm_set1_epi32 (RoadMapContext.focus.east + visibility_distance);
+      __m128i west = _mm_set1_epi32 (RoadMapContext.focus.west - visibility_distance);
+      __m128i north = _mm_set1_epi32 (RoadMapContext.focus.north + visibility_distance);
+      __m128i south = _mm_set1_epi32 (RoadMapContext.focus.south - visibility_distance);
+
+      for (; i + 4 <= count; i += 4) {
+
+         __m128i longitude = _mm_loadu_si128 ((const __m128i *)(longitudes + i));
+         __m128i latitude = _mm_loadu_si128 ((const __m128i *)(latitudes + i));
+         __m128i outside =
+            _mm_or_si128
+               (_mm_or_si128 (_mm_cmpgt_epi32 (longitude, east),
+                              _mm_cmplt_epi32 (longitude, west)),
+                _mm_or_si128 (_mm_cmpgt_epi32 (latitude, north),
+                              _mm_cmplt_epi32 (latitude, south)));
+         int mask = _mm_movemask_ps (_mm_castsi128_ps (outside));
+
+         visible[i] = !(mask & 1);
+         visible[i + 1] = !(mask & 2);
+         visible[i + 2] = !(mask & 4);
+         visible[i + 3] = !(mask & 8);
+      }
+   }
+#endif
+
+   for (; i < count; i++) {
+
+      visible[i] =
+         !((longitudes[i] > RoadMapContext.focus.east + visibility_distance) ||
+           (longitudes[i] < RoadMapContext.focus.west - visibility_distance) ||
+           (latitudes[i]  > RoadMapContext.focus.north + visibility_distance) ||
+           (latitudes[i]  < RoadMapContext.focus.south - visibility_distance));
+   }
+}
+
+
+void roadmap_math_distances (const RoadMapPosition *position,
+                             int count,
+                             const int *longitudes,
+                             const int *latitudes,
+                             int *distances) {
+
+   int i = 0;
+
+#ifdef ROADMAP_MATH_SSE2
+   /* The sum is computed in single precision and the square root in double
+    * precision, as done by roadmap_math_distance.
+    */
+   __m128i longitude0 = _mm_set1_epi32 (position->longitude);
+   __m128i latitude0 = _mm_set1_epi32 (position->latitude);
+   __m128 unit_per_longitude = _mm_set1_ps (RoadMapContext.units->unit_per_longitude);
+   __m128 unit_per_latitude = _mm_set1_ps (RoadMapContext.units->unit_per_latitude);
+
+   for (; i + 4 <= count; i += 4) {
+
+      __m128 x = _mm_mul_ps (unit_per_longitude,
+                    _mm_cvtepi32_ps (_mm_sub_epi32 (longitude0,
+                       _mm_loadu_si128 ((const __m128i *)(longitudes + i)))));
+      __m128 y = _mm_mul_ps (unit_per_latitude,
+                    _mm_cvtepi32_ps (_mm_sub_epi32 (latitude0,
+                       _mm_loadu_si128 ((const __m128i *)(latitudes + i)))));
+      __m128 sum = _mm_add_ps (_mm_mul_ps (x, x), _mm_mul_ps (y, y));
+
+#ifdef ROADMAP_MATH_AVX
+      _mm_storeu_si128 ((__m128i *)(distances + i),
+                        _mm256_cvttpd_epi32 (_mm256_sqrt_pd (_mm256_cvtps_pd (sum))));
+#else
+      _mm_storeu_si128 ((__m128i *)(distances + i),
+                        _mm_unpacklo_epi64
+                           (_mm_cvttpd_epi32 (_mm_sqrt_pd (_mm_cvtps_pd (sum))),
+                            _mm_cvttpd_epi32 (_mm_sqrt_pd (_mm_cvtps_pd (_mm_movehl_ps (sum, sum))))));
+#endif
+   }
+#endif
+
+   for (; i < count; i++) {
+
+      float x = RoadMapContext.units->unit_per_longitude
+                  * (position->longitude - longitudes[i]);
+      float y = RoadMapContext.units->unit_per_latitude
+                  * (position->latitude  - latitudes[i]);
+
+      distances[i] = (int) sqrt ((x * x) + (y * y));
+   }
+}
+
+
 /* Take a number followed by ft/mi/m/km, and converts it to current units. */
 int roadmap_math_distance_convert(const char *string, int *was_explicit)
 {
@@ -2122,6 +2357,18 @@ void roadmap_math_get_context (RoadMapPosition *position, zoom_t *zoom) {
 }
 
 
+void roadmap_math_save_view (struct RoadMapContext_t *view) {
+
+   *view = RoadMapContext;
+}
+
+
+void roadmap_math_restore_view (const struct RoadMapContext_t *view) {
+
+   RoadMapContext = *view;
+}
+
+
 int roadmap_math_calc_line_length (const RoadMapPosition *position,
                                    const RoadMapPosition *from_pos,
                                    const RoadMapPosition *to_pos,
@@ -334,6 +334,8 @@ int  roadmap_math_line_is_visible  (const RoadMapPosition *point1,
                                     const RoadMapPosition *point2);
 int  roadmap_math_point_is_visible (const RoadMapPosition *point);
 
+int roadmap_math_get_visible_area (RoadMapArea *area);
+
 int roadmap_math_get_visible_coordinates (const RoadMapPosition *from,
                                           const RoadMapPosition *to,
                                           RoadMapGuiPoint *point0,
@@ -342,6 +344,14 @@ int roadmap_math_get_visible_coordinates (const RoadMapPosition *from,
 
 void roadmap_math_coordinate  (const RoadMapPosition *position,
                                RoadMapGuiPoint *point);
+void roadmap_math_coordinates (int count,
+                               const int *longitudes,
+                               const int *latitudes,
+                               RoadMapGuiPoint *points);
+void roadmap_math_points_visible (int count,
+                                  const int *longitudes,
+                                  const int *latitudes,
+                                  unsigned char *visible);
 void roadmap_math_to_position (const RoadMapGuiPoint *point,
                                RoadMapPosition *position,
                                int projected);
@@ -374,6 +384,9 @@ char *roadmap_math_speed_unit    (void);
 
 int  roadmap_math_distance
         (const RoadMapPosition *position1, const RoadMapPosition *position2);
+void roadmap_math_distances
+        (const RoadMapPosition *position, int count,
+         const int *longitudes, const int *latitudes, int *distances);
 
 int  roadmap_math_distance_convert (const char *string, int *was_explicit);
 int  roadmap_math_to_trip_distance (int distance);
@@ -416,6 +429,12 @@ void roadmap_math_set_context (const RoadMapPosition *position, zoom_t zoom);
 
 void roadmap_math_get_context (RoadMapPosition *position, zoom_t *zoom);
 
+/* The whole view (size, center, zoom, orientation, projection), to draw
+ * somewhere else and come back.
+ */
+void roadmap_math_save_view (struct RoadMapContext_t *view);
+void roadmap_math_restore_view (const struct RoadMapContext_t *view);
+
 int roadmap_math_calc_line_length (const RoadMapPosition *position,
                                    const RoadMapPosition *from_pos,
                                    const RoadMapPosition *to_pos,
@@ -951,6 +951,8 @@ void roadmap_navigate_locate (const RoadMapGpsPosition *gps_position, time_t gps
    roadmap_math_set_context ((RoadMapPosition *)gps_position, zoom);
 
 	roadmap_square_request_location ((const RoadMapPosition *)gps_position);
+	roadmap_square_prefetch_location ((const RoadMapPosition *)gps_position,
+												 gps_position->speed, gps_position->steering);
 
    if (0 && (gps_position->speed < roadmap_gps_speed_accuracy()) &&
        first_speed_time > 0 &&
@@ -0,0 +1,94 @@
+/* roadmap_net_reactor.h - Event loop for many network connections.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2008 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   Multiplexes all the network IO of the process on a single epoll
+ *   descriptor (Linux, built with ROADMAP_NET_EPOLL). It replaces the
+ *   roadmap_main input / output / periodic calls used by roadmap_net and
+ *   socket_async_receive, so the main loop only waits on one descriptor
+ *   (see roadmap_net_reactor_fd), however many sockets are open.
+ *
+ *   Data which cannot be sent right away is queued per socket, and
+ *   flushed with a single gathered send when the socket is writable.
+ */
+
+#ifndef _ROADMAP_NET_REACTOR__H_
+#define _ROADMAP_NET_REACTOR__H_
+
+#include "roadmap.h"
+#include "roadmap_main.h"
+
+#define ROADMAP_REACTOR_MAX_QUEUED  (1024 * 1024) /* Bytes queued per socket */
+
+BOOL roadmap_net_reactor_initialize (void);
+void roadmap_net_reactor_shutdown   (void);
+
+/* The descriptor to wait on: it is readable when there is work for
+ * roadmap_net_reactor_dispatch().
+ */
+int  roadmap_net_reactor_fd (void);
+
+/* Waits up to 'timeout' milliseconds (-1 for ever, 0 to poll), and calls
+ * the callbacks of the ready sockets and of the expired timers. Returns
+ * the number of events handled, or -1 on error.
+ */
+int  roadmap_net_reactor_dispatch (int timeout);
+
+/* Same as the roadmap_main functions with the same names */
+void roadmap_net_reactor_set_input    (RoadMapIO *io, RoadMapInput callback);
+void roadmap_net_reactor_set_output   (RoadMapIO *io, RoadMapInput callback,
+                                       BOOL is_connect);
+void roadmap_net_reactor_remove_input (RoadMapIO *io);
+RoadMapIO *roadmap_net_reactor_output_timedout (time_t timeout);
+
+void roadmap_net_reactor_set_periodic    (int interval, RoadMapCallback callback);
+void roadmap_net_reactor_remove_periodic (RoadMapCallback callback);
+
+/* Sends without blocking: what the socket does not take now is queued,
+ * behind any data already queued. Returns 'length', or -1 on error.
+ */
+int  roadmap_net_reactor_send    (int fd, const void *data, int length);
+int  roadmap_net_reactor_pending (int fd);
+
+/* Drops the socket state; call before closing the descriptor */
+void roadmap_net_reactor_close   (int fd);
+
+
+/* The network code waits on its sockets through these */
+#ifdef ROADMAP_NET_EPOLL
+#define roadmap_net_io_set_input        roadmap_net_reactor_set_input
+#define roadmap_net_io_set_output       roadmap_net_reactor_set_output
+#define roadmap_net_io_remove_input     roadmap_net_reactor_remove_input
+#define roadmap_net_io_output_timedout  roadmap_net_reactor_output_timedout
+#define roadmap_net_io_set_periodic     roadmap_net_reactor_set_periodic
+#define roadmap_net_io_remove_periodic  roadmap_net_reactor_remove_periodic
+#else
+#define roadmap_net_io_set_input        roadmap_main_set_input
+#define roadmap_net_io_set_output       roadmap_main_set_output
+#define roadmap_net_io_remove_input     roadmap_main_remove_input
+#define roadmap_net_io_output_timedout  roadmap_main_output_timedout
+#define roadmap_net_io_set_periodic     roadmap_main_set_periodic
+#define roadmap_net_io_remove_periodic  roadmap_main_remove_periodic
+#endif
+
+#endif // _ROADMAP_NET_REACTOR__H_
@@ -0,0 +1,122 @@
+/* roadmap_render.c - render map images without a GUI
+ *
+ * LICENSE:
+ *
+ *   Copyright 2008 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * SYNOPSYS:
+ *
+ *   See roadmap_render.h
+ */
+
+#include <stdlib.h>
+
+#include "roadmap.h"
+#include "roadmap_math.h"
+#include "roadmap_canvas.h"
+#include "roadmap_screen.h"
+#include "roadmap_label.h"
+
+#include "roadmap_render.h"
+
+/* Kept between images, the canvas goes back to its own buffer after each */
+static unsigned char *RoadMapRenderBuffer;
+static int RoadMapRenderBufferSize;
+
+
+int roadmap_render_area (const RoadMapArea *area, zoom_t zoom, const char *file) {
+
+   struct RoadMapContext_t saved_view;
+   unsigned char *saved_buffer;
+   int saved_width;
+   int saved_height;
+   int saved_stride;
+   RoadMapPosition center;
+   RoadMapPosition corner;
+   RoadMapGuiPoint top_left;
+   RoadMapGuiPoint bottom_right;
+   RoadMapGuiRect rect;
+   int width;
+   int height;
+   int stride;
+
+   roadmap_math_save_view (&saved_view);
+
+   center.longitude = (area->west + area->east) / 2;
+   center.latitude = (area->north + area->south) / 2;
+
+   roadmap_math_set_horizon (0, 0);
+   roadmap_math_zoom_set (zoom);
+   roadmap_math_set_size (0, 0);
+   roadmap_math_set_center (&center);
+   roadmap_math_set_orientation (0);
+
+   corner.longitude = area->west;
+   corner.latitude = area->north;
+   roadmap_math_coordinate (&corner, &top_left);
+
+   corner.longitude = area->east;
+   corner.latitude = area->south;
+   roadmap_math_coordinate (&corner, &bottom_right);
+
+   width = bottom_right.x - top_left.x + 1;
+   height = bottom_right.y - top_left.y + 1;
+
+   if (width <= 0 || height <= 0 ||
+       width > ROADMAP_RENDER_MAX_SIZE || height > ROADMAP_RENDER_MAX_SIZE) {
+
+      roadmap_log (ROADMAP_ERROR, "Cannot render %dx%d image of %s",
+                   width, height, file);
+      roadmap_math_restore_view (&saved_view);
+      return -1;
+   }
+
+   stride = width * roadmap_canvas_buffer_pixel_size ();
+
+   if (height * stride > RoadMapRenderBufferSize) {
+      RoadMapRenderBufferSize = height * stride;
+      free (RoadMapRenderBuffer);
+      RoadMapRenderBuffer = malloc (RoadMapRenderBufferSize);
+      roadmap_check_allocated(RoadMapRenderBuffer);
+   }
+
+   roadmap_canvas_get_buffer (&saved_buffer, &saved_width, &saved_height, &saved_stride);
+   roadmap_canvas_draw_to_buffer (RoadMapRenderBuffer, width, height, stride);
+
+   /* One view for the whole image, so labels are placed across all of it */
+   roadmap_math_set_size (width, height);
+   roadmap_math_set_center (&center);
+   roadmap_math_set_orientation (0);
+
+   rect.minx = 0;
+   rect.miny = 0;
+   rect.maxx = width - 1;
+   rect.maxy = height - 1;
+
+   roadmap_label_start ();
+   roadmap_screen_draw_map (&rect);
+   roadmap_label_draw_cache (1, 1);
+
+   roadmap_canvas_save_screenshot (file);
+
+   roadmap_canvas_draw_to_buffer (saved_buffer, saved_width, saved_height, saved_stride);
+   roadmap_math_restore_view (&saved_view);
+
+   return 0;
+}
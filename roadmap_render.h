@@ -0,0 +1,41 @@
+/* roadmap_render.h - render map images without a GUI
+ *
+ * LICENSE:
+ *
+ *   Copyright 2008 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef ROADMAP_RENDER_H_
+#define ROADMAP_RENDER_H_
+
+#include "roadmap_types.h"
+#include "roadmap_math.h"
+
+#define ROADMAP_RENDER_MAX_SIZE  8192
+
+/* Renders the map of the area at the given zoom into a PNG file.
+ *
+ * The image is drawn in one pass into a memory buffer, with its own label
+ * cache. The view of the screen and the buffer of the canvas are restored
+ * afterwards, but the labels of the screen are not: it needs a redraw.
+ * Writing the file needs a build with USE_LIBPNG.
+ * Returns 0 on success and -1 on error.
+ */
+int roadmap_render_area (const RoadMapArea *area, zoom_t zoom, const char *file);
+
+#endif /*ROADMAP_RENDER_H_*/
@@ -310,6 +310,53 @@ static struct roadmap_screen_point_buffer RoadMapScreenPoints;
 
 static int RoadMapPolygonGeoPoints[ROADMAP_SCREEN_BULK];
 
+#define ROADMAP_SCREEN_SHAPE_BATCH 64
+
+/* Shape points of the line being drawn, decoded ahead so that their
+ * visibility and screen coordinates are computed in one batch.
+ */
+static struct {
+
+   int longitude[ROADMAP_SCREEN_SHAPE_BATCH];
+   int latitude[ROADMAP_SCREEN_SHAPE_BATCH];
+   unsigned char visible[ROADMAP_SCREEN_SHAPE_BATCH];
+   RoadMapGuiPoint points[ROADMAP_SCREEN_SHAPE_BATCH];
+
+} RoadMapScreenShapes;
+
+static int roadmap_screen_load_shapes (int first_shape,
+                                       int last_shape,
+                                       RoadMapShapeItr shape_itr,
+                                       RoadMapPosition *position,
+                                       int check_visibility) {
+
+   int count = last_shape - first_shape + 1;
+   int i;
+
+   if (count > ROADMAP_SCREEN_SHAPE_BATCH) count = ROADMAP_SCREEN_SHAPE_BATCH;
+
+   for (i = 0; i < count; i++) {
+
+      if (shape_itr) (*shape_itr) (first_shape + i, position);
+      else roadmap_shape_get_position (first_shape + i, position);
+
+      RoadMapScreenShapes.longitude[i] = position->longitude;
+      RoadMapScreenShapes.latitude[i] = position->latitude;
+   }
+
+   if (check_visibility) {
+      roadmap_math_points_visible (count, RoadMapScreenShapes.longitude,
+                                   RoadMapScreenShapes.latitude,
+                                   RoadMapScreenShapes.visible);
+   }
+
+   roadmap_math_coordinates (count, RoadMapScreenShapes.longitude,
+                             RoadMapScreenShapes.latitude,
+                             RoadMapScreenShapes.points);
+
+   return count;
+}
+
 
 static RoadMapPen RoadMapBackground = NULL;
 static RoadMapPen RoadMapNoTileBg = NULL;
@@ -565,6 +612,14 @@ INLINE_DEC int  roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
    RoadMapPosition last_midposition;
    RoadMapScreenPattern empty_pattern = {NULL, 0};
    BOOL draw_out_of_screen = FALSE;
+
+   /* These are used to walk the shape points in batches: */
+   RoadMapGuiPoint last_point;
+   int last_visible = 0;
+   int segment_visible;
+   int shapes_first;
+   int shapes_count;
+   int k;
    
    int i;
 
@@ -628,13 +683,15 @@ INLINE_DEC int  roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
          roadmap_screen_add_segment_point (&point0, pens, num_pens,
                                            pattern, opposite_flag | SEGMENT_START);
 
-         for (i = first_shape; i <= last_shape; ++i) {
+         for (i = first_shape; i <= last_shape; i += shapes_count) {
 
-            if (shape_itr) (*shape_itr) (i, &midposition);
-            else roadmap_shape_get_position (i, &midposition);
+            shapes_count = roadmap_screen_load_shapes
+                              (i, last_shape, shape_itr, &midposition, 0);
 
-            roadmap_math_coordinate (&midposition, &point0);
-            roadmap_screen_add_segment_point (&point0, pens, num_pens, pattern, opposite_flag);
+            for (k = 0; k < shapes_count; k++) {
+               roadmap_screen_add_segment_point (RoadMapScreenShapes.points + k,
+                                                 pens, num_pens, pattern, opposite_flag);
+            }
          }
 
          roadmap_math_coordinate (to, &point0);
@@ -771,14 +828,40 @@ INLINE_DEC int  roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
 
          last_point_visible = 0; /* We have drawn nothing yet. */
 
+         shapes_first = first_shape;
+         shapes_count = 0;
+         last_visible = roadmap_math_point_is_visible (&last_midposition);
+         if (last_visible) roadmap_math_coordinate (&last_midposition, &last_point);
+
          for (i = first_shape; i <= last_shape; ++i) {
 
-            if (shape_itr) (*shape_itr) (i, &midposition);
-            else roadmap_shape_get_position (i, &midposition);
+            k = i - shapes_first;
+            if (k >= shapes_count) {
+               shapes_first = i;
+               shapes_count = roadmap_screen_load_shapes
+                                 (i, last_shape, shape_itr, &midposition, 1);
+               k = 0;
+            }
+
+            midposition.longitude = RoadMapScreenShapes.longitude[k];
+            midposition.latitude = RoadMapScreenShapes.latitude[k];
 
-            if (roadmap_math_line_is_visible (&last_midposition, &midposition) &&
+            /* When both ends are visible there is nothing to clip */
+            if (last_visible && RoadMapScreenShapes.visible[k]) {
+               point0 = last_point;
+               point1 = RoadMapScreenShapes.points[k];
+               segment_visible = 1;
+            } else {
+               segment_visible =
+                  roadmap_math_line_is_visible (&last_midposition, &midposition) &&
                   roadmap_math_get_visible_coordinates
-                  (&last_midposition, &midposition, &point0, &point1)) {
+                     (&last_midposition, &midposition, &point0, &point1);
+            }
+
+            last_visible = RoadMapScreenShapes.visible[k];
+            last_point = RoadMapScreenShapes.points[k];
+
+            if (segment_visible) {
                
 
                if ((point0.x == point1.x) && (point0.y == point1.y)) {
@@ -822,7 +905,7 @@ INLINE_DEC int  roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
                   drawn = 1;
                }
 
-               last_point_visible = roadmap_math_point_is_visible (&midposition);
+               last_point_visible = last_visible;
                if (last_point_visible) {
                   roadmap_screen_add_segment_point (&point1, pens, num_pens, pattern, opposite_flag);
                   drawn = 1;
@@ -1623,6 +1706,10 @@ void roadmap_screen_draw_line_points (RoadMapPosition *from,
    /* These are used when the line has a shape: */
    RoadMapPosition midposition;
    RoadMapPosition last_midposition;
+   RoadMapGuiPoint last_point;
+   int last_visible;
+   int shapes_count;
+   int k;
 
    int i;
 
@@ -1687,18 +1774,32 @@ void roadmap_screen_draw_line_points (RoadMapPosition *from,
       last_midposition = *from;
       midposition = *first_shape_pos;
 
-      for (i = first_shape; i <= last_shape; ++i) {
+      last_visible = roadmap_math_point_is_visible (&last_midposition);
+      if (last_visible) roadmap_math_coordinate (&last_midposition, &last_point);
+
+      for (i = first_shape; i <= last_shape; i += shapes_count) {
+
+         shapes_count = roadmap_screen_load_shapes
+                           (i, last_shape, shape_itr, &midposition, 1);
 
-         if (!shape_itr) roadmap_shape_get_position(i, &midposition);
-         else (*shape_itr) (i, &midposition);
+         for (k = 0; k < shapes_count; k++) {
 
-         if (roadmap_math_line_is_visible (&last_midposition, &midposition) &&
-            roadmap_math_get_visible_coordinates
-                        (&last_midposition, &midposition, &point0, &point1)) {
-            roadmap_screen_draw_points (&point0, &point1);
+            midposition.longitude = RoadMapScreenShapes.longitude[k];
+            midposition.latitude = RoadMapScreenShapes.latitude[k];
 
+            if (last_visible && RoadMapScreenShapes.visible[k]) {
+               roadmap_screen_draw_points (&last_point, RoadMapScreenShapes.points + k);
+
+            } else if (roadmap_math_line_is_visible (&last_midposition, &midposition) &&
+               roadmap_math_get_visible_coordinates
+                           (&last_midposition, &midposition, &point0, &point1)) {
+               roadmap_screen_draw_points (&point0, &point1);
+
+            }
+            last_visible = RoadMapScreenShapes.visible[k];
+            last_point = RoadMapScreenShapes.points[k];
+            last_midposition = midposition;
          }
-         last_midposition = midposition;
       }
 
       if (roadmap_math_get_visible_coordinates
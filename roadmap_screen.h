@@ -84,6 +84,7 @@ void roadmap_screen_freeze   (void); /* Forbid any screen refresh. */
 void roadmap_screen_unfreeze (void); /* Enable screen refresh. */
 
 void roadmap_screen_update_center (const RoadMapPosition *pos);
+void roadmap_screen_draw_map (RoadMapGuiRect *rect);
 
 
 void roadmap_screen_get_center (RoadMapPosition *center);
@@ -34,6 +34,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
 
 #define DECLARE_ROADMAP_SQUARE
 
@@ -62,6 +63,8 @@
 #include "roadmap_tile_manager.h"
 #include "roadmap_tile_status.h"
 #include "roadmap_tile_storage.h"
+#include "roadmap_main.h"
+#include "roadmap_config.h"
 
 #include "roadmap_square.h"
 
@@ -94,20 +97,31 @@ typedef struct {
    void                 *subs[NUM_SUB_HANDLERS];
    int						attributes;
 	RoadMapArea 			edges;
+	RoadMapLineIndex		*line_index;
 } RoadMapSquareData;
 
 
+/* The cache is bounded by the memory of the loaded squares (in KB, see
+ * "Map"/"Square cache size"). ROADMAP_SQUARE_CACHE_SIZE only bounds the
+ * number of slots.
+ */
 #ifdef J2ME
 #define ROADMAP_SQUARE_CACHE_SIZE	64
+#define ROADMAP_SQUARE_CACHE_BUDGET	"1024"
 #else
-#define ROADMAP_SQUARE_CACHE_SIZE	512
+#define ROADMAP_SQUARE_CACHE_SIZE	1024
+#define ROADMAP_SQUARE_CACHE_BUDGET	"16384"
 #endif
 
+/* Number of least recently used squares compared when choosing a victim */
+#define ROADMAP_SQUARE_EVICT_CANDIDATES	8
+
 #define ROADMAP_SQUARE_UNAVAILABLE	((RoadMapSquareData *)-1)
 #define ROADMAP_SQUARE_NOT_LOADED	NULL
 
 typedef struct {
 	int	square;
+	int	size;
 	int	next;
 	int	prev;
 } SquareCacheNode;
@@ -129,10 +143,29 @@ RoadMapSquareContext *RoadMapSquareActive = NULL;
 int RoadMapScaleCurrent = 0;
 int RoadMapSquareCurrent = -1;
 static int RoadMapSquareCurrentSlot = -1;
-static int RoadMapSquareNextAvailableSlot = ROADMAP_SQUARE_CACHE_SIZE-1;
+
+static RoadMapConfigDescriptor RoadMapConfigSquareCacheSize =
+                        ROADMAP_CONFIG_ITEM("Map", "Square cache size");
+
+static RoadMapSquareCacheStats RoadMapSquareStats;
+static int RoadMapSquareCacheBudget = 0;
+
+static RoadMapPosition RoadMapSquareFocus;
+static int RoadMapSquareHasFocus = 0;
 
 static int RoadMapSquareForceUpdateMode = 0;
 
+/* Squares predicted ahead of the GPS position, loaded one per timer tick */
+#define ROADMAP_SQUARE_PREFETCH_MAX			8
+#define ROADMAP_SQUARE_PREFETCH_INTERVAL	50		// msec between two tile loads
+#define ROADMAP_SQUARE_PREFETCH_HORIZON	30		// seconds of driving to look ahead
+#define ROADMAP_SQUARE_PREFETCH_MIN_SPEED	10		// knots
+
+static int RoadMapSquarePrefetch[ROADMAP_SQUARE_PREFETCH_MAX];
+static int RoadMapSquarePrefetchCount = 0;
+
+static void roadmap_square_prefetch_next (void);
+
 static void *roadmap_square_map (const roadmap_db_data_file *file) {
 
    RoadMapSquareContext *context;
@@ -161,6 +194,7 @@ static void *roadmap_square_map (const roadmap_db_data_file *file) {
 
 	for (i = 0; i <= ROADMAP_SQUARE_CACHE_SIZE; i++) {
 		context->SquareCache[i].square = -1;
+		context->SquareCache[i].size = 0;
 		context->SquareCache[i].next = (i + 1) % (ROADMAP_SQUARE_CACHE_SIZE + 1);
 		context->SquareCache[i].prev = (i + ROADMAP_SQUARE_CACHE_SIZE) % (ROADMAP_SQUARE_CACHE_SIZE + 1);
 	}
@@ -198,6 +232,11 @@ static void roadmap_square_unmap (void *context) {
 
    roadmap_square_unload_all ();
 
+   if (RoadMapSquarePrefetchCount) {
+   	RoadMapSquarePrefetchCount = 0;
+   	roadmap_main_remove_periodic (roadmap_square_prefetch_next);
+   }
+
    if (RoadMapSquareActive == square_context) {
       RoadMapSquareActive = NULL;
    }
@@ -307,58 +346,173 @@ static void roadmap_square_promote (int slot) {
 }
 
 
+/* Free slots are kept at the tail of the list, where they are taken first */
+static void roadmap_square_demote (int slot) {
+
+	SquareCacheNode *cache = RoadMapSquareActive->SquareCache;
+
+	if (cache[ROADMAP_SQUARE_CACHE_SIZE].prev != slot) {
+		cache[cache[slot].next].prev = cache[slot].prev;
+		cache[cache[slot].prev].next = cache[slot].next;
+
+		cache[slot].prev = cache[ROADMAP_SQUARE_CACHE_SIZE].prev;
+		cache[slot].next = ROADMAP_SQUARE_CACHE_SIZE;
+
+		cache[cache[ROADMAP_SQUARE_CACHE_SIZE].prev].next = slot;
+		cache[ROADMAP_SQUARE_CACHE_SIZE].prev = slot;
+	}
+}
+
+
 void roadmap_square_unload_all (void) {
 
 	int i;
 
-	for (i = 1; i <= ROADMAP_SQUARE_CACHE_SIZE; i++) {
+	for (i = 0; i < ROADMAP_SQUARE_CACHE_SIZE; i++) {
 
 		if (RoadMapSquareActive->SquareCache[i].square >= 0) {
 			roadmap_square_unload (i);
 			RoadMapSquareActive->SquareCache[i].square = -1;
 		}
+		RoadMapSquareActive->SquareCache[i].size = 0;
+	}
+
+	for (i = 0; i <= ROADMAP_SQUARE_CACHE_SIZE; i++) {
 		RoadMapSquareActive->SquareCache[i].next = (i + 1) % (ROADMAP_SQUARE_CACHE_SIZE + 1);
 		RoadMapSquareActive->SquareCache[i].prev = (i + ROADMAP_SQUARE_CACHE_SIZE) % (ROADMAP_SQUARE_CACHE_SIZE + 1);
 	}
+
+	RoadMapSquareStats.count = 0;
+	RoadMapSquareStats.bytes = 0;
+}
+
+
+static int roadmap_square_cache_budget (void) {
+
+	static int initialized = 0;
+
+	if (!initialized) {
+		roadmap_config_declare ("preferences", &RoadMapConfigSquareCacheSize,
+										ROADMAP_SQUARE_CACHE_BUDGET, NULL);
+		RoadMapSquareCacheBudget = roadmap_config_get_integer (&RoadMapConfigSquareCacheSize) * 1024;
+		initialized = 1;
+	}
+
+	return RoadMapSquareCacheBudget;
 }
 
 
-static int roadmap_square_cache (int square) {
+/* Higher is a better victim: old squares far from the GPS position go
+ * first, squares on the navigation route go last.
+ */
+static int roadmap_square_evict_score (int slot, int age) {
+
+	int square = RoadMapSquareActive->SquareCache[slot].square;
+	int score = age;
+	int *status;
+
+	if (RoadMapSquareHasFocus && RoadMapSquareActive->Square[slot] != ROADMAP_SQUARE_NOT_LOADED) {
+
+		RoadMapArea *edges = &RoadMapSquareActive->Square[slot]->edges;
+		int tile_size = roadmap_tile_get_size (0);
+		int dx = abs ((edges->west + edges->east) / 2 - RoadMapSquareFocus.longitude);
+		int dy = abs ((edges->south + edges->north) / 2 - RoadMapSquareFocus.latitude);
+		int distance = (dx + dy) / tile_size;
+
+		score += distance < 16 ? distance : 16;
+	}
+
+	status = roadmap_tile_status_get (square);
+	if (status && ((*status) & ROADMAP_TILE_STATUS_FLAG_ROUTE)) {
+		score -= 2 * (ROADMAP_SQUARE_EVICT_CANDIDATES + 16);
+	}
+
+	return score;
+}
+
+
+static int roadmap_square_evict (void) {
 
-	SquareCacheNode *node;
 	SquareCacheNode *cache = RoadMapSquareActive->SquareCache;
-	int slot = RoadMapSquareNextAvailableSlot;
+	int best_slot = -1;
+	int best_score = 0;
+	int count = 0;
+	int slot;
 
-	if ( slot < 0 )
-	{
-		slot = cache[ROADMAP_SQUARE_CACHE_SIZE].prev;
+	for (slot = cache[ROADMAP_SQUARE_CACHE_SIZE].prev;
+		  slot != ROADMAP_SQUARE_CACHE_SIZE && count < ROADMAP_SQUARE_EVICT_CANDIDATES;
+		  slot = cache[slot].prev) {
+
+		int score;
+
+		if (cache[slot].square < 0 || slot == RoadMapSquareCurrentSlot) continue;
+
+		score = roadmap_square_evict_score (slot, ROADMAP_SQUARE_EVICT_CANDIDATES - count);
+		if (best_slot < 0 || score > best_score) {
+			best_slot = slot;
+			best_score = score;
+		}
+		count++;
+	}
+
+	if (best_slot < 0) return -1;
+
+	roadmap_square_unload (best_slot);
+
+	/* unload normally releases the slot through roadmap_square_delete_reference */
+	if (cache[best_slot].square >= 0) {
+		RoadMapSquareStats.bytes -= cache[best_slot].size;
+		RoadMapSquareStats.count--;
+		cache[best_slot].square = -1;
+		cache[best_slot].size = 0;
+		roadmap_square_demote (best_slot);
 	}
-	else
-	{
-		/*
-		 * At the end arrives to -1 - no more slots available for filling - replace is necessary
-		 */
-		RoadMapSquareNextAvailableSlot--;
+
+	RoadMapSquareStats.evictions++;
+
+	return best_slot;
+}
+
+
+static int roadmap_square_cache (int square, int size) {
+
+	SquareCacheNode *cache = RoadMapSquareActive->SquareCache;
+	int budget = roadmap_square_cache_budget ();
+	int slot;
+
+	while (RoadMapSquareStats.bytes + size > budget &&
+			 roadmap_square_evict () >= 0)
+		;
+
+	slot = cache[ROADMAP_SQUARE_CACHE_SIZE].prev;
+	if (cache[slot].square >= 0 || slot == RoadMapSquareCurrentSlot) {
+		slot = roadmap_square_evict ();
 	}
 
-	// make sure not to unload the current tile
-	if ( slot == RoadMapSquareCurrentSlot )
-	{
-		slot = cache[slot].prev;
+	if (slot < 0) {
+		/* Only the current square is cached and there is a single slot */
+		roadmap_log (ROADMAP_FATAL, "No square cache slot available for %d", square);
 	}
 
-	node = cache + slot;
 	//printf ("Putting square %d in slot %d\n", square, slot);
-	if ( node->square >= 0 )	// Over checking - if RoadMapSquareNextAvailableSlot > 0 - there are still unfilled slots available
-	{
-		roadmap_square_unload (slot);
-	}
+	cache[slot].square = square;
+	cache[slot].size = size;
+	roadmap_square_promote (slot);
+
+	RoadMapSquareStats.bytes += size;
+	RoadMapSquareStats.count++;
 
-	node->square = square;
 	return slot;
 }
 
 
+const RoadMapSquareCacheStats *roadmap_square_get_cache_stats (void) {
+
+	RoadMapSquareStats.budget = roadmap_square_cache_budget ();
+	return &RoadMapSquareStats;
+}
+
+
 
 
 //static int TotalSquares = 0;
@@ -389,7 +543,7 @@ static void *roadmap_square_map_one (const roadmap_db_data_file *file) {
 							  &context->edges.north);
 
 	RoadMapSquareCurrent = index;
-    slot = roadmap_square_cache (index);
+    slot = roadmap_square_cache (index, (int) roadmap_db_get_size (file));
 	RoadMapSquareActive->Square[slot] = context;
 	RoadMapSquareCurrentSlot = slot;
 
@@ -409,6 +563,7 @@ static void *roadmap_square_map_one (const roadmap_db_data_file *file) {
    }
 
 	context->attributes = 0;
+	context->line_index = NULL;
 
    //printf ("Loaded square %d, total squares = %d\n", index, ++TotalSquares);
    return context;
@@ -424,8 +579,18 @@ void roadmap_square_delete_reference (int square) {
 
 	if (slot >= 0) {
 
+		SquareCacheNode *node = RoadMapSquareActive->SquareCache + slot;
+
 		roadmap_hash_remove (RoadMapSquareActive->SquareHash, square, slot);
 		RoadMapSquareActive->Square[slot] = ROADMAP_SQUARE_NOT_LOADED;
+
+		RoadMapSquareStats.bytes -= node->size;
+		RoadMapSquareStats.count--;
+		node->square = -1;
+		node->size = 0;
+		if (slot != RoadMapSquareCurrentSlot) {
+			roadmap_square_demote (slot);
+		}
 	}
 }
 
@@ -447,6 +612,8 @@ static void roadmap_square_unmap_one (void *context) {
 
 	roadmap_square_delete_reference (square_data->square->square_id);
 
+	roadmap_line_index_free (square_data->line_index);
+
    //printf ("Unloaded square %d, total squares = %d\n", index, --TotalSquares);
    free(square_data);
 }
@@ -514,6 +681,9 @@ void roadmap_square_request_location (const RoadMapPosition *position) {
 	int square;
 	RoadMapPosition neighbour;
 
+	RoadMapSquareFocus = *position;
+	RoadMapSquareHasFocus = 1;
+
 	square = roadmap_square_location (position, 0);
 
 	tile_size = roadmap_tile_get_size (0);
@@ -555,6 +725,90 @@ void roadmap_square_request_location (const RoadMapPosition *position) {
 }
 
 
+/* Loads the next predicted square without changing the current square, so
+ * that crossing into it later does not stall on the tile load.
+ */
+static void roadmap_square_prefetch_next (void) {
+
+	int square;
+	int current = RoadMapSquareCurrent;
+
+	while (RoadMapSquarePrefetchCount > 0) {
+
+		square = RoadMapSquarePrefetch[0];
+		RoadMapSquarePrefetchCount--;
+		memmove (RoadMapSquarePrefetch, RoadMapSquarePrefetch + 1,
+					RoadMapSquarePrefetchCount * sizeof (int));
+
+		if (RoadMapSquareActive == NULL) break;
+		if (roadmap_square_find (square) >= 0) continue;
+
+		if (roadmap_square_set_current_internal (square) && current >= 0) {
+			roadmap_square_set_current_internal (current);
+		}
+		break;
+	}
+
+	if (!RoadMapSquarePrefetchCount) {
+		roadmap_main_remove_periodic (roadmap_square_prefetch_next);
+	}
+}
+
+
+void roadmap_square_prefetch_location (const RoadMapPosition *position, int speed, int steering) {
+
+	int tile_size;
+	int distance;
+	int step;
+	int prev_square = -1;
+	int was_empty = (RoadMapSquarePrefetchCount == 0);
+	double lon_step;
+	double lat_step;
+	RoadMapPosition ahead;
+
+	if (RoadMapSquareActive == NULL ||
+		 speed < ROADMAP_SQUARE_PREFETCH_MIN_SPEED ||
+		 steering < 0 || steering >= 360) {
+		return;
+	}
+
+	/* knots to meters, and meters to microdegrees (about 9 per meter) */
+	distance = speed * 1852 / 3600 * ROADMAP_SQUARE_PREFETCH_HORIZON * 9;
+	tile_size = roadmap_tile_get_size (0);
+
+	lat_step = cos (steering * 3.14159265 / 180.0) * tile_size / 2;
+	lon_step = sin (steering * 3.14159265 / 180.0) * tile_size / 2 /
+					cos (position->latitude / 1000000.0 * 3.14159265 / 180.0);
+
+	RoadMapSquarePrefetchCount = 0;
+
+	for (step = 1;
+		  step * tile_size / 2 <= distance && RoadMapSquarePrefetchCount < ROADMAP_SQUARE_PREFETCH_MAX;
+		  step++) {
+
+		int square;
+
+		ahead.longitude = position->longitude + (int) (lon_step * step);
+		ahead.latitude = position->latitude + (int) (lat_step * step);
+		square = roadmap_square_location (&ahead, 0);
+
+		if (square == prev_square) continue;
+		prev_square = square;
+
+		if (roadmap_square_find (square) >= 0) continue;
+
+		RoadMapSquarePrefetch[RoadMapSquarePrefetchCount++] = square;
+		roadmap_square_request (square, ROADMAP_TILE_STATUS_PRIORITY_PREFETCH, 0);
+	}
+
+	if (RoadMapSquarePrefetchCount && was_empty) {
+		roadmap_main_set_periodic (ROADMAP_SQUARE_PREFETCH_INTERVAL, roadmap_square_prefetch_next);
+	} else if (!RoadMapSquarePrefetchCount && !was_empty) {
+		roadmap_main_remove_periodic (roadmap_square_prefetch_next);
+	}
+}
+
+
 int roadmap_square_search (const RoadMapPosition *position, int scale_index) {
 
    int square;
@@ -936,6 +1190,21 @@ int roadmap_square_first_shape (int square) {
 }
 
 
+RoadMapLineIndex *roadmap_square_line_index (int square) {
+
+	RoadMapSquareData *data;
+
+	if (!roadmap_square_set_current (square)) return NULL;
+
+	data = RoadMapSquareActive->Square[RoadMapSquareCurrentSlot];
+	if (data->line_index == NULL) {
+		data->line_index = roadmap_line_index_new (&data->edges);
+	}
+
+	return data->line_index;
+}
+
+
 static int roadmap_square_load (int square) {
 
 	return roadmap_locator_load_tile (square);
@@ -977,11 +1246,15 @@ int roadmap_square_set_current_internal (int square) {
    int slot;
 
    slot = roadmap_square_find (square);
-   if (slot < 0) {
+   if (slot >= 0) {
+		RoadMapSquareStats.hits++;
+   } else {
 
 		int res;
 		int *status = roadmap_tile_status_get (square);
 
+		RoadMapSquareStats.misses++;
+
 		if (status != NULL) {
 
 			if ((*status) & ROADMAP_TILE_STATUS_FLAG_CHECKED) {
@@ -1118,7 +1391,7 @@ int roadmap_square_refresh( int fips, int max_num_tiles, RoadMapCallback tile_lo
    int *tile_status;
    int i, tile_count = 0;
 
-   for ( i = 1; i <= ROADMAP_SQUARE_CACHE_SIZE; i++ )
+   for ( i = 0; i < ROADMAP_SQUARE_CACHE_SIZE; i++ )
    {
       if (RoadMapSquareActive->SquareCache[i].square >= 0)
       {
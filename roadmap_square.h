@@ -29,6 +29,7 @@
 #include "roadmap_types.h"
 #include "roadmap_dbread.h"
 #include "roadmap_gui.h"
+#include "roadmap_line_index.h"
 
 #define ROADMAP_SQUARE_GLOBAL -1
 #define ROADMAP_SQUARE_OTHER  -2
@@ -81,6 +82,7 @@ int 	roadmap_square_reset_attribute (int square, int attribute);
 int 	roadmap_square_get_attribute (int square, int attribute);
 
 void 	roadmap_square_request_location (const RoadMapPosition *position);
+void 	roadmap_square_prefetch_location (const RoadMapPosition *position, int speed, int steering);
 int   roadmap_square_search (const RoadMapPosition *position, int scale_index);
 int 	roadmap_square_find_neighbours (const RoadMapPosition *position, int scale_index, int squares[9]);
 void  roadmap_square_min    (int square, RoadMapPosition *position);
@@ -95,6 +97,9 @@ int   roadmap_square_points_count (int square);
 int   roadmap_square_has_shapes   (int square);
 int   roadmap_square_first_shape  (int square);
 
+/* The line index of the square, built the first time it is needed */
+RoadMapLineIndex *roadmap_square_line_index (int square);
+
 void 	roadmap_square_load_index (void);
 void  roadmap_square_rebuild_index (void);
 int   roadmap_square_set_current (int square);
@@ -111,6 +116,17 @@ int 	roadmap_square_at_current_scale (int square);
 void  roadmap_square_unload_all (void);
 int roadmap_square_refresh( int fips, int max_num_tiles, RoadMapCallback tile_loaded_cb );
 
+typedef struct {
+	int hits;
+	int misses;
+	int evictions;
+	int count;     /* squares in the cache */
+	int bytes;     /* memory of the cached squares */
+	int budget;
+} RoadMapSquareCacheStats;
+
+const RoadMapSquareCacheStats *roadmap_square_get_cache_stats (void);
+
 extern roadmap_db_handler RoadMapSquareHandler;
 extern roadmap_db_handler RoadMapSquareOneHandler;
 
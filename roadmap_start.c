@@ -171,6 +171,7 @@ const char*   grid_menu_labels[256];
 #include "navigate/navigate_route.h"
 #include "editor/editor_main.h"
 #include "editor/track/editor_track_main.h"
+#include "editor/track/editor_gps_data.h"
 #include "editor/editor_screen.h"
 #include "editor/db/editor_db.h"
 #include "editor/static/update_range.h"
@@ -988,6 +989,12 @@ RoadMapAction RoadMapStartActions[MAX_ACTIONS + 1] = {
    {"recalc_alt_routes", "Alternative routes", NULL,  NULL,
                           "Alternative routes ", navigate_main_alt_recalculate_route},
 
+   {"departure_times", "Departure time", NULL,  NULL,
+                          "Best time to leave for the destination", navigate_main_departure_times},
+
+   {"match_gps_data", "Match GPS data", NULL,  NULL,
+                          "Match the recorded GPS data to the map", editor_gps_data_match_active},
+
    {"nav_menu", "Nav navigation", NULL,  NULL,
                          "Nav menu", navigate_menu},
 #ifdef SSD
@@ -92,6 +92,8 @@ typedef struct {
 static RoadMapStreetContext *RoadMapStreetActive = NULL;
 
 #define MAX_SEARCH_NAMES 100
+
+#define STREET_SHAPE_BATCH 64
 static int RoadMapStreetSearchCount;
 static char *RoadMapStreetSearchNames[MAX_SEARCH_NAMES];
 
@@ -655,6 +657,12 @@ static int roadmap_street_get_distance_with_shape
                RoadMapNeighbour *neighbours, int max) {
 
    int i;
+   int k;
+   int count;
+   int longitudes[STREET_SHAPE_BATCH];
+   int latitudes[STREET_SHAPE_BATCH];
+   unsigned char visible[STREET_SHAPE_BATCH];
+   int from_visible;
    RoadMapNeighbour current;
    int fips = roadmap_locator_active();
 	int square = roadmap_square_active ();
@@ -671,22 +679,45 @@ static int roadmap_street_get_distance_with_shape
 
    current.to = current.from; /* Initialize the shape position (relative). */
 
-   for (i = first_shape; i <= last_shape; i++) {
-
-      roadmap_shape_get_position (i, &current.to);
+   /* The shape points are decoded in batches, so that the visibility of
+    * the points is checked at once. A segment with a visible end is
+    * visible, the others still need the full intersection test.
+    */
+   from_visible = roadmap_math_point_is_visible (&current.from);
 
-      if (roadmap_math_get_visible_coordinates (&current.from, &current.to,
-                                                NULL, NULL)) {
+   for (i = first_shape; i <= last_shape; i += count) {
 
-         current.distance =
-            roadmap_math_get_distance_from_segment
-               (position, &current.from, &current.to,
-                &current.intersection, NULL);
+      count = last_shape - i + 1;
+      if (count > STREET_SHAPE_BATCH) count = STREET_SHAPE_BATCH;
 
-			found = roadmap_street_replace (neighbours, found, max, &current);
+      for (k = 0; k < count; k++) {
+         roadmap_shape_get_position (i + k, &current.to);
+         longitudes[k] = current.to.longitude;
+         latitudes[k] = current.to.latitude;
       }
 
-      current.from = current.to;
+      roadmap_math_points_visible (count, longitudes, latitudes, visible);
+
+      for (k = 0; k < count; k++) {
+
+         current.to.longitude = longitudes[k];
+         current.to.latitude = latitudes[k];
+
+         if (from_visible || visible[k] ||
+             roadmap_math_get_visible_coordinates (&current.from, &current.to,
+                                                   NULL, NULL)) {
+
+            current.distance =
+               roadmap_math_get_distance_from_segment
+                  (position, &current.from, &current.to,
+                   &current.intersection, NULL);
+
+				found = roadmap_street_replace (neighbours, found, max, &current);
+         }
+
+         current.from = current.to;
+         from_visible = visible[k];
+      }
    }
 
    roadmap_line_to (line, &current.to);
@@ -836,12 +867,14 @@ int roadmap_street_get_distance
 }
 
 
+/* When lines is not NULL, only the given lines (sorted) are checked */
 static int roadmap_street_get_closest_in_square
               (const RoadMapPosition *position, int square, int cfcc,
-               int max_shapes, RoadMapNeighbour *neighbours,
-               int count, int max) {
+               int max_shapes, const int *lines, int lines_count,
+               RoadMapNeighbour *neighbours, int count, int max) {
 
    int line;
+   int next = 0;
    int found;
    int first_line;
    int last_line;
@@ -861,10 +894,19 @@ static int roadmap_street_get_closest_in_square
 
    if (roadmap_line_in_square (square, cfcc, &first_line, &last_line) > 0) {
 
+      if (lines != NULL) {
+         while (next < lines_count && lines[next] < first_line) next++;
+      }
+
       if (roadmap_square_has_shapes (square)) {
 
          for (line = first_line; line <= last_line; line++) {
 
+            if (lines != NULL) {
+               if (next >= lines_count || lines[next] > last_line) break;
+               line = lines[next++];
+            }
+
             if (roadmap_plugin_override_line (line, cfcc, fips)) continue;
 
             if (roadmap_line_shapes (line, &first_shape, &last_shape) > 0) {
@@ -887,6 +929,11 @@ static int roadmap_street_get_closest_in_square
 
          for (line = first_line; line <= last_line; line++) {
 
+            if (lines != NULL) {
+               if (next >= lines_count || lines[next] > last_line) break;
+               line = lines[next++];
+            }
+
             if (roadmap_street_get_distance_no_shape
                         (position, line, cfcc, this)) {
                count = roadmap_street_replace (neighbours, count, max, this);
@@ -912,6 +959,10 @@ int roadmap_street_get_closest
    int county_count;
    int square[9];
    int count_squares;
+   RoadMapArea area;
+   RoadMapLineIndex *index;
+   int *lines;
+   int lines_count;
 
    int count = 0;
 
@@ -935,12 +986,25 @@ int roadmap_street_get_closest
 
       /* The current location fits in one of the county's squares.
        * We might be in that county, search for the closest streets.
+       * Only the lines which may have a visible segment are checked.
        */
+         lines = NULL;
+         lines_count = 0;
+
+         if (roadmap_math_get_visible_area (&area)) {
+            index = roadmap_square_line_index (square[j]);
+            if (index != NULL) {
+               lines_count = roadmap_line_index_query (index, &area, &lines);
+               if (lines_count == 0) continue;
+            }
+         }
+
          for (i = 0; i < categories_count; ++i) {
 
             count =
                roadmap_street_get_closest_in_square
-                  (position, square[j], categories[i], max_shapes, neighbours, count, max);
+                  (position, square[j], categories[i], max_shapes,
+                   lines, lines_count, neighbours, count, max);
 			}
 		}
    }
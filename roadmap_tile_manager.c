@@ -28,6 +28,7 @@
 
 #include "roadmap_tile_manager.h"
 #include "roadmap_tile_storage.h"
+#include "roadmap_tile_pack.h"
 #include "roadmap_math.h"
 #include "roadmap.h"
 #include "roadmap_tile_status.h"
@@ -53,12 +54,20 @@
 
 #if defined(__SYMBIAN32__) || defined(J2ME)
 #define	TM_MAX_CONCURRENT		1
+#define	TM_PIPELINE_DEPTH		1
 #elif defined(IPHONE) || defined(ANDROID)
 #define	TM_MAX_CONCURRENT		6
+#define	TM_PIPELINE_DEPTH		4
 #else
 #define	TM_MAX_CONCURRENT		3
+#define	TM_PIPELINE_DEPTH		4
 #endif
 
+/* Each of the TM_MAX_CONCURRENT connections is kept alive, and carries
+ * up to TM_PIPELINE_DEPTH tile requests at a time.
+ */
+#define	TM_MAX_DOWNLOADS		(TM_MAX_CONCURRENT * TM_PIPELINE_DEPTH)
+
 #ifdef _WIN32
 #ifdef OPENGL
 #define TM_MAX_QUEUE                256
@@ -76,14 +85,18 @@ typedef struct {
 
 	time_t				time_out;
 	int					tile_index;
+	int					priority;
 	int					*tile_status;
 	char					url[512];
 	RoadMapCallback	callback;
 	char					*tile_data;
 	size_t				tile_size;
+	size_t				expected_size;
 	HttpAsyncContext	*http_context;
 } ConnectionContext;
 
+static HttpAsyncPipe					*Pipes[TM_MAX_CONCURRENT];
+
 
 static enum {
 	stat_First,
@@ -101,17 +114,21 @@ typedef struct {
 
 	int					tile_index;
 	int					priority;
+	unsigned int		seq;
 	RoadMapCallback	callback;
 } TileData;
 
+/* RequestQueue is a binary heap: the best request is at index 0 */
 static TileData						RequestQueue[TM_MAX_QUEUE];
-static int								QueueHead = 0;
 static int								QueueSize = 0;
+static unsigned int					QueueSeq = 0;
 static RoadMapCallback				NextLoginCallback = NULL;
 static RoadMapTileCallback			TileCallback = NULL;
 static int								ActiveLoadingSession = 0;
 static int                       TilesRefreshProgressCount = 0;         // Currently updated tiles count
 static int                       TilesRefreshTotalCount = -1;           // Total number of tiles to be updated
+static int                       *TilesRefreshStored = NULL;            // Tiles stored by the refresh, packed when it ends
+static int                       TilesRefreshStoredCount = 0;
 
 static RoadMapConfigDescriptor 	LastLoadingSessionCfg =
                         ROADMAP_CONFIG_ITEM("Tiles", "Last Session");
@@ -121,13 +138,13 @@ static RoadMapConfigDescriptor 	LoadingSessionLifetimeCfg =
 
 
 static void load_next_tile (void);
-static void queue_tile (int index, int push, RoadMapCallback on_loaded);
+static int queue_tile (int index, int priority, RoadMapCallback on_loaded);
 static void roadmap_tile_manager_login_cb (void);
 static void on_connection_failure (ConnectionContext *conn);
 #ifndef INLINE_DEC
 #define INLINE_DEC static
 #endif //INLINE_DEC
-INLINE_DEC void tile_refresh_cb( int tile_id );
+INLINE_DEC void tile_refresh_cb( int tile_id, BOOL stored );
 static void init_loading_session (void) {
 
 	int last_session;
@@ -160,10 +177,14 @@ static void init_connections (void) {
 
 	if (Connections != NULL) return;
 
-	Connections = (ConnectionContext *) malloc (TM_MAX_CONCURRENT * sizeof (ConnectionContext));
-	for (i = 0; i < TM_MAX_CONCURRENT; i++) {
+	Connections = (ConnectionContext *) malloc (TM_MAX_DOWNLOADS * sizeof (ConnectionContext));
+	for (i = 0; i < TM_MAX_DOWNLOADS; i++) {
 		Connections[i].tile_status = NULL;
 	}
+
+	for (i = 0; i < TM_MAX_CONCURRENT; i++) {
+		Pipes[i] = roadmap_http_async_pipe_new ();
+	}
 }
 
 
@@ -174,6 +195,7 @@ static int  http_cb_size (void *context, size_t size) {
    //printf ("Size for %s is %d\n", conn->url, size);
 	conn->tile_data = malloc (size);
 	conn->tile_size = 0;
+	conn->expected_size = size;
 
 	return size;
 }
@@ -213,7 +235,7 @@ static void http_cb_error (void *context, int connection_failure, const char *fo
 	}
 
 	// Update the refresh progress also in case of error on tile
-   tile_refresh_cb( conn->tile_index );
+   tile_refresh_cb( conn->tile_index, FALSE );
 
    // The callback responsibility to "null" the context in case of failure
    // The memory is deallocated out of this function
@@ -279,7 +301,7 @@ static void http_cb_done (void *context,char *last_modified, const char *format,
    //printf("http_cb_done: load %dms\n", t2 - t1);
 
    // Tiles refresh progress (if active)
-   tile_refresh_cb( tile_index );
+   tile_refresh_cb( tile_index, TRUE );
 
    load_next_tile ();
 
@@ -349,6 +371,72 @@ static void get_url (ConnectionContext *context) {
 }
 
 
+/* Requests of a higher priority go first. Among prioritized requests of
+ * the same priority the latest goes first, as it reflects the latest
+ * position; requests with no priority are served in order.
+ */
+static int queue_before (const TileData *a, const TileData *b) {
+
+	if (a->priority != b->priority) return a->priority > b->priority;
+
+	if (a->priority) return (int)(a->seq - b->seq) > 0;
+
+	return (int)(a->seq - b->seq) < 0;
+}
+
+
+static void queue_swap (int i, int j) {
+
+	TileData tmp = RequestQueue[i];
+	RequestQueue[i] = RequestQueue[j];
+	RequestQueue[j] = tmp;
+}
+
+
+static void queue_sift_up (int pos) {
+
+	while (pos > 0) {
+
+		int parent = (pos - 1) / 2;
+
+		if (!queue_before (RequestQueue + pos, RequestQueue + parent)) break;
+
+		queue_swap (pos, parent);
+		pos = parent;
+	}
+}
+
+
+static void queue_sift_down (int pos) {
+
+	while (1) {
+
+		int best = pos;
+		int child = pos * 2 + 1;
+
+		if (child < QueueSize && queue_before (RequestQueue + child, RequestQueue + best)) best = child;
+		child++;
+		if (child < QueueSize && queue_before (RequestQueue + child, RequestQueue + best)) best = child;
+
+		if (best == pos) break;
+
+		queue_swap (pos, best);
+		pos = best;
+	}
+}
+
+
+static void queue_remove (int pos) {
+
+	QueueSize--;
+	if (pos == QueueSize) return;
+
+	RequestQueue[pos] = RequestQueue[QueueSize];
+	queue_sift_down (pos);
+	queue_sift_up (pos);
+}
+
+
 static void next_to_load (int *tile_index, int *priority, RoadMapCallback *callback) {
 
 	if (QueueSize <= 0) {
@@ -356,34 +444,64 @@ static void next_to_load (int *tile_index, int *priority, RoadMapCallback *callb
 		return;
 	}
 
-	*tile_index = RequestQueue[QueueHead].tile_index;
-	*callback = RequestQueue[QueueHead].callback;
-	*priority = RequestQueue[QueueHead].priority;
-	QueueHead = (QueueHead + 1) % TM_MAX_QUEUE;
-	QueueSize--;
+	*tile_index = RequestQueue[0].tile_index;
+	*callback = RequestQueue[0].callback;
+	*priority = RequestQueue[0].priority;
+	queue_remove (0);
 }
 
 
-static void load_next_tile (void) {
+/* The connection with the fewest requests in flight, or -1 if all are full */
+static int next_pipe (void) {
+
+	int best = -1;
+	int best_pending = TM_PIPELINE_DEPTH;
+	int i;
+
+	for (i = 0; i < TM_MAX_CONCURRENT; i++) {
+
+		int pending = roadmap_http_async_pipe_pending (Pipes[i]);
+
+		if (pending < best_pending) {
+			best = i;
+			best_pending = pending;
+		}
+	}
+
+	return best;
+}
+
+
+/* Starts the download of the next queued tile. Returns 0 when nothing
+ * more can be started now.
+ */
+static int start_next_tile (void) {
 
 	static RoadMapHttpAsyncCallbacks callbacks = { http_cb_size, http_cb_progress, http_cb_error, http_cb_done };
 	int conn;
+	int pipe;
 	time_t tile_time;
 	int tile_index;
 	int priority;
 	int *tile_status;
 	RoadMapCallback tile_callback;
 
-   roadmap_log(ROADMAP_DEBUG, "load_next_tile - status:%d", Status);
+	if (NumOpenConnections >= TM_MAX_DOWNLOADS || Status != stat_Active) {
+		return 0;
+	}
 
-	if (NumOpenConnections >= TM_MAX_CONCURRENT || Status != stat_Active) {
-		return;
+	/* An aborted request keeps its place on the connection until its
+	 * response is read
+	 */
+	pipe = next_pipe ();
+	if (pipe < 0) {
+		return 0;
 	}
 
 	do {
 		next_to_load (&tile_index, &priority, &tile_callback);
 		if (tile_index == -1) {
-			return;
+			return 0;
 		}
 		tile_status = roadmap_tile_status_get (tile_index);
 		assert (tile_status != NULL);
@@ -397,19 +515,21 @@ static void load_next_tile (void) {
 	roadmap_log (ROADMAP_DEBUG, "Loading tile %d -- priority %d",
 						tile_index, priority);
 
-	for (conn = 0; conn < TM_MAX_CONCURRENT; conn++) {
+	for (conn = 0; conn < TM_MAX_DOWNLOADS; conn++) {
 
 		if (Connections[conn].tile_status == NULL) break;
 	}
 
-	assert (conn < TM_MAX_CONCURRENT);
+	assert (conn < TM_MAX_DOWNLOADS);
 
 	Connections[conn].tile_index = tile_index;
+	Connections[conn].priority = priority;
 	Connections[conn].tile_status = tile_status;
 	Connections[conn].callback = tile_callback;
 	Connections[conn].time_out = 0;
 	Connections[conn].tile_data = NULL;
 	Connections[conn].tile_size = 0;
+	Connections[conn].expected_size = 0;
 	get_url (&Connections[conn]);
 
 	//printf ("Requesting %s\n", Connections[conn].url);
@@ -420,18 +540,46 @@ static void load_next_tile (void) {
 	tile_time = roadmap_square_timestamp (tile_index);
 
 	Connections[conn].http_context =
-		roadmap_http_async_copy (&callbacks,
-										 &Connections[conn],
-										 Connections[conn].url,
-										 tile_time);
+		roadmap_http_async_pipe_copy (Pipes[pipe],
+												&callbacks,
+												&Connections[conn],
+												Connections[conn].url,
+												tile_time);
 
 	// failure is handled by http_cb_error
+	return 1;
+}
+
+
+/* Fills the free download slots, and sends the new requests of each
+ * connection together.
+ */
+static void load_next_tile (void) {
+
+	int i;
+
+   roadmap_log(ROADMAP_DEBUG, "load_next_tile - status:%d", Status);
+
+	while (start_next_tile ())
+		;
+
+	if (Status != stat_Active) return;
+
+	for (i = 0; i < TM_MAX_CONCURRENT; i++) {
+		roadmap_http_async_pipe_flush (Pipes[i]);
+	}
 }
 
 static void requeue_tile (ConnectionContext *conn) {
 
    *conn->tile_status = (*conn->tile_status) & ~ROADMAP_TILE_STATUS_FLAG_ACTIVE;
-	queue_tile (conn->tile_index, (*conn->tile_status) & ROADMAP_TILE_STATUS_MASK_PRIORITY, conn->callback);
+	if (queue_tile (conn->tile_index, (*conn->tile_status) & ROADMAP_TILE_STATUS_MASK_PRIORITY, conn->callback)) {
+		*conn->tile_status |= ROADMAP_TILE_STATUS_FLAG_QUEUED;
+	}
+   if (conn->tile_data) {
+   	free (conn->tile_data);
+   	conn->tile_data = NULL;
+   }
    conn->tile_status = NULL;
    NumOpenConnections--;
 }
@@ -441,7 +589,7 @@ static void roadmap_tile_manager_check_timeouts (void) {
 	int i;
 	time_t time_now = time (NULL);
 
-	for (i = 0; i < TM_MAX_CONCURRENT; i++) {
+	for (i = 0; i < TM_MAX_DOWNLOADS; i++) {
 		ConnectionContext *conn = Connections + i;
 		if (conn->tile_status != NULL && conn->time_out && conn->time_out < time_now) {
 			roadmap_log (ROADMAP_ERROR, "Timed out waiting for tile %d", conn->tile_index);
@@ -476,64 +624,127 @@ static void on_connection_failure (ConnectionContext *conn) {
 	roadmap_main_set_periodic (TM_RETRY_CONNECTION_SECONDS * 1000, start_network);
 }
 
-static void queue_tile (int index, int priority, RoadMapCallback on_loaded) {
+static int queue_find (int index, RoadMapCallback on_loaded) {
 
-	int slot;
+	int i;
 
-	if (priority) {
-		int pos;
-		int test_slot;
+	for (i = 0; i < QueueSize; i++) {
+		if (RequestQueue[i].tile_index == index &&
+			 (on_loaded == NULL || RequestQueue[i].callback == NULL ||
+			  RequestQueue[i].callback == on_loaded)) {
+			return i;
+		}
+	}
 
-		QueueHead = (QueueHead + TM_MAX_QUEUE - 1) % TM_MAX_QUEUE;
+	return -1;
+}
 
-		// Note{ID}:
-		// This is a safety against removing callback items from queue
-		// assuming there is only one callback item at a time.
-		// if things change (more than one possible callback item)
-		// change it to call the callback (it will work but will demand more CPU)
-		if (QueueSize == TM_MAX_QUEUE) {
-			if (RequestQueue[QueueHead].priority > priority) {
-				roadmap_log (ROADMAP_WARNING, "Tile request queue is full with prioritized items");
-				return;
-			}
-			if (RequestQueue[QueueHead].callback != NULL) {
 
-				int before_last = (QueueHead + TM_MAX_QUEUE - 1) % TM_MAX_QUEUE;
-				assert (RequestQueue[before_last].callback == NULL);
-				*roadmap_tile_status_get (RequestQueue[before_last].tile_index) &= ~ROADMAP_TILE_STATUS_FLAG_QUEUED;
-				RequestQueue[before_last] = RequestQueue[QueueHead];
-			}
-			QueueSize--;
-		}
+/* The request which would be served last, skipping requests with a callback */
+static int queue_find_last (void) {
 
-		for (slot = QueueHead, pos = 1; pos <= QueueSize; pos++) {
-			test_slot = (QueueHead + pos) % TM_MAX_QUEUE;
-			if (RequestQueue[test_slot].priority <= priority) break;
-			RequestQueue[slot] = RequestQueue[test_slot];
-			slot = test_slot;
-		}
+	int last = -1;
+	int i;
 
-		if (QueueSize < TM_MAX_QUEUE) {
-			QueueSize++;
+	for (i = QueueSize / 2; i < QueueSize; i++) {
+		if (RequestQueue[i].callback == NULL &&
+			 (last < 0 || queue_before (RequestQueue + last, RequestQueue + i))) {
+			last = i;
 		}
-	} else {
-		if (QueueSize >= TM_MAX_QUEUE) {
-			roadmap_log (ROADMAP_INFO, "Tile request queue is full");
-			return;
+	}
+
+	return last;
+}
+
+
+static int queue_tile (int index, int priority, RoadMapCallback on_loaded) {
+
+	TileData request;
+	int pos;
+
+	request.tile_index = index;
+	request.callback = on_loaded;
+	request.priority = priority;
+	request.seq = ++QueueSeq;
+
+	/* A tile which is already queued is moved according to its new priority */
+	pos = queue_find (index, on_loaded);
+	if (pos >= 0) {
+
+		if (on_loaded) RequestQueue[pos].callback = on_loaded;
+
+		if (priority > RequestQueue[pos].priority ||
+			 (priority && priority == RequestQueue[pos].priority)) {
+			RequestQueue[pos].priority = priority;
+			RequestQueue[pos].seq = request.seq;
+			queue_sift_up (pos);
 		}
-		slot = (QueueHead + QueueSize) % TM_MAX_QUEUE;
-		if (QueueSize < TM_MAX_QUEUE) {
-			QueueSize++;
+
+		roadmap_log (ROADMAP_DEBUG, "Requeued tile %d with priority %d Status:%d", index, priority, Status);
+		return 1;
+	}
+
+	if (QueueSize >= TM_MAX_QUEUE) {
+
+		pos = queue_find_last ();
+
+		if (pos < 0 || queue_before (RequestQueue + pos, &request)) {
+			if (priority) {
+				roadmap_log (ROADMAP_WARNING, "Tile request queue is full with prioritized items");
+			} else {
+				roadmap_log (ROADMAP_INFO, "Tile request queue is full");
+			}
+			return 0;
 		}
+
+		*roadmap_tile_status_get (RequestQueue[pos].tile_index) &= ~ROADMAP_TILE_STATUS_FLAG_QUEUED;
+		queue_remove (pos);
 	}
 
-	RequestQueue[slot].tile_index = index;
-	RequestQueue[slot].callback = on_loaded;
-	RequestQueue[slot].priority = priority;
-	roadmap_log (ROADMAP_DEBUG, "Queued tile %d at slot %d (position %d) with priority %d Status:%d",
-						index, slot, (slot + 1 + TM_MAX_QUEUE - QueueHead) % TM_MAX_QUEUE, priority, Status);
+	pos = QueueSize++;
+	RequestQueue[pos] = request;
+	queue_sift_up (pos);
+
+	roadmap_log (ROADMAP_DEBUG, "Queued tile %d (queue size %d) with priority %d Status:%d",
+						index, QueueSize, priority, Status);
+	return 1;
 }
 
+
+/* When all connections are busy, a download which has not progressed much
+ * is given up in favour of a more urgent tile, and goes back to the queue.
+ */
+static void preempt_connection (int priority) {
+
+	ConnectionContext *victim = NULL;
+	int i;
+
+	if (NumOpenConnections < TM_MAX_DOWNLOADS || Status != stat_Active) return;
+
+	for (i = 0; i < TM_MAX_DOWNLOADS; i++) {
+
+		ConnectionContext *conn = Connections + i;
+
+		if (conn->tile_status == NULL || conn->priority >= priority) continue;
+
+		/* Only connected downloads can be aborted safely */
+		if (!conn->time_out) continue;
+		if (conn->expected_size && conn->tile_size * 2 > conn->expected_size) continue;
+
+		if (victim == NULL || conn->priority < victim->priority) victim = conn;
+	}
+
+	if (victim == NULL) return;
+
+	roadmap_log (ROADMAP_DEBUG, "Preempting tile %d (priority %d) for priority %d",
+					 victim->tile_index, victim->priority, priority);
+
+	roadmap_http_async_copy_abort (victim->http_context);
+	victim->http_context = NULL;
+	requeue_tile (victim);
+}
+
+
 void roadmap_tile_request (int index, int priority, int force_update, RoadMapCallback on_loaded) {
 
 	int *tile_status = roadmap_tile_status_get (index);
@@ -563,7 +774,9 @@ void roadmap_tile_request (int index, int priority, int force_update, RoadMapCal
 		}
 	}
 
-	queue_tile (index, priority, on_loaded);
+	if (!queue_tile (index, priority, on_loaded)) {
+		return;
+	}
 	*tile_status = ((*tile_status) & ~ROADMAP_TILE_STATUS_MASK_PRIORITY) | ROADMAP_TILE_STATUS_FLAG_QUEUED | priority;
 
 	init_connections ();
@@ -574,6 +787,7 @@ void roadmap_tile_request (int index, int priority, int force_update, RoadMapCal
 	}
 
 	if (Status == stat_Active) {
+		preempt_connection (priority);
 		load_next_tile ();
 	}
 
@@ -622,13 +836,28 @@ static BOOL tile_load_progress_warn( char* warn_string )
 /*
  * Callback executed upon subsequent tile download
  */
-INLINE_DEC void tile_refresh_cb( int tile_id )
+INLINE_DEC void tile_refresh_cb( int tile_id, BOOL stored )
 {
    if ( TilesRefreshTotalCount < 0 )
       return;
 
+   if ( stored && TilesRefreshStored && TilesRefreshStoredCount < TilesRefreshTotalCount )
+      TilesRefreshStored[TilesRefreshStoredCount++] = tile_id;
+
    if ( ++TilesRefreshProgressCount >= TilesRefreshTotalCount )
    {
+#ifdef ROADMAP_TILE_PACK
+      /*
+       * All the tiles were downloaded again: pack them, so that they are
+       * used in place from now on. A tile which is still being stored in the
+       * background is not found and is simply left out of the pack.
+       */
+      if ( TilesRefreshStoredCount > 0 )
+         roadmap_tile_pack_build( roadmap_locator_active(), TilesRefreshStored, TilesRefreshStoredCount );
+#endif
+      free( TilesRefreshStored );
+      TilesRefreshStored = NULL;
+      TilesRefreshStoredCount = 0;
       TilesRefreshTotalCount = -1;
       TilesRefreshProgressCount = 0;
       roadmap_screen_refresh();
@@ -671,6 +900,15 @@ static void refresh_all_tiles( void )
 
    TilesRefreshTotalCount = roadmap_square_refresh( fips, TM_MAX_QUEUE, NULL );
    roadmap_log( ROADMAP_WARNING, "Going to update %d tiles", TilesRefreshTotalCount );
+
+   free( TilesRefreshStored );
+   TilesRefreshStored = NULL;
+   TilesRefreshStoredCount = 0;
+   if ( TilesRefreshTotalCount > 0 )
+   {
+      TilesRefreshStored = malloc( TilesRefreshTotalCount * sizeof( int ) );
+      roadmap_check_allocated( TilesRefreshStored );
+   }
 }
 /*
  * Tiles refresh interface
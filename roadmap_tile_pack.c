@@ -0,0 +1,528 @@
+/* roadmap_tile_pack.c - Memory mapped packs of uncompressed tiles.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai.
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * SYNOPSYS:
+ *
+ *   See roadmap_tile_pack.h
+ *
+ *   The pack of a fips is mapped once, the first time one of its tiles is
+ *   opened, and the tiles are used in place. A tile which is updated in the
+ *   tile storage after the pack was built is dropped from the index of the
+ *   pack file (its size is set to 0) and is loaded from the storage again.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "zlib/zlib.h"
+
+#include "roadmap.h"
+#include "roadmap_file.h"
+#include "roadmap_path.h"
+#include "roadmap_dbread.h"
+#include "roadmap_tile_storage.h"
+#include "roadmap_tile_pack.h"
+
+#define MAX_TILE_PACKS	4
+
+typedef struct {
+
+	int				fips;
+	int				absent;		/* no valid pack file for this fips */
+	int				obsolete;	/* unmap as soon as the last tile is released */
+	int				users;
+
+	RoadMapFileContext					file;
+	const roadmap_tile_pack_header	*header;
+	const roadmap_tile_pack_entry		*entries;
+	unsigned char							*stale;
+} RoadMapTilePack;
+
+static RoadMapTilePack TilePacks[MAX_TILE_PACKS];
+static int TilePacksCount = 0;
+
+
+static const char *get_pack_filename (int fips, int temp) {
+
+	static char filename[512];
+	char name[64];
+
+	snprintf (name, sizeof (name), "%05d%s%s", fips, ROADMAP_TILE_PACK_SUFFIX,
+				 temp ? ".tmp" : "");
+	roadmap_path_format (filename, sizeof (filename), roadmap_db_map_path (), name);
+
+	return filename;
+}
+
+
+static void pack_unmap (RoadMapTilePack *pack) {
+
+	if (pack->file) {
+		roadmap_file_unmap (&pack->file);
+		pack->file = NULL;
+	}
+
+	free (pack->stale);
+	pack->stale = NULL;
+	pack->header = NULL;
+	pack->entries = NULL;
+	pack->obsolete = 0;
+}
+
+
+static int pack_validate (const unsigned char *base, unsigned int size) {
+
+	const roadmap_tile_pack_header *header = (const roadmap_tile_pack_header *) base;
+	const roadmap_tile_pack_entry *entries = (const roadmap_tile_pack_entry *) (header + 1);
+	unsigned int i;
+
+	if (size < sizeof (roadmap_tile_pack_header)) {
+		roadmap_log (ROADMAP_ERROR, "tile pack: header size %u too small", size);
+		return 0;
+	}
+
+	if (memcmp (header->general_header.signature, ROADMAP_TILE_PACK_SIGNATURE,
+					sizeof (header->general_header.signature)) ||
+		 header->general_header.endianness != ROADMAP_DATA_ENDIAN_CORRECT ||
+		 header->general_header.version != ROADMAP_TILE_PACK_VERSION) {
+		roadmap_log (ROADMAP_ERROR, "tile pack: invalid header");
+		return 0;
+	}
+
+	if ((size - sizeof (roadmap_tile_pack_header)) / sizeof (roadmap_tile_pack_entry) < header->count) {
+		roadmap_log (ROADMAP_ERROR, "tile pack: size %u cannot contain index", size);
+		return 0;
+	}
+
+	for (i = 0; i < header->count; i++) {
+
+		if (entries[i].offset % ROADMAP_TILE_PACK_ALIGN ||
+			 entries[i].offset > size ||
+			 entries[i].size > size - entries[i].offset ||
+			 (i > 0 && entries[i].tile_id <= entries[i - 1].tile_id)) {
+			roadmap_log (ROADMAP_ERROR, "tile pack: invalid entry %u", i);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+
+static void pack_map (RoadMapTilePack *pack) {
+
+	const char *filename = get_pack_filename (pack->fips, 0);
+	unsigned char *base;
+
+	pack->absent = 1;
+
+	if (!roadmap_file_exists (NULL, filename)) return;
+
+	if (roadmap_file_map (NULL, filename, NULL, "r", &pack->file) == NULL) {
+		pack->file = NULL;
+		return;
+	}
+
+	base = (unsigned char *) roadmap_file_base (pack->file);
+
+	if (!pack_validate (base, (unsigned int) roadmap_file_size (pack->file))) {
+		pack_unmap (pack);
+		return;
+	}
+
+	pack->header = (const roadmap_tile_pack_header *) base;
+	pack->entries = (const roadmap_tile_pack_entry *) (pack->header + 1);
+	pack->stale = calloc (pack->header->count + 1, 1);
+	roadmap_check_allocated (pack->stale);
+	pack->absent = 0;
+
+	roadmap_log (ROADMAP_INFO, "tile pack: mapped %u tiles of fips %d",
+					 pack->header->count, pack->fips);
+}
+
+
+static RoadMapTilePack *pack_find (int fips, int create) {
+
+	RoadMapTilePack *pack;
+	int i;
+
+	for (i = 0; i < TilePacksCount; i++) {
+		if (TilePacks[i].fips == fips) return TilePacks + i;
+	}
+
+	if (!create) return NULL;
+
+	if (TilePacksCount < MAX_TILE_PACKS) {
+		pack = TilePacks + TilePacksCount++;
+	} else {
+
+		/* Reuse a pack which has no tile in use */
+		for (i = 0; i < TilePacksCount; i++) {
+			if (!TilePacks[i].users) break;
+		}
+		if (i == TilePacksCount) return NULL;
+
+		pack = TilePacks + i;
+		pack_unmap (pack);
+	}
+
+	memset (pack, 0, sizeof (*pack));
+	pack->fips = fips;
+	pack_map (pack);
+
+	return pack;
+}
+
+
+static int pack_search (const RoadMapTilePack *pack, int tile_index) {
+
+	int low = 0;
+	int high = (int) pack->header->count - 1;
+
+	while (low <= high) {
+
+		int middle = (low + high) / 2;
+		int tile_id = pack->entries[middle].tile_id;
+
+		if (tile_id == tile_index) return middle;
+
+		if (tile_id < tile_index) low = middle + 1;
+		else high = middle - 1;
+	}
+
+	return -1;
+}
+
+
+int roadmap_tile_pack_get (int fips, int tile_index, void **data, size_t *size) {
+
+	RoadMapTilePack *pack = pack_find (fips, 1);
+	int entry;
+
+	if (!pack || pack->absent || pack->obsolete) return -1;
+
+	entry = pack_search (pack, tile_index);
+	if (entry < 0 || pack->stale[entry] || !pack->entries[entry].size) return -1;
+
+	*data = (unsigned char *) pack->header + pack->entries[entry].offset;
+	*size = pack->entries[entry].size;
+	pack->users++;
+
+	return 0;
+}
+
+
+void roadmap_tile_pack_release (int fips) {
+
+	RoadMapTilePack *pack = pack_find (fips, 0);
+
+	if (!pack || !pack->users) {
+		roadmap_log (ROADMAP_ERROR, "tile pack: release of unused pack for fips %d", fips);
+		return;
+	}
+
+	pack->users--;
+
+	if (!pack->users && pack->obsolete) {
+		pack_unmap (pack);
+		pack->fips = -1;
+		pack->absent = 1;
+	}
+}
+
+
+/* Clears the size of the tile in the index of the pack file, so that the
+ * stale copy is not used after a restart either. The mapping is shared, so
+ * a mapped pack sees the change too.
+ */
+static void pack_invalidate_file (int fips, int tile_index) {
+
+	const char *filename = get_pack_filename (fips, 0);
+	roadmap_tile_pack_header header;
+	roadmap_tile_pack_entry entry;
+	RoadMapFile file;
+	int low;
+	int high;
+
+	if (!roadmap_file_exists (NULL, filename)) return;
+
+	file = roadmap_file_open (filename, "rw");
+	if (!ROADMAP_FILE_IS_VALID (file)) {
+		roadmap_log (ROADMAP_ERROR, "tile pack: cannot update %s", filename);
+		return;
+	}
+
+	if (roadmap_file_read (file, &header, sizeof (header)) != sizeof (header) ||
+		 memcmp (header.general_header.signature, ROADMAP_TILE_PACK_SIGNATURE,
+					sizeof (header.general_header.signature))) {
+		roadmap_file_close (file);
+		return;
+	}
+
+	low = 0;
+	high = (int) header.count - 1;
+
+	while (low <= high) {
+
+		int middle = (low + high) / 2;
+		int offset = sizeof (header) + middle * sizeof (roadmap_tile_pack_entry);
+
+		if (roadmap_file_seek (file, offset, ROADMAP_SEEK_START) < 0 ||
+			 roadmap_file_read (file, &entry, sizeof (entry)) != sizeof (entry)) {
+			roadmap_log (ROADMAP_ERROR, "tile pack: cannot read index of %s", filename);
+			break;
+		}
+
+		if (entry.tile_id == tile_index) {
+
+			if (entry.size > 0) {
+				entry.size = 0;
+				if (roadmap_file_seek (file, offset, ROADMAP_SEEK_START) < 0 ||
+					 roadmap_file_write (file, &entry, sizeof (entry)) != sizeof (entry)) {
+					roadmap_log (ROADMAP_ERROR, "tile pack: cannot invalidate tile %d in %s",
+									 tile_index, filename);
+				}
+			}
+			break;
+		}
+
+		if (entry.tile_id < tile_index) low = middle + 1;
+		else high = middle - 1;
+	}
+
+	roadmap_file_close (file);
+}
+
+
+void roadmap_tile_pack_invalidate (int fips, int tile_index) {
+
+	RoadMapTilePack *pack = pack_find (fips, 0);
+	int entry;
+
+	if (pack && !pack->absent) {
+		entry = pack_search (pack, tile_index);
+		if (entry >= 0) pack->stale[entry] = 1;
+	}
+
+	pack_invalidate_file (fips, tile_index);
+}
+
+
+void roadmap_tile_pack_invalidate_all (int fips) {
+
+	RoadMapTilePack *pack = pack_find (fips, 0);
+
+	if (pack) {
+		if (pack->users) {
+			pack->obsolete = 1;
+		} else {
+			pack_unmap (pack);
+			/* Forget the fips so that a rebuilt pack is mapped again */
+			pack->fips = -1;
+			pack->absent = 1;
+		}
+	}
+
+	roadmap_file_remove (NULL, get_pack_filename (fips, 0));
+}
+
+
+static int pack_uncompress (const void *base, size_t size, void **raw_data, unsigned long *raw_size) {
+
+	const roadmap_tile_file_header *tile_header = (const roadmap_tile_file_header *) base;
+	const unsigned char *compressed_data = (const unsigned char *) (tile_header + 1);
+
+	if (size < sizeof (roadmap_tile_file_header) ||
+		 tile_header->compressed_data_size != size - sizeof (roadmap_tile_file_header) ||
+		 tile_header->raw_data_size < sizeof (roadmap_data_header)) {
+		return 0;
+	}
+
+	*raw_size = tile_header->raw_data_size;
+
+#ifdef NO_MAP_COMPRESSION
+	*raw_data = malloc (*raw_size);
+	roadmap_check_allocated (*raw_data);
+	memcpy (*raw_data, compressed_data, *raw_size);
+#else
+	*raw_data = malloc (*raw_size);
+	roadmap_check_allocated (*raw_data);
+
+	if (uncompress (*raw_data, raw_size, compressed_data, tile_header->compressed_data_size) != Z_OK ||
+		 *raw_size != tile_header->raw_data_size) {
+		free (*raw_data);
+		return 0;
+	}
+#endif
+
+	return 1;
+}
+
+
+static int compare_tile_ids (const void *a, const void *b) {
+
+	int id_a = *(const int *) a;
+	int id_b = *(const int *) b;
+
+	return (id_a > id_b) - (id_a < id_b);
+}
+
+
+typedef struct {
+
+	int fips;
+	RoadMapFile file;
+	unsigned int offset;
+	roadmap_tile_pack_entry *entries;
+	int written;
+	int ok;
+} RoadMapTilePackBuild;
+
+static const unsigned char PackPadding[ROADMAP_TILE_PACK_ALIGN] = {0};
+
+
+static void pack_build_tile (int tile_index, const void *data, size_t size, void *context) {
+
+	RoadMapTilePackBuild *build = (RoadMapTilePackBuild *) context;
+	void *raw_data;
+	unsigned long raw_size;
+	unsigned int aligned;
+
+	if (!build->ok) return;
+
+	if (build->written > 0 && build->entries[build->written - 1].tile_id == tile_index) return;
+
+	if (!pack_uncompress (data, size, &raw_data, &raw_size)) {
+		roadmap_log (ROADMAP_WARNING, "tile pack: skipping invalid tile %d (fips %d)", tile_index, build->fips);
+		return;
+	}
+
+	aligned = (build->offset + ROADMAP_TILE_PACK_ALIGN - 1) & ~(ROADMAP_TILE_PACK_ALIGN - 1);
+	if (aligned > build->offset) {
+		build->ok = roadmap_file_write (build->file, PackPadding, aligned - build->offset) ==
+							(int) (aligned - build->offset);
+	}
+
+	build->ok = build->ok &&
+					roadmap_file_write (build->file, raw_data, (int) raw_size) == (int) raw_size;
+	free (raw_data);
+
+	build->entries[build->written].tile_id = tile_index;
+	build->entries[build->written].offset = aligned;
+	build->entries[build->written].size = (unsigned int) raw_size;
+	build->written++;
+
+	build->offset = aligned + raw_size;
+}
+
+
+int roadmap_tile_pack_build (int fips, const int *tiles, int count) {
+
+	char temp_name[512];
+	roadmap_tile_pack_header header;
+	RoadMapTilePackBuild build;
+	int *sorted;
+	unsigned int i;
+
+	if (count <= 0) return 0;
+
+	sorted = malloc (count * sizeof (int));
+	roadmap_check_allocated (sorted);
+	memcpy (sorted, tiles, count * sizeof (int));
+	qsort (sorted, count, sizeof (int), compare_tile_ids);
+
+	memset (&build, 0, sizeof (build));
+	build.fips = fips;
+	build.entries = calloc (count, sizeof (roadmap_tile_pack_entry));
+	roadmap_check_allocated (build.entries);
+
+	strncpy_safe (temp_name, get_pack_filename (fips, 1), sizeof (temp_name));
+	build.file = roadmap_file_open (temp_name, "w");
+	if (!ROADMAP_FILE_IS_VALID (build.file)) {
+		roadmap_log (ROADMAP_ERROR, "tile pack: cannot create %s", temp_name);
+		free (build.entries);
+		free (sorted);
+		return -1;
+	}
+
+	/* The index is written again once the sections are in place */
+	build.ok = 1;
+	build.offset = sizeof (header) + count * sizeof (roadmap_tile_pack_entry);
+	for (i = 0; build.ok && i < build.offset; i += sizeof (PackPadding)) {
+		int length = build.offset - i < sizeof (PackPadding) ? build.offset - i : sizeof (PackPadding);
+		build.ok = roadmap_file_write (build.file, PackPadding, length) == length;
+	}
+
+	/* Tiles arrive in the order of the sorted request, so the index stays sorted */
+	if (build.ok && roadmap_tile_load_batch (fips, sorted, count, pack_build_tile, &build) < 0) {
+		build.ok = 0;
+	}
+
+	memset (&header, 0, sizeof (header));
+	memcpy (header.general_header.signature, ROADMAP_TILE_PACK_SIGNATURE,
+			  sizeof (header.general_header.signature));
+	header.general_header.endianness = ROADMAP_DATA_ENDIAN_CORRECT;
+	header.general_header.version = ROADMAP_TILE_PACK_VERSION;
+	header.count = build.written;
+
+	build.ok = build.ok &&
+		  roadmap_file_seek (build.file, 0, ROADMAP_SEEK_START) == 0 &&
+		  roadmap_file_write (build.file, &header, sizeof (header)) == sizeof (header) &&
+		  roadmap_file_write (build.file, build.entries, build.written * sizeof (roadmap_tile_pack_entry)) ==
+				(int) (build.written * sizeof (roadmap_tile_pack_entry));
+
+	roadmap_file_close (build.file);
+	free (build.entries);
+	free (sorted);
+
+	if (!build.ok) {
+		roadmap_log (ROADMAP_ERROR, "tile pack: failed writing %s", temp_name);
+		roadmap_file_remove (NULL, temp_name);
+		return -1;
+	}
+
+	/* Tiles already open keep the old mapping until they are closed */
+	roadmap_tile_pack_invalidate_all (fips);
+
+	if (roadmap_file_rename (temp_name, get_pack_filename (fips, 0)) != 0) {
+		roadmap_log (ROADMAP_ERROR, "tile pack: cannot rename %s", temp_name);
+		roadmap_file_remove (NULL, temp_name);
+		return -1;
+	}
+
+	roadmap_log (ROADMAP_INFO, "tile pack: built %d tiles for fips %d", build.written, fips);
+
+	return build.written;
+}
+
+
+void roadmap_tile_pack_shutdown (void) {
+
+	int i;
+
+	for (i = 0; i < TilePacksCount; i++) {
+		pack_unmap (TilePacks + i);
+	}
+
+	TilePacksCount = 0;
+}
@@ -0,0 +1,81 @@
+/* roadmap_tile_pack.h - Memory mapped packs of uncompressed tiles.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai.
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef ROADMAP_TILE_PACK_H_
+#define ROADMAP_TILE_PACK_H_
+
+#include <stdlib.h>
+#include "roadmap_data_format.h"
+
+/* A tile pack holds the tiles of one fips already uncompressed, so they can
+ * be used in place from a read only mapping of the file:
+ *
+ *   roadmap_tile_pack_header
+ *   roadmap_tile_pack_entry[count]      sorted by tile_id, size 0 if stale
+ *   raw tile sections                   each aligned to ROADMAP_TILE_PACK_ALIGN
+ *
+ * Every section has the same layout as an uncompressed tile, starting with
+ * its roadmap_data_header.
+ */
+#if !defined (J2ME) && !defined (RIMAPI)
+#define ROADMAP_TILE_PACK
+#endif
+
+#define ROADMAP_TILE_PACK_SIGNATURE			"WTPK"
+#define ROADMAP_TILE_PACK_VERSION			0x1
+#define ROADMAP_TILE_PACK_ALIGN				16
+#define ROADMAP_TILE_PACK_SUFFIX				"_tiles.pack"
+
+typedef struct {
+
+	roadmap_data_file_header	general_header;
+	unsigned int					count;
+} roadmap_tile_pack_header;
+
+typedef struct {
+
+	int				tile_id;
+	unsigned int	offset;
+	unsigned int	size;
+} roadmap_tile_pack_entry;
+
+
+/* Returns the uncompressed tile inside the mapped pack of the fips.
+ * Every successful call must be matched by roadmap_tile_pack_release().
+ */
+int  roadmap_tile_pack_get (int fips, int tile_index, void **data, size_t *size);
+void roadmap_tile_pack_release (int fips);
+
+/* Called by the tile storage when a tile changes, so that the stale copy
+ * in the pack is not used anymore, also after a restart.
+ */
+void roadmap_tile_pack_invalidate (int fips, int tile_index);
+void roadmap_tile_pack_invalidate_all (int fips);
+
+/* Builds the pack of the fips from the given tiles of the tile storage.
+ * The tile manager calls it when a refresh of all the tiles completes.
+ */
+int  roadmap_tile_pack_build (int fips, const int *tiles, int count);
+
+void roadmap_tile_pack_shutdown (void);
+
+#endif /*ROADMAP_TILE_PACK_H_*/
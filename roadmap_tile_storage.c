@@ -32,6 +32,7 @@
 #include "roadmap_file.h"
 #include "roadmap_path.h"
 #include "roadmap_locator.h"
+#include "roadmap_tile_pack.h"
 
 
 typedef enum
@@ -107,6 +108,11 @@ int roadmap_tile_store( int fips, int tile_index, void *data, size_t size )
     char thread_name[RM_THREAD_MAX_THREAD_NAME];
 	const char* full_path = get_tile_filename( fips, tile_index, 0 );
 	TileContext *ctx = NULL;
+
+#ifdef ROADMAP_TILE_PACK
+	roadmap_tile_pack_invalidate( fips, tile_index );
+#endif
+
 	if ( sgAsyncStoreType != _async_store_none )
 	{
 		BOOL separate_thread = ( sgAsyncStoreType == _async_store_separate_thread );
@@ -188,6 +194,10 @@ int roadmap_tile_store_context( TileContext* context )
 
 void roadmap_tile_remove (int fips, int tile_index) {
 
+#ifdef ROADMAP_TILE_PACK
+   roadmap_tile_pack_invalidate (fips, tile_index);
+#endif
+
    roadmap_file_remove(NULL, get_tile_filename(fips, tile_index, 0));
 }
 
@@ -200,6 +210,10 @@ void roadmap_tile_remove_all( int fips )
    roadmap_path_format( path, sizeof (path), map_path, path );
    // Remove the directory
    roadmap_file_rmdir( path, NULL );
+
+#ifdef ROADMAP_TILE_PACK
+   roadmap_tile_pack_invalidate_all( fips );
+#endif
 }
 
 
@@ -235,3 +249,40 @@ int roadmap_tile_load (int fips, int tile_index, void **base, size_t *size) {
 }
 
 
+
+
+int roadmap_tile_load_batch (int fips, const int *tiles, int count,
+                             roadmap_tile_load_cb cb, void *context) {
+
+   int loaded = 0;
+   int i;
+
+   for (i = 0; i < count; i++) {
+
+      void *base;
+      size_t size;
+
+      if (roadmap_tile_load (fips, tiles[i], &base, &size) != 0) continue;
+
+      cb (tiles[i], base, size, context);
+      free (base);
+      loaded++;
+   }
+
+   return loaded;
+}
+
+
+int roadmap_tile_store_batch (int fips, const int *tiles, void **data,
+                              const size_t *sizes, int count) {
+
+   int stored = 0;
+   int i;
+
+   for (i = 0; i < count; i++) {
+
+      if (roadmap_tile_store (fips, tiles[i], data[i], sizes[i]) == 0) stored++;
+   }
+
+   return stored;
+}
@@ -48,4 +48,15 @@ int roadmap_tile_store_context( TileContext* context );
 
 int roadmap_tile_load (int fips, int tile_index, void **data, size_t *size);
 
+/* Batches run in a single transaction. The data passed to the load callback
+ * is only valid during the call, and the callback must not use the storage.
+ */
+typedef void (*roadmap_tile_load_cb) (int tile_index, const void *data, size_t size, void *context);
+
+int roadmap_tile_load_batch (int fips, const int *tiles, int count,
+                             roadmap_tile_load_cb cb, void *context);
+
+int roadmap_tile_store_batch (int fips, const int *tiles, void **data,
+                              const size_t *sizes, int count);
+
 #endif /*ROADMAP_TILE_STORAGE_H_*/
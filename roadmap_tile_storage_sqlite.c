@@ -33,6 +33,8 @@
 #include "roadmap_file.h"
 #include "roadmap_path.h"
 #include "roadmap_main.h"
+#include "roadmap_tile_storage.h"
+#include "roadmap_tile_pack.h"
 
 typedef enum
 {
@@ -53,7 +55,7 @@ typedef enum
 #define   RM_TILE_STORAGE_TILES_TABLE_DATA		"data"
 
 #define   RM_TILE_STORAGE_STMT_CREATE_TABLE		"CREATE TABLE IF NOT EXISTS tiles_table(id INTEGER PRIMARY KEY, data BLOB)"
-#define   RM_TILE_STORAGE_STMT_STORE		    "INSERT OR REPLACE INTO tiles_table values (%d,?);"
+#define   RM_TILE_STORAGE_STMT_STORE		    "INSERT OR REPLACE INTO tiles_table values (?,?);"
 #define   RM_TILE_STORAGE_STMT_LOAD		        "SELECT data FROM tiles_table WHERE id=?;"
 #define   RM_TILE_STORAGE_STMT_REMOVE	        "DELETE FROM tiles_table WHERE id=?;"
 #define   RM_TILE_STORAGE_STMT_SYNC_OFF 		"PRAGMA synchronous = OFF"
@@ -65,16 +67,33 @@ typedef enum
 static int sgCurrentFips	= -1;			// Current fips - used to avoid database
 static BOOL sgTableExists   = FALSE;		// Indicates if the table exits ( in order to avoid unnecessary queries)
 static sqlite3* sgSQLiteDb  = NULL;			// The current db handle
-static RMTileStorageConLifetime sgConLifetime = _con_lifetime_session;		// The type of connection lifetime
+static RMTileStorageConLifetime sgConLifetime = _con_lifetime_application;		// The type of connection lifetime - keeps the cached statements
 
 static BOOL sgIsInTransaction = FALSE;
 static int  sgTransStmtsCount = 0;
 
+typedef enum
+{
+	_stmt_load = 0,
+	_stmt_store,
+	_stmt_remove,
+	_stmt_count
+} RMTileStorageStmt;
+
+static const char* sgStmtStrings[_stmt_count] = {
+	RM_TILE_STORAGE_STMT_LOAD,
+	RM_TILE_STORAGE_STMT_STORE,
+	RM_TILE_STORAGE_STMT_REMOVE
+};
+
+static sqlite3_stmt* sgStmtCache[_stmt_count] = {0};	// Statements prepared on the current db handle
+
 #define check_sqlite_error( errstr, code ) \
 	check_sqlite_error_line( errstr, code, __LINE__ )
 
 static void trans_timeout( void );
 static void trans_commit( void );
+static void close_db( void );
 
 /***********************************************************/
 /*  Name        : roadmap_camera_image_capture()
@@ -156,6 +175,13 @@ static sqlite3* get_db( int fips )
 	char* error_msg;
 	const char* full_path = get_db_file( fips );     //  One time only for the current fips
 
+	if ( fips != sgCurrentFips )
+	{
+		// The handle and its statements belong to the database of another fips
+		close_db();
+		sgTableExists = FALSE;
+	}
+
 	sgCurrentFips = fips;
 
 
@@ -200,6 +226,17 @@ static sqlite3* get_db( int fips )
  */
 static void close_db( void )
 {
+	int i;
+
+	for ( i = 0; i < _stmt_count; ++i )
+	{
+		if ( sgStmtCache[i] )
+		{
+			sqlite3_finalize( sgStmtCache[i] );
+			sgStmtCache[i] = NULL;
+		}
+	}
+
 	if ( sgSQLiteDb )
 	{
 		check_sqlite_error( "Close DB", sqlite3_close( sgSQLiteDb ) );
@@ -218,6 +255,11 @@ static sqlite3*  trans_open( int fips )
 	int ret_val;
 	sqlite3*  db = sgSQLiteDb;
 	roadmap_log( ROADMAP_DEBUG, "Transaction open %d, %d ", sgIsInTransaction, sgTransStmtsCount );
+	if ( sgIsInTransaction && fips != sgCurrentFips )
+	{
+		roadmap_main_remove_periodic( trans_timeout );
+		trans_commit();
+	}
 	if ( sgIsInTransaction )
 	{
 		sgTransStmtsCount++;
@@ -331,6 +373,163 @@ static void trans_timeout( void )
 	}
 }
 
+/***********************************************************/
+/*  Name        : get_stmt()
+ *  Purpose     : Auxiliary function. Returns the cached statement of the given type
+ *                  prepared on the current database handle. The statement is prepared on first use
+ *                  and remains valid until the database is closed
+ *  Params		: [in] db
+ *  			: [in] type - the statement type
+ *				:
+ */
+static sqlite3_stmt* get_stmt( sqlite3* db, RMTileStorageStmt type )
+{
+	int ret_val;
+
+	if ( !sgStmtCache[type] )
+	{
+		ret_val = sqlite3_prepare_v2( db, sgStmtStrings[type], -1, &sgStmtCache[type], NULL );
+		if ( !check_sqlite_error( "preparing the SQLITE statement", ret_val ) )
+		{
+			sgStmtCache[type] = NULL;
+		}
+	}
+
+	return sgStmtCache[type];
+}
+
+/***********************************************************/
+/*  Name        : release_stmt()
+ *  Purpose     : Auxiliary function. Resets the cached statement for the next use
+ *  Params		: [in] stmt
+ *  			:
+ *				:
+ */
+static void release_stmt( sqlite3_stmt* stmt )
+{
+	sqlite3_reset( stmt );
+	sqlite3_clear_bindings( stmt );
+}
+
+/***********************************************************/
+/*  Name        : session_close()
+ *  Purpose     : Auxiliary function. Closes the database if it should not outlive the statement
+ *  Params		:
+ *  			:
+ *				:
+ */
+static void session_close( void )
+{
+	if ( sgConLifetime == _con_lifetime_session && !sgIsInTransaction )
+	{
+		close_db();
+	}
+}
+
+/***********************************************************/
+/*  Name        : batch_open()
+ *  Purpose     : Auxiliary function. Commits the pending transaction and opens a new one
+ *                  which is committed explicitly by the batch (not by the timer)
+ *  Params		: [in] fips
+ *  			:
+ *				:
+ */
+static sqlite3* batch_open( int fips )
+{
+	sqlite3* db;
+
+	if ( sgIsInTransaction )
+	{
+		roadmap_main_remove_periodic( trans_timeout );
+		trans_commit();
+	}
+
+	db = get_db( fips );
+	if ( !db )
+	{
+		roadmap_log( ROADMAP_ERROR, "Begin batch failed - cannot open database" );
+		return NULL;
+	}
+
+	if ( !check_sqlite_error( "Begin batch transaction", sqlite3_exec( db, "BEGIN TRANSACTION;", NULL, NULL, NULL ) ) )
+	{
+		session_close();
+		return NULL;
+	}
+
+	sgIsInTransaction = TRUE;
+	sgTransStmtsCount = 0;
+
+	return db;
+}
+
+/***********************************************************/
+/*  Name        : exec_store()
+ *  Purpose     : Auxiliary function. Executes the store statement for one tile
+ *  Params		: [in] stmt - the cached store statement
+ *  			: [in] tile_index - primary key
+ *  			: [in] data - the pointer to the blob data
+ *  			: [in] size - the size of the blob data block
+ */
+static int exec_store( sqlite3_stmt* stmt, int tile_index, const void *data, size_t size )
+{
+	int ret_val;
+	int res = -1;
+
+	if ( check_sqlite_error( "binding int parameter", sqlite3_bind_int( stmt, 1, tile_index ) ) &&
+		  check_sqlite_error( "binding the blob statement", sqlite3_bind_blob( stmt, 2, data, size, SQLITE_STATIC ) ) )
+	{
+		ret_val = sqlite3_step( stmt );
+		if ( ret_val == SQLITE_DONE )
+		{
+			res = 0;
+		}
+		else
+		{
+			check_sqlite_error( "store evaluation", ret_val );
+		}
+	}
+
+	release_stmt( stmt );
+
+	return res;
+}
+
+/***********************************************************/
+/*  Name        : exec_load()
+ *  Purpose     : Auxiliary function. Executes the load statement for one tile.
+ *                  The returned data belongs to the statement and is valid until release_stmt()
+ *  Params		: [in] stmt - the cached load statement
+ *  			: [in] tile_index - primary key
+ *  			: [out] data - the blob data
+ *  			: [out] size - the size of the blob data block
+ */
+static int exec_load( sqlite3_stmt* stmt, int tile_index, const void **data, size_t *size )
+{
+	int ret_val;
+
+	if ( !check_sqlite_error( "binding int parameter", sqlite3_bind_int( stmt, 1, tile_index ) ) )
+	{
+		return -1;
+	}
+
+	ret_val = sqlite3_step( stmt );
+
+	if ( ret_val == SQLITE_ROW )
+	{
+		*data = sqlite3_column_blob( stmt, 0 );
+		*size = sqlite3_column_bytes( stmt, 0 );
+		return 0;
+	}
+
+	if ( ret_val != SQLITE_DONE )
+	{
+		check_sqlite_error( "select evaluation", ret_val );
+	}
+
+	return -1;
+}
+
 /***********************************************************/
 /*  Name        : roadmap_tile_store()
  *  Purpose     : Interface function. Stores the tile to the database
@@ -342,13 +541,14 @@ static void trans_timeout( void )
  */
 int roadmap_tile_store( int fips, int tile_index, void *data, size_t size )
 {
-	int res = 0;
+	int res;
 	sqlite3* db = NULL;
 	sqlite3_stmt *stmt = NULL;
-	int ret_val;
-	char stmt_string[RM_TILE_STORAGE_QUERY_MAXSIZE];
 
-	// db = get_db( fips );
+#ifdef ROADMAP_TILE_PACK
+	roadmap_tile_pack_invalidate( fips, tile_index );
+#endif
+
 	db = trans_open( fips );
 
 	if ( !db )
@@ -356,47 +556,65 @@ int roadmap_tile_store( int fips, int tile_index, void *data, size_t size )
 		roadmap_log( ROADMAP_ERROR, "Tile storage failed - cannot open database" );
 		return -1;
 	}
-	/*
-	 * Prepare the string
-	 */
-	sprintf( stmt_string, RM_TILE_STORAGE_STMT_STORE, tile_index );
 
-	/*
-	 * Prepare the sqlite statement
-	 */
-	ret_val = sqlite3_prepare( db, stmt_string, -1, &stmt, NULL );
-	if ( !check_sqlite_error( "preparing the SQLITE statement", ret_val ) )
+	stmt = get_stmt( db, _stmt_store );
+	if ( !stmt )
 	{
 		return -1;
 	}
-	/*
-	 * Binding the data
-	 */
-	ret_val = sqlite3_bind_blob( stmt, 1, data, size, NULL );
-	if ( !check_sqlite_error( "binding the blob statement", ret_val ) )
+
+	res = exec_store( stmt, tile_index, data, size );
+
+	session_close();
+
+	return res;
+}
+
+/***********************************************************/
+/*  Name        : roadmap_tile_store_batch()
+ *  Purpose     : Interface function. Stores the tiles to the database in one transaction
+ *  Params		: [in] fips
+ *  			: [in] tiles - primary keys
+ *  			: [in] data - the pointers to the blob data of each tile
+ *  			: [in] sizes - the sizes of the blob data blocks
+ *  			: [in] count - the number of tiles
+ *  Returns     : the number of stored tiles or -1 on failure
+ */
+int roadmap_tile_store_batch( int fips, const int *tiles, void **data, const size_t *sizes, int count )
+{
+	sqlite3* db = NULL;
+	sqlite3_stmt *stmt = NULL;
+	int stored = 0;
+	int i;
+
+	db = batch_open( fips );
+	if ( !db )
 	{
 		return -1;
 	}
-	/*
-	 * Evaluate
-	 */
-	sqlite3_step( stmt );
-	if ( !check_sqlite_error( "finishing", sqlite3_finalize( stmt ) ) )
+
+	stmt = get_stmt( db, _stmt_store );
+	if ( !stmt )
 	{
+		trans_rollback();
 		return -1;
 	}
 
-	/*
-	 * Close the database
-	 */
-	if ( sgConLifetime == _con_lifetime_session && !sgIsInTransaction )
+	for ( i = 0; i < count; ++i )
 	{
-		sqlite3_close( db );
+#ifdef ROADMAP_TILE_PACK
+		roadmap_tile_pack_invalidate( fips, tiles[i] );
+#endif
+		if ( exec_store( stmt, tiles[i], data[i], sizes[i] ) == 0 )
+		{
+			stored++;
+		}
 	}
 
-	return res;
-}
+	trans_commit();
 
+	return stored;
+}
 
 /***********************************************************/
 /*  Name        : roadmap_tile_remove
@@ -412,51 +630,36 @@ void roadmap_tile_remove( int fips, int tile_index )
 	sqlite3_stmt *stmt = NULL;
 	int ret_val;
 
-//	db = get_db( fips );
+#ifdef ROADMAP_TILE_PACK
+	roadmap_tile_pack_invalidate( fips, tile_index );
+#endif
+
 	db = trans_open( fips );
 
 	if ( !db )
 	{
 		roadmap_log( ROADMAP_ERROR, "Tile remove failed - cannot open database" );
-	}
-
-	/*
-	 * Prepare the sqlite statement
-	 */
-	ret_val = sqlite3_prepare( db, RM_TILE_STORAGE_STMT_REMOVE, -1, &stmt, NULL );
-	if ( !check_sqlite_error( "preparing the SQLITE statement", ret_val ) )
-	{
 		return;
 	}
-	/*
-	 * Binding the parameter
-	 */
-	ret_val = sqlite3_bind_int( stmt, 1, tile_index );
-	if ( !check_sqlite_error( "binding int parameter", ret_val ) )
+
+	stmt = get_stmt( db, _stmt_remove );
+	if ( !stmt )
 	{
 		return;
 	}
 
-	/*
-	 * Evaluate
-	 */
-	ret_val = sqlite3_step( stmt );
-	if ( ret_val != SQLITE_DONE )
+	if ( check_sqlite_error( "binding int parameter", sqlite3_bind_int( stmt, 1, tile_index ) ) )
 	{
-		check_sqlite_error( "statement evaluation", ret_val );
+		ret_val = sqlite3_step( stmt );
+		if ( ret_val != SQLITE_DONE )
+		{
+			check_sqlite_error( "statement evaluation", ret_val );
+		}
 	}
 
-	/*
-	 * Finalize
-	 */
-	sqlite3_finalize( stmt );
-	/*
-	 * Close the database
-	 */
-	if ( sgConLifetime == _con_lifetime_session  && !sgIsInTransaction )
-	{
-		sqlite3_close( db );
-	}
+	release_stmt( stmt );
+
+	session_close();
 }
 
 
@@ -503,7 +706,7 @@ int roadmap_tile_load (int fips, int tile_index, void **base, size_t *size)
 	int res = -1;
 	sqlite3* db = NULL;
 	sqlite3_stmt *stmt = NULL;
-	int ret_val;
+	const void* data;
 
 	if ( tile_index == -1 )
 	{
@@ -512,7 +715,6 @@ int roadmap_tile_load (int fips, int tile_index, void **base, size_t *size)
 		return res;
 	}
 
-//	db = get_db( fips );
 	db = trans_open( fips );
 
 	if ( !db )
@@ -521,61 +723,78 @@ int roadmap_tile_load (int fips, int tile_index, void **base, size_t *size)
 		return -1;
 	}
 
-	/*
-	 * Prepare the sqlite statement
-	 */
-	ret_val = sqlite3_prepare( db, RM_TILE_STORAGE_STMT_LOAD, -1, &stmt, NULL );
-	if ( !check_sqlite_error( "preparing the SQLITE statement", ret_val ) )
+	stmt = get_stmt( db, _stmt_load );
+	if ( !stmt )
 	{
 		return -1;
 	}
-	/*
-	 * Binding the parameter
-	 */
-	ret_val = sqlite3_bind_int( stmt, 1, tile_index );
-	if ( !check_sqlite_error( "binding int parameter", ret_val ) )
-	{
-		return -1;
-	}
-
-	/*
-	 * Evaluate
-	 */
-	ret_val = sqlite3_step( stmt );
 
-	if ( ret_val == SQLITE_ROW )
+	if ( exec_load( stmt, tile_index, &data, size ) == 0 )
 	{
-		const void* data;
-		*size = sqlite3_column_bytes( stmt, 0 );
 		*base = malloc( *size );
 		roadmap_check_allocated( *base );
-		data = sqlite3_column_blob( stmt, 0 );
-
 		memcpy( *base, data, *size );
 		res = 0;
 	}
-	else
+
+	release_stmt( stmt );
+
+	session_close();
+
+   return res;
+}
+
+
+/***********************************************************/
+/*  Name        : roadmap_tile_load_batch
+ *  Purpose     : Interface function. Loads the tiles from the database in one transaction.
+ *                 The data passed to the callback is not copied and is valid only
+ *                 during the callback, which must not access the tile storage
+ *  Params		: [in] fips
+ *  			: [in] tiles - primary keys
+ *  			: [in] count - the number of tiles
+ *  			: [in] cb - called for every tile found
+ *  			: [in] context - passed to the callback
+ *  Returns     : the number of loaded tiles or -1 on failure
+ */
+int roadmap_tile_load_batch( int fips, const int *tiles, int count, roadmap_tile_load_cb cb, void *context )
+{
+	sqlite3* db = NULL;
+	sqlite3_stmt *stmt = NULL;
+	const void* data;
+	size_t size;
+	int loaded = 0;
+	int i;
+
+	db = batch_open( fips );
+	if ( !db )
 	{
-		res = -1;
-		if ( ret_val != SQLITE_DONE )
-		{
-			check_sqlite_error( "select evaluation", ret_val );
-		}
+		return -1;
 	}
 
-	/*
-	 * Finalize
-	 */
-	sqlite3_finalize( stmt );
-	/*
-	 * Close the database
-	 */
-	if ( sgConLifetime == _con_lifetime_session && !sgIsInTransaction )
+	stmt = get_stmt( db, _stmt_load );
+	if ( !stmt )
 	{
-		sqlite3_close( db );
+		trans_rollback();
+		return -1;
 	}
 
-   return res;
+	for ( i = 0; i < count; ++i )
+	{
+		if ( tiles[i] == -1 )
+			continue;
+
+		if ( exec_load( stmt, tiles[i], &data, &size ) == 0 )
+		{
+			cb( tiles[i], data, size, context );
+			loaded++;
+		}
+		release_stmt( stmt );
+	}
+
+	trans_commit();
+
+	return loaded;
 }
 
 
@@ -595,21 +814,22 @@ void roadmap_tile_remove_all( int fips )
    // Close gracefully
    if ( sgIsInTransaction )
    {
+      roadmap_main_remove_periodic( trans_timeout );
       trans_rollback();
    }
-   else
-   {
-      close_db();
-   }
+   close_db();
 
 
    // Reset state
    sgTableExists = FALSE;
-   sgSQLiteDb = NULL;
 
 
    // Remove the db file
    roadmap_file_remove( db_path, NULL );
+
+#ifdef ROADMAP_TILE_PACK
+   roadmap_tile_pack_invalidate_all( fips );
+#endif
 }
 
 
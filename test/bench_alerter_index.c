@@ -0,0 +1,589 @@
+/* bench_alerter_index.c - The alerter position index of a sorted provider.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   A provider keeps its alerts in a table of pointers which it sorts in
+ *   place, as RTAlerts_Sort_List() does, and calls
+ *   roadmap_alerter_provider_changed() when the order changed. Alerts come
+ *   in close pairs, so the table order decides which one is alerted. Each
+ *   check must pick the alert a scan of the table in order picks, before
+ *   and after the sort. A sort which does not notify is run last, to show
+ *   that the check notices a stale index.
+ *
+ *   Usage: bench_alerter_index [spots]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "roadmap.h"
+#include "roadmap_config.h"
+#include "roadmap_math.h"
+#include "roadmap_square.h"
+#include "roadmap_line.h"
+#include "roadmap_line_route.h"
+#include "roadmap_street.h"
+#include "roadmap_point.h"
+#include "roadmap_layer.h"
+#include "roadmap_main.h"
+#include "roadmap_sound.h"
+#include "roadmap_lang.h"
+#include "roadmap_messagebox.h"
+#include "roadmap_screen.h"
+#include "roadmap_navigate.h"
+#include "roadmap_tile.h"
+#include "roadmap_alert.h"
+#include "roadmap_alerter.h"
+#include "navigate/navigate_main.h"
+#include "ssd/ssd_widget.h"
+#include "ssd/ssd_dialog.h"
+#include "ssd/ssd_container.h"
+#include "ssd/ssd_bitmap.h"
+#include "ssd/ssd_text.h"
+#include "ssd/ssd_popup.h"
+#include "test_stubs.h"
+
+#define MAX_SPOTS       4000
+#define ALERT_DISTANCE  500      /* meters */
+#define PAIR_OFFSET     300      /* microdegrees between the alerts of a pair */
+#define AREA_SIZE       400000   /* microdegrees */
+#define AREA_LONGITUDE  34700000
+#define AREA_LATITUDE   32000000
+
+typedef struct {
+   int id;
+   RoadMapPosition position;
+   roadmap_alerter_location_info location;
+} TestAlert;
+
+static TestAlert  Alerts[2 * MAX_SPOTS];
+static TestAlert *Table[2 * MAX_SPOTS];
+static int        TableCount;
+
+
+/* --- The alerter environment: every alert is on the route --- */
+
+roadmap_alert_provider RoadmapAlertProvider;
+
+int roadmap_math_distance (const RoadMapPosition *position1, const RoadMapPosition *position2) {
+
+   double x = (position1->longitude - position2->longitude) *
+                 cos (position1->latitude * M_PI / 180000000.0);
+   double y = position1->latitude - position2->latitude;
+
+   return (int)(sqrt (x * x + y * y) * 0.111319);
+}
+
+void roadmap_math_distances (const RoadMapPosition *position, int count,
+                             const int *longitudes, const int *latitudes, int *distances) {
+
+   RoadMapPosition to;
+   int i;
+
+   for (i = 0; i < count; i++) {
+      to.longitude = longitudes[i];
+      to.latitude = latitudes[i];
+      distances[i] = roadmap_math_distance (position, &to);
+   }
+}
+
+int roadmap_math_azymuth (const RoadMapPosition *point1, const RoadMapPosition *point2) {
+
+   return 0;
+}
+
+void roadmap_math_get_context (RoadMapPosition *position, zoom_t *zoom) {
+}
+
+void roadmap_math_set_context (const RoadMapPosition *position, zoom_t zoom) {
+}
+
+int roadmap_math_to_speed_unit (int knots) {
+
+   return knots;
+}
+
+char *roadmap_math_distance_unit (void) {
+
+   return "m";
+}
+
+void roadmap_config_declare (const char *file, RoadMapConfigDescriptor *descriptor,
+                             const char *default_value, int *is_new) {
+}
+
+RoadMapConfigItem *roadmap_config_declare_enumeration (const char *file,
+                                                       RoadMapConfigDescriptor *descriptor,
+                                                       RoadMapCallback callback,
+                                                       const char *enumeration_value, ...) {
+   return NULL;
+}
+
+int roadmap_config_get_integer (RoadMapConfigDescriptor *descriptor) {
+
+   return 0;
+}
+
+int roadmap_config_match (RoadMapConfigDescriptor *descriptor, const char *text) {
+
+   return 1;
+}
+
+int roadmap_square_active (void) {
+
+   return 1;
+}
+
+int roadmap_square_set_current (int square) {
+
+   return 1;
+}
+
+int roadmap_square_version (int square) {
+
+   return 0;
+}
+
+int roadmap_square_find_neighbours (const RoadMapPosition *position, int scale_index, int squares[9]) {
+
+   return 0;
+}
+
+int roadmap_tile_get_id_from_position (int scale, const RoadMapPosition *position) {
+
+   return 1;
+}
+
+int roadmap_layer_all_roads (int *layers, int size) {
+
+   return 0;
+}
+
+void roadmap_line_points (int line, int *from, int *to) {
+
+   *from = *to = 0;
+}
+
+int roadmap_line_route_get_direction (int line, int who) {
+
+   return ROUTE_DIRECTION_ANY;
+}
+
+void roadmap_point_position (int point, RoadMapPosition *position) {
+
+   position->longitude = position->latitude = 0;
+}
+
+int roadmap_street_get_closest (const RoadMapPosition *position, int scale, int *categories,
+                                int categories_count, int max_shapes,
+                                RoadMapNeighbour *neighbours, int max) {
+   return 0;
+}
+
+void roadmap_street_get_properties (int line, RoadMapStreetProperties *properties) {
+}
+
+const char *roadmap_street_get_street_fename (const RoadMapStreetProperties *properties) {
+
+   return "";
+}
+
+int navigate_is_line_on_route (int square_id, int line_id, int from_line, int to_line) {
+
+   return 1;
+}
+
+int roadmap_navigate_get_current (RoadMapGpsPosition *position, PluginLine *line, int *direction) {
+
+   return -1;
+}
+
+const char *roadmap_lang_get (const char *name) {
+
+   return name;
+}
+
+void roadmap_main_set_periodic (int interval, RoadMapCallback callback) {
+}
+
+void roadmap_main_remove_periodic (RoadMapCallback callback) {
+}
+
+int roadmap_sound_play_list (const RoadMapSoundList list) {
+
+   return 0;
+}
+
+void roadmap_messagebox (const char *title, const char *message) {
+}
+
+void roadmap_messagebox_timeout (const char *title, const char *text, int seconds) {
+}
+
+void roadmap_screen_redraw (void) {
+}
+
+int roadmap_screen_refresh (void) {
+
+   return 0;
+}
+
+
+/* --- The alert dialog is never shown here --- */
+
+SsdWidget ssd_bitmap_new (const char *name, const char *bitmap, int flags) {
+
+   return NULL;
+}
+
+void ssd_bitmap_update (SsdWidget widget, const char *bitmap) {
+}
+
+SsdWidget ssd_container_new (const char *name, const char *title, int width, int height, int flags) {
+
+   return NULL;
+}
+
+SsdWidget ssd_dialog_activate (const char *name, void *context) {
+
+   return NULL;
+}
+
+char *ssd_dialog_currently_active_name (void) {
+
+   return NULL;
+}
+
+void ssd_dialog_hide (const char *name, int exit_code) {
+}
+
+BOOL ssd_dialog_is_currently_active (void) {
+
+   return FALSE;
+}
+
+void ssd_dialog_refresh_current_softkeys (void) {
+}
+
+SsdWidget ssd_popup_new (const char *name, const char *title, PFN_ON_DIALOG_CLOSED on_popup_closed,
+                         int width, int height, const RoadMapPosition *position, int flags,
+                         int animation) {
+   return NULL;
+}
+
+SsdWidget ssd_text_new (const char *name, const char *value, int size, int flags) {
+
+   return NULL;
+}
+
+void ssd_text_set_text (SsdWidget this, const char *value) {
+}
+
+void ssd_widget_add (SsdWidget parent, SsdWidget child) {
+}
+
+SsdWidget ssd_widget_get (SsdWidget child, const char *name) {
+
+   return NULL;
+}
+
+void ssd_widget_set_color (SsdWidget w, const char *fg_color, const char *bg_color) {
+}
+
+void ssd_widget_set_left_softkey_callback (SsdWidget widget, SsdSoftKeyCallback callback) {
+}
+
+int ssd_widget_set_left_softkey_text (SsdWidget widget, const char *value) {
+
+   return 0;
+}
+
+void ssd_widget_set_offset (SsdWidget widget, int x, int y) {
+}
+
+void ssd_widget_set_right_softkey_callback (SsdWidget widget, SsdSoftKeyCallback callback) {
+}
+
+int ssd_widget_set_right_softkey_text (SsdWidget widget, const char *value) {
+
+   return 0;
+}
+
+
+/* --- The provider: a table of alerts sorted in place --- */
+
+static int provider_count (void) {
+
+   return TableCount;
+}
+
+static int provider_get_id (int alert) {
+
+   return Table[alert]->id;
+}
+
+static void provider_get_position (int alert, RoadMapPosition *position, int *steering) {
+
+   *position = Table[alert]->position;
+   *steering = 0;
+}
+
+static unsigned int provider_get_speed (int alert) {
+
+   return 0;
+}
+
+static int provider_get_distance (int alert) {
+
+   return ALERT_DISTANCE;
+}
+
+static int provider_is_alertable (int alert) {
+
+   return 1;
+}
+
+static BOOL provider_is_square_dependent (void) {
+
+   return FALSE;
+}
+
+static roadmap_alerter_location_info *provider_get_location_info (int alert) {
+
+   return &Table[alert]->location;
+}
+
+static BOOL provider_distance_check (RoadMapPosition gps_pos) {
+
+   return TRUE;
+}
+
+static int provider_get_priority (void) {
+
+   return ALERTER_PRIORITY_HIGH;
+}
+
+static int provider_check_same_street (int alert) {
+
+   return 0;
+}
+
+static BOOL provider_is_on_route (int alert) {
+
+   return TRUE;
+}
+
+static roadmap_alert_provider SortedProvider = {
+   "sorted",
+   provider_count,
+   provider_get_id,
+   provider_get_position,
+   provider_get_speed,
+   NULL,
+   NULL,
+   NULL,
+   provider_get_distance,
+   NULL,
+   provider_is_alertable,
+   NULL,
+   NULL,
+   NULL,
+   provider_check_same_street,
+   NULL,
+   provider_is_square_dependent,
+   provider_get_location_info,
+   provider_distance_check,
+   provider_get_priority,
+   NULL,
+   NULL,
+   NULL,
+   NULL,
+   NULL,
+   provider_is_on_route,
+   NULL,
+   NULL
+};
+
+
+static RoadMapPosition SortOrigin;
+
+static int compare_proximity (const void *a, const void *b) {
+
+   const TestAlert *alert_a = *(TestAlert * const *)a;
+   const TestAlert *alert_b = *(TestAlert * const *)b;
+
+   return roadmap_math_distance (&SortOrigin, &alert_a->position) -
+          roadmap_math_distance (&SortOrigin, &alert_b->position);
+}
+
+
+/* Sorts the table by the distance from a position, as RTAlerts_Sort_List() */
+static void sort_table (const RoadMapPosition *origin, int notify) {
+
+   static TestAlert *previous_order[2 * MAX_SPOTS];
+
+   memcpy (previous_order, Table, TableCount * sizeof (TestAlert *));
+
+   SortOrigin = *origin;
+   qsort (Table, TableCount, sizeof (TestAlert *), compare_proximity);
+
+   if (notify && memcmp (previous_order, Table, TableCount * sizeof (TestAlert *))) {
+      roadmap_alerter_provider_changed (&SortedProvider);
+   }
+}
+
+
+/* --- The checks --- */
+
+static int random_in (int size) {
+
+   return (int)(((double)rand () / ((double)RAND_MAX + 1.0)) * size);
+}
+
+
+static void build_alerts (int spots) {
+
+   int i;
+
+   for (i = 0; i < 2 * spots; i++) {
+
+      TestAlert *alert = Alerts + i;
+
+      if (i % 2 == 0) {
+         alert->position.longitude = AREA_LONGITUDE + random_in (AREA_SIZE);
+         alert->position.latitude = AREA_LATITUDE + random_in (AREA_SIZE);
+      } else {
+         alert->position.longitude = Alerts[i - 1].position.longitude + PAIR_OFFSET;
+         alert->position.latitude = Alerts[i - 1].position.latitude;
+      }
+
+      alert->id = i + 1;
+      alert->location.square_id = 1;
+      alert->location.line_id = i;
+      alert->location.time_stamp = 0;
+
+      Table[i] = alert;
+   }
+
+   TableCount = 2 * spots;
+   roadmap_alerter_provider_changed (&SortedProvider);
+}
+
+
+/* The alert which a scan of the table in order picks */
+static int expected_alert (const RoadMapPosition *position) {
+
+   int i;
+
+   for (i = 0; i < TableCount; i++) {
+      if (roadmap_math_distance (&Table[i]->position, position) <= ALERT_DISTANCE) {
+         return Table[i]->id;
+      }
+   }
+
+   return -1;
+}
+
+
+/* Checks a position next to each pair, returns the number of wrong alerts */
+static int check_alerts (int spots, double *elapsed) {
+
+   RoadMapGpsPosition gps;
+   PluginLine line = {0, 1, 0, 1, 0};
+   double start;
+   int wrong = 0;
+   int i;
+
+   memset (&gps, 0, sizeof (gps));
+
+   start = test_time_ms ();
+
+   for (i = 0; i < spots; i++) {
+
+      RoadMapPosition position;
+
+      position.longitude = Alerts[2 * i].position.longitude + PAIR_OFFSET / 2;
+      position.latitude = Alerts[2 * i].position.latitude - 1000;
+
+      gps.longitude = position.longitude;
+      gps.latitude = position.latitude;
+
+      roadmap_alerter_check (&gps, &line);
+
+      if (roadmap_alerter_get_active_alert_id () != expected_alert (&position)) wrong++;
+   }
+
+   *elapsed = test_time_ms () - start;
+
+   return wrong;
+}
+
+
+int main (int argc, char **argv) {
+
+   RoadMapPosition origin;
+   double elapsed;
+   int spots = 1000;
+   int wrong;
+
+   if (argc > 1) spots = atoi (argv[1]);
+
+   if (spots <= 0 || spots > MAX_SPOTS) {
+      fprintf (stderr, "Usage: bench_alerter_index [spots]\n");
+      return 1;
+   }
+
+   srand (1);
+
+   roadmap_alerter_register (&SortedProvider);
+   build_alerts (spots);
+
+   printf ("%d alerts in pairs %d m apart\n", 2 * spots,
+           roadmap_math_distance (&Alerts[0].position, &Alerts[1].position));
+
+   wrong = check_alerts (spots, &elapsed);
+   printf ("added     %5d checks  %7.1f us/check  %d wrong\n",
+           spots, elapsed * 1000.0 / spots, wrong);
+   TEST_CHECK (wrong == 0);
+
+   /* Away from the area, so the second alert of a pair often comes first */
+   origin.longitude = AREA_LONGITUDE + AREA_SIZE + AREA_SIZE / 2;
+   origin.latitude = AREA_LATITUDE + AREA_SIZE / 2;
+   sort_table (&origin, 1);
+
+   wrong = check_alerts (spots, &elapsed);
+   printf ("sorted    %5d checks  %7.1f us/check  %d wrong\n",
+           spots, elapsed * 1000.0 / spots, wrong);
+   TEST_CHECK (wrong == 0);
+
+   origin.longitude = AREA_LONGITUDE - AREA_SIZE / 2;
+   sort_table (&origin, 0);
+
+   wrong = check_alerts (spots, &elapsed);
+   printf ("unnotified sort: %d of %d checks wrong\n", wrong, spots);
+   TEST_CHECK (wrong > 0);
+
+   return test_result ("bench_alerter_index");
+}
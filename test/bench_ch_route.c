@@ -0,0 +1,433 @@
+/* bench_ch_route.c - Contraction hierarchy routes over a grid of streets.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   Square 0 holds a grid of two way streets with random costs, and a
+ *   penalty on every turn. The cost of each CH route is checked against a
+ *   plain Dijkstra search over the (line, direction) graph of the grid.
+ *   The costs are then changed, as when traffic arrives, and the routes
+ *   must follow the new costs.
+ *
+ *   The other squares hold a single street, and are all preprocessed, so
+ *   the store holds more squares than its initial table.
+ *
+ *   Usage: bench_ch_route [routes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "roadmap.h"
+#include "roadmap_config.h"
+#include "roadmap_point.h"
+#include "roadmap_line.h"
+#include "roadmap_line_route.h"
+#include "roadmap_street.h"
+#include "roadmap_square.h"
+#include "roadmap_math.h"
+#include "navigate/navigate_cost.h"
+#include "navigate/navigate_ch.h"
+#include "navigate/navigate_queue.h"
+#include "test_stubs.h"
+
+#define MAP_SQUARE      0
+#define STREET_SQUARES  300      /* squares 1..300 hold one street */
+#define STREET_LINES    4
+
+#define GRID_SIZE       16       /* junctions per side */
+#define GRID_POINTS     (GRID_SIZE * GRID_SIZE)
+#define GRID_ROWS       (GRID_SIZE * (GRID_SIZE - 1))   /* east-west lines */
+#define GRID_LINES      (2 * GRID_ROWS)
+
+#define TURN_PENALTY    15
+#define MIN_LINE_COST   10
+
+/* The CH heuristic takes 28 meters per second: at this spacing the
+ * cheapest line still costs no less than the heuristic says.
+ */
+#define GRID_STEP       (28 * MIN_LINE_COST)
+
+static int LineCost[GRID_LINES];
+static int CurrentSquare = MAP_SQUARE;
+static int DataVersion;
+
+
+/* --- The map --- */
+
+int roadmap_square_set_current (int square) {
+
+   CurrentSquare = square;
+   return square >= MAP_SQUARE && square <= STREET_SQUARES;
+}
+
+int roadmap_square_active (void) {
+
+   return CurrentSquare;
+}
+
+int roadmap_square_points_count (int square) {
+
+   return GRID_POINTS;
+}
+
+int roadmap_line_in_square (int square, int cfcc, int *first, int *last) {
+
+   if (cfcc != ROADMAP_ROAD_STREET) return 0;
+
+   *first = 0;
+   *last = square == MAP_SQUARE ? GRID_LINES - 1 : STREET_LINES - 1;
+   return 1;
+}
+
+void roadmap_line_points (int line, int *from, int *to) {
+
+   if (line < GRID_ROWS) {
+      *from = (line / (GRID_SIZE - 1)) * GRID_SIZE + line % (GRID_SIZE - 1);
+      *to = *from + 1;
+   } else {
+      *from = line - GRID_ROWS;
+      *to = *from + GRID_SIZE;
+   }
+}
+
+void roadmap_line_from_point (int line, int *from) {
+
+   int to;
+
+   roadmap_line_points (line, from, &to);
+}
+
+void roadmap_line_to_point (int line, int *to) {
+
+   int from;
+
+   roadmap_line_points (line, &from, to);
+}
+
+int roadmap_line_cfcc (int line_id) {
+
+   return ROADMAP_ROAD_STREET;
+}
+
+void roadmap_point_position (int point, RoadMapPosition *position) {
+
+   position->longitude = (point % GRID_SIZE) * GRID_STEP;
+   position->latitude = (point / GRID_SIZE) * GRID_STEP;
+}
+
+int roadmap_line_route_get_direction (int line, int who) {
+
+   return ROUTE_DIRECTION_ANY;
+}
+
+int roadmap_line_route_get_restrictions (int line, int against_dir) {
+
+   return 0;
+}
+
+int roadmap_street_extend_line_ends
+         (const PluginLine *line, RoadMapPosition *from, RoadMapPosition *to,
+          int flags, RoadMapStreetIterCB cb, void *context) {
+
+   return 0;
+}
+
+int roadmap_math_distance
+        (const RoadMapPosition *position1, const RoadMapPosition *position2) {
+
+   return abs (position1->longitude - position2->longitude) +
+          abs (position1->latitude - position2->latitude);
+}
+
+
+/* --- The costs --- */
+
+static int is_turn (int line, int prev_line) {
+
+   return prev_line >= 0 && (line < GRID_ROWS) != (prev_line < GRID_ROWS);
+}
+
+static int line_cost (int line_id, int is_reversed, int cur_cost,
+                      int prev_line_id, int is_prev_reversed, int node_id) {
+
+   return LineCost[line_id] + (is_turn (line_id, prev_line_id) ? TURN_PENALTY : 0);
+}
+
+NavigateCostFn navigate_cost_get (void) {
+
+   return line_cost;
+}
+
+int navigate_cost_type (void) {
+
+   return COST_FASTEST;
+}
+
+int navigate_cost_use_traffic (void) {
+
+   return 1;
+}
+
+int navigate_cost_avoid_primaries (void) {
+
+   return 0;
+}
+
+int navigate_cost_avoid_trails (void) {
+
+   return 0;
+}
+
+int navigate_cost_prefer_same_street (void) {
+
+   return 0;
+}
+
+int navigate_cost_allow_unknowns (void) {
+
+   return 0;
+}
+
+int navigate_cost_data_version (void) {
+
+   return DataVersion;
+}
+
+RoadMapConfigItem *roadmap_config_declare_enumeration
+        (const char *file, RoadMapConfigDescriptor *descriptor,
+         RoadMapCallback callback, const char *enumeration_value, ...) {
+
+   return NULL;
+}
+
+int roadmap_config_match (RoadMapConfigDescriptor *descriptor, const char *text) {
+
+   return 1;
+}
+
+
+/* --- The reference search --- */
+
+/* The lines which meet at a junction */
+static int junction_lines (int point, int *lines) {
+
+   int x = point % GRID_SIZE;
+   int y = point / GRID_SIZE;
+   int count = 0;
+
+   if (x + 1 < GRID_SIZE) lines[count++] = y * (GRID_SIZE - 1) + x;
+   if (x > 0) lines[count++] = y * (GRID_SIZE - 1) + x - 1;
+   if (y + 1 < GRID_SIZE) lines[count++] = GRID_ROWS + point;
+   if (y > 0) lines[count++] = GRID_ROWS + point - GRID_SIZE;
+
+   return count;
+}
+
+/* The cost of reaching either direction of the goal line, as the route
+ * search prices it: the lines after the start line cost their own cost.
+ */
+static int reference_cost (NavigateQueue *q, int *state_cost,
+                           int start, int reversed, int goal) {
+
+   int i;
+
+   for (i = 0; i < 2 * GRID_LINES; i++) state_cost[i] = INT_MAX;
+
+   navigate_queue_reset (q);
+   state_cost[start * 2 + reversed] = 0;
+   navigate_queue_insert (q, 0, (void *)(long) (start * 2 + reversed));
+
+   while (!navigate_queue_empty (q)) {
+
+      int cost = navigate_queue_min_key (q);
+      int state = (int)(long) navigate_queue_extract_min (q);
+      int line = state / 2;
+      int lines[4];
+      int from;
+      int to;
+      int count;
+
+      if (cost > state_cost[state]) continue;
+      if (line == goal) return cost;
+
+      roadmap_line_points (line, &from, &to);
+      count = junction_lines ((state & 1) ? from : to, lines);
+
+      for (i = 0; i < count; i++) {
+
+         int next_from;
+         int next_to;
+         int next;
+         int next_cost;
+
+         if (lines[i] == line) continue;
+
+         roadmap_line_points (lines[i], &next_from, &next_to);
+         next = lines[i] * 2 + (next_from == ((state & 1) ? from : to) ? 0 : 1);
+         next_cost = cost + line_cost (lines[i], next & 1, cost, line, state & 1, 0);
+
+         if (next_cost < state_cost[next]) {
+            state_cost[next] = next_cost;
+            navigate_queue_insert (q, next_cost, (void *)(long) next);
+         }
+      }
+   }
+
+   return -1;
+}
+
+
+/* --- The benchmark --- */
+
+typedef struct {
+   int start;
+   int reversed;
+   int goal;
+} Route;
+
+static int path_cb (void *context, int square, int line_id, int reversed,
+                    int prev_square, int prev_line_id, int prev_reversed) {
+
+   (*(int *) context)++;
+   return 1;
+}
+
+
+static void random_costs (void) {
+
+   int i;
+
+   for (i = 0; i < GRID_LINES; i++) LineCost[i] = MIN_LINE_COST + rand () % 90;
+}
+
+
+static void run (const char *name, const Route *routes, int count,
+                 NavigateQueue *q, int *state_cost) {
+
+   double start;
+   double elapsed;
+   int wrong = 0;
+   int i;
+
+   start = test_time_ms ();
+   TEST_CHECK (navigate_ch_preprocess (NULL, 0) == 0);
+   i = MAP_SQUARE;
+   TEST_CHECK (navigate_ch_preprocess (&i, 1) == 1);
+   elapsed = test_time_ms () - start;
+
+   printf ("%-8s preprocess %8.1f ms", name, elapsed);
+
+   start = test_time_ms ();
+
+   for (i = 0; i < count; i++) {
+
+      int cost = -1;
+      int goal_reversed;
+      int segments = 0;
+
+      if (navigate_ch_route (MAP_SQUARE, routes[i].start, routes[i].reversed,
+                             MAP_SQUARE, routes[i].goal, path_cb, &segments,
+                             &cost, &goal_reversed) != 0 || segments < 1) {
+         wrong++;
+         continue;
+      }
+
+      if (cost != reference_cost (q, state_cost, routes[i].start, routes[i].reversed,
+                                  routes[i].goal)) {
+         wrong++;
+      }
+   }
+
+   elapsed = test_time_ms () - start;
+
+   printf ("  %d routes %8.1f ms  (with the reference searches)\n", count, elapsed);
+
+   TEST_CHECK (wrong == 0);
+}
+
+
+int main (int argc, char **argv) {
+
+   NavigateQueue *q;
+   Route *routes;
+   int *state_cost;
+   int *squares;
+   int count = 200;
+   int cost;
+   int goal_reversed;
+   int segments = 0;
+   int i;
+
+   if (argc > 1) count = atoi (argv[1]);
+   if (count < 1) {
+      fprintf (stderr, "Usage: %s [routes]\n", argv[0]);
+      return 1;
+   }
+
+   routes = malloc (count * sizeof (Route));
+   state_cost = malloc (2 * GRID_LINES * sizeof (int));
+   squares = malloc (STREET_SQUARES * sizeof (int));
+   roadmap_check_allocated (routes);
+   roadmap_check_allocated (state_cost);
+   roadmap_check_allocated (squares);
+
+   srand (1);
+
+   for (i = 0; i < count; i++) {
+      routes[i].start = rand () % GRID_LINES;
+      routes[i].reversed = rand () % 2;
+      do {
+         routes[i].goal = rand () % GRID_LINES;
+      } while (routes[i].goal == routes[i].start);
+   }
+
+   q = navigate_queue_new (NAVIGATE_QUEUE_HEAP, 1024);
+
+   random_costs ();
+   run ("initial", routes, count, q, state_cost);
+
+   /* New live costs: the shortcuts must be rebuilt */
+   random_costs ();
+   DataVersion++;
+   run ("changed", routes, count, q, state_cost);
+
+   /* More squares than the first block of the store */
+   for (i = 0; i < STREET_SQUARES; i++) squares[i] = i + 1;
+   TEST_CHECK (navigate_ch_preprocess (squares, STREET_SQUARES) == STREET_SQUARES);
+   TEST_CHECK (navigate_ch_preprocess (squares, STREET_SQUARES) == 0);
+
+   TEST_CHECK (navigate_ch_route (STREET_SQUARES, 0, 0, STREET_SQUARES, STREET_LINES - 1,
+                                  path_cb, &segments, &cost, &goal_reversed) == 0);
+   TEST_CHECK (cost == LineCost[1] + LineCost[2] + LineCost[3]);
+   TEST_CHECK (segments == STREET_LINES);
+
+   navigate_ch_clear (-1);
+   navigate_queue_free (q);
+
+   free (routes);
+   free (state_cost);
+   free (squares);
+
+   return test_result ("bench_ch_route");
+}
@@ -0,0 +1,397 @@
+/* bench_gps_path.c - Size and speed of the GPSPath and NodePath commands.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The tracks are made of 1Hz points of a car driving around, split into
+ *   commands of the maximum GPSPath size, as the realtime session sends
+ *   them. Each track is built as 'GPSPath' text and as 'GPSPathZ'. The
+ *   compact commands, and 'NodePathZ' commands of the same tracks, are
+ *   decoded back and checked against the input, as is a path which jumps
+ *   between the extreme coordinates.
+ *
+ *   Usage: bench_gps_path [tracks]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "editor/db/editor_point.h"
+#include "Realtime/RealtimePath.h"
+#include "test_stubs.h"
+
+#define TRACK_POINTS    RTTRK_GPSPATH_MAX_POINTS
+#define NODE_COUNT      RTTRK_NODEPATH_MAX_POINTS
+
+#define PACKET_SIZE     (TRACK_POINTS * 64 + 64)
+#define DATA_SIZE       (RTNET_COMPACT_PATH_POINT_MAXSIZE * (TRACK_POINTS + 1))
+
+
+/* --- The text formatting of RealtimeNet.c --- */
+
+void format_RoadMapPosition_string (char *buffer, const RoadMapPosition *position) {
+
+   int values[2];
+   int i;
+
+   values[0] = position->longitude;
+   values[1] = position->latitude;
+
+   for (i = 0; i < 2; i++) {
+
+      int value = values[i] < 0 ? -values[i] : values[i];
+
+      if (i) *buffer++ = ',';
+
+      if (!values[i]) {
+         buffer += sprintf (buffer, "0");
+      } else {
+         buffer += sprintf (buffer, "%s%d.%06d",
+                            values[i] < 0 ? "-" : "", value / 1000000, value % 1000000);
+      }
+   }
+}
+
+
+/* --- Decoding of the compact commands --- */
+
+static const unsigned char *get_varint (const unsigned char *p, const unsigned char *end,
+                                        unsigned int *value) {
+
+   int shift = 0;
+
+   *value = 0;
+
+   while (p < end && shift < 35) {
+
+      *value |= (unsigned int)(*p & 0x7f) << shift;
+      if (!(*p++ & 0x80)) return p;
+      shift += 7;
+   }
+
+   return NULL;
+}
+
+static int get_zigzag (const unsigned char **p, const unsigned char *end) {
+
+   unsigned int value = 0;
+
+   if (*p) *p = get_varint (*p, end, &value);
+
+   return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+static int base64_value (char c) {
+
+   if (c >= 'A' && c <= 'Z') return c - 'A';
+   if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+   if (c >= '0' && c <= '9') return c - '0' + 52;
+   if (c == '+') return 62;
+   if (c == '/') return 63;
+
+   return -1;
+}
+
+/* Splits '<command>,<time>,<count>,<base64>\n' and decodes the data */
+static int decode_command (const char *text, const char *command,
+                           unsigned int *time_offset, int *count,
+                           unsigned char *data, int max_size) {
+
+   char name[16];
+   int offset;
+   int size = 0;
+   int bits = 0;
+   unsigned int buffer = 0;
+   const char *p;
+
+   if (sscanf (text, "%15[^,],%u,%d,%n", name, time_offset, count, &offset) != 3 ||
+       strcmp (name, command)) {
+      return -1;
+   }
+
+   for (p = text + offset; *p && *p != '\n' && *p != '='; p++) {
+
+      int value = base64_value (*p);
+
+      if (value < 0) return -1;
+
+      buffer = (buffer << 6) | value;
+      bits += 6;
+
+      if (bits >= 8) {
+         bits -= 8;
+         if (size >= max_size) return -1;
+         data[size++] = (unsigned char)(buffer >> bits);
+      }
+   }
+
+   return size;
+}
+
+static int check_gps_path (const char *text, const GPSPointInTime *points, int count) {
+
+   unsigned char data[DATA_SIZE];
+   const unsigned char *p = data;
+   const unsigned char *end;
+   unsigned int time_offset;
+   RoadMapPosition position = {0, 0};
+   int altitude = 0;
+   time_t gps_time;
+   int decoded_count;
+   int size;
+   int i;
+
+   size = decode_command (text, "GPSPathZ", &time_offset, &decoded_count, data, sizeof (data));
+   if (size < 0 || decoded_count != count || time_offset != (unsigned int) points->GPS_time) {
+      return 0;
+   }
+
+   end = data + size;
+   gps_time = time_offset;
+
+   for (i = 0; i < count; i++) {
+
+      position.longitude += get_zigzag (&p, end);
+      position.latitude += get_zigzag (&p, end);
+      altitude += get_zigzag (&p, end);
+      gps_time += get_zigzag (&p, end);
+
+      if (!p ||
+          position.longitude != points[i].Position.longitude ||
+          position.latitude != points[i].Position.latitude ||
+          altitude != points[i].altitude ||
+          gps_time != points[i].GPS_time) {
+         return 0;
+      }
+   }
+
+   return p == end;
+}
+
+static int check_node_path (const char *text, time_t period_begin,
+                            const NodeInTime *nodes, const UserPointsVer *user_points,
+                            int count) {
+
+   unsigned char data[DATA_SIZE];
+   const unsigned char *p = data;
+   const unsigned char *end;
+   unsigned int time_offset;
+   unsigned int type;
+   int node = 0;
+   int version = 0;
+   time_t gps_time = 0;
+   int decoded_count;
+   int size;
+   int i;
+
+   size = decode_command (text, "NodePathZ", &time_offset, &decoded_count, data, sizeof (data));
+   if (size < 0 || decoded_count != count || time_offset != (unsigned int) period_begin) {
+      return 0;
+   }
+
+   end = data + size;
+   gps_time = nodes->GPS_time;
+
+   for (i = 0; i < count; i++) {
+
+      node += get_zigzag (&p, end);
+      gps_time += get_zigzag (&p, end);
+
+      if (!p || node != nodes[i].node || gps_time != nodes[i].GPS_time) return 0;
+   }
+
+   if (!p || !(p = get_varint (p, end, &type)) || type != EDITOR_POINT_TYPE_MUNCHING) return 0;
+
+   for (i = 0; i < count; i++) {
+
+      if (get_zigzag (&p, end) != user_points[i].points) return 0;
+
+      version += get_zigzag (&p, end);
+      if (!p || version != user_points[i].version) return 0;
+   }
+
+   return p == end;
+}
+
+
+/* --- The benchmark --- */
+
+static GPSPointInTime *Tracks;
+static NodeInTime *Nodes;
+static UserPointsVer *UserPoints;
+
+
+static void build_tracks (int tracks) {
+
+   int heading_lon = 0;
+   int heading_lat = 0;
+   int i;
+
+   Tracks = malloc (tracks * TRACK_POINTS * sizeof (GPSPointInTime));
+   Nodes = malloc (tracks * NODE_COUNT * sizeof (NodeInTime));
+   UserPoints = malloc (tracks * NODE_COUNT * sizeof (UserPointsVer));
+   roadmap_check_allocated (Tracks);
+   roadmap_check_allocated (Nodes);
+   roadmap_check_allocated (UserPoints);
+
+   for (i = 0; i < tracks * TRACK_POINTS; i++) {
+
+      GPSPointInTime *point = Tracks + i;
+
+      if (i == 0) {
+         point->Position.longitude = 34780000;
+         point->Position.latitude = 32080000;
+         point->altitude = 40;
+         point->GPS_time = 1250000000;
+         continue;
+      }
+
+      /* About 50 km/h, turning now and then */
+      if (rand () % 20 == 0) {
+         heading_lon = rand () % 301 - 150;
+         heading_lat = rand () % 301 - 150;
+      }
+
+      point->Position.longitude = point[-1].Position.longitude + heading_lon + rand () % 11 - 5;
+      point->Position.latitude = point[-1].Position.latitude + heading_lat + rand () % 11 - 5;
+      point->altitude = point[-1].altitude + rand () % 3 - 1;
+      point->GPS_time = point[-1].GPS_time + (rand () % 10 ? 1 : 2);
+   }
+
+   for (i = 0; i < tracks * NODE_COUNT; i++) {
+
+      Nodes[i].node = i ? Nodes[i - 1].node + rand () % 2001 - 1000 : 5000000;
+      Nodes[i].GPS_time = i ? Nodes[i - 1].GPS_time + rand () % 30 : 1250000000;
+      UserPoints[i].points = rand () % 4 ? 0 : rand () % 10;
+      UserPoints[i].version = i ? UserPoints[i - 1].version + rand () % 2 : 100;
+   }
+}
+
+
+static void check_extremes (char *packet, unsigned char *data) {
+
+   static const int longitudes[] = {180000000, -180000000, 0, 180000000, -999999, 1};
+   static const int latitudes[] = {90000000, -90000000, 90000000, 0, 1, -90000000};
+   static const int altitudes[] = {-10000, 100000, 0, -10000, 1, 0};
+   GPSPointInTime points[6];
+   NodeInTime nodes[3];
+   UserPointsVer user_points[3];
+   int i;
+
+   for (i = 0; i < 6; i++) {
+      points[i].Position.longitude = longitudes[i];
+      points[i].Position.latitude = latitudes[i];
+      points[i].altitude = altitudes[i];
+      points[i].GPS_time = i ? points[i - 1].GPS_time + i * 100000 : 0x7fff0000;
+   }
+
+   RTNet_GPSPath_BuildCompactCommand (packet, data, points, 6, FALSE);
+   TEST_CHECK (check_gps_path (packet, points, 6));
+
+   nodes[0].node = 0x7fffffff;
+   nodes[1].node = 0;
+   nodes[2].node = 0x3fffffff;
+   for (i = 0; i < 3; i++) {
+      nodes[i].GPS_time = 1250000000 + i * 1000;
+      user_points[i].points = 0x7fffffff - i;
+      user_points[i].version = -i * 0x3fffffff;
+   }
+
+   RTNet_NodePath_BuildCompactCommand (packet, data, 1250000000, nodes, 3, user_points, TRUE);
+   TEST_CHECK (check_node_path (packet, 1250000000, nodes, user_points, 3));
+}
+
+
+static void report (const char *name, double elapsed, long long bytes, int points) {
+
+   printf ("%-10s %7.1f bytes/point  %6.1f ns/point\n",
+           name, (double) bytes / points, elapsed * 1000000.0 / points);
+}
+
+
+int main (int argc, char **argv) {
+
+   static char packet[PACKET_SIZE];
+   static unsigned char data[DATA_SIZE];
+   int tracks = 2000;
+   long long bytes;
+   double start;
+   int i;
+
+   if (argc > 1) tracks = atoi (argv[1]);
+   if (tracks < 1) {
+      fprintf (stderr, "Usage: %s [tracks]\n", argv[0]);
+      return 1;
+   }
+
+   srand (1);
+   build_tracks (tracks);
+
+   printf ("%d tracks of %d points\n", tracks, TRACK_POINTS);
+
+   bytes = 0;
+   start = test_time_ms ();
+   for (i = 0; i < tracks; i++) {
+      bytes += RTNet_GPSPath_BuildCommand (packet, Tracks + i * TRACK_POINTS, TRACK_POINTS, FALSE)
+                  - packet;
+   }
+   report ("GPSPath", test_time_ms () - start, bytes, tracks * TRACK_POINTS);
+
+   bytes = 0;
+   start = test_time_ms ();
+   for (i = 0; i < tracks; i++) {
+      bytes += RTNet_GPSPath_BuildCompactCommand (packet, data, Tracks + i * TRACK_POINTS,
+                                                  TRACK_POINTS, FALSE) - packet;
+   }
+   report ("GPSPathZ", test_time_ms () - start, bytes, tracks * TRACK_POINTS);
+
+   for (i = 0; i < tracks; i++) {
+
+      GPSPointInTime *track = Tracks + i * TRACK_POINTS;
+      NodeInTime *nodes = Nodes + i * NODE_COUNT;
+      UserPointsVer *user_points = UserPoints + i * NODE_COUNT;
+
+      RTNet_GPSPath_BuildCompactCommand (packet, data, track, TRACK_POINTS, FALSE);
+      if (!check_gps_path (packet, track, TRACK_POINTS)) {
+         TEST_CHECK (check_gps_path (packet, track, TRACK_POINTS));
+         break;
+      }
+
+      RTNet_NodePath_BuildCompactCommand (packet, data, nodes->GPS_time - 10,
+                                          nodes, NODE_COUNT, user_points, TRUE);
+      if (!check_node_path (packet, nodes->GPS_time - 10, nodes, user_points, NODE_COUNT)) {
+         TEST_CHECK (check_node_path (packet, nodes->GPS_time - 10, nodes, user_points,
+                                      NODE_COUNT));
+         break;
+      }
+   }
+
+   check_extremes (packet, data);
+
+   free (Tracks);
+   free (Nodes);
+   free (UserPoints);
+
+   return test_result ("bench_gps_path");
+}
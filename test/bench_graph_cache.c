@@ -0,0 +1,267 @@
+/* bench_graph_cache.c - Cost of a successor expansion in navigate_graph.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   Every square of the map is the same grid of streets, so a square graph
+ *   can be checked against the grid. As in a route search, the expansions
+ *   jump between the squares of a frontier, which moves on to neighbouring
+ *   squares. The search area is either small enough to stay in the square
+ *   graph cache, or so wide that the cache keeps evicting. Once the cache
+ *   is full, a square which was used again must outlive the others.
+ *
+ *   Usage: bench_graph_cache [expansions]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "roadmap.h"
+#include "roadmap_line.h"
+#include "roadmap_line_route.h"
+#include "roadmap_street.h"
+#include "roadmap_square.h"
+#include "navigate/navigate_graph.h"
+#include "navigate/navigate_ch.h"
+#include "test_stubs.h"
+
+#define GRID_SIZE       16       /* junctions per square side */
+#define GRID_POINTS     (GRID_SIZE * GRID_SIZE)
+#define GRID_ROWS       (GRID_SIZE * (GRID_SIZE - 1))   /* east-west lines */
+#define GRID_LINES      (2 * GRID_ROWS)
+
+#define FRONTIER_SIZE   12       /* squares the expansions jump between */
+#define FRONTIER_STAY   20       /* expansions before the frontier moves */
+
+static int CurrentSquare = -1;
+
+
+/* --- The map: the same grid of streets in every square --- */
+
+int roadmap_square_set_current (int square) {
+
+   CurrentSquare = square;
+   return 1;
+}
+
+int roadmap_square_active (void) {
+
+   return CurrentSquare;
+}
+
+int roadmap_square_points_count (int square) {
+
+   return GRID_POINTS;
+}
+
+int roadmap_line_in_square (int square, int cfcc, int *first, int *last) {
+
+   if (cfcc != ROADMAP_ROAD_STREET) return 0;
+
+   *first = 0;
+   *last = GRID_LINES - 1;
+   return 1;
+}
+
+void roadmap_line_points (int line, int *from, int *to) {
+
+   if (line < GRID_ROWS) {
+      *from = (line / (GRID_SIZE - 1)) * GRID_SIZE + line % (GRID_SIZE - 1);
+      *to = *from + 1;
+   } else {
+      *from = line - GRID_ROWS;
+      *to = *from + GRID_SIZE;
+   }
+}
+
+void roadmap_line_from_point (int line, int *from) {
+
+   int to;
+
+   roadmap_line_points (line, from, &to);
+}
+
+void roadmap_line_to_point (int line, int *to) {
+
+   int from;
+
+   roadmap_line_points (line, &from, to);
+}
+
+int roadmap_line_route_get_direction (int line, int who) {
+
+   return ROUTE_DIRECTION_ANY;
+}
+
+int roadmap_line_route_get_restrictions (int line, int against_dir) {
+
+   return 0;
+}
+
+int roadmap_street_extend_line_ends
+         (const PluginLine *line, RoadMapPosition *from, RoadMapPosition *to,
+          int flags, RoadMapStreetIterCB cb, void *context) {
+
+   return 0;
+}
+
+void navigate_ch_clear (int square) {
+}
+
+
+/* --- The benchmark --- */
+
+static int grid_degree (int point) {
+
+   int x = point % GRID_SIZE;
+   int y = point / GRID_SIZE;
+
+   return 4 - (x == 0) - (x == GRID_SIZE - 1) - (y == 0) - (y == GRID_SIZE - 1);
+}
+
+
+static void run (const char *name, int area, int expansions) {
+
+   struct successor successors[8];
+   NavigateGraphStats before;
+   NavigateGraphStats after;
+   int frontier[FRONTIER_SIZE];
+   int square_x = area / 2;
+   int square_y = area / 2;
+   double start;
+   double elapsed;
+   int i;
+
+   for (i = 0; i < FRONTIER_SIZE; i++) frontier[i] = square_y * area + square_x;
+
+   navigate_graph_clear (-1);
+   navigate_graph_get_stats (&before);
+
+   start = test_time_ms ();
+
+   for (i = 0; i < expansions; i++) {
+
+      int point = rand () % GRID_POINTS;
+      int count;
+
+      if (i % FRONTIER_STAY == 0) {
+         switch (rand () % 4) {
+            case 0: if (square_x + 1 < area) square_x++; break;
+            case 1: if (square_x > 0) square_x--; break;
+            case 2: if (square_y + 1 < area) square_y++; break;
+            default: if (square_y > 0) square_y--; break;
+         }
+         frontier[(i / FRONTIER_STAY) % FRONTIER_SIZE] = square_y * area + square_x;
+      }
+
+      count = get_connected_segments (frontier[rand () % FRONTIER_SIZE], -1, 0, point,
+                                      successors, 8, 1, 1);
+      if (count != grid_degree (point)) {
+         TEST_CHECK (count == grid_degree (point));
+         break;
+      }
+   }
+
+   elapsed = test_time_ms () - start;
+
+   navigate_graph_get_stats (&after);
+
+   printf ("%-6s %3dx%-3d squares %6.1f ns/expansion  hits %d misses %d evictions %d"
+           "  (%d squares, %d bytes cached)\n",
+           name, area, area, elapsed * 1000000.0 / expansions,
+           after.hits - before.hits, after.misses - before.misses,
+           after.evictions - before.evictions, after.squares, after.mem_size);
+}
+
+
+static int lookup (int square) {
+
+   struct successor successors[8];
+
+   return get_connected_segments (square, -1, 0, 0, successors, 8, 1, 1);
+}
+
+
+/* Fills the cache, uses the first square again and adds one more square:
+ * the second square is evicted, not the first.
+ */
+static void check_recency (void) {
+
+   NavigateGraphStats stats;
+   int squares;
+   int misses;
+   int i;
+
+   navigate_graph_clear (-1);
+
+   for (i = 0; ; i++) {
+      navigate_graph_get_stats (&stats);
+      if (i > 0 && stats.squares < i) break;
+      lookup (i);
+   }
+   squares = stats.squares;
+
+   /* Start again with a full cache */
+   navigate_graph_clear (-1);
+   for (i = 0; i < squares; i++) lookup (i);
+
+   navigate_graph_get_stats (&stats);
+   misses = stats.misses;
+
+   lookup (0);
+   lookup (squares);
+
+   navigate_graph_get_stats (&stats);
+   TEST_CHECK (stats.misses == misses + 1);
+   TEST_CHECK (stats.squares == squares);
+
+   lookup (0);
+   navigate_graph_get_stats (&stats);
+   TEST_CHECK (stats.misses == misses + 1);
+
+   lookup (1);
+   navigate_graph_get_stats (&stats);
+   TEST_CHECK (stats.misses == misses + 2);
+
+   printf ("recency %d squares cached\n", squares);
+}
+
+
+int main (int argc, char **argv) {
+
+   int expansions = 2000000;
+
+   if (argc > 1) expansions = atoi (argv[1]);
+   if (expansions < 1) {
+      fprintf (stderr, "Usage: %s [expansions]\n", argv[0]);
+      return 1;
+   }
+
+   srand (1);
+
+   run ("local", 8, expansions);
+   run ("wide", 40, expansions);
+
+   check_recency ();
+
+   return test_result ("bench_graph_cache");
+}
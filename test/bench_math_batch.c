@@ -0,0 +1,289 @@
+/* bench_math_batch.c - Batch coordinate kernels against the single point ones.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The points are shapes made of short random steps, as the shapes of a
+ *   tile, spread over an area a few times larger than the screen. Like
+ *   the screen drawing code, each kernel gets the shape points 64 at a
+ *   time. The results must be the same as the single point functions.
+ *
+ *   Usage: bench_math_batch [shapes [rounds]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_gui.h"
+#include "roadmap_math.h"
+#include "roadmap_config.h"
+#include "roadmap_state.h"
+#include "roadmap_bar.h"
+#include "roadmap_screen.h"
+#include "roadmap_shape.h"
+#include "roadmap_square.h"
+#include "test_stubs.h"
+
+#define SHAPE_POINTS    64
+#define BATCH_SIZE      64
+
+#define SCREEN_WIDTH    800
+#define SCREEN_HEIGHT   480
+#define SCREEN_ZOOM     20
+
+
+/* --- The services roadmap_math uses --- */
+
+int roadmap_bar_top_height () {
+
+   return 0;
+}
+
+int roadmap_bar_bottom_height () {
+
+   return 0;
+}
+
+void roadmap_config_declare
+        (const char *file,
+         RoadMapConfigDescriptor *descriptor, const char *default_value,
+         int *is_new) {
+}
+
+int roadmap_config_get_integer (RoadMapConfigDescriptor *descriptor) {
+
+   return 100;
+}
+
+void roadmap_config_set_integer (RoadMapConfigDescriptor *descriptor, int x) {
+}
+
+void roadmap_state_add (const char *name, RoadMapStateFn state_fn) {
+}
+
+int roadmap_screen_fast_refresh (void) {
+
+   return 0;
+}
+
+int roadmap_screen_is_hd_screen (void) {
+
+   return 0;
+}
+
+int roadmap_screen_get_screen_scale (void) {
+
+   return 100;
+}
+
+void roadmap_shape_get_position (int shape, RoadMapPosition *position) {
+
+   position->longitude = 0;
+   position->latitude = 0;
+}
+
+void roadmap_square_adjust_scale (int zoom_factor) {
+}
+
+int roadmap_square_scale (int square) {
+
+   return 0;
+}
+
+int roadmap_square_at_current_scale (int square) {
+
+   return 1;
+}
+
+
+/* --- The benchmark --- */
+
+static int PointCount;
+static int *Longitudes;
+static int *Latitudes;
+
+static RoadMapGuiPoint *Points;
+static RoadMapGuiPoint *BatchPoints;
+static unsigned char *Visible;
+static unsigned char *BatchVisible;
+static int *Distances;
+static int *BatchDistances;
+
+
+static void build_shapes (int shapes, const RoadMapPosition *center, int spread) {
+
+   int i;
+
+   PointCount = shapes * SHAPE_POINTS;
+
+   Longitudes = malloc (PointCount * sizeof (int));
+   Latitudes = malloc (PointCount * sizeof (int));
+   Points = malloc (PointCount * sizeof (RoadMapGuiPoint));
+   BatchPoints = malloc (PointCount * sizeof (RoadMapGuiPoint));
+   Visible = malloc (PointCount);
+   BatchVisible = malloc (PointCount);
+   Distances = malloc (PointCount * sizeof (int));
+   BatchDistances = malloc (PointCount * sizeof (int));
+   roadmap_check_allocated (Longitudes);
+   roadmap_check_allocated (Latitudes);
+   roadmap_check_allocated (Points);
+   roadmap_check_allocated (BatchPoints);
+   roadmap_check_allocated (Visible);
+   roadmap_check_allocated (BatchVisible);
+   roadmap_check_allocated (Distances);
+   roadmap_check_allocated (BatchDistances);
+
+   for (i = 0; i < PointCount; i++) {
+
+      if (i % SHAPE_POINTS == 0) {
+         Longitudes[i] = center->longitude - spread + rand () % (2 * spread);
+         Latitudes[i] = center->latitude - spread + rand () % (2 * spread);
+      } else {
+         Longitudes[i] = Longitudes[i - 1] - 100 + rand () % 201;
+         Latitudes[i] = Latitudes[i - 1] - 100 + rand () % 201;
+      }
+   }
+}
+
+
+static void report (const char *name, double scalar, double batch, long long points) {
+
+   printf ("%-11s scalar %6.2f ns/point  batch %6.2f ns/point  (x%.1f)\n",
+           name, scalar * 1000000.0 / points, batch * 1000000.0 / points,
+           batch > 0 ? scalar / batch : 0.0);
+}
+
+
+int main (int argc, char **argv) {
+
+   RoadMapPosition center;
+   RoadMapPosition position;
+   int shapes = 2000;
+   int rounds = 50;
+   long long points;
+   double start;
+   double scalar;
+   double batch;
+   int round;
+   int i;
+
+   if (argc > 1) shapes = atoi (argv[1]);
+   if (argc > 2) rounds = atoi (argv[2]);
+   if (shapes < 1 || rounds < 1) {
+      fprintf (stderr, "Usage: %s [shapes [rounds]]\n", argv[0]);
+      return 1;
+   }
+
+   center.longitude = 34780000;
+   center.latitude = 32080000;
+
+   roadmap_math_initialize ();
+   roadmap_math_set_size (SCREEN_WIDTH, SCREEN_HEIGHT);
+   roadmap_math_set_context (&center, SCREEN_ZOOM);
+
+   srand (1);
+   build_shapes (shapes, &center, SCREEN_WIDTH * SCREEN_ZOOM * 2);
+
+   points = (long long) PointCount * rounds;
+
+   printf ("%d shapes of %d points, batches of %d\n", shapes, SHAPE_POINTS, BATCH_SIZE);
+
+   /* Screen coordinates */
+   start = test_time_ms ();
+   for (round = 0; round < rounds; round++) {
+      for (i = 0; i < PointCount; i++) {
+         position.longitude = Longitudes[i];
+         position.latitude = Latitudes[i];
+         roadmap_math_coordinate (&position, Points + i);
+      }
+   }
+   scalar = test_time_ms () - start;
+
+   start = test_time_ms ();
+   for (round = 0; round < rounds; round++) {
+      for (i = 0; i < PointCount; i += BATCH_SIZE) {
+         roadmap_math_coordinates (BATCH_SIZE, Longitudes + i, Latitudes + i, BatchPoints + i);
+      }
+   }
+   batch = test_time_ms () - start;
+
+   report ("coordinate", scalar, batch, points);
+   TEST_CHECK (!memcmp (Points, BatchPoints, PointCount * sizeof (RoadMapGuiPoint)));
+
+   /* Visibility */
+   start = test_time_ms ();
+   for (round = 0; round < rounds; round++) {
+      for (i = 0; i < PointCount; i++) {
+         position.longitude = Longitudes[i];
+         position.latitude = Latitudes[i];
+         Visible[i] = (unsigned char) roadmap_math_point_is_visible (&position);
+      }
+   }
+   scalar = test_time_ms () - start;
+
+   start = test_time_ms ();
+   for (round = 0; round < rounds; round++) {
+      for (i = 0; i < PointCount; i += BATCH_SIZE) {
+         roadmap_math_points_visible (BATCH_SIZE, Longitudes + i, Latitudes + i, BatchVisible + i);
+      }
+   }
+   batch = test_time_ms () - start;
+
+   report ("visible", scalar, batch, points);
+   TEST_CHECK (!memcmp (Visible, BatchVisible, PointCount));
+
+   /* Distance from the center */
+   start = test_time_ms ();
+   for (round = 0; round < rounds; round++) {
+      for (i = 0; i < PointCount; i++) {
+         position.longitude = Longitudes[i];
+         position.latitude = Latitudes[i];
+         Distances[i] = roadmap_math_distance (&center, &position);
+      }
+   }
+   scalar = test_time_ms () - start;
+
+   start = test_time_ms ();
+   for (round = 0; round < rounds; round++) {
+      for (i = 0; i < PointCount; i += BATCH_SIZE) {
+         roadmap_math_distances (&center, BATCH_SIZE, Longitudes + i, Latitudes + i,
+                                 BatchDistances + i);
+      }
+   }
+   batch = test_time_ms () - start;
+
+   report ("distance", scalar, batch, points);
+   TEST_CHECK (!memcmp (Distances, BatchDistances, PointCount * sizeof (int)));
+
+   free (Longitudes);
+   free (Latitudes);
+   free (Points);
+   free (BatchPoints);
+   free (Visible);
+   free (BatchVisible);
+   free (Distances);
+   free (BatchDistances);
+
+   return test_result ("bench_math_batch");
+}
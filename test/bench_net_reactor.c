@@ -0,0 +1,447 @@
+/* bench_net_reactor.c - The epoll reactor over local socket pairs.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   unix/roadmap_net_reactor.c runs on unix socket pairs, one end of each
+ *   pair watched by the reactor and the other end driven by the test:
+ *
+ *   - Read readiness: the input callback runs once data arrives, with the
+ *     IO it was registered with, and no more once it is removed.
+ *   - Write readiness: the output callback runs on a writable socket, and a
+ *     connect which takes too long is reported by output_timedout.
+ *   - A socket closed by the callback of another socket in the same
+ *     dispatch gets no stale event.
+ *   - Sends the socket cannot take are queued, flushed in order when it is
+ *     writable, and refused above ROADMAP_REACTOR_MAX_QUEUED.
+ *   - Periodic callbacks run from the timerfd at their interval, can be
+ *     removed from their own callback, and the timer is disarmed when none
+ *     is left.
+ *
+ *   Then a sixteenth of many sockets gets data in each round, to time the
+ *   dispatch.
+ *
+ *   Usage: bench_net_reactor [sockets [rounds]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include "roadmap.h"
+#include "roadmap_io.h"
+#include "roadmap_net.h"
+#include "roadmap_net_mon.h"
+#include "roadmap_net_reactor.h"
+#include "test_stubs.h"
+
+#define MAX_PAIRS       1000
+#define QUEUE_CHUNK     (64 * 1024)
+#define PERIODIC_MS     20
+
+struct roadmap_socket_t {
+   int s;
+};
+
+typedef struct {
+   struct roadmap_socket_t socket;
+   RoadMapIO io;           /* The end watched by the reactor */
+   int peer;               /* The end driven by the test */
+   int reads;
+   int writes;
+} Pair;
+
+static Pair Pairs[MAX_PAIRS];
+
+
+/* --- The network services the reactor uses --- */
+
+int roadmap_net_get_fd (RoadMapSocket s) {
+
+   return s->s;
+}
+
+void roadmap_net_mon_send (size_t size) {
+}
+
+void roadmap_net_mon_error (const char *text) {
+}
+
+
+/* --- The socket pairs --- */
+
+static void open_pair (Pair *pair) {
+
+   int fds[2];
+
+   TEST_CHECK (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+   fcntl (fds[0], F_SETFL, O_NONBLOCK);
+   fcntl (fds[1], F_SETFL, O_NONBLOCK);
+
+   memset (pair, 0, sizeof (Pair));
+   pair->socket.s = fds[0];
+   pair->peer = fds[1];
+   pair->io.subsystem = ROADMAP_IO_NET;
+   pair->io.os.socket = &pair->socket;
+   pair->io.context = pair;
+}
+
+static void close_pair (Pair *pair) {
+
+   roadmap_net_reactor_close (pair->socket.s);
+   close (pair->socket.s);
+   close (pair->peer);
+}
+
+static int drain (int fd) {
+
+   char buffer[4096];
+   int total = 0;
+   int res;
+
+   while ((res = read (fd, buffer, sizeof (buffer))) > 0) total += res;
+
+   return total;
+}
+
+static void on_read (RoadMapIO *io) {
+
+   Pair *pair = (Pair *) io->context;
+
+   TEST_CHECK (io->os.socket == &pair->socket);
+
+   pair->reads++;
+   drain (pair->socket.s);
+}
+
+static void on_write (RoadMapIO *io) {
+
+   Pair *pair = (Pair *) io->context;
+
+   pair->writes++;
+}
+
+/* Closes the other pair of the two, whose event is then stale */
+static void on_read_close_other (RoadMapIO *io) {
+
+   Pair *pair = (Pair *) io->context;
+   Pair *other = (pair == Pairs) ? Pairs + 1 : Pairs;
+
+   pair->reads++;
+   drain (pair->socket.s);
+   roadmap_net_reactor_close (other->socket.s);
+}
+
+/* Dispatches until nothing is ready */
+static int dispatch_all (void) {
+
+   int total = 0;
+   int count;
+
+   while ((count = roadmap_net_reactor_dispatch (0)) > 0) total += count;
+
+   return total;
+}
+
+
+/* --- Readiness --- */
+
+static void test_read (void) {
+
+   Pair *pair = Pairs;
+
+   open_pair (pair);
+   roadmap_net_reactor_set_input (&pair->io, on_read);
+
+   TEST_CHECK (dispatch_all () == 0);
+   TEST_CHECK (pair->reads == 0);
+
+   TEST_CHECK (write (pair->peer, "x", 1) == 1);
+   TEST_CHECK (roadmap_net_reactor_dispatch (1000) == 1);
+   TEST_CHECK (pair->reads == 1);
+
+   /* Drained: level triggered, but nothing left to report */
+   TEST_CHECK (dispatch_all () == 0);
+
+   roadmap_net_reactor_remove_input (&pair->io);
+   TEST_CHECK (write (pair->peer, "y", 1) == 1);
+   TEST_CHECK (dispatch_all () == 0);
+   TEST_CHECK (pair->reads == 1);
+
+   /* A hangup is reported to the input callback */
+   roadmap_net_reactor_set_input (&pair->io, on_read);
+   close (pair->peer);
+   pair->peer = -1;
+   TEST_CHECK (roadmap_net_reactor_dispatch (1000) == 1);
+   TEST_CHECK (pair->reads == 2);
+
+   roadmap_net_reactor_close (pair->socket.s);
+   close (pair->socket.s);
+}
+
+static void test_write (void) {
+
+   Pair *pair = Pairs;
+
+   open_pair (pair);
+
+   roadmap_net_reactor_set_output (&pair->io, on_write, FALSE);
+   TEST_CHECK (roadmap_net_reactor_dispatch (1000) == 1);
+   TEST_CHECK (pair->writes == 1);
+   TEST_CHECK (roadmap_net_reactor_output_timedout (time (NULL) + 10) == NULL);
+
+   /* A connect in progress times out */
+   roadmap_net_reactor_set_output (&pair->io, on_write, TRUE);
+   TEST_CHECK (roadmap_net_reactor_output_timedout (time (NULL) - 10) == NULL);
+   TEST_CHECK (roadmap_net_reactor_output_timedout (time (NULL) + 10) != NULL);
+   TEST_CHECK (roadmap_net_reactor_output_timedout (time (NULL) + 10)->context == pair);
+
+   roadmap_net_reactor_remove_input (&pair->io);
+   TEST_CHECK (roadmap_net_reactor_output_timedout (time (NULL) + 10) == NULL);
+   TEST_CHECK (dispatch_all () == 0);
+   TEST_CHECK (pair->writes == 1);
+
+   close_pair (pair);
+}
+
+static void test_stale (void) {
+
+   open_pair (Pairs);
+   open_pair (Pairs + 1);
+
+   roadmap_net_reactor_set_input (&Pairs[0].io, on_read_close_other);
+   roadmap_net_reactor_set_input (&Pairs[1].io, on_read_close_other);
+
+   /* Both are ready in the same dispatch, the first one closes the other */
+   TEST_CHECK (write (Pairs[0].peer, "x", 1) == 1);
+   TEST_CHECK (write (Pairs[1].peer, "x", 1) == 1);
+
+   TEST_CHECK (roadmap_net_reactor_dispatch (1000) == 2);
+   TEST_CHECK (Pairs[0].reads + Pairs[1].reads == 1);
+
+   TEST_CHECK (dispatch_all () == 0);
+   TEST_CHECK (Pairs[0].reads + Pairs[1].reads == 1);
+
+   close_pair (Pairs);
+   close_pair (Pairs + 1);
+}
+
+
+/* --- The send queue --- */
+
+static void test_queue (void) {
+
+   Pair *pair = Pairs;
+   unsigned char *data;
+   unsigned char *received;
+   int size = ROADMAP_REACTOR_MAX_QUEUED;
+   int sent = 0;
+   int got = 0;
+   int res;
+   int i;
+
+   open_pair (pair);
+
+   data = malloc (size * 3);
+   received = malloc (size * 3);
+   roadmap_check_allocated (data);
+   roadmap_check_allocated (received);
+
+   for (i = 0; i < size * 3; i++) data[i] = (unsigned char) (i * 7 + i / 251);
+
+   /* More than the socket takes, all accepted */
+   while (sent < size) {
+      TEST_CHECK (roadmap_net_reactor_send (pair->socket.s, data + sent, QUEUE_CHUNK) == QUEUE_CHUNK);
+      sent += QUEUE_CHUNK;
+   }
+
+   TEST_CHECK (roadmap_net_reactor_pending (pair->socket.s) > 0);
+
+   /* Then the queue is full */
+   while (roadmap_net_reactor_pending (pair->socket.s) + QUEUE_CHUNK <= ROADMAP_REACTOR_MAX_QUEUED) {
+      TEST_CHECK (roadmap_net_reactor_send (pair->socket.s, data + sent, QUEUE_CHUNK) == QUEUE_CHUNK);
+      sent += QUEUE_CHUNK;
+   }
+   TEST_CHECK (roadmap_net_reactor_send (pair->socket.s, data + sent, QUEUE_CHUNK) == -1);
+
+   /* The peer reads, the reactor flushes when the socket is writable */
+   while (got < sent) {
+
+      res = read (pair->peer, received + got, sent - got);
+
+      if (res > 0) got += res;
+      else if (res < 0 && errno != EAGAIN) break;
+      else if (roadmap_net_reactor_dispatch (1000) <= 0) break;
+   }
+
+   TEST_CHECK (got == sent);
+   TEST_CHECK (!memcmp (data, received, sent));
+   TEST_CHECK (roadmap_net_reactor_pending (pair->socket.s) == 0);
+
+   /* The queue flushed, nothing waits on the socket anymore */
+   TEST_CHECK (dispatch_all () == 0);
+
+   close_pair (pair);
+   free (data);
+   free (received);
+}
+
+
+/* --- The timers --- */
+
+static int FastCalls;
+static int SlowCalls;
+static int OnceCalls;
+
+static void on_fast (void) {
+
+   FastCalls++;
+}
+
+static void on_slow (void) {
+
+   SlowCalls++;
+}
+
+static void on_once (void) {
+
+   OnceCalls++;
+   roadmap_net_reactor_remove_periodic (on_once);
+}
+
+static void dispatch_for (int ms) {
+
+   double end = test_time_ms () + ms;
+   double now;
+
+   while ((now = test_time_ms ()) < end) {
+      roadmap_net_reactor_dispatch ((int) (end - now) + 1);
+   }
+}
+
+static void test_timers (void) {
+
+   double start;
+
+   roadmap_net_reactor_set_periodic (PERIODIC_MS, on_fast);
+   roadmap_net_reactor_set_periodic (PERIODIC_MS * 4, on_slow);
+   roadmap_net_reactor_set_periodic (PERIODIC_MS / 2, on_once);
+
+   dispatch_for (PERIODIC_MS * 10 + PERIODIC_MS / 2);
+
+   printf ("timers in %d ms: %d every %d ms, %d every %d ms, %d once\n",
+           PERIODIC_MS * 10, FastCalls, PERIODIC_MS, SlowCalls, PERIODIC_MS * 4, OnceCalls);
+
+   TEST_CHECK (FastCalls >= 8 && FastCalls <= 10);
+   TEST_CHECK (SlowCalls == 2);
+   TEST_CHECK (OnceCalls == 1);
+
+   /* Set again: the new interval replaces the old one */
+   FastCalls = 0;
+   roadmap_net_reactor_set_periodic (PERIODIC_MS * 20, on_fast);
+   roadmap_net_reactor_remove_periodic (on_slow);
+   dispatch_for (PERIODIC_MS * 5);
+   TEST_CHECK (FastCalls == 0);
+
+   /* None left: the timer is disarmed, and a dispatch waits its full time */
+   roadmap_net_reactor_remove_periodic (on_fast);
+   start = test_time_ms ();
+   TEST_CHECK (roadmap_net_reactor_dispatch (PERIODIC_MS * 2) == 0);
+   TEST_CHECK (test_time_ms () - start >= PERIODIC_MS * 2 - 1);
+   TEST_CHECK (FastCalls == 0);
+}
+
+
+/* --- The benchmark --- */
+
+static void run (int count, int rounds) {
+
+   double start;
+   double elapsed;
+   int events = 0;
+   int reads = 0;
+   int i;
+   int j;
+
+   for (i = 0; i < count; i++) {
+      open_pair (Pairs + i);
+      roadmap_net_reactor_set_input (&Pairs[i].io, on_read);
+   }
+
+   start = test_time_ms ();
+
+   for (j = 0; j < rounds; j++) {
+
+      /* A few of the sockets have data in each round */
+      for (i = j % 16; i < count; i += 16) {
+         TEST_CHECK (write (Pairs[i].peer, "x", 1) == 1);
+      }
+
+      events += dispatch_all ();
+   }
+
+   elapsed = test_time_ms () - start;
+
+   for (i = 0; i < count; i++) {
+      reads += Pairs[i].reads;
+      close_pair (Pairs + i);
+   }
+
+   printf ("%d sockets, %d rounds: %8.1f ms  %6.2f us/event\n",
+           count, rounds, elapsed, elapsed * 1000 / (events ? events : 1));
+
+   TEST_CHECK (reads == events);
+}
+
+
+int main (int argc, char **argv) {
+
+   int count = 400;
+   int rounds = 200;
+
+   if (argc > 1) count = atoi (argv[1]);
+   if (argc > 2) rounds = atoi (argv[2]);
+   if (count < 2 || count > MAX_PAIRS || rounds < 1) {
+      fprintf (stderr, "Usage: %s [sockets (2-%d) [rounds]]\n", argv[0], MAX_PAIRS);
+      return 1;
+   }
+
+   TEST_CHECK (roadmap_net_reactor_initialize ());
+   TEST_CHECK (roadmap_net_reactor_fd () >= 0);
+
+   test_read ();
+   test_write ();
+   test_stale ();
+   test_queue ();
+   test_timers ();
+
+   run (count, rounds);
+
+   roadmap_net_reactor_shutdown ();
+
+   return test_result ("bench_net_reactor");
+}
@@ -0,0 +1,528 @@
+/* bench_offline_batch.c - Batching of the offline journal files.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   Realtime_OfflineBatch() runs on .wud files in a temporary directory,
+ *   with the file and path services on the real file system. Each rename
+ *   and remove is recorded, so the order of the commit can be checked:
+ *   the batch is renamed over its first source before any other source
+ *   is removed, and a failed rename leaves the sources as they were.
+ *
+ *   Usage: bench_offline_batch [files]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "roadmap.h"
+#include "roadmap_file.h"
+#include "roadmap_path.h"
+#include "roadmap_dbread.h"
+#include "Realtime/RealtimeOffline.h"
+#include "test_stubs.h"
+
+#define MAX_OPERATIONS  4096
+#define BIG_FILE_SIZE   (100 * 1024)
+
+static char  TestDir[64];
+static char *Operations[MAX_OPERATIONS];
+static int   OperationsCount;
+static int   FailRename;
+static int   AuthCount;
+
+
+/* --- The file services, on the real file system --- */
+
+RoadMapFile roadmap_file_open (const char *name, const char *mode) {
+
+   int unix_mode;
+
+   if (strcmp (mode, "r") == 0) {
+      unix_mode = O_RDONLY;
+   } else if (strchr (mode, 'w') != NULL) {
+      unix_mode = O_RDWR|O_CREAT|O_TRUNC;
+   } else {
+      unix_mode = O_RDWR|O_CREAT|O_APPEND;
+   }
+
+   return (RoadMapFile) open (name, unix_mode, 0644);
+}
+
+int roadmap_file_read (RoadMapFile file, void *data, int size) {
+
+   return read (file, data, size);
+}
+
+int roadmap_file_write (RoadMapFile file, const void *data, int length) {
+
+   return write (file, data, length);
+}
+
+void roadmap_file_close (RoadMapFile file) {
+
+   close (file);
+}
+
+int roadmap_file_length (const char *path, const char *name) {
+
+   struct stat st;
+
+   if (stat (name, &st) != 0) return -1;
+   return (int) st.st_size;
+}
+
+static void record_operation (const char *operation, const char *name) {
+
+   char *record;
+
+   if (OperationsCount >= MAX_OPERATIONS) return;
+
+   /* Names relative to the test directory */
+   name += strlen (TestDir) + 1;
+
+   record = malloc (strlen (operation) + strlen (name) + 2);
+   roadmap_check_allocated (record);
+   sprintf (record, "%s %s", operation, name);
+
+   Operations[OperationsCount++] = record;
+}
+
+int roadmap_file_rename (const char *old_name, const char *new_name) {
+
+   record_operation ("rename", old_name);
+   if (FailRename) return -1;
+
+   return rename (old_name, new_name);
+}
+
+void roadmap_file_remove (const char *path, const char *name) {
+
+   record_operation ("remove", name);
+   remove (name);
+}
+
+char *roadmap_path_join (const char *path, const char *name) {
+
+   char *joined = malloc (strlen (path) + strlen (name) + 2);
+
+   roadmap_check_allocated (joined);
+   sprintf (joined, "%s/%s", path, name);
+
+   return joined;
+}
+
+void roadmap_path_free (const char *path) {
+
+   free ((char *) path);
+}
+
+static int compare_names (const void *a, const void *b) {
+
+   return strcmp (*(char **) a, *(char **) b);
+}
+
+/* The names are sorted, so the batches are the same on every run */
+char **roadmap_path_list (const char *path, const char *extension) {
+
+   DIR *directory = opendir (path);
+   struct dirent *entry;
+   char **list;
+   int count = 0;
+   int size = 16;
+
+   list = calloc (size, sizeof (char *));
+   roadmap_check_allocated (list);
+
+   while (directory && (entry = readdir (directory)) != NULL) {
+
+      int length = strlen (entry->d_name);
+
+      if (length < (int) strlen (extension) ||
+          strcmp (entry->d_name + length - strlen (extension), extension)) {
+         continue;
+      }
+
+      if (count + 1 >= size) {
+         size *= 2;
+         list = realloc (list, size * sizeof (char *));
+         roadmap_check_allocated (list);
+      }
+      list[count++] = strdup (entry->d_name);
+   }
+   list[count] = NULL;
+
+   if (directory) closedir (directory);
+
+   qsort (list, count, sizeof (char *), compare_names);
+
+   return list;
+}
+
+void roadmap_path_list_free (char **list) {
+
+   char **cursor;
+
+   for (cursor = list; *cursor != NULL; ++cursor) free (*cursor);
+   free (list);
+}
+
+const char *roadmap_db_map_path (void) {
+
+   return TestDir;
+}
+
+/* The journal starts with the login, as Realtime.c writes it */
+void RealTime_Auth (void) {
+
+   AuthCount++;
+   Realtime_OfflineWrite ("Auth,1,142,user,secret\n");
+}
+
+
+/* --- Helpers --- */
+
+static char *file_path (const char *name) {
+
+   static char path[256];
+
+   snprintf (path, sizeof (path), "%s/%s", TestDir, name);
+   return path;
+}
+
+static void write_file (const char *name, const char *data, int length) {
+
+   FILE *file = fopen (file_path (name), "w");
+
+   if (file == NULL) return;
+   fwrite (data, 1, length, file);
+   fclose (file);
+}
+
+static char *read_file (const char *name) {
+
+   FILE *file = fopen (file_path (name), "r");
+   char *data;
+   long length;
+
+   if (file == NULL) return NULL;
+
+   fseek (file, 0, SEEK_END);
+   length = ftell (file);
+   fseek (file, 0, SEEK_SET);
+
+   data = malloc (length + 1);
+   roadmap_check_allocated (data);
+   data[fread (data, 1, length, file)] = '\0';
+   fclose (file);
+
+   return data;
+}
+
+static void write_text (const char *name, const char *text) {
+
+   write_file (name, text, strlen (text));
+}
+
+static int file_exists (const char *name) {
+
+   return access (file_path (name), F_OK) == 0;
+}
+
+static int count_files (const char *extension) {
+
+   char **list = roadmap_path_list (TestDir, extension);
+   char **cursor;
+   int count = 0;
+
+   for (cursor = list; *cursor != NULL; ++cursor) count++;
+   roadmap_path_list_free (list);
+
+   return count;
+}
+
+static void clear_operations (void) {
+
+   int i;
+
+   for (i = 0; i < OperationsCount; i++) free (Operations[i]);
+   OperationsCount = 0;
+}
+
+static void clear_directory (void) {
+
+   char **list = roadmap_path_list (TestDir, "");
+   char **cursor;
+
+   for (cursor = list; *cursor != NULL; ++cursor) {
+      if (strcmp (*cursor, ".") && strcmp (*cursor, "..")) remove (file_path (*cursor));
+   }
+   roadmap_path_list_free (list);
+
+   clear_operations ();
+}
+
+static int check_content (const char *name, const char *expected) {
+
+   char *data = read_file (name);
+   int same = data != NULL && strcmp (data, expected) == 0;
+
+   if (!same) fprintf (stderr, "%s: [%s]\n  expected [%s]\n", name, data ? data : "(none)", expected);
+   free (data);
+
+   return same;
+}
+
+/* A file of about BIG_FILE_SIZE bytes of GPS lines */
+static void write_big_file (const char *name, int tag) {
+
+   char *data = malloc (BIG_FILE_SIZE + 64);
+   int length = 0;
+
+   roadmap_check_allocated (data);
+   while (length < BIG_FILE_SIZE) {
+      length += sprintf (data + length, "GPSPath,%d,%d,34780000,32080000\n", tag, length);
+   }
+   write_file (name, data, length);
+   free (data);
+}
+
+
+/* --- The tests --- */
+
+static void test_merge (void) {
+
+   /* 002 repeats the login and the disconnect of 001; 003 has a torn tail */
+   write_text ("001.wud",
+               "Auth,1,142,user,secret\nGPSPath,1\nGPSDisconnect\n");
+   write_text ("002.wud",
+               "Auth,1,142,user,secret\nGPSDisconnect\nGPSPath,2\nGPSDisconnect\n");
+   write_text ("003.wud",
+               "NodePath,3\nGPSPath,to");
+
+   Realtime_OfflineBatch (TestDir);
+
+   TEST_CHECK (count_files (".wud") == 1);
+   TEST_CHECK (count_files (".tmp") == 0);
+   TEST_CHECK (check_content ("001.wud",
+               "Auth,1,142,user,secret\nGPSPath,1\nGPSDisconnect\n"
+               "GPSPath,2\nGPSDisconnect\nNodePath,3\n"));
+
+   /* The batch is in place before the other sources go */
+   TEST_CHECK (OperationsCount == 3);
+   if (OperationsCount == 3) {
+      TEST_CHECK (!strcmp (Operations[0], "rename 001.wud.tmp"));
+      TEST_CHECK (!strcmp (Operations[1], "remove 002.wud"));
+      TEST_CHECK (!strcmp (Operations[2], "remove 003.wud"));
+   }
+
+   clear_directory ();
+}
+
+
+static void test_torn_tail (void) {
+
+   /* A file with no complete line is merged as an empty file */
+   write_text ("001.wud", "GPSPath,1\nNodePath,1\n");
+   write_text ("002.wud", "GPSPath,2,3478");
+   write_text ("003.wud", "NodePath,3\nSubmitMarker,3,4");
+
+   Realtime_OfflineBatch (TestDir);
+
+   TEST_CHECK (count_files (".wud") == 1);
+   TEST_CHECK (check_content ("001.wud", "GPSPath,1\nNodePath,1\nNodePath,3\n"));
+
+   clear_directory ();
+}
+
+
+static void test_rename_failed (void) {
+
+   FailRename = 1;
+
+   write_text ("001.wud", "GPSPath,1\n");
+   write_text ("002.wud", "GPSPath,2\n");
+
+   Realtime_OfflineBatch (TestDir);
+
+   /* The sources are untouched, and the batch is dropped */
+   TEST_CHECK (count_files (".tmp") == 0);
+   TEST_CHECK (check_content ("001.wud", "GPSPath,1\n"));
+   TEST_CHECK (check_content ("002.wud", "GPSPath,2\n"));
+
+   TEST_CHECK (OperationsCount == 2);
+   if (OperationsCount == 2) {
+      TEST_CHECK (!strcmp (Operations[0], "rename 001.wud.tmp"));
+      TEST_CHECK (!strcmp (Operations[1], "remove 001.wud.tmp"));
+   }
+
+   FailRename = 0;
+   clear_directory ();
+}
+
+
+static void test_active_file (void) {
+
+   write_text ("001.wud", "GPSPath,1\n");
+   write_text ("002.wud", "GPSPath,2\n");
+
+   /* The journal being written now: one login, repeated lines dropped */
+   Realtime_OfflineOpen (TestDir, "003.wud");
+   Realtime_OfflineWrite ("GPSDisconnect\nGPSDisconnect\nAt,1,2\n");
+   Realtime_OfflineWrite ("GPSPath,3\nGPSDisconnect\n");
+
+   TEST_CHECK (AuthCount == 1);
+   TEST_CHECK (check_content ("003.wud",
+               "Auth,1,142,user,secret\nGPSDisconnect\nGPSPath,3\nGPSDisconnect\n"));
+
+   Realtime_OfflineBatch (TestDir);
+
+   TEST_CHECK (count_files (".wud") == 2);
+   TEST_CHECK (check_content ("001.wud", "GPSPath,1\nGPSPath,2\n"));
+   TEST_CHECK (file_exists ("003.wud"));
+   TEST_CHECK (!file_exists ("002.wud"));
+
+   Realtime_OfflineWrite ("NodePath,3\n");
+   TEST_CHECK (check_content ("003.wud",
+               "Auth,1,142,user,secret\nGPSDisconnect\nGPSPath,3\nGPSDisconnect\nNodePath,3\n"));
+
+   Realtime_OfflineClose ();
+   clear_directory ();
+}
+
+
+static void test_batch_size (void) {
+
+   char *big;
+
+   /* Two files fit in a batch, a third one starts the next batch */
+   write_big_file ("001.wud", 1);
+   write_big_file ("002.wud", 2);
+   write_big_file ("003.wud", 3);
+   write_big_file ("004.wud", 4);
+
+   /* A file as large as a batch is uploaded on its own */
+   big = malloc (300 * 1024);
+   roadmap_check_allocated (big);
+   memset (big, 'x', 300 * 1024);
+   memcpy (big, "GPSPath", 7);
+   big[300 * 1024 - 1] = '\n';
+   write_file ("000.wud", big, 300 * 1024);
+   free (big);
+
+   Realtime_OfflineBatch (TestDir);
+
+   TEST_CHECK (count_files (".wud") == 3);
+   TEST_CHECK (file_exists ("000.wud"));
+   TEST_CHECK (file_exists ("001.wud"));
+   TEST_CHECK (file_exists ("003.wud"));
+   TEST_CHECK (roadmap_file_length (NULL, file_path ("000.wud")) == 300 * 1024);
+   TEST_CHECK (roadmap_file_length (NULL, file_path ("001.wud")) <= 256 * 1024);
+   TEST_CHECK (roadmap_file_length (NULL, file_path ("003.wud")) <= 256 * 1024);
+
+   TEST_CHECK (OperationsCount == 4);
+   if (OperationsCount == 4) {
+      TEST_CHECK (!strcmp (Operations[0], "rename 001.wud.tmp"));
+      TEST_CHECK (!strcmp (Operations[1], "remove 002.wud"));
+      TEST_CHECK (!strcmp (Operations[2], "rename 003.wud.tmp"));
+      TEST_CHECK (!strcmp (Operations[3], "remove 004.wud"));
+   }
+
+   clear_directory ();
+}
+
+
+/* --- The benchmark --- */
+
+static double bench_batch (int files) {
+
+   char name[32];
+   char line[64];
+   double start;
+   double elapsed;
+   int length;
+   int merged = 0;
+   int i;
+
+   for (i = 0; i < files; i++) {
+      snprintf (name, sizeof (name), "%06d.wud", i);
+      length = snprintf (line, sizeof (line),
+                         "Auth,1,142,user,secret\nGPSPath,%d,34780000\nGPSDisconnect\n", i);
+      write_file (name, line, length);
+
+      /* The login is written once per batch */
+      merged += length;
+      if (i > 0) merged -= strlen ("Auth,1,142,user,secret\n");
+   }
+
+   start = test_time_ms ();
+   Realtime_OfflineBatch (TestDir);
+   elapsed = test_time_ms () - start;
+
+   if (merged <= 256 * 1024) {
+      TEST_CHECK (count_files (".wud") == 1);
+      TEST_CHECK (roadmap_file_length (NULL, file_path ("000000.wud")) == merged);
+   }
+   TEST_CHECK (count_files (".tmp") == 0);
+
+   clear_directory ();
+
+   return elapsed;
+}
+
+
+int main (int argc, char **argv) {
+
+   int files = 1000;
+   double elapsed;
+
+   if (argc > 1) files = atoi (argv[1]);
+   if (files < 1) {
+      fprintf (stderr, "Usage: %s [files]\n", argv[0]);
+      return 1;
+   }
+
+   strcpy (TestDir, "/tmp/bench_offline_batch.XXXXXX");
+   if (mkdtemp (TestDir) == NULL) {
+      perror ("mkdtemp");
+      return 1;
+   }
+
+   test_merge ();
+   test_torn_tail ();
+   test_rename_failed ();
+   test_active_file ();
+   test_batch_size ();
+
+   elapsed = bench_batch (files);
+   printf ("%d files batched: %8.1f ms  %6.1f us/file\n",
+           files, elapsed, elapsed * 1000.0 / files);
+
+   rmdir (TestDir);
+
+   return test_result ("bench_offline_batch");
+}
@@ -0,0 +1,215 @@
+/* bench_queue.c - Route search queues: the fib heap against navigate_queue.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   Replays the same route queries with each queue. A query is a search
+ *   over a grid of junctions, with random cross times in seconds, which
+ *   inserts every improved node and skips the stale entries when they are
+ *   extracted, as astar() does. The costs found by the queues must agree.
+ *
+ *   Usage: bench_queue [grid_size [queries]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "roadmap.h"
+#include "navigate/navigate_queue.h"
+#include "navigate/fib-1.1/fib.h"
+#include "test_stubs.h"
+
+#define QUEUE_FIB    -1
+
+static int GridSize = 300;
+static int QueryCount = 20;
+
+static int *EdgeCost;      /* 4 edges per node: east, west, north, south */
+static int *NodeCost;
+static int *Queries;
+
+static long long QueueOperations;
+
+
+static int neighbour (int node, int edge) {
+
+   int x = node % GridSize;
+   int y = node / GridSize;
+
+   switch (edge) {
+      case 0: return x + 1 < GridSize ? node + 1 : -1;
+      case 1: return x > 0 ? node - 1 : -1;
+      case 2: return y + 1 < GridSize ? node + GridSize : -1;
+      default: return y > 0 ? node - GridSize : -1;
+   }
+}
+
+
+static long long run_query (int type, int from, void *queue) {
+
+   int count = GridSize * GridSize;
+   long long total = 0;
+   int i;
+
+   for (i = 0; i < count; i++) NodeCost[i] = INT_MAX;
+
+   NodeCost[from] = 0;
+
+   if (type == QUEUE_FIB) {
+      fh_insertkey ((struct fibheap *) queue, 0, (void *)(long) from);
+   } else {
+      navigate_queue_reset ((NavigateQueue *) queue);
+      navigate_queue_insert ((NavigateQueue *) queue, 0, (void *)(long) from);
+   }
+   QueueOperations++;
+
+   while (1) {
+
+      int node;
+      int cost;
+      int edge;
+
+      if (type == QUEUE_FIB) {
+         struct fibheap *heap = (struct fibheap *) queue;
+         if (fh_minkey (heap) == INT_MIN) break;
+         cost = fh_minkey (heap);
+         node = (int)(long) fh_extractmin (heap);
+      } else {
+         NavigateQueue *q = (NavigateQueue *) queue;
+         if (navigate_queue_empty (q)) break;
+         cost = navigate_queue_min_key (q);
+         node = (int)(long) navigate_queue_extract_min (q);
+      }
+      QueueOperations++;
+
+      if (cost > NodeCost[node]) continue;
+
+      for (edge = 0; edge < 4; edge++) {
+
+         int next = neighbour (node, edge);
+         int next_cost;
+
+         if (next < 0) continue;
+
+         next_cost = cost + EdgeCost[node * 4 + edge];
+         if (next_cost >= NodeCost[next]) continue;
+
+         NodeCost[next] = next_cost;
+         if (type == QUEUE_FIB) {
+            fh_insertkey ((struct fibheap *) queue, next_cost, (void *)(long) next);
+         } else {
+            navigate_queue_insert ((NavigateQueue *) queue, next_cost, (void *)(long) next);
+         }
+         QueueOperations++;
+      }
+   }
+
+   for (i = 0; i < count; i++) total += NodeCost[i];
+
+   return total;
+}
+
+
+static double run_queries (int type, const char *name, long long *checksums) {
+
+   double start = test_time_ms ();
+   double elapsed;
+   NavigateQueue *q = NULL;
+   int i;
+
+   QueueOperations = 0;
+
+   if (type != QUEUE_FIB) q = navigate_queue_new (type, 1024);
+
+   for (i = 0; i < QueryCount; i++) {
+
+      if (type == QUEUE_FIB) {
+         /* astar() made a new heap for each search */
+         struct fibheap *heap = fh_makekeyheap ();
+         checksums[i] = run_query (type, Queries[i], heap);
+         fh_deleteheap (heap);
+      } else {
+         checksums[i] = run_query (type, Queries[i], q);
+      }
+   }
+
+   if (q) navigate_queue_free (q);
+
+   elapsed = test_time_ms () - start;
+
+   printf ("%-6s %8.1f ms  %6.1f ns/op  (%lld operations)\n",
+           name, elapsed, elapsed * 1000000.0 / QueueOperations, QueueOperations);
+
+   return elapsed;
+}
+
+
+int main (int argc, char **argv) {
+
+   long long *fib_checksums;
+   long long *checksums;
+   int count;
+   int i;
+
+   if (argc > 1) GridSize = atoi (argv[1]);
+   if (argc > 2) QueryCount = atoi (argv[2]);
+   if (GridSize < 2 || QueryCount < 1) {
+      fprintf (stderr, "Usage: %s [grid_size [queries]]\n", argv[0]);
+      return 1;
+   }
+
+   count = GridSize * GridSize;
+
+   EdgeCost = malloc (count * 4 * sizeof (int));
+   NodeCost = malloc (count * sizeof (int));
+   Queries = malloc (QueryCount * sizeof (int));
+   fib_checksums = malloc (QueryCount * sizeof (long long));
+   checksums = malloc (QueryCount * sizeof (long long));
+   roadmap_check_allocated (EdgeCost);
+   roadmap_check_allocated (NodeCost);
+   roadmap_check_allocated (Queries);
+   roadmap_check_allocated (fib_checksums);
+   roadmap_check_allocated (checksums);
+
+   srand (1);
+   for (i = 0; i < count * 4; i++) EdgeCost[i] = 1 + rand () % 60;
+   for (i = 0; i < QueryCount; i++) Queries[i] = rand () % count;
+
+   printf ("%d queries over a %dx%d grid\n", QueryCount, GridSize, GridSize);
+
+   run_queries (QUEUE_FIB, "fib", fib_checksums);
+
+   run_queries (NAVIGATE_QUEUE_HEAP, "heap", checksums);
+   for (i = 0; i < QueryCount; i++) TEST_CHECK (checksums[i] == fib_checksums[i]);
+
+   run_queries (NAVIGATE_QUEUE_RADIX, "radix", checksums);
+   for (i = 0; i < QueryCount; i++) TEST_CHECK (checksums[i] == fib_checksums[i]);
+
+   free (EdgeCost);
+   free (NodeCost);
+   free (Queries);
+   free (fib_checksums);
+   free (checksums);
+
+   return test_result ("bench_queue");
+}
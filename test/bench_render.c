@@ -0,0 +1,376 @@
+/* bench_render.c - Headless rendering of map areas to PNG files.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   roadmap_render_area() runs with the real math and the real AGG canvas,
+ *   without a GUI and without fonts. The map is a grid of streets, drawn
+ *   the way roadmap_screen_draw_map() draws lines. A "screen" view and
+ *   canvas buffer are set up first, as the GUI would, and must be the
+ *   same after each image. The PNG file is read back and the street
+ *   through the center must cross the whole image.
+ *
+ *   Usage: bench_render [images [pixels]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <png.h>
+
+#include "roadmap.h"
+#include "roadmap_gui.h"
+#include "roadmap_math.h"
+#include "roadmap_config.h"
+#include "roadmap_state.h"
+#include "roadmap_bar.h"
+#include "roadmap_canvas.h"
+#include "roadmap_screen.h"
+#include "roadmap_shape.h"
+#include "roadmap_square.h"
+#include "roadmap_label.h"
+#include "roadmap_path.h"
+#include "roadmap_file.h"
+#include "roadmap_messagebox.h"
+#include "roadmap_render.h"
+#include "test_stubs.h"
+
+#define SCREEN_WIDTH    800
+#define SCREEN_HEIGHT   480
+#define SCREEN_ZOOM     20
+#define SCREEN_ANGLE    30
+
+#define RENDER_ZOOM     10
+#define STREET_SPACING  40       /* pixels between streets */
+
+#define IMAGE_FILE      "bench_render.png"
+
+static RoadMapArea StreetArea;
+static RoadMapPosition StreetCenter;
+static int StreetSpacing;
+static int StreetMargin;
+static int LabelPasses;
+
+
+/* --- The services roadmap_math and the canvas use --- */
+
+int roadmap_bar_top_height () {
+
+   return 0;
+}
+
+int roadmap_bar_bottom_height () {
+
+   return 0;
+}
+
+void roadmap_config_declare
+        (const char *file,
+         RoadMapConfigDescriptor *descriptor, const char *default_value,
+         int *is_new) {
+}
+
+const char *roadmap_config_get (RoadMapConfigDescriptor *descriptor) {
+
+   return "";
+}
+
+int roadmap_config_get_integer (RoadMapConfigDescriptor *descriptor) {
+
+   return 100;
+}
+
+void roadmap_config_set_integer (RoadMapConfigDescriptor *descriptor, int x) {
+}
+
+void roadmap_state_add (const char *name, RoadMapStateFn state_fn) {
+}
+
+int roadmap_screen_fast_refresh (void) {
+
+   return 0;
+}
+
+int roadmap_screen_is_hd_screen (void) {
+
+   return 0;
+}
+
+int roadmap_screen_get_screen_scale (void) {
+
+   return 100;
+}
+
+void roadmap_screen_set_screen_type (int width, int height) {
+}
+
+void roadmap_shape_get_position (int shape, RoadMapPosition *position) {
+
+   position->longitude = 0;
+   position->latitude = 0;
+}
+
+void roadmap_square_adjust_scale (int zoom_factor) {
+}
+
+int roadmap_square_scale (int square) {
+
+   return 0;
+}
+
+int roadmap_square_at_current_scale (int square) {
+
+   return 1;
+}
+
+const char *roadmap_path_user (void) {
+
+   return ".";
+}
+
+char *roadmap_path_join (const char *path, const char *name) {
+
+   char *joined = malloc (strlen (path) + strlen (name) + 2);
+
+   roadmap_check_allocated (joined);
+   sprintf (joined, "%s/%s", path, name);
+
+   return joined;
+}
+
+void roadmap_path_free (const char *path) {
+
+   free ((char *) path);
+}
+
+FILE *roadmap_file_fopen (const char *path, const char *name, const char *mode) {
+
+   return fopen (name, mode);
+}
+
+void roadmap_messagebox (const char *title, const char *message) {
+}
+
+/* The map has no images */
+unsigned char *read_png_file (const char *file_name, int *width, int *height, int *stride) {
+
+   return NULL;
+}
+
+void dbg_time_start (int type) {
+}
+
+void dbg_time_end (int type) {
+}
+
+
+/* --- The map --- */
+
+void roadmap_label_start (void) {
+}
+
+int roadmap_label_draw_cache (int angles, int full) {
+
+   LabelPasses++;
+   return 0;
+}
+
+static void draw_street (int west, int north, int east, int south) {
+
+   RoadMapPosition position;
+   RoadMapGuiPoint points[2];
+   int count = 2;
+
+   position.longitude = west;
+   position.latitude = north;
+   roadmap_math_coordinate (&position, points);
+
+   position.longitude = east;
+   position.latitude = south;
+   roadmap_math_coordinate (&position, points + 1);
+
+   roadmap_canvas_draw_multiple_lines (1, &count, points, 0);
+}
+
+void roadmap_screen_draw_map (RoadMapGuiRect *rect) {
+
+   int x;
+   int y;
+
+   roadmap_canvas_create_pen ("background");
+   roadmap_canvas_set_foreground ("#f0f0f0");
+   roadmap_canvas_erase ();
+
+   roadmap_canvas_create_pen ("street");
+   roadmap_canvas_set_foreground ("#404040");
+   roadmap_canvas_set_thickness (3);
+
+   /* Streets through the center, every StreetSpacing, and past the area
+    * on all sides.
+    */
+   for (y = StreetCenter.latitude - StreetMargin; y <= StreetArea.north + StreetSpacing; y += StreetSpacing) {
+      draw_street (StreetArea.west - StreetSpacing, y, StreetArea.east + StreetSpacing, y);
+   }
+
+   for (x = StreetCenter.longitude - StreetMargin; x <= StreetArea.east + StreetSpacing; x += StreetSpacing) {
+      draw_street (x, StreetArea.north + StreetSpacing, x, StreetArea.south - StreetSpacing);
+   }
+}
+
+
+/* --- The benchmark --- */
+
+/* Pixels of the street row through the middle of the image which are not
+ * the background.
+ */
+static int check_image (const char *file, int *width, int *height) {
+
+   png_image image;
+   unsigned char *pixels;
+   int street = 0;
+   int x;
+   int y;
+
+   memset (&image, 0, sizeof (image));
+   image.version = PNG_IMAGE_VERSION;
+
+   if (!png_image_begin_read_from_file (&image, file)) return -1;
+
+   image.format = PNG_FORMAT_RGB;
+   pixels = malloc (PNG_IMAGE_SIZE (image));
+   roadmap_check_allocated (pixels);
+
+   if (!png_image_finish_read (&image, NULL, pixels, 0, NULL)) {
+      free (pixels);
+      return -1;
+   }
+
+   *width = image.width;
+   *height = image.height;
+
+   /* The best row around the middle, the street may be a pixel off */
+   for (y = image.height / 2 - 2; y <= (int) image.height / 2 + 2; y++) {
+
+      int count = 0;
+
+      for (x = 0; x < (int) image.width; x++) {
+         if (pixels[(y * image.width + x) * 3] < 0x80) count++;
+      }
+      if (count > street) street = count;
+   }
+
+   free (pixels);
+
+   return street;
+}
+
+
+int main (int argc, char **argv) {
+
+   struct RoadMapContext_t gui_view;
+   struct RoadMapContext_t view;
+   RoadMapPosition center;
+   unsigned char *gui_buffer;
+   unsigned char *buffer;
+   int images = 20;
+   int pixels = 1024;
+   int half;
+   int width = 0;
+   int height = 0;
+   int stride;
+   int street;
+   double start;
+   double elapsed;
+   int i;
+
+   if (argc > 1) images = atoi (argv[1]);
+   if (argc > 2) pixels = atoi (argv[2]);
+   if (images < 1 || pixels < 16 || pixels > ROADMAP_RENDER_MAX_SIZE) {
+      fprintf (stderr, "Usage: %s [images [pixels]]\n", argv[0]);
+      return 1;
+   }
+
+   /* The screen, as the GUI sets it up */
+   center.longitude = 34780000;
+   center.latitude = 32080000;
+
+   roadmap_math_initialize ();
+   roadmap_math_set_size (SCREEN_WIDTH, SCREEN_HEIGHT);
+   roadmap_math_set_context (&center, SCREEN_ZOOM);
+   roadmap_math_set_orientation (SCREEN_ANGLE);
+   roadmap_math_save_view (&gui_view);
+
+   gui_buffer = calloc (SCREEN_HEIGHT, SCREEN_WIDTH * roadmap_canvas_buffer_pixel_size ());
+   roadmap_check_allocated (gui_buffer);
+   roadmap_canvas_draw_to_buffer (gui_buffer, SCREEN_WIDTH, SCREEN_HEIGHT,
+                                  SCREEN_WIDTH * roadmap_canvas_buffer_pixel_size ());
+
+   /* The area to render: about pixels wide, with a street through the center */
+   half = pixels * RENDER_ZOOM / 2;
+   StreetSpacing = STREET_SPACING * RENDER_ZOOM;
+   StreetMargin = (half / StreetSpacing + 1) * StreetSpacing;
+   StreetCenter = center;
+
+   StreetArea.west = center.longitude - half;
+   StreetArea.east = center.longitude + half;
+   StreetArea.south = center.latitude - half;
+   StreetArea.north = center.latitude + half;
+
+   start = test_time_ms ();
+   for (i = 0; i < images; i++) {
+      TEST_CHECK (roadmap_render_area (&StreetArea, RENDER_ZOOM, IMAGE_FILE) == 0);
+   }
+   elapsed = test_time_ms () - start;
+
+   TEST_CHECK (LabelPasses == images);
+
+   /* The GUI gets its view and its canvas back */
+   roadmap_math_save_view (&view);
+   TEST_CHECK (view.width == gui_view.width);
+   TEST_CHECK (view.height == gui_view.height);
+   TEST_CHECK (view.zoom == gui_view.zoom);
+   TEST_CHECK (view.orientation == gui_view.orientation);
+   TEST_CHECK (view.center.longitude == gui_view.center.longitude);
+   TEST_CHECK (view.center.latitude == gui_view.center.latitude);
+   TEST_CHECK (!memcmp (&view.current_screen, &gui_view.current_screen, sizeof (RoadMapArea)));
+
+   roadmap_canvas_get_buffer (&buffer, &width, &height, &stride);
+   TEST_CHECK (buffer == gui_buffer);
+   TEST_CHECK (width == SCREEN_WIDTH);
+   TEST_CHECK (height == SCREEN_HEIGHT);
+
+   street = check_image (IMAGE_FILE, &width, &height);
+   TEST_CHECK (street >= 0);
+   TEST_CHECK (width > pixels / 2 && height > pixels / 2);
+
+   /* The center street, drawn in one view, crosses the whole image */
+   TEST_CHECK (street == width);
+
+   printf ("%d images of %dx%d: %8.1f ms  %6.1f ms/image  %6.1f Mpixel/s\n",
+           images, width, height, elapsed, elapsed / images,
+           (double) width * height * images / elapsed / 1000.0);
+
+   remove (IMAGE_FILE);
+   free (gui_buffer);
+
+   return test_result ("bench_render");
+}
@@ -0,0 +1,63 @@
+/* bench_render_agg.cpp - The GUI side of the AGG canvas, without a GUI.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   Each GUI port implements these for agg/roadmap_canvas.cpp, see
+ *   android/roadmap_canvas_agg.cpp. bench_render only needs colors in the
+ *   "#rrggbb" form, and plain ASCII text.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <wchar.h>
+
+#include "agg_pixfmt_rgb_packed.h"
+
+extern "C" {
+#include "roadmap.h"
+#include "roadmap_canvas.h"
+}
+#include "roadmap_canvas_agg.h"
+
+
+int roadmap_canvas_agg_to_wchar (const char *text, wchar_t *output, int size)
+{
+   int length = mbstowcs (output, text, size - 1);
+
+   if (length < 0) length = 0;
+   output[length] = 0;
+
+   return length;
+}
+
+
+agg::rgba8 roadmap_canvas_agg_parse_color (const char *color)
+{
+   int r, g, b, a;
+   int count = sscanf (color, "#%2x%2x%2x%2x", &r, &g, &b, &a);
+
+   if (count == 4) return agg::rgba8 (r, g, b, a);
+   if (count == 3) return agg::rgba8 (r, g, b);
+
+   return agg::rgba8 (0, 0, 0);
+}
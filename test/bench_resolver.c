@@ -0,0 +1,303 @@
+/* bench_resolver.c - Lookups of the worker pool resolver.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   getaddrinfo() is replaced by a stub resolver, which answers after a
+ *   fixed delay and counts the lookups. The names "hostN.test" resolve to
+ *   10.0.0.N, the ".invalid" names fail. The resolver results are posted
+ *   to a queue, which the main thread hands to resolver_handler(), as the
+ *   main loop does.
+ *
+ *   Several requests for the same domain must share one lookup, and the
+ *   later requests must be answered from the cache, for successes and for
+ *   failures. A batch of distinct domains measures the worker pool.
+ *
+ *   Usage: bench_resolver [domains [delay_ms]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "roadmap.h"
+#include "roadmap_main.h"
+#include "unix/resolver.h"
+#include "test_stubs.h"
+
+#define MAX_DOMAINS        48    /* leaves room in the resolver table */
+#define SHARED_DOMAINS     8
+#define SHARED_REQUESTS    8     /* requests per shared domain */
+#define RESULTS_MAX        1024
+#define WAIT_TIMEOUT_MS    10000
+
+static int LookupDelay = 20;     /* ms */
+
+static pthread_mutex_t StubMutex = PTHREAD_MUTEX_INITIALIZER;
+static int Lookups;
+
+
+/* --- The stub resolver --- */
+
+int getaddrinfo (const char *node, const char *service,
+                 const struct addrinfo *hints, struct addrinfo **res) {
+
+   struct addrinfo *info;
+   struct sockaddr_in *address;
+   int host;
+
+   pthread_mutex_lock (&StubMutex);
+   Lookups++;
+   pthread_mutex_unlock (&StubMutex);
+
+   usleep (LookupDelay * 1000);
+
+   if (sscanf (node, "host%d.test", &host) != 1) return EAI_NONAME;
+
+   info = calloc (1, sizeof (struct addrinfo) + sizeof (struct sockaddr_in));
+   roadmap_check_allocated (info);
+
+   address = (struct sockaddr_in *) (info + 1);
+   address->sin_family = AF_INET;
+   address->sin_addr.s_addr = htonl (0x0a000000 | host);
+
+   info->ai_family = AF_INET;
+   info->ai_addr = (struct sockaddr *) address;
+   info->ai_addrlen = sizeof (struct sockaddr_in);
+
+   *res = info;
+   return 0;
+}
+
+void freeaddrinfo (struct addrinfo *res) {
+
+   free (res);
+}
+
+
+/* --- The main loop --- */
+
+static pthread_mutex_t ResultMutex = PTHREAD_MUTEX_INITIALIZER;
+static int Results[RESULTS_MAX];
+static int ResultCount;
+
+void roadmap_main_post_resolver_result (int entry_id) {
+
+   pthread_mutex_lock (&ResultMutex);
+   if (ResultCount < RESULTS_MAX) Results[ResultCount++] = entry_id;
+   pthread_mutex_unlock (&ResultMutex);
+}
+
+void roadmap_main_set_periodic (int interval, RoadMapCallback callback) {
+}
+
+void roadmap_main_remove_periodic (RoadMapCallback callback) {
+}
+
+
+/* --- The benchmark --- */
+
+typedef struct {
+   int host;               /* -1 for a name which does not resolve */
+   int answers;
+   int wrong_answers;
+} Request;
+
+static int Answers;
+
+
+static in_addr_t host_address (int host) {
+
+   return host < 0 ? INADDR_NONE : htonl (0x0a000000 | host);
+}
+
+
+static void on_resolved (const void *context, in_addr_t ip_addr) {
+
+   Request *request = (Request *) context;
+
+   request->answers++;
+   if (ip_addr != host_address (request->host)) request->wrong_answers++;
+
+   Answers++;
+}
+
+
+/* Hands the posted results to the handler until the answers arrive */
+static int wait_answers (int expected) {
+
+   double start = test_time_ms ();
+
+   while (Answers < expected) {
+
+      int results[RESULTS_MAX];
+      int count;
+      int i;
+
+      if (test_time_ms () - start > WAIT_TIMEOUT_MS) return 0;
+
+      pthread_mutex_lock (&ResultMutex);
+      count = ResultCount;
+      memcpy (results, Results, count * sizeof (int));
+      ResultCount = 0;
+      pthread_mutex_unlock (&ResultMutex);
+
+      for (i = 0; i < count; i++) resolver_handler (results[i]);
+
+      if (!count) usleep (1000);
+   }
+
+   return 1;
+}
+
+
+static int get_lookups (void) {
+
+   int lookups;
+
+   pthread_mutex_lock (&StubMutex);
+   lookups = Lookups;
+   pthread_mutex_unlock (&StubMutex);
+
+   return lookups;
+}
+
+
+static void request (Request *r, int host) {
+
+   char domain[64];
+
+   if (host < 0) {
+      strcpy (domain, "missing.invalid");
+   } else {
+      snprintf (domain, sizeof (domain), "host%d.test", host);
+   }
+
+   r->host = host;
+
+   /* An immediate answer comes from the cache */
+   if (resolver_request (domain, on_resolved, r) != INADDR_NONE) {
+      on_resolved (r, host_address (host));
+   }
+}
+
+
+static int check_requests (const Request *requests, int count) {
+
+   int i;
+
+   for (i = 0; i < count; i++) {
+      if (requests[i].answers != 1 || requests[i].wrong_answers) return 0;
+   }
+
+   return 1;
+}
+
+
+int main (int argc, char **argv) {
+
+   static Request requests[SHARED_DOMAINS * SHARED_REQUESTS];
+   static Request batch[MAX_DOMAINS];
+   static Request missing[2];
+   int domains = MAX_DOMAINS;
+   double start;
+   int lookups;
+   int expected;
+   int i;
+
+   if (argc > 1) domains = atoi (argv[1]);
+   if (argc > 2) LookupDelay = atoi (argv[2]);
+   if (domains < 1 || domains > MAX_DOMAINS || LookupDelay < 0) {
+      fprintf (stderr, "Usage: %s [domains (1-%d) [delay_ms]]\n", argv[0], MAX_DOMAINS);
+      return 1;
+   }
+
+   resolver_init ();
+
+   printf ("lookups of %d ms\n", LookupDelay);
+
+   /* Requests for the same domains share the lookups */
+   start = test_time_ms ();
+   for (i = 0; i < SHARED_DOMAINS * SHARED_REQUESTS; i++) {
+      request (requests + i, i % SHARED_DOMAINS);
+   }
+   TEST_CHECK (wait_answers (SHARED_DOMAINS * SHARED_REQUESTS));
+   printf ("shared  %3d requests for %d domains: %3d lookups %8.1f ms\n",
+           SHARED_DOMAINS * SHARED_REQUESTS, SHARED_DOMAINS, get_lookups (),
+           test_time_ms () - start);
+
+   TEST_CHECK (get_lookups () == SHARED_DOMAINS);
+   TEST_CHECK (check_requests (requests, SHARED_DOMAINS * SHARED_REQUESTS));
+
+   /* Answered from the cache */
+   lookups = get_lookups ();
+   expected = Answers;
+   for (i = 0; i < SHARED_DOMAINS; i++) {
+
+      char domain[64];
+
+      requests[i].answers = 0;
+      request (requests + i, i);
+
+      snprintf (domain, sizeof (domain), "host%d.test", i);
+      TEST_CHECK (resolver_find (domain) == host_address (i));
+   }
+   TEST_CHECK (Answers == expected + SHARED_DOMAINS);
+   TEST_CHECK (check_requests (requests, SHARED_DOMAINS));
+   TEST_CHECK (get_lookups () == lookups);
+
+   /* A failure is retried, then cached */
+   lookups = get_lookups ();
+   expected = Answers + 1;
+   request (missing, -1);
+   TEST_CHECK (wait_answers (expected));
+   printf ("failure %3d lookups\n", get_lookups () - lookups);
+
+   lookups = get_lookups ();
+   expected = Answers + 1;
+   request (missing + 1, -1);
+   TEST_CHECK (wait_answers (expected));
+   TEST_CHECK (get_lookups () == lookups);
+   TEST_CHECK (check_requests (missing, 2));
+   TEST_CHECK (resolver_find ("missing.invalid") == INADDR_NONE);
+
+   /* Distinct domains keep the workers busy */
+   lookups = get_lookups ();
+   expected = Answers + domains;
+   start = test_time_ms ();
+   for (i = 0; i < domains; i++) request (batch + i, SHARED_DOMAINS + i);
+   TEST_CHECK (wait_answers (expected));
+   printf ("batch   %3d domains:                %3d lookups %8.1f ms\n",
+           domains, get_lookups () - lookups, test_time_ms () - start);
+
+   TEST_CHECK (get_lookups () - lookups == domains);
+   TEST_CHECK (check_requests (batch, domains));
+
+   resolver_shutdown ();
+
+   return test_result ("bench_resolver");
+}
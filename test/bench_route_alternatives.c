@@ -0,0 +1,526 @@
+/* bench_route_alternatives.c - Alternative routes by iterative penalties.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The map is one square holding a grid of two way streets, as in
+ *   bench_route_matrix, where a line of negative cost is closed.
+ *   navigate_route_search_alternatives() runs over it with the real square
+ *   graph:
+ *
+ *   - On the open grid with random costs, every route must be connected
+ *     from the origin line to the goal line, priced as returned, within the
+ *     stretch of the best route, and within the overlap with the routes
+ *     before it. The best route must be the one of a plain search, and the
+ *     penalties must be gone after the call.
+ *   - When the origin and goal lines meet, any other route is a detour of
+ *     more than the allowed stretch, so there is only one route.
+ *   - When the grid is cut in two halves joined by a corridor, the routes
+ *     share the corridor: a long corridor leaves only one route, a short
+ *     one leaves alternatives.
+ *
+ *   Usage: bench_route_alternatives [pairs]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_plugin.h"
+#include "roadmap_point.h"
+#include "roadmap_line.h"
+#include "roadmap_line_route.h"
+#include "roadmap_street.h"
+#include "roadmap_square.h"
+#include "roadmap_math.h"
+#include "roadmap_navigate.h"
+#include "roadmap_lang.h"
+#include "roadmap_main.h"
+#include "navigate/navigate_main.h"
+#include "navigate/navigate_cost.h"
+#include "navigate/navigate_ch.h"
+#include "navigate/navigate_route.h"
+#include "test_stubs.h"
+
+#define MAP_SQUARE      0
+
+#define GRID_SIZE       24       /* junctions per side */
+#define GRID_POINTS     (GRID_SIZE * GRID_SIZE)
+#define GRID_ROWS       (GRID_SIZE * (GRID_SIZE - 1))   /* east-west lines */
+#define GRID_LINES      (2 * GRID_ROWS)
+
+#define LINE_LENGTH     100
+#define TURN_COST       60
+
+/* As in navigate_route_astar.c */
+#define MAX_ALT_STRETCH 150
+#define MAX_ALT_OVERLAP 70
+
+#define MAX_ROUTES      3
+
+static int LineCost[GRID_LINES];
+
+
+/* --- The map --- */
+
+static int row_line (int x, int y) {
+
+   return y * (GRID_SIZE - 1) + x;
+}
+
+static int column_line (int x, int y) {
+
+   return GRID_ROWS + y * GRID_SIZE + x;
+}
+
+int roadmap_square_set_current (int square) {
+
+   return square == MAP_SQUARE;
+}
+
+int roadmap_square_active (void) {
+
+   return MAP_SQUARE;
+}
+
+int roadmap_square_points_count (int square) {
+
+   return GRID_POINTS;
+}
+
+void roadmap_square_set_screen_scale (int scale) {
+}
+
+int roadmap_square_get_screen_scale (void) {
+
+   return 0;
+}
+
+int roadmap_line_in_square (int square, int cfcc, int *first, int *last) {
+
+   if (cfcc != ROADMAP_ROAD_STREET) return 0;
+
+   *first = 0;
+   *last = GRID_LINES - 1;
+   return 1;
+}
+
+void roadmap_line_points (int line, int *from, int *to) {
+
+   if (line < GRID_ROWS) {
+      *from = (line / (GRID_SIZE - 1)) * GRID_SIZE + line % (GRID_SIZE - 1);
+      *to = *from + 1;
+   } else {
+      *from = line - GRID_ROWS;
+      *to = *from + GRID_SIZE;
+   }
+}
+
+void roadmap_line_from_point (int line, int *from) {
+
+   int to;
+
+   roadmap_line_points (line, from, &to);
+}
+
+void roadmap_line_to_point (int line, int *to) {
+
+   int from;
+
+   roadmap_line_points (line, &from, to);
+}
+
+int roadmap_line_cfcc (int line_id) {
+
+   return ROADMAP_ROAD_STREET;
+}
+
+int roadmap_line_length (int line) {
+
+   return LINE_LENGTH;
+}
+
+void roadmap_point_position (int point, RoadMapPosition *position) {
+
+   position->longitude = (point % GRID_SIZE) * 1000;
+   position->latitude = (point / GRID_SIZE) * 1000;
+}
+
+int roadmap_line_route_get_direction (int line, int who) {
+
+   return ROUTE_DIRECTION_ANY;
+}
+
+int roadmap_line_route_get_restrictions (int line, int against_dir) {
+
+   return 0;
+}
+
+int roadmap_street_extend_line_ends
+         (const PluginLine *line, RoadMapPosition *from, RoadMapPosition *to,
+          int flags, RoadMapStreetIterCB cb, void *context) {
+
+   return 0;
+}
+
+int roadmap_navigate_get_neighbours
+              (const RoadMapPosition *position, int scale, int accuracy, int max_shapes,
+               RoadMapNeighbour *neighbours, int max, int type) {
+
+   return 0;
+}
+
+int roadmap_math_distance
+        (const RoadMapPosition *position1, const RoadMapPosition *position2) {
+
+   return abs (position1->longitude - position2->longitude) +
+          abs (position1->latitude - position2->latitude);
+}
+
+int roadmap_math_to_cm (int value) {
+
+   return value * 100;
+}
+
+
+/* --- The rest of the route search --- */
+
+/* The cost of entering a line, with a turn penalty between a street and a
+ * cross street. A closed line can't be entered.
+ */
+static int turn_cost (int prev_line_id, int line_id) {
+
+   if (LineCost[line_id] < 0) return -1;
+
+   if (prev_line_id < 0) return LineCost[line_id];
+
+   if ((prev_line_id < GRID_ROWS) != (line_id < GRID_ROWS)) {
+      return LineCost[line_id] + TURN_COST;
+   }
+
+   return LineCost[line_id];
+}
+
+static int line_cost (int line_id, int is_reversed, int cur_cost,
+                      int prev_line_id, int is_prev_reversed, int node_id) {
+
+   return turn_cost (prev_line_id, line_id);
+}
+
+NavigateCostFn navigate_cost_get (void) {
+
+   return line_cost;
+}
+
+NavigateCostFn navigate_cost_get_time_dependent (void) {
+
+   return line_cost;
+}
+
+int navigate_cost_type (void) {
+
+   return COST_FASTEST;
+}
+
+void navigate_cost_set_departure (time_t departure) {
+}
+
+time_t navigate_cost_get_departure (void) {
+
+   return 0;
+}
+
+int navigate_ch_enabled (void) {
+
+   return 0;
+}
+
+int navigate_ch_route (int start_square, int start_line, int start_reversed,
+                       int goal_square, int goal_line,
+                       NavigateChPathCB cb, void *context,
+                       int *route_total_cost, int *goal_reversed) {
+
+   return -1;
+}
+
+void navigate_ch_clear (int square) {
+}
+
+/* roadmap_dialog.h maps the name to an inline wrapper, which is not included */
+void roadmap_dialog_set_progress (const char *frame, const char *name, int progress) {
+}
+
+const char *roadmap_lang_get (const char *name) {
+
+   return name;
+}
+
+void roadmap_main_flush (void) {
+}
+
+
+/* --- Checks --- */
+
+static void make_line (PluginLine *line, int line_id) {
+
+   line->plugin_id = ROADMAP_PLUGIN_ID;
+   line->line_id = line_id;
+   line->cfcc = ROADMAP_ROAD_STREET;
+   line->square = MAP_SQUARE;
+   line->fips = 0;
+}
+
+/* The cost of a route, as the alternatives search prices it: each line
+ * costs its own cost, and the turn into it.
+ */
+static int segments_cost (const NavigateSegment *segments, int count) {
+
+   int cost = 0;
+   int i;
+
+   for (i = 0; i < count; i++) {
+      cost += turn_cost (i > 0 ? segments[i - 1].line : -1, segments[i].line);
+   }
+
+   return cost;
+}
+
+/* Each segment starts at the junction where the previous one ends */
+static int segments_connected (const NavigateSegment *segments, int count) {
+
+   int prev_end = -1;
+   int i;
+
+   for (i = 0; i < count; i++) {
+
+      int from;
+      int to;
+
+      roadmap_line_points (segments[i].line, &from, &to);
+      if (segments[i].line_direction != ROUTE_DIRECTION_WITH_LINE) {
+         int tmp = from;
+         from = to;
+         to = tmp;
+      }
+
+      if (i > 0 && from != prev_end) return 0;
+      if (LineCost[segments[i].line] < 0) return 0;
+      prev_end = to;
+   }
+
+   return 1;
+}
+
+/* Percent of the route on lines of the routes before it */
+static int route_overlap (const NavigateRouteAlternative *routes, int index) {
+
+   int shared = 0;
+   int i;
+   int j;
+   int k;
+
+   for (i = 0; i < routes[index].num_segments; i++) {
+
+      int line = routes[index].segments[i].line;
+      int found = 0;
+
+      for (j = 0; j < index && !found; j++) {
+         for (k = 0; k < routes[j].num_segments && !found; k++) {
+            found = routes[j].segments[k].line == line;
+         }
+      }
+      if (found) shared++;
+   }
+
+   return shared * 100 / routes[index].num_segments;
+}
+
+/* The cost of a plain search between the two lines */
+static int best_cost (NavigateRouteSearch *search, PluginLine *from_line, int from_point,
+                      const PluginLine *to_line, int to_point) {
+
+   NavigateSegment *segments;
+   PluginLine goal = *to_line;
+   int goal_point = to_point;
+   int num_total;
+   int num_new;
+   int flags = RECALC_ROUTE;
+
+   if (navigate_route_search_get_segments (search, from_line, from_point,
+                                           &goal, &goal_point, &segments,
+                                           &num_total, &num_new, &flags, NULL, 0) <= 0) {
+      return -1;
+   }
+
+   return segments_cost (segments, num_total);
+}
+
+/* The alternatives between two lines, checked. Returns the number of routes. */
+static int check_alternatives (NavigateRouteSearch *search, int from_line_id, int to_line_id) {
+
+   NavigateRouteAlternative routes[MAX_ROUTES];
+   PluginLine from_line;
+   PluginLine to_line;
+   int from_point;
+   int to_point;
+   int best;
+   int count;
+   int i;
+
+   make_line (&from_line, from_line_id);
+   make_line (&to_line, to_line_id);
+   roadmap_line_to_point (from_line_id, &from_point);
+   roadmap_line_to_point (to_line_id, &to_point);
+
+   best = best_cost (search, &from_line, from_point, &to_line, to_point);
+
+   count = navigate_route_search_alternatives (search, &from_line, from_point,
+                                               &to_line, to_point, MAX_ROUTES, routes);
+
+   TEST_CHECK (count >= 1 && count <= MAX_ROUTES);
+   if (count < 1) return 0;
+
+   TEST_CHECK (routes[0].cost == best);
+
+   for (i = 0; i < count; i++) {
+
+      const NavigateRouteAlternative *route = routes + i;
+
+      TEST_CHECK (route->num_segments > 0);
+      TEST_CHECK (route->segments[0].line == from_line_id);
+      TEST_CHECK (route->segments[route->num_segments - 1].line == to_line_id);
+      TEST_CHECK (segments_connected (route->segments, route->num_segments));
+
+      TEST_CHECK (route->cost == segments_cost (route->segments, route->num_segments));
+      TEST_CHECK (route->length == route->num_segments * LINE_LENGTH);
+
+      TEST_CHECK (route->cost * 100 <= routes[0].cost * MAX_ALT_STRETCH);
+      if (i > 0) TEST_CHECK (route_overlap (routes, i) <= MAX_ALT_OVERLAP);
+   }
+
+   /* No penalty is left for the next search */
+   TEST_CHECK (best_cost (search, &from_line, from_point, &to_line, to_point) == best);
+
+   navigate_route_alternatives_free (routes, count);
+
+   return count;
+}
+
+
+/* --- The maps --- */
+
+static void open_grid (int random_costs) {
+
+   int i;
+
+   for (i = 0; i < GRID_LINES; i++) {
+      LineCost[i] = random_costs ? 10 + rand () % 90 : 100;
+   }
+}
+
+/* The columns between west and east can only be crossed on row y */
+static void corridor_grid (int west, int east, int y) {
+
+   int i;
+   int j;
+
+   open_grid (0);
+
+   for (i = west; i < east; i++) {
+      for (j = 0; j < GRID_SIZE; j++) {
+         if (j != y) LineCost[row_line (i, j)] = -1;
+      }
+   }
+
+   for (i = west + 1; i < east; i++) {
+      for (j = 0; j < GRID_SIZE - 1; j++) {
+         LineCost[column_line (i, j)] = -1;
+      }
+   }
+}
+
+
+int main (int argc, char **argv) {
+
+   NavigateRouteSearch *search;
+   int pairs = 50;
+   int total = 0;
+   int with_alternatives = 0;
+   double start;
+   double elapsed;
+   int count;
+   int i;
+
+   if (argc > 1) pairs = atoi (argv[1]);
+   if (pairs < 1) {
+      fprintf (stderr, "Usage: %s [pairs]\n", argv[0]);
+      return 1;
+   }
+
+   search = navigate_route_search_new ();
+
+   srand (1);
+
+   /* The open grid, between random rows far apart */
+   open_grid (1);
+
+   start = test_time_ms ();
+   for (i = 0; i < pairs; i++) {
+
+      int from = row_line (rand () % 4, rand () % GRID_SIZE);
+      int to = row_line (GRID_SIZE - 2 - rand () % 4, rand () % GRID_SIZE);
+
+      count = check_alternatives (search, from, to);
+      total += count;
+      if (count > 1) with_alternatives++;
+   }
+   elapsed = test_time_ms () - start;
+
+   /* Alternatives are found on an open grid */
+   TEST_CHECK (with_alternatives > pairs / 2);
+
+   printf ("%d pairs: %d routes, %d pairs with alternatives: %8.1f ms  %6.2f ms/pair\n",
+           pairs, total, with_alternatives, elapsed, elapsed / pairs);
+
+   /* Stretch: the lines meet, any other route goes around a block */
+   open_grid (0);
+   count = check_alternatives (search, row_line (10, 12), row_line (11, 12));
+   TEST_CHECK (count == 1);
+   printf ("meeting lines: %d route(s)\n", count);
+
+   /* Overlap: the corridor is most of every route */
+   corridor_grid (2, GRID_SIZE - 3, 12);
+   count = check_alternatives (search, row_line (0, 12), row_line (GRID_SIZE - 2, 12));
+   TEST_CHECK (count == 1);
+   printf ("long corridor: %d route(s)\n", count);
+
+   /* Within the overlap: the corridor is a small part of the routes */
+   corridor_grid (11, 13, 12);
+   count = check_alternatives (search, row_line (0, 12), row_line (GRID_SIZE - 2, 12));
+   TEST_CHECK (count > 1);
+   printf ("short corridor: %d route(s)\n", count);
+
+   navigate_route_search_free (search);
+
+   return test_result ("bench_route_alternatives");
+}
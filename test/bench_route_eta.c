@@ -0,0 +1,465 @@
+/* bench_route_eta.c - Time dependent travel times and departure sweeps.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The map is one square with two ways between the same junctions: a
+ *   highway which is faster than the regular A* bound of 100 km/h, except
+ *   during a rush hour when it is jammed, and a side road of constant
+ *   speed. navigate_route_search_eta() runs over it with the real square
+ *   graph, and navigate_route_search_eta_sweep() over a series of
+ *   departures around the rush hour. Every travel time is checked against
+ *   a time dependent Dijkstra search, which prices the lines as the route
+ *   search does.
+ *
+ *   Usage: bench_route_eta [departures]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "roadmap.h"
+#include "roadmap_plugin.h"
+#include "roadmap_point.h"
+#include "roadmap_line.h"
+#include "roadmap_line_route.h"
+#include "roadmap_street.h"
+#include "roadmap_square.h"
+#include "roadmap_math.h"
+#include "roadmap_navigate.h"
+#include "roadmap_lang.h"
+#include "roadmap_main.h"
+#include "navigate/navigate_main.h"
+#include "navigate/navigate_cost.h"
+#include "navigate/navigate_ch.h"
+#include "navigate/navigate_queue.h"
+#include "navigate/navigate_route.h"
+#include "test_stubs.h"
+
+#define MAP_SQUARE      0
+
+#define SPAN            40       /* lines of the highway */
+#define SPACING         100      /* meters between junctions */
+
+/* Points: the start, the highway junctions, the side road junctions and
+ * the end. The start line leads to the first highway junction, and the
+ * goal line leaves the last one.
+ */
+#define START_POINT     0
+#define HIGHWAY_POINT   1
+#define SIDE_POINT      (HIGHWAY_POINT + SPAN + 1)
+#define END_POINT       (SIDE_POINT + SPAN + 1)
+#define MAP_POINTS      (END_POINT + 1)
+
+#define START_LINE      0
+#define HIGHWAY_LINE    1
+#define SIDE_LINE       (HIGHWAY_LINE + SPAN)      /* up, along, down */
+#define GOAL_LINE       (SIDE_LINE + SPAN + 2)
+#define MAP_LINES       (GOAL_LINE + 1)
+
+#define HIGHWAY_SPEED   250      /* km/h */
+#define JAMMED_SPEED    15
+#define SIDE_SPEED      60
+
+#define DEPARTURE       1000000000
+#define RUSH_START      (DEPARTURE + 3600)
+#define RUSH_END        (RUSH_START + 3600)
+#define SWEEP_INTERVAL  300
+
+static int    LineFrom[MAP_LINES];
+static int    LineTo[MAP_LINES];
+static time_t Departure;
+
+
+/* --- The map --- */
+
+static void build_map (void) {
+
+   int i;
+
+   LineFrom[START_LINE] = START_POINT;
+   LineTo[START_LINE] = HIGHWAY_POINT;
+
+   for (i = 0; i < SPAN; i++) {
+      LineFrom[HIGHWAY_LINE + i] = HIGHWAY_POINT + i;
+      LineTo[HIGHWAY_LINE + i] = HIGHWAY_POINT + i + 1;
+   }
+
+   LineFrom[SIDE_LINE] = HIGHWAY_POINT;
+   LineTo[SIDE_LINE] = SIDE_POINT;
+
+   for (i = 0; i < SPAN; i++) {
+      LineFrom[SIDE_LINE + 1 + i] = SIDE_POINT + i;
+      LineTo[SIDE_LINE + 1 + i] = SIDE_POINT + i + 1;
+   }
+
+   LineFrom[SIDE_LINE + SPAN + 1] = SIDE_POINT + SPAN;
+   LineTo[SIDE_LINE + SPAN + 1] = HIGHWAY_POINT + SPAN;
+
+   LineFrom[GOAL_LINE] = HIGHWAY_POINT + SPAN;
+   LineTo[GOAL_LINE] = END_POINT;
+}
+
+int roadmap_square_set_current (int square) {
+
+   return square == MAP_SQUARE;
+}
+
+int roadmap_square_active (void) {
+
+   return MAP_SQUARE;
+}
+
+int roadmap_square_points_count (int square) {
+
+   return MAP_POINTS;
+}
+
+void roadmap_square_set_screen_scale (int scale) {
+}
+
+int roadmap_square_get_screen_scale (void) {
+
+   return 0;
+}
+
+int roadmap_line_in_square (int square, int cfcc, int *first, int *last) {
+
+   if (cfcc != ROADMAP_ROAD_STREET) return 0;
+
+   *first = 0;
+   *last = MAP_LINES - 1;
+   return 1;
+}
+
+void roadmap_line_points (int line, int *from, int *to) {
+
+   *from = LineFrom[line];
+   *to = LineTo[line];
+}
+
+void roadmap_line_from_point (int line, int *from) {
+
+   *from = LineFrom[line];
+}
+
+void roadmap_line_to_point (int line, int *to) {
+
+   *to = LineTo[line];
+}
+
+int roadmap_line_cfcc (int line_id) {
+
+   return ROADMAP_ROAD_STREET;
+}
+
+int roadmap_line_length (int line) {
+
+   return SPACING;
+}
+
+void roadmap_point_position (int point, RoadMapPosition *position) {
+
+   if (point == START_POINT) {
+      position->longitude = -SPACING;
+      position->latitude = 0;
+   } else if (point == END_POINT) {
+      position->longitude = (SPAN + 1) * SPACING;
+      position->latitude = 0;
+   } else if (point < SIDE_POINT) {
+      position->longitude = (point - HIGHWAY_POINT) * SPACING;
+      position->latitude = 0;
+   } else {
+      position->longitude = (point - SIDE_POINT) * SPACING;
+      position->latitude = SPACING;
+   }
+}
+
+int roadmap_line_route_get_direction (int line, int who) {
+
+   return ROUTE_DIRECTION_ANY;
+}
+
+int roadmap_line_route_get_restrictions (int line, int against_dir) {
+
+   return 0;
+}
+
+int roadmap_street_extend_line_ends
+         (const PluginLine *line, RoadMapPosition *from, RoadMapPosition *to,
+          int flags, RoadMapStreetIterCB cb, void *context) {
+
+   return 0;
+}
+
+int roadmap_navigate_get_neighbours
+              (const RoadMapPosition *position, int scale, int accuracy, int max_shapes,
+               RoadMapNeighbour *neighbours, int max, int type) {
+
+   return 0;
+}
+
+/* Meters */
+int roadmap_math_distance
+        (const RoadMapPosition *position1, const RoadMapPosition *position2) {
+
+   return abs (position1->longitude - position2->longitude) +
+          abs (position1->latitude - position2->latitude);
+}
+
+int roadmap_math_to_cm (int value) {
+
+   return value * 100;
+}
+
+
+/* --- The rest of the route search --- */
+
+/* The historical speed of a line at a time of day */
+static int line_speed (int line_id, time_t at) {
+
+   if (line_id >= HIGHWAY_LINE && line_id < HIGHWAY_LINE + SPAN) {
+      if (at >= RUSH_START && at < RUSH_END) return JAMMED_SPEED;
+      return HIGHWAY_SPEED;
+   }
+
+   return SIDE_SPEED;
+}
+
+/* As roadmap_line_speed_get_cross_time_at () */
+static int line_cost_at (int line_id, int is_reversed, int cur_cost,
+                         int prev_line_id, int is_prev_reversed, int node_id) {
+
+   int speed = line_speed (line_id, Departure + (time_t)cur_cost);
+
+   return (int)(roadmap_line_length (line_id) * 3.6 / speed) + 1;
+}
+
+static int line_cost (int line_id, int is_reversed, int cur_cost,
+                      int prev_line_id, int is_prev_reversed, int node_id) {
+
+   return (int)(roadmap_line_length (line_id) * 3.6 / SIDE_SPEED) + 1;
+}
+
+NavigateCostFn navigate_cost_get (void) {
+
+   return line_cost;
+}
+
+NavigateCostFn navigate_cost_get_time_dependent (void) {
+
+   return line_cost_at;
+}
+
+int navigate_cost_type (void) {
+
+   return COST_FASTEST;
+}
+
+void navigate_cost_set_departure (time_t departure) {
+
+   Departure = departure;
+}
+
+time_t navigate_cost_get_departure (void) {
+
+   return Departure;
+}
+
+int navigate_ch_enabled (void) {
+
+   return 0;
+}
+
+int navigate_ch_route (int start_square, int start_line, int start_reversed,
+                       int goal_square, int goal_line,
+                       NavigateChPathCB cb, void *context,
+                       int *route_total_cost, int *goal_reversed) {
+
+   return -1;
+}
+
+void navigate_ch_clear (int square) {
+}
+
+/* roadmap_dialog.h maps the name to an inline wrapper, which is not included */
+void roadmap_dialog_set_progress (const char *frame, const char *name, int progress) {
+}
+
+const char *roadmap_lang_get (const char *name) {
+
+   return name;
+}
+
+void roadmap_main_flush (void) {
+}
+
+
+/* --- The reference search --- */
+
+static int junction_lines (int point, int *lines) {
+
+   int count = 0;
+   int i;
+
+   for (i = 0; i < MAP_LINES; i++) {
+      if (LineFrom[i] == point || LineTo[i] == point) lines[count++] = i;
+   }
+
+   return count;
+}
+
+/* The travel time from the start line to the goal line, as the route search
+ * prices it: each line after the start line costs its time when it is
+ * reached, and one more second.
+ */
+static int reference_eta (NavigateQueue *q, time_t departure) {
+
+   int state_cost[2 * MAP_LINES];
+   int best;
+   int i;
+
+   for (i = 0; i < 2 * MAP_LINES; i++) state_cost[i] = INT_MAX;
+
+   navigate_queue_reset (q);
+   state_cost[START_LINE * 2] = 0;
+   navigate_queue_insert (q, 0, (void *)(long) (START_LINE * 2));
+
+   while (!navigate_queue_empty (q)) {
+
+      int cost = navigate_queue_min_key (q);
+      int state = (int)(long) navigate_queue_extract_min (q);
+      int line = state / 2;
+      int node = (state & 1) ? LineFrom[line] : LineTo[line];
+      int lines[MAP_LINES];
+      int count;
+
+      if (cost > state_cost[state]) continue;
+
+      count = junction_lines (node, lines);
+
+      for (i = 0; i < count; i++) {
+
+         int next;
+         int next_cost;
+
+         if (lines[i] == line) continue;
+
+         next = lines[i] * 2 + (LineFrom[lines[i]] == node ? 0 : 1);
+         next_cost = cost + (int)(SPACING * 3.6 / line_speed (lines[i], departure + cost)) + 2;
+
+         if (next_cost < state_cost[next]) {
+            state_cost[next] = next_cost;
+            navigate_queue_insert (q, next_cost, (void *)(long) next);
+         }
+      }
+   }
+
+   best = state_cost[GOAL_LINE * 2];
+   if (state_cost[GOAL_LINE * 2 + 1] < best) best = state_cost[GOAL_LINE * 2 + 1];
+
+   return best == INT_MAX ? -1 : best;
+}
+
+
+/* --- The benchmark --- */
+
+int main (int argc, char **argv) {
+
+   NavigateRouteSearch *search;
+   NavigateQueue *q;
+   PluginLine from_line = {ROADMAP_PLUGIN_ID, START_LINE, ROADMAP_ROAD_STREET, MAP_SQUARE, 0};
+   PluginLine to_line = {ROADMAP_PLUGIN_ID, GOAL_LINE, ROADMAP_ROAD_STREET, MAP_SQUARE, 0};
+   time_t first_departure;
+   int *travel_times;
+   int *expected;
+   int departures = 25;
+   int expected_best = -1;
+   int wrong = 0;
+   int best;
+   double start;
+   double elapsed;
+   int i;
+
+   if (argc > 1) departures = atoi (argv[1]);
+   if (departures < 1) {
+      fprintf (stderr, "Usage: %s [departures]\n", argv[0]);
+      return 1;
+   }
+
+   travel_times = malloc (departures * sizeof (int));
+   expected = malloc (departures * sizeof (int));
+   roadmap_check_allocated (travel_times);
+   roadmap_check_allocated (expected);
+
+   build_map ();
+   search = navigate_route_search_new ();
+   q = navigate_queue_new (NAVIGATE_QUEUE_HEAP, 64);
+
+   /* Off peak the highway is taken, although it is faster than 100 km/h */
+   Departure = DEPARTURE - 1;
+   i = navigate_route_search_eta (search, &from_line, HIGHWAY_POINT, &to_line, END_POINT, DEPARTURE);
+   printf ("off peak   %4d s  (highway %d km/h, expected %d s)\n",
+           i, HIGHWAY_SPEED, reference_eta (q, DEPARTURE));
+   TEST_CHECK (i == reference_eta (q, DEPARTURE));
+   TEST_CHECK (Departure == DEPARTURE - 1);
+
+   i = navigate_route_search_eta (search, &from_line, HIGHWAY_POINT, &to_line, END_POINT, RUSH_START);
+   printf ("rush hour  %4d s  (side road %d km/h, expected %d s)\n",
+           i, SIDE_SPEED, reference_eta (q, RUSH_START));
+   TEST_CHECK (i == reference_eta (q, RUSH_START));
+
+   /* The first departure reaches the jam half way, the best one is after it */
+   first_departure = RUSH_START - 60;
+
+   start = test_time_ms ();
+   best = navigate_route_search_eta_sweep (search, &from_line, HIGHWAY_POINT, &to_line, END_POINT,
+                                           first_departure, SWEEP_INTERVAL, departures,
+                                           travel_times);
+   elapsed = test_time_ms () - start;
+
+   for (i = 0; i < departures; i++) {
+
+      expected[i] = reference_eta (q, first_departure + (time_t)i * SWEEP_INTERVAL);
+
+      if (travel_times[i] != expected[i]) wrong++;
+      if (expected[i] >= 0 &&
+          (expected_best < 0 || expected[i] < expected[expected_best])) {
+         expected_best = i;
+      }
+   }
+
+   printf ("sweep      %4d departures every %d s: %6.2f ms/departure, best %d (%d s), %d wrong\n",
+           departures, SWEEP_INTERVAL, elapsed / departures, best,
+           best >= 0 ? travel_times[best] : -1, wrong);
+
+   TEST_CHECK (wrong == 0);
+   TEST_CHECK (best == expected_best);
+
+   navigate_queue_free (q);
+   navigate_route_search_free (search);
+   free (travel_times);
+   free (expected);
+
+   return test_result ("bench_route_eta");
+}
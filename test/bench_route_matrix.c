@@ -0,0 +1,473 @@
+/* bench_route_matrix.c - Travel cost matrices over a grid of streets.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The map is one square holding a grid of two way streets, each with a
+ *   random cost, and every turn costs TURN_COST more than going straight.
+ *   navigate_route_search_matrix() runs over it, with the real square
+ *   graph, and every entry of the matrix is checked against a plain
+ *   Dijkstra search over the (line, direction) graph of the grid. The
+ *   routes of navigate_route_search_get_segments() between the same lines
+ *   are priced as well, and may never be cheaper than the matrix.
+ *
+ *   Usage: bench_route_matrix [origins [destinations]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "roadmap.h"
+#include "roadmap_plugin.h"
+#include "roadmap_point.h"
+#include "roadmap_line.h"
+#include "roadmap_line_route.h"
+#include "roadmap_line_speed.h"
+#include "roadmap_street.h"
+#include "roadmap_square.h"
+#include "roadmap_math.h"
+#include "roadmap_navigate.h"
+#include "roadmap_lang.h"
+#include "roadmap_main.h"
+#include "navigate/navigate_main.h"
+#include "navigate/navigate_cost.h"
+#include "navigate/navigate_ch.h"
+#include "navigate/navigate_queue.h"
+#include "navigate/navigate_route.h"
+#include "test_stubs.h"
+
+#define MAP_SQUARE      0
+
+#define GRID_SIZE       48       /* junctions per side */
+#define GRID_POINTS     (GRID_SIZE * GRID_SIZE)
+#define GRID_ROWS       (GRID_SIZE * (GRID_SIZE - 1))   /* east-west lines */
+#define GRID_LINES      (2 * GRID_ROWS)
+
+#define TURN_COST       60
+
+static int LineCost[GRID_LINES];
+
+
+/* --- The map --- */
+
+int roadmap_square_set_current (int square) {
+
+   return square == MAP_SQUARE;
+}
+
+int roadmap_square_active (void) {
+
+   return MAP_SQUARE;
+}
+
+int roadmap_square_points_count (int square) {
+
+   return GRID_POINTS;
+}
+
+void roadmap_square_set_screen_scale (int scale) {
+}
+
+int roadmap_square_get_screen_scale (void) {
+
+   return 0;
+}
+
+int roadmap_line_in_square (int square, int cfcc, int *first, int *last) {
+
+   if (cfcc != ROADMAP_ROAD_STREET) return 0;
+
+   *first = 0;
+   *last = GRID_LINES - 1;
+   return 1;
+}
+
+void roadmap_line_points (int line, int *from, int *to) {
+
+   if (line < GRID_ROWS) {
+      *from = (line / (GRID_SIZE - 1)) * GRID_SIZE + line % (GRID_SIZE - 1);
+      *to = *from + 1;
+   } else {
+      *from = line - GRID_ROWS;
+      *to = *from + GRID_SIZE;
+   }
+}
+
+void roadmap_line_from_point (int line, int *from) {
+
+   int to;
+
+   roadmap_line_points (line, from, &to);
+}
+
+void roadmap_line_to_point (int line, int *to) {
+
+   int from;
+
+   roadmap_line_points (line, &from, to);
+}
+
+int roadmap_line_cfcc (int line_id) {
+
+   return ROADMAP_ROAD_STREET;
+}
+
+int roadmap_line_length (int line) {
+
+   return 100;
+}
+
+void roadmap_point_position (int point, RoadMapPosition *position) {
+
+   position->longitude = (point % GRID_SIZE) * 1000;
+   position->latitude = (point / GRID_SIZE) * 1000;
+}
+
+int roadmap_line_route_get_direction (int line, int who) {
+
+   return ROUTE_DIRECTION_ANY;
+}
+
+int roadmap_line_route_get_restrictions (int line, int against_dir) {
+
+   return 0;
+}
+
+int roadmap_street_extend_line_ends
+         (const PluginLine *line, RoadMapPosition *from, RoadMapPosition *to,
+          int flags, RoadMapStreetIterCB cb, void *context) {
+
+   return 0;
+}
+
+int roadmap_navigate_get_neighbours
+              (const RoadMapPosition *position, int scale, int accuracy, int max_shapes,
+               RoadMapNeighbour *neighbours, int max, int type) {
+
+   return 0;
+}
+
+int roadmap_math_distance
+        (const RoadMapPosition *position1, const RoadMapPosition *position2) {
+
+   return abs (position1->longitude - position2->longitude) +
+          abs (position1->latitude - position2->latitude);
+}
+
+int roadmap_math_to_cm (int value) {
+
+   return value * 100;
+}
+
+
+/* --- The rest of the route search --- */
+
+/* The cost of entering a line, with a turn penalty between a street and a
+ * cross street.
+ */
+static int turn_cost (int prev_line_id, int line_id) {
+
+   if (prev_line_id < 0) return LineCost[line_id];
+
+   if ((prev_line_id < GRID_ROWS) != (line_id < GRID_ROWS)) {
+      return LineCost[line_id] + TURN_COST;
+   }
+
+   return LineCost[line_id];
+}
+
+static int line_cost (int line_id, int is_reversed, int cur_cost,
+                      int prev_line_id, int is_prev_reversed, int node_id) {
+
+   return turn_cost (prev_line_id, line_id);
+}
+
+NavigateCostFn navigate_cost_get (void) {
+
+   return line_cost;
+}
+
+NavigateCostFn navigate_cost_get_time_dependent (void) {
+
+   return line_cost;
+}
+
+int navigate_cost_type (void) {
+
+   return COST_FASTEST;
+}
+
+void navigate_cost_set_departure (time_t departure) {
+}
+
+time_t navigate_cost_get_departure (void) {
+
+   return 0;
+}
+
+int navigate_ch_enabled (void) {
+
+   return 0;
+}
+
+int navigate_ch_route (int start_square, int start_line, int start_reversed,
+                       int goal_square, int goal_line,
+                       NavigateChPathCB cb, void *context,
+                       int *route_total_cost, int *goal_reversed) {
+
+   return -1;
+}
+
+void navigate_ch_clear (int square) {
+}
+
+/* roadmap_dialog.h maps the name to an inline wrapper, which is not included */
+void roadmap_dialog_set_progress (const char *frame, const char *name, int progress) {
+}
+
+const char *roadmap_lang_get (const char *name) {
+
+   return name;
+}
+
+void roadmap_main_flush (void) {
+}
+
+
+/* --- The reference search --- */
+
+/* The lines which meet at a junction */
+static int junction_lines (int point, int *lines) {
+
+   int x = point % GRID_SIZE;
+   int y = point / GRID_SIZE;
+   int count = 0;
+
+   if (x + 1 < GRID_SIZE) lines[count++] = y * (GRID_SIZE - 1) + x;
+   if (x > 0) lines[count++] = y * (GRID_SIZE - 1) + x - 1;
+   if (y + 1 < GRID_SIZE) lines[count++] = GRID_ROWS + point;
+   if (y > 0) lines[count++] = GRID_ROWS + point - GRID_SIZE;
+
+   return count;
+}
+
+/* The cost of reaching each line, in either direction, as the route search
+ * prices it: the lines after the origin line cost their own cost.
+ */
+static void reference_row (NavigateQueue *q, int *state_cost, int origin, int reversed,
+                           const PluginLine *destinations, int num_destinations,
+                           int *costs) {
+
+   int i;
+
+   for (i = 0; i < 2 * GRID_LINES; i++) state_cost[i] = INT_MAX;
+
+   navigate_queue_reset (q);
+   state_cost[origin * 2 + reversed] = 0;
+   navigate_queue_insert (q, 0, (void *)(long) (origin * 2 + reversed));
+
+   while (!navigate_queue_empty (q)) {
+
+      int cost = navigate_queue_min_key (q);
+      int state = (int)(long) navigate_queue_extract_min (q);
+      int line = state / 2;
+      int lines[4];
+      int from;
+      int to;
+      int count;
+
+      if (cost > state_cost[state]) continue;
+
+      roadmap_line_points (line, &from, &to);
+      count = junction_lines ((state & 1) ? from : to, lines);
+
+      for (i = 0; i < count; i++) {
+
+         int next_from;
+         int next_to;
+         int next;
+
+         if (lines[i] == line) continue;
+
+         roadmap_line_points (lines[i], &next_from, &next_to);
+         next = lines[i] * 2 + (next_from == ((state & 1) ? from : to) ? 0 : 1);
+
+         if (cost + turn_cost (line, lines[i]) < state_cost[next]) {
+            state_cost[next] = cost + turn_cost (line, lines[i]);
+            navigate_queue_insert (q, state_cost[next], (void *)(long) next);
+         }
+      }
+   }
+
+   for (i = 0; i < num_destinations; i++) {
+
+      int forward = state_cost[destinations[i].line_id * 2];
+      int backward = state_cost[destinations[i].line_id * 2 + 1];
+      int best = forward < backward ? forward : backward;
+
+      costs[i] = best == INT_MAX ? -1 : best;
+   }
+}
+
+
+/* The cost of a route of the A* search, priced the same way */
+static int segments_cost (const NavigateSegment *segments, int count) {
+
+   int cost = 0;
+   int i;
+
+   for (i = 1; i < count; i++) {
+      cost += turn_cost (segments[i - 1].line, segments[i].line);
+   }
+
+   return cost;
+}
+
+
+/* --- The benchmark --- */
+
+static void random_line (PluginLine *line) {
+
+   line->plugin_id = ROADMAP_PLUGIN_ID;
+   line->line_id = rand () % GRID_LINES;
+   line->cfcc = ROADMAP_ROAD_STREET;
+   line->square = MAP_SQUARE;
+   line->fips = 0;
+}
+
+
+int main (int argc, char **argv) {
+
+   NavigateRouteSearch *search;
+   NavigateQueue *q;
+   PluginLine *origins;
+   PluginLine *destinations;
+   int *origin_points;
+   int *costs;
+   int *expected;
+   int *state_cost;
+   int num_origins = 20;
+   int num_destinations = 50;
+   int num_longer = 0;
+   double start;
+   double elapsed;
+   int i;
+
+   if (argc > 1) num_origins = atoi (argv[1]);
+   if (argc > 2) num_destinations = atoi (argv[2]);
+   if (num_origins < 1 || num_destinations < 1) {
+      fprintf (stderr, "Usage: %s [origins [destinations]]\n", argv[0]);
+      return 1;
+   }
+
+   origins = malloc (num_origins * sizeof (PluginLine));
+   origin_points = malloc (num_origins * sizeof (int));
+   destinations = malloc (num_destinations * sizeof (PluginLine));
+   costs = malloc (num_origins * num_destinations * sizeof (int));
+   expected = malloc (num_destinations * sizeof (int));
+   state_cost = malloc (2 * GRID_LINES * sizeof (int));
+   roadmap_check_allocated (origins);
+   roadmap_check_allocated (origin_points);
+   roadmap_check_allocated (destinations);
+   roadmap_check_allocated (costs);
+   roadmap_check_allocated (expected);
+   roadmap_check_allocated (state_cost);
+
+   srand (1);
+
+   for (i = 0; i < GRID_LINES; i++) LineCost[i] = 10 + rand () % 90;
+
+   for (i = 0; i < num_origins; i++) {
+
+      int from;
+      int to;
+
+      random_line (origins + i);
+      roadmap_line_points (origins[i].line_id, &from, &to);
+      origin_points[i] = rand () % 2 ? from : to;
+   }
+
+   for (i = 0; i < num_destinations; i++) random_line (destinations + i);
+
+   search = navigate_route_search_new ();
+
+   start = test_time_ms ();
+   TEST_CHECK (navigate_route_search_matrix (search, origins, origin_points, num_origins,
+                                             destinations, num_destinations, costs) == 0);
+   elapsed = test_time_ms () - start;
+
+   printf ("%dx%d matrix over %d lines: %8.1f ms  %6.2f ms/origin\n",
+           num_origins, num_destinations, GRID_LINES, elapsed, elapsed / num_origins);
+
+   q = navigate_queue_new (NAVIGATE_QUEUE_HEAP, 1024);
+
+   for (i = 0; i < num_origins; i++) {
+
+      int from;
+      int to;
+      int j;
+
+      roadmap_line_points (origins[i].line_id, &from, &to);
+      reference_row (q, state_cost, origins[i].line_id,
+                     origin_points[i] == from && origin_points[i] != to,
+                     destinations, num_destinations, expected);
+
+      for (j = 0; j < num_destinations; j++) {
+
+         NavigateSegment *segments;
+         PluginLine goal = destinations[j];
+         int goal_point;
+         int num_total;
+         int num_new;
+         int flags = RECALC_ROUTE;
+         int route;
+
+         TEST_CHECK (costs[i * num_destinations + j] == expected[j]);
+
+         roadmap_line_to_point (goal.line_id, &goal_point);
+         TEST_CHECK (navigate_route_search_get_segments (search, origins + i, origin_points[i],
+                                                         &goal, &goal_point, &segments,
+                                                         &num_total, &num_new, &flags,
+                                                         NULL, 0) > 0);
+
+         route = segments_cost (segments, num_total);
+         TEST_CHECK (route >= costs[i * num_destinations + j]);
+         if (route > costs[i * num_destinations + j]) num_longer++;
+      }
+   }
+
+   printf ("A* routes costlier than the matrix: %d of %d\n",
+           num_longer, num_origins * num_destinations);
+
+   navigate_queue_free (q);
+   navigate_route_search_free (search);
+
+   free (origins);
+   free (origin_points);
+   free (destinations);
+   free (costs);
+   free (expected);
+   free (state_cost);
+
+   return test_result ("bench_route_matrix");
+}
@@ -0,0 +1,808 @@
+/* bench_tile_fetch.c - Tile downloads from a local HTTP server.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   A stub tile server runs on a local socket. It answers each request a
+ *   fixed latency after the request arrived, and a new connection costs the
+ *   same latency before it is usable, as a TCP handshake would. The tiles
+ *   are fetched as the tile manager does: with one connection per tile, or
+ *   over keep-alive connections carrying several pipelined requests. The
+ *   content of every tile is checked.
+ *
+ *   The pipelined fetch is repeated with a server which closes each
+ *   connection after a few responses, and with a request aborted while its
+ *   response is being received.
+ *
+ *   bench_tile_fetch_epoll is the same program built with ROADMAP_NET_EPOLL:
+ *   the sockets are then waited on by the real unix/roadmap_net_reactor.c,
+ *   and roadmap_main_set_input() is not there to be called.
+ *
+ *   Usage: bench_tile_fetch [tiles [latency_ms]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "roadmap.h"
+#include "roadmap_io.h"
+#include "roadmap_net.h"
+#include "roadmap_main.h"
+#include "roadmap_net_reactor.h"
+#include "roadmap_net_mon.h"
+#include "roadmap_httpcopy_async.h"
+#include "websvc_trans/websvc_address.h"
+#include "websvc_trans/websvc_address_defs.h"
+#include "test_stubs.h"
+
+#define CONNECTIONS        3     /* as TM_MAX_CONCURRENT */
+#define PIPELINE_DEPTH     4     /* as TM_PIPELINE_DEPTH */
+#define MAX_TILES          2000
+#define MAX_INPUTS         64
+#define MAX_CONNECTS       64
+#define WAIT_TIMEOUT_MS    20000
+
+static int Latency = 10;         /* ms */
+static int ServerPort;
+static int KeepAliveMax;         /* responses per connection, 0 for no limit */
+static int SlowTile = -1;        /* its body is sent a latency after its header */
+
+static pthread_mutex_t ServerMutex = PTHREAD_MUTEX_INITIALIZER;
+static int ServerConnections;
+
+
+/* --- The tiles --- */
+
+static int tile_size (int tile) {
+
+   return 2000 + (tile * 37) % 6000;
+}
+
+static unsigned char tile_byte (int tile, int i) {
+
+   return (unsigned char)(tile * 7 + i);
+}
+
+
+/* --- The stub server --- */
+
+static void send_all (int fd, const char *data, int size) {
+
+   while (size > 0) {
+      int res = send (fd, data, size, MSG_NOSIGNAL);
+      if (res <= 0) return;
+      data += res;
+      size -= res;
+   }
+}
+
+
+typedef struct {
+   int tile;
+   int version;
+   double due;
+} ServerRequest;
+
+
+static int send_response (int fd, const ServerRequest *request, int close_after) {
+
+   char header[256];
+   char *body;
+   int size;
+   int i;
+
+   if (request->tile < 0) {
+      snprintf (header, sizeof (header),
+                "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n%s\r\n",
+                close_after ? "Connection: close\r\n" : "");
+      send_all (fd, header, strlen (header));
+      return 0;
+   }
+
+   size = tile_size (request->tile);
+   body = malloc (size);
+   roadmap_check_allocated (body);
+   for (i = 0; i < size; i++) body[i] = tile_byte (request->tile, i);
+
+   snprintf (header, sizeof (header),
+             "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n%s\r\n",
+             size, close_after ? "Connection: close\r\n" : "");
+   send_all (fd, header, strlen (header));
+   if (request->tile == SlowTile) usleep (Latency * 1000);
+   send_all (fd, body, size);
+   free (body);
+
+   return size;
+}
+
+
+/* Each request is answered a latency after it arrived, in order */
+static void *serve_connection (void *arg) {
+
+   int fd = (int)(long)arg;
+   char buffer[16384];
+   ServerRequest queue[256];
+   int queue_size = 0;
+   int len = 0;
+   int served = 0;
+
+   for (;;) {
+
+      struct timeval timeout = {1, 0};
+      fd_set fds;
+      char *end;
+      int res;
+
+      if (queue_size > 0) {
+
+         double wait = queue[0].due - test_time_ms ();
+
+         if (wait <= 0) {
+
+            int close_after;
+
+            served++;
+            close_after = queue[0].version == 0 || (KeepAliveMax && served >= KeepAliveMax);
+            send_response (fd, queue, close_after);
+            if (close_after) break;
+
+            memmove (queue, queue + 1, --queue_size * sizeof (ServerRequest));
+            continue;
+         }
+
+         timeout.tv_sec = 0;
+         timeout.tv_usec = (int)(wait * 1000);
+      }
+
+      FD_ZERO (&fds);
+      FD_SET (fd, &fds);
+      if (select (fd + 1, &fds, NULL, NULL, &timeout) <= 0) continue;
+
+      res = recv (fd, buffer + len, sizeof (buffer) - 1 - len, 0);
+      if (res <= 0) break;
+      len += res;
+      buffer[len] = '\0';
+
+      while ((end = strstr (buffer, "\r\n\r\n")) != NULL &&
+             queue_size < (int)(sizeof (queue) / sizeof (queue[0]))) {
+
+         ServerRequest *request = queue + queue_size++;
+
+         request->tile = -1;
+         request->version = 0;
+         request->due = test_time_ms () + Latency;
+         sscanf (buffer, "GET /tiles/%d HTTP/1.%d", &request->tile, &request->version);
+
+         end += 4;
+         len -= (int)(end - buffer);
+         memmove (buffer, end, len + 1);
+      }
+   }
+
+   close (fd);
+   return NULL;
+}
+
+
+static void *serve (void *arg) {
+
+   int listener = (int)(long)arg;
+
+   for (;;) {
+
+      pthread_t thread;
+      int fd = accept (listener, NULL, NULL);
+      int one = 1;
+
+      if (fd < 0) continue;
+
+      /* The header and the body go out as separate writes */
+      setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+
+      pthread_mutex_lock (&ServerMutex);
+      ServerConnections++;
+      pthread_mutex_unlock (&ServerMutex);
+
+      pthread_create (&thread, NULL, serve_connection, (void *)(long)fd);
+      pthread_detach (thread);
+   }
+
+   return NULL;
+}
+
+
+static void start_server (void) {
+
+   struct sockaddr_in addr;
+   socklen_t addr_len = sizeof (addr);
+   pthread_t thread;
+   int listener = socket (AF_INET, SOCK_STREAM, 0);
+
+   memset (&addr, 0, sizeof (addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+   if (listener < 0 ||
+       bind (listener, (struct sockaddr *)&addr, sizeof (addr)) < 0 ||
+       listen (listener, 64) < 0 ||
+       getsockname (listener, (struct sockaddr *)&addr, &addr_len) < 0) {
+      perror ("server");
+      exit (1);
+   }
+
+   ServerPort = ntohs (addr.sin_port);
+   pthread_create (&thread, NULL, serve, (void *)(long)listener);
+   pthread_detach (thread);
+}
+
+
+static int server_connections (void) {
+
+   int count;
+
+   pthread_mutex_lock (&ServerMutex);
+   count = ServerConnections;
+   pthread_mutex_unlock (&ServerMutex);
+
+   return count;
+}
+
+
+/* --- The network layer and the main loop --- */
+
+struct roadmap_socket_t {
+   int s;
+};
+
+typedef struct {
+   RoadMapSocket socket;
+   RoadMapNetConnectCallback callback;
+   void *context;
+   double due;
+   char packet[1024];
+} PendingConnect;
+
+static PendingConnect Connects[MAX_CONNECTS];
+static int ConnectCount;
+
+#ifndef ROADMAP_NET_EPOLL
+typedef struct {
+   RoadMapIO *io;
+   RoadMapInput callback;
+   int fd;
+} Input;
+
+static Input Inputs[MAX_INPUTS];
+static int InputCount;
+#endif
+
+
+void *roadmap_net_connect_async (const char *protocol, const char *name, const char *resolved_name,
+                                 time_t update_time, int default_port, int flags,
+                                 RoadMapNetConnectCallback callback, void *context) {
+
+   char server_url[WSA_SERVER_URL_MAXSIZE + 1];
+   char service_name[WSA_SERVICE_NAME_MAXSIZE + 1];
+   struct sockaddr_in addr;
+   PendingConnect *pending;
+   int port = 0;
+   int fd;
+
+   if (ConnectCount == MAX_CONNECTS) return NULL;
+   pending = Connects + ConnectCount;
+   pending->packet[0] = '\0';
+
+   if (!strcmp (protocol, "tcp")) {
+      const char *separator = strchr (name, ':');
+      if (separator) port = atoi (separator + 1);
+   } else {
+      if (!WSA_ExtractParams (name, server_url, &port, service_name)) return NULL;
+      snprintf (pending->packet, sizeof (pending->packet),
+                "GET %s HTTP/1.0\r\nHost: %s\r\nUser-Agent: FreeMap/test\r\n",
+                service_name, server_url);
+   }
+
+   memset (&addr, 0, sizeof (addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons (port);
+   addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+   fd = socket (AF_INET, SOCK_STREAM, 0);
+   if (fd < 0 || connect (fd, (struct sockaddr *)&addr, sizeof (addr)) < 0) {
+      if (fd >= 0) close (fd);
+      return NULL;
+   }
+
+   pending->socket = malloc (sizeof (struct roadmap_socket_t));
+   roadmap_check_allocated (pending->socket);
+   pending->socket->s = fd;
+   pending->callback = callback;
+   pending->context = context;
+   pending->due = test_time_ms () + Latency;
+   ConnectCount++;
+
+   return pending->socket;
+}
+
+void roadmap_net_close (RoadMapSocket s) {
+
+#ifdef ROADMAP_NET_EPOLL
+   roadmap_net_reactor_close (s->s);
+#endif
+   close (s->s);
+   free (s);
+}
+
+int roadmap_io_read (RoadMapIO *io, void *data, int size) {
+
+   return recv (io->os.socket->s, data, size, 0);
+}
+
+int roadmap_io_write (RoadMapIO *io, const void *data, int length, int wait) {
+
+   send_all (io->os.socket->s, data, length);
+   return length;
+}
+
+int roadmap_io_write_async (RoadMapIO *io, const void *data, int length) {
+
+   return roadmap_io_write (io, data, length, 0);
+}
+
+void roadmap_io_close (RoadMapIO *io) {
+
+   if (io->subsystem == ROADMAP_IO_NET && io->os.socket != ROADMAP_INVALID_SOCKET) {
+      roadmap_net_close (io->os.socket);
+   }
+   io->subsystem = ROADMAP_IO_INVALID;
+   io->os.socket = ROADMAP_INVALID_SOCKET;
+}
+
+#ifdef ROADMAP_NET_EPOLL
+
+int roadmap_net_get_fd (RoadMapSocket s) {
+
+   return s->s;
+}
+
+void roadmap_net_mon_send (size_t size) {
+}
+
+void roadmap_net_mon_error (const char *text) {
+}
+
+#else
+
+void roadmap_main_set_input (RoadMapIO *io, RoadMapInput callback) {
+
+   if (InputCount == MAX_INPUTS) {
+      TEST_CHECK (InputCount < MAX_INPUTS);
+      return;
+   }
+   Inputs[InputCount].io = io;
+   Inputs[InputCount].callback = callback;
+   Inputs[InputCount].fd = io->os.socket->s;
+   InputCount++;
+}
+
+void roadmap_main_remove_input (RoadMapIO *io) {
+
+   int i;
+
+   for (i = 0; i < InputCount; i++) {
+      if (Inputs[i].io == io) {
+         Inputs[i] = Inputs[--InputCount];
+         return;
+      }
+   }
+}
+
+#endif // ROADMAP_NET_EPOLL
+
+RoadMapFile roadmap_file_open (const char *name, const char *mode) {
+
+   return ROADMAP_INVALID_FILE;
+}
+
+int roadmap_file_read (RoadMapFile file, void *data, int size) {
+
+   return -1;
+}
+
+void roadmap_file_close (RoadMapFile file) {
+}
+
+char *roadmap_path_skip_directories (const char *name) {
+
+   return (char *)name;
+}
+
+const char *roadmap_start_version (void) {
+
+   return "test";
+}
+
+
+/* Completes the due connections and serves the ready inputs */
+static void main_loop_once (void) {
+
+#ifndef ROADMAP_NET_EPOLL
+   fd_set fds;
+   struct timeval timeout = {0, 1000};
+   Input ready[MAX_INPUTS];
+   int ready_count = 0;
+   int max_fd = -1;
+#endif
+   double now = test_time_ms ();
+   int i;
+
+   for (i = 0; i < ConnectCount; ) {
+
+      if (Connects[i].due <= now) {
+
+         PendingConnect pending = Connects[i];
+
+         Connects[i] = Connects[--ConnectCount];
+         if (pending.packet[0]) {
+            send_all (pending.socket->s, pending.packet, strlen (pending.packet));
+         }
+         pending.callback (pending.socket, pending.context, succeeded);
+      } else {
+         i++;
+      }
+   }
+
+#ifdef ROADMAP_NET_EPOLL
+   roadmap_net_reactor_dispatch (1);
+#else
+   FD_ZERO (&fds);
+   for (i = 0; i < InputCount; i++) {
+      FD_SET (Inputs[i].fd, &fds);
+      if (Inputs[i].fd > max_fd) max_fd = Inputs[i].fd;
+   }
+
+   if (select (max_fd + 1, &fds, NULL, NULL, &timeout) <= 0) return;
+
+   for (i = 0; i < InputCount; i++) {
+      if (FD_ISSET (Inputs[i].fd, &fds)) ready[ready_count++] = Inputs[i];
+   }
+
+   /* A callback may remove other inputs */
+   for (i = 0; i < ready_count; i++) {
+
+      int j;
+
+      for (j = 0; j < InputCount; j++) {
+         if (Inputs[j].io == ready[i].io && Inputs[j].fd == ready[i].fd &&
+             Inputs[j].callback == ready[i].callback) break;
+      }
+      if (j < InputCount) ready[i].callback (ready[i].io);
+   }
+#endif
+}
+
+
+/* --- The downloads, as the tile manager makes them --- */
+
+typedef struct {
+   int tile;
+   char *data;
+   int size;
+   int expected;
+   int done;
+   int errors;
+   HttpAsyncContext *http;
+} Download;
+
+static Download Downloads[MAX_TILES];
+static int TileCount;
+static int NextTile;
+static int InFlight;
+static int Finished;
+static int UsePipes;
+static HttpAsyncPipe *Pipes[CONNECTIONS];
+
+static void refill (void);
+
+static int cb_size (void *context, size_t size) {
+
+   Download *download = (Download *)context;
+
+   download->data = malloc (size);
+   roadmap_check_allocated (download->data);
+   download->size = 0;
+   download->expected = (int)size;
+
+   return (int)size;
+}
+
+static void cb_progress (void *context, char *data, size_t size) {
+
+   Download *download = (Download *)context;
+
+   if (size && download->data) {
+      memcpy (download->data + download->size, data, size);
+      download->size += (int)size;
+   }
+}
+
+static void cb_error (void *context, int connection_failure, const char *format, ...) {
+
+   Download *download = (Download *)context;
+
+   download->errors++;
+   download->http = NULL;
+   free (download->data);
+   download->data = NULL;
+
+   InFlight--;
+   Finished++;
+   refill ();
+}
+
+static void cb_done (void *context, char *last_modified, const char *format, ...) {
+
+   Download *download = (Download *)context;
+
+   download->done++;
+   download->http = NULL;
+
+   InFlight--;
+   Finished++;
+   refill ();
+}
+
+static RoadMapHttpAsyncCallbacks Callbacks = { cb_size, cb_progress, cb_error, cb_done };
+
+
+static int next_pipe (void) {
+
+   int best = -1;
+   int best_pending = PIPELINE_DEPTH;
+   int i;
+
+   for (i = 0; i < CONNECTIONS; i++) {
+
+      int pending = roadmap_http_async_pipe_pending (Pipes[i]);
+
+      if (pending < best_pending) {
+         best = i;
+         best_pending = pending;
+      }
+   }
+
+   return best;
+}
+
+
+static void start (Download *download, int pipe) {
+
+   char url[128];
+
+   snprintf (url, sizeof (url), "http://127.0.0.1:%d/tiles/%d", ServerPort, download->tile);
+   InFlight++;
+
+   if (pipe >= 0) {
+      download->http = roadmap_http_async_pipe_copy (Pipes[pipe], &Callbacks, download, url, 0);
+   } else {
+      download->http = roadmap_http_async_copy (&Callbacks, download, url, 0);
+   }
+}
+
+
+/* Starts downloads while there is room, as load_next_tile () does */
+static void refill (void) {
+
+   int i;
+
+   if (UsePipes) {
+
+      int pipe;
+
+      while (NextTile < TileCount && (pipe = next_pipe ()) >= 0) {
+         start (Downloads + NextTile++, pipe);
+      }
+
+      for (i = 0; i < CONNECTIONS; i++) roadmap_http_async_pipe_flush (Pipes[i]);
+
+   } else {
+
+      while (NextTile < TileCount && InFlight < CONNECTIONS) {
+         start (Downloads + NextTile++, -1);
+      }
+   }
+}
+
+
+static void reset (int tiles, int use_pipes) {
+
+   int i;
+
+   for (i = 0; i < MAX_TILES; i++) {
+      free (Downloads[i].data);
+      memset (Downloads + i, 0, sizeof (Download));
+      Downloads[i].tile = i + 1;
+   }
+
+   TileCount = tiles;
+   NextTile = 0;
+   InFlight = 0;
+   Finished = 0;
+   UsePipes = use_pipes;
+}
+
+
+static int wait_finished (int expected) {
+
+   double start = test_time_ms ();
+
+   while (Finished < expected) {
+      if (test_time_ms () - start > WAIT_TIMEOUT_MS) return 0;
+      main_loop_once ();
+   }
+
+   return 1;
+}
+
+
+/* Every tile arrived once, complete; skip is a tile which was aborted */
+static int check_tiles (int skip) {
+
+   int i;
+   int j;
+
+   for (i = 0; i < TileCount; i++) {
+
+      Download *download = Downloads + i;
+
+      if (i == skip) {
+         if (download->done || download->errors) return 0;
+         continue;
+      }
+
+      if (download->done != 1 || download->errors) return 0;
+      if (download->size != tile_size (download->tile)) return 0;
+
+      for (j = 0; j < download->size; j++) {
+         if ((unsigned char)download->data[j] != tile_byte (download->tile, j)) return 0;
+      }
+   }
+
+   return 1;
+}
+
+
+static void run (const char *name, int tiles, int use_pipes, int max_connections) {
+
+   double start;
+   double elapsed;
+   int connections = server_connections ();
+   long bytes = 0;
+   int i;
+
+   reset (tiles, use_pipes);
+
+   start = test_time_ms ();
+   refill ();
+   TEST_CHECK (wait_finished (tiles));
+   elapsed = test_time_ms () - start;
+
+   connections = server_connections () - connections;
+
+   for (i = 0; i < tiles; i++) bytes += Downloads[i].size;
+
+   printf ("%-8s %4d tiles %8.1f ms  %7.1f tiles/s  %6.2f MB/s  %3d connections\n",
+           name, tiles, elapsed, tiles * 1000.0 / elapsed,
+           bytes / elapsed / 1000.0, connections);
+
+   TEST_CHECK (check_tiles (-1));
+   if (max_connections) TEST_CHECK (connections <= max_connections);
+}
+
+
+/* Aborts the first request of a pipe while its response arrives */
+static void run_abort (void) {
+
+   int connections = server_connections ();
+   int i;
+
+   reset (PIPELINE_DEPTH, 1);
+   SlowTile = Downloads[0].tile;
+
+   for (i = 0; i < PIPELINE_DEPTH; i++) start (Downloads + i, 0);
+   NextTile = TileCount;
+   roadmap_http_async_pipe_flush (Pipes[0]);
+
+   while (!Downloads[0].data && Finished == 0) main_loop_once ();
+   TEST_CHECK (Finished == 0);
+
+   roadmap_http_async_copy_abort (Downloads[0].http);
+   InFlight--;
+   Finished++;
+
+   TEST_CHECK (wait_finished (PIPELINE_DEPTH));
+   TEST_CHECK (check_tiles (0));
+   SlowTile = -1;
+   TEST_CHECK (server_connections () - connections == 2);
+
+   printf ("abort    %d tiles, the first aborted: %d connections\n",
+           PIPELINE_DEPTH, server_connections () - connections);
+}
+
+
+int main (int argc, char **argv) {
+
+   int tiles = 120;
+   int i;
+
+   if (argc > 1) tiles = atoi (argv[1]);
+   if (argc > 2) Latency = atoi (argv[2]);
+   if (tiles < 1 || tiles > MAX_TILES || Latency < 0) {
+      fprintf (stderr, "Usage: %s [tiles (1-%d) [latency_ms]]\n", argv[0], MAX_TILES);
+      return 1;
+   }
+
+#ifdef ROADMAP_NET_EPOLL
+   TEST_CHECK (roadmap_net_reactor_initialize ());
+#endif
+
+   start_server ();
+
+   for (i = 0; i < CONNECTIONS; i++) Pipes[i] = roadmap_http_async_pipe_new ();
+
+   printf ("latency %d ms, %d connections, pipelines of %d\n",
+           Latency, CONNECTIONS, PIPELINE_DEPTH);
+
+   run ("single", tiles, 0, tiles);
+   run ("pipe", tiles, 1, CONNECTIONS);
+
+   /* The server closes after a few responses: the rest are sent again */
+   KeepAliveMax = 5;
+   run ("limited", tiles, 1, 0);
+   KeepAliveMax = 0;
+
+   /* Drop the connections the limited server closed */
+   for (i = 0; i < CONNECTIONS; i++) {
+      roadmap_http_async_pipe_free (Pipes[i]);
+      Pipes[i] = roadmap_http_async_pipe_new ();
+   }
+
+   run_abort ();
+
+   for (i = 0; i < CONNECTIONS; i++) roadmap_http_async_pipe_free (Pipes[i]);
+   reset (0, 0);
+
+#ifdef ROADMAP_NET_EPOLL
+   roadmap_net_reactor_shutdown ();
+   return test_result ("bench_tile_fetch_epoll");
+#else
+   return test_result ("bench_tile_fetch");
+#endif
+}
@@ -0,0 +1,293 @@
+/* bench_tile_storage.c - Tiles per second through the SQLite tile storage.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   Stores a set of tiles one by one, as the tile manager does when the
+ *   downloads complete, then in one batch, as after a refresh of all the
+ *   tiles. The tiles are then loaded right after the database is opened
+ *   (cold), a second time (warm) and in one batch. Every loaded tile is
+ *   checked against the stored data.
+ *
+ *   The database is created in a temporary directory, and removed.
+ *
+ *   Usage: bench_tile_storage [tiles]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "roadmap.h"
+#include "roadmap_file.h"
+#include "roadmap_path.h"
+#include "roadmap_dbread.h"
+#include "roadmap_main.h"
+#include "roadmap_tile_pack.h"
+#include "roadmap_tile_storage.h"
+#include "test_stubs.h"
+
+#define TILE_FIPS       1
+#define OTHER_FIPS      2      /* switching to it closes the database */
+
+#define TILE_MIN_SIZE   2000
+#define TILE_MAX_SIZE   20000
+
+static char MapPath[64];
+
+static RoadMapCallback PendingTimer = NULL;
+
+
+/* --- The services the tile storage uses --- */
+
+const char *roadmap_db_map_path (void) {
+
+   return MapPath;
+}
+
+void roadmap_path_format (char *buffer, int buffer_size, const char *path, const char *name) {
+
+   snprintf (buffer, buffer_size, "%s/%s", path, name);
+}
+
+RoadMapFile roadmap_file_open (const char *name, const char *mode) {
+
+   return open (name, O_RDONLY);
+}
+
+int roadmap_file_read (RoadMapFile file, void *data, int size) {
+
+   return read (file, data, size);
+}
+
+void roadmap_file_close (RoadMapFile file) {
+
+   close (file);
+}
+
+int roadmap_file_length (const char *path, const char *name) {
+
+   RoadMapFile file = open (name, O_RDONLY);
+   int length;
+
+   if (file < 0) return -1;
+
+   length = lseek (file, 0, SEEK_END);
+   close (file);
+
+   return length;
+}
+
+void roadmap_file_remove (const char *path, const char *name) {
+
+   unlink (path);
+}
+
+/* The storage commits the pending transaction from a timer */
+void roadmap_main_set_periodic (int interval, RoadMapCallback callback) {
+
+   PendingTimer = callback;
+}
+
+void roadmap_main_remove_periodic (RoadMapCallback callback) {
+
+   if (PendingTimer == callback) PendingTimer = NULL;
+}
+
+void roadmap_tile_pack_invalidate (int fips, int tile_index) {
+}
+
+void roadmap_tile_pack_invalidate_all (int fips) {
+}
+
+
+/* --- The benchmark --- */
+
+static int    TileCount = 500;
+static int   *Tiles;
+static void **TileData;
+static size_t *TileSizes;
+
+static int    LoadErrors;
+
+
+static void fire_timer (void) {
+
+   if (PendingTimer) PendingTimer ();
+}
+
+
+static void build_tiles (void) {
+
+   int i;
+
+   Tiles = malloc (TileCount * sizeof (int));
+   TileData = malloc (TileCount * sizeof (void *));
+   TileSizes = malloc (TileCount * sizeof (size_t));
+   roadmap_check_allocated (Tiles);
+   roadmap_check_allocated (TileData);
+   roadmap_check_allocated (TileSizes);
+
+   for (i = 0; i < TileCount; i++) {
+
+      unsigned char *data;
+      size_t j;
+
+      Tiles[i] = 1000 + i * 7;
+      TileSizes[i] = TILE_MIN_SIZE + rand () % (TILE_MAX_SIZE - TILE_MIN_SIZE);
+
+      data = malloc (TileSizes[i]);
+      roadmap_check_allocated (data);
+      for (j = 0; j < TileSizes[i]; j++) data[j] = (unsigned char) (Tiles[i] * 31 + j);
+
+      TileData[i] = data;
+   }
+}
+
+
+static int find_tile (int tile_index) {
+
+   int i;
+
+   for (i = 0; i < TileCount; i++) {
+      if (Tiles[i] == tile_index) return i;
+   }
+
+   return -1;
+}
+
+
+static void check_tile (int tile_index, const void *data, size_t size) {
+
+   int i = find_tile (tile_index);
+
+   if (i < 0 || size != TileSizes[i] || memcmp (data, TileData[i], size)) {
+      LoadErrors++;
+   }
+}
+
+
+static void report (const char *name, double start) {
+
+   double elapsed = test_time_ms () - start;
+
+   printf ("%-12s %8.1f ms  %8.0f tiles/sec\n",
+           name, elapsed, elapsed > 0 ? TileCount * 1000.0 / elapsed : 0.0);
+}
+
+
+static void load_cb (int tile_index, const void *data, size_t size, void *context) {
+
+   check_tile (tile_index, data, size);
+   (*(int *) context)++;
+}
+
+
+static void load_one_by_one (const char *name) {
+
+   double start = test_time_ms ();
+   int i;
+
+   for (i = 0; i < TileCount; i++) {
+
+      void *data;
+      size_t size;
+
+      if (roadmap_tile_load (TILE_FIPS, Tiles[i], &data, &size) != 0) {
+         LoadErrors++;
+         continue;
+      }
+
+      check_tile (Tiles[i], data, size);
+      free (data);
+   }
+   fire_timer ();
+
+   report (name, start);
+}
+
+
+int main (int argc, char **argv) {
+
+   double start;
+   void *data;
+   size_t size;
+   int loaded = 0;
+   int i;
+
+   if (argc > 1) TileCount = atoi (argv[1]);
+   if (TileCount < 1) {
+      fprintf (stderr, "Usage: %s [tiles]\n", argv[0]);
+      return 1;
+   }
+
+   strcpy (MapPath, "/tmp/bench_tile_storage.XXXXXX");
+   if (!mkdtemp (MapPath)) {
+      perror ("mkdtemp");
+      return 1;
+   }
+
+   srand (1);
+   build_tiles ();
+
+   printf ("%d tiles of %d to %d bytes\n", TileCount, TILE_MIN_SIZE, TILE_MAX_SIZE);
+
+   start = test_time_ms ();
+   for (i = 0; i < TileCount; i++) {
+      TEST_CHECK (roadmap_tile_store (TILE_FIPS, Tiles[i], TileData[i], TileSizes[i]) == 0);
+   }
+   fire_timer ();
+   report ("store", start);
+
+   start = test_time_ms ();
+   TEST_CHECK (roadmap_tile_store_batch (TILE_FIPS, Tiles, TileData, TileSizes, TileCount)
+                  == TileCount);
+   report ("store batch", start);
+
+   /* Reopen the database, with an empty page cache */
+   TEST_CHECK (roadmap_tile_load (OTHER_FIPS, Tiles[0], &data, &size) != 0);
+   fire_timer ();
+
+   load_one_by_one ("cold load");
+   load_one_by_one ("warm load");
+
+   start = test_time_ms ();
+   TEST_CHECK (roadmap_tile_load_batch (TILE_FIPS, Tiles, TileCount, load_cb, &loaded)
+                  == TileCount);
+   report ("load batch", start);
+
+   TEST_CHECK (loaded == TileCount);
+   TEST_CHECK (LoadErrors == 0);
+
+   roadmap_tile_remove_all (TILE_FIPS);
+   roadmap_tile_remove_all (OTHER_FIPS);
+   rmdir (MapPath);
+
+   for (i = 0; i < TileCount; i++) free (TileData[i]);
+   free (Tiles);
+   free (TileData);
+   free (TileSizes);
+
+   return test_result ("bench_tile_storage");
+}
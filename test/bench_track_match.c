@@ -0,0 +1,479 @@
+/* bench_track_match.c - Map matching of a noisy track over a grid of streets.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The map is one square holding a grid of two way streets, one block
+ *   every BLOCK meters, with the real square graph. A car drives a random
+ *   route over it, and each GPS fix gets gaussian noise. editor_track_match()
+ *   must put most fixes on the line the car was on, and do better than
+ *   taking the closest line of each fix. A gap in the middle of the track,
+ *   away from any street, must split it into two matched chains.
+ *
+ *   Usage: bench_track_match [fixes [noise]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "roadmap.h"
+#include "roadmap_plugin.h"
+#include "roadmap_point.h"
+#include "roadmap_line.h"
+#include "roadmap_line_route.h"
+#include "roadmap_street.h"
+#include "roadmap_square.h"
+#include "roadmap_layer.h"
+#include "roadmap_math.h"
+#include "roadmap_navigate.h"
+#include "roadmap_main.h"
+#include "navigate/navigate_ch.h"
+#include "editor/track/editor_track_match.h"
+#include "test_stubs.h"
+
+#define MAP_SQUARE      0
+
+#define GRID_SIZE       32       /* junctions per side */
+#define GRID_POINTS     (GRID_SIZE * GRID_SIZE)
+#define GRID_ROWS       (GRID_SIZE * (GRID_SIZE - 1))   /* east-west lines */
+#define GRID_LINES      (2 * GRID_ROWS)
+
+#define BLOCK           100      /* meters, one map unit is a meter */
+#define FIX_SPACING     12       /* meters driven between fixes */
+#define FIX_SPEED       25       /* knots */
+
+#define PI              3.14159265358979
+
+
+/* --- The map --- */
+
+int roadmap_square_set_current (int square) {
+
+   return square == MAP_SQUARE;
+}
+
+int roadmap_square_active (void) {
+
+   return MAP_SQUARE;
+}
+
+int roadmap_square_points_count (int square) {
+
+   return GRID_POINTS;
+}
+
+int roadmap_line_in_square (int square, int cfcc, int *first, int *last) {
+
+   if (cfcc != ROADMAP_ROAD_STREET) return 0;
+
+   *first = 0;
+   *last = GRID_LINES - 1;
+   return 1;
+}
+
+void roadmap_line_points (int line, int *from, int *to) {
+
+   if (line < GRID_ROWS) {
+      *from = (line / (GRID_SIZE - 1)) * GRID_SIZE + line % (GRID_SIZE - 1);
+      *to = *from + 1;
+   } else {
+      *from = line - GRID_ROWS;
+      *to = *from + GRID_SIZE;
+   }
+}
+
+void roadmap_line_from_point (int line, int *from) {
+
+   int to;
+
+   roadmap_line_points (line, from, &to);
+}
+
+void roadmap_line_to_point (int line, int *to) {
+
+   int from;
+
+   roadmap_line_points (line, &from, to);
+}
+
+int roadmap_line_length (int line) {
+
+   return BLOCK;
+}
+
+void roadmap_point_position (int point, RoadMapPosition *position) {
+
+   position->longitude = (point % GRID_SIZE) * BLOCK;
+   position->latitude = (point / GRID_SIZE) * BLOCK;
+}
+
+int roadmap_line_route_get_direction (int line, int who) {
+
+   return ROUTE_DIRECTION_ANY;
+}
+
+int roadmap_line_route_get_restrictions (int line, int against_dir) {
+
+   return 0;
+}
+
+int roadmap_street_extend_line_ends
+         (const PluginLine *line, RoadMapPosition *from, RoadMapPosition *to,
+          int flags, RoadMapStreetIterCB cb, void *context) {
+
+   return 0;
+}
+
+int roadmap_layer_all_roads (int *layers, int size) {
+
+   layers[0] = ROADMAP_ROAD_STREET;
+   return 1;
+}
+
+int roadmap_plugin_get_direction (PluginLine *line, int who) {
+
+   return ROUTE_DIRECTION_ANY;
+}
+
+void roadmap_math_set_focus (const RoadMapArea *focus) {
+}
+
+void roadmap_math_release_focus (void) {
+}
+
+int roadmap_math_distance
+        (const RoadMapPosition *position1, const RoadMapPosition *position2) {
+
+   double dx = position1->longitude - position2->longitude;
+   double dy = position1->latitude - position2->latitude;
+
+   return (int) (sqrt (dx * dx + dy * dy) + 0.5);
+}
+
+int roadmap_math_to_cm (int value) {
+
+   return value * 100;
+}
+
+int roadmap_math_azymuth
+       (const RoadMapPosition *point1, const RoadMapPosition *point2) {
+
+   double angle = atan2 (point2->longitude - point1->longitude,
+                         point2->latitude - point1->latitude) * 180 / PI;
+
+   return ((int) floor (angle + 0.5) + 360) % 360;
+}
+
+int roadmap_math_delta_direction (int direction1, int direction2) {
+
+   int delta = direction2 - direction1;
+
+   while (delta > 180)  delta -= 360;
+   while (delta < -180) delta += 360;
+
+   return abs (delta);
+}
+
+/* The offset of the projection along the line */
+int roadmap_plugin_calc_length (const RoadMapPosition *position,
+                                const PluginLine *line,
+                                int *total_length) {
+
+   RoadMapPosition from;
+   int from_point;
+   int to_point;
+
+   roadmap_line_points (line->line_id, &from_point, &to_point);
+   roadmap_point_position (from_point, &from);
+
+   *total_length = BLOCK;
+   return roadmap_math_distance (&from, position);
+}
+
+/* Projects the position on every line around it, closest first */
+int roadmap_street_get_closest
+       (const RoadMapPosition *position, int scale, int *categories, int categories_count,
+        int max_shapes, RoadMapNeighbour *neighbours, int max) {
+
+   int x = position->longitude / BLOCK;
+   int y = position->latitude / BLOCK;
+   int count = 0;
+   int gx;
+   int gy;
+   int i;
+
+   for (gy = y - 1; gy <= y + 2; gy++) {
+      for (gx = x - 1; gx <= x + 2; gx++) {
+
+         int lines[2];
+         int line_count = 0;
+
+         if (gx < 0 || gy < 0 || gx >= GRID_SIZE || gy >= GRID_SIZE) continue;
+
+         if (gx + 1 < GRID_SIZE) lines[line_count++] = gy * (GRID_SIZE - 1) + gx;
+         if (gy + 1 < GRID_SIZE) lines[line_count++] = GRID_ROWS + gy * GRID_SIZE + gx;
+
+         for (i = 0; i < line_count; i++) {
+
+            RoadMapNeighbour neighbour;
+            int from_point;
+            int to_point;
+            int j;
+
+            roadmap_line_points (lines[i], &from_point, &to_point);
+            roadmap_point_position (from_point, &neighbour.from);
+            roadmap_point_position (to_point, &neighbour.to);
+
+            neighbour.intersection = neighbour.from;
+            if (lines[i] < GRID_ROWS) {
+               neighbour.intersection.longitude = position->longitude;
+               if (position->longitude < neighbour.from.longitude) neighbour.intersection = neighbour.from;
+               if (position->longitude > neighbour.to.longitude) neighbour.intersection = neighbour.to;
+            } else {
+               neighbour.intersection.latitude = position->latitude;
+               if (position->latitude < neighbour.from.latitude) neighbour.intersection = neighbour.from;
+               if (position->latitude > neighbour.to.latitude) neighbour.intersection = neighbour.to;
+            }
+
+            neighbour.distance = roadmap_math_distance (position, &neighbour.intersection);
+            neighbour.line.plugin_id = ROADMAP_PLUGIN_ID;
+            neighbour.line.line_id = lines[i];
+            neighbour.line.square = MAP_SQUARE;
+            neighbour.line.cfcc = ROADMAP_ROAD_STREET;
+
+            /* Insertion sort, the farthest drops off the end */
+            for (j = count; j > 0 && neighbours[j - 1].distance > neighbour.distance; j--) {
+               if (j < max) neighbours[j] = neighbours[j - 1];
+            }
+            if (j < max) {
+               neighbours[j] = neighbour;
+               if (count < max) count++;
+            }
+         }
+      }
+   }
+
+   return count;
+}
+
+void roadmap_square_set_screen_scale (int scale) {
+}
+
+int roadmap_square_get_screen_scale (void) {
+
+   return 0;
+}
+
+int roadmap_navigate_get_neighbours
+              (const RoadMapPosition *position, int scale, int accuracy, int max_shapes,
+               RoadMapNeighbour *neighbours, int max, int type) {
+
+   return 0;
+}
+
+void navigate_ch_clear (int square) {
+}
+
+/* roadmap_dialog.h maps the name to an inline wrapper, which is not included */
+void roadmap_dialog_set_progress (const char *frame, const char *name, int progress) {
+}
+
+void roadmap_main_flush (void) {
+}
+
+
+/* --- The track --- */
+
+static double gaussian (double sigma) {
+
+   double u1 = (rand () + 1.0) / (RAND_MAX + 2.0);
+   double u2 = (rand () + 1.0) / (RAND_MAX + 2.0);
+
+   return sigma * sqrt (-2 * log (u1)) * cos (2 * PI * u2);
+}
+
+/* The lines which meet at a junction */
+static int junction_lines (int point, int *lines) {
+
+   int x = point % GRID_SIZE;
+   int y = point / GRID_SIZE;
+   int count = 0;
+
+   if (x + 1 < GRID_SIZE) lines[count++] = y * (GRID_SIZE - 1) + x;
+   if (x > 0) lines[count++] = y * (GRID_SIZE - 1) + x - 1;
+   if (y + 1 < GRID_SIZE) lines[count++] = GRID_ROWS + point;
+   if (y > 0) lines[count++] = GRID_ROWS + point - GRID_SIZE;
+
+   return count;
+}
+
+/* Drives from junction to junction, never turning back, and records a fix
+ * every FIX_SPACING meters with the line it was on. Fixes within the noise
+ * of a junction could be on either line, those get truth -1.
+ */
+static void drive (RoadMapGpsPosition *fixes, int *truth, int count, double noise) {
+
+   int point = (GRID_SIZE / 2) * GRID_SIZE + GRID_SIZE / 2;
+   int line = -1;
+   int driven = 0;
+   int i = 0;
+
+   while (i < count) {
+
+      RoadMapPosition from;
+      RoadMapPosition to;
+      int lines[4];
+      int next;
+      int from_point;
+      int to_point;
+      int steering;
+
+      /* Pick the next line, keeping away from the edges of the grid */
+      do {
+         next = lines[rand () % junction_lines (point, lines)];
+         roadmap_line_points (next, &from_point, &to_point);
+         to_point = (from_point == point) ? to_point : from_point;
+      } while (next == line ||
+               to_point % GRID_SIZE < 2 || to_point % GRID_SIZE >= GRID_SIZE - 2 ||
+               to_point / GRID_SIZE < 2 || to_point / GRID_SIZE >= GRID_SIZE - 2);
+
+      roadmap_point_position (point, &from);
+      roadmap_point_position (to_point, &to);
+      steering = roadmap_math_azymuth (&from, &to);
+
+      for (; driven < BLOCK && i < count; driven += FIX_SPACING, i++) {
+
+         fixes[i].longitude = from.longitude +
+            (to.longitude - from.longitude) * driven / BLOCK + (int) floor (gaussian (noise) + 0.5);
+         fixes[i].latitude = from.latitude +
+            (to.latitude - from.latitude) * driven / BLOCK + (int) floor (gaussian (noise) + 0.5);
+         fixes[i].speed = FIX_SPEED;
+         fixes[i].steering = (steering + (int) gaussian (10) + 360) % 360;
+         fixes[i].altitude = 0;
+         fixes[i].accuracy = 0;
+
+         if (driven < noise * 2 || driven > BLOCK - noise * 2) {
+            truth[i] = -1;
+         } else {
+            truth[i] = next;
+         }
+      }
+
+      driven -= BLOCK;
+      line = next;
+      point = to_point;
+   }
+}
+
+/* The closest line of each fix, as a per fix decision would pick it */
+static int closest_line (const RoadMapGpsPosition *fix) {
+
+   RoadMapNeighbour neighbour;
+   RoadMapPosition position;
+
+   position.longitude = fix->longitude;
+   position.latitude = fix->latitude;
+
+   if (roadmap_street_get_closest (&position, 0, NULL, 0, 1, &neighbour, 1) < 1) return -1;
+
+   return neighbour.line.line_id;
+}
+
+
+int main (int argc, char **argv) {
+
+   RoadMapGpsPosition *fixes;
+   EditorTrackMatch *matches;
+   int *truth;
+   int count = 2000;
+   double noise = 10;
+   int scored = 0;
+   int correct = 0;
+   int closest = 0;
+   int matched;
+   int gap;
+   double start;
+   double elapsed;
+   int i;
+
+   if (argc > 1) count = atoi (argv[1]);
+   if (argc > 2) noise = atof (argv[2]);
+   if (count < 10 || noise < 0 || noise > 20) {
+      fprintf (stderr, "Usage: %s [fixes [noise]]\n", argv[0]);
+      return 1;
+   }
+
+   fixes = malloc (count * sizeof (RoadMapGpsPosition));
+   matches = malloc (count * sizeof (EditorTrackMatch));
+   truth = malloc (count * sizeof (int));
+   roadmap_check_allocated (fixes);
+   roadmap_check_allocated (matches);
+   roadmap_check_allocated (truth);
+
+   srand (1);
+   drive (fixes, truth, count, noise);
+
+   start = test_time_ms ();
+   matched = editor_track_match (fixes, count, matches);
+   elapsed = test_time_ms () - start;
+
+   TEST_CHECK (matched == count);
+
+   for (i = 0; i < count; i++) {
+
+      if (truth[i] < 0) continue;
+
+      scored++;
+      if (matches[i].line.line_id == truth[i]) correct++;
+      if (closest_line (fixes + i) == truth[i]) closest++;
+   }
+
+   printf ("%d fixes, noise %.0f m: %8.1f ms  %6.1f us/fix\n",
+           count, noise, elapsed, elapsed * 1000 / count);
+   printf ("  matched %d of %d (%.1f%%), closest line %d (%.1f%%)\n",
+           correct, scored, 100.0 * correct / scored,
+           closest, 100.0 * closest / scored);
+
+   TEST_CHECK (correct * 100 >= scored * 95);
+   TEST_CHECK (correct >= closest);
+
+   /* A fix far from any street in the middle: it stays unmatched, and the
+    * fixes on both sides of it are still matched.
+    */
+   gap = count / 2;
+   fixes[gap].longitude = -10 * BLOCK;
+   fixes[gap].latitude = -10 * BLOCK;
+
+   matched = editor_track_match (fixes, count, matches);
+
+   TEST_CHECK (matched == count - 1);
+   TEST_CHECK (matches[gap].line.line_id == -1);
+   TEST_CHECK (truth[gap - 1] < 0 || matches[gap - 1].line.line_id == truth[gap - 1]);
+   TEST_CHECK (truth[gap + 1] < 0 || matches[gap + 1].line.line_id == truth[gap + 1]);
+
+   free (fixes);
+   free (matches);
+   free (truth);
+
+   return test_result ("bench_track_match");
+}
@@ -0,0 +1,314 @@
+/* bench_wst_parser.c - Response lines per second through websvc_trans.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   Runs transactions with the tags of the realtime general parser over a
+ *   fake socket, which hands a large response to websvc_trans in network
+ *   sized chunks. In the "busy" response most lines are AddUser and
+ *   AddAlert, as after a login in a busy area; the "mixed" response uses
+ *   all the tags evenly. Each tag has its own parser, which checks that
+ *   the line was dispatched to it.
+ *
+ *   Usage: bench_wst_parser [lines [transactions]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_net.h"
+#include "websvc_trans/websvc_trans.h"
+#include "websvc_trans/socket_async_receive.h"
+#include "test_stubs.h"
+
+#define RECEIVE_CHUNK   4096
+
+static int LineCount = 20000;
+static int TransCount = 20;
+
+
+/* --- A socket which receives the response --- */
+
+static char *Response = NULL;
+static int   ResponseSize;
+static int   ResponseSent;
+
+static RoadMapNetConnectCallback ConnectCallback;
+static void *ConnectContext;
+
+static CB_OnDataReceive ReceiveCallback;
+static char *ReceiveBuffer;
+static int   ReceiveSize;
+static void *ReceiveContext;
+
+void *roadmap_net_connect_async (const char *protocol,
+                                 const char *name,
+                                 const char *resolved_name,
+                                 time_t update_time,
+                                 int default_port,
+                                 int flags,
+                                 RoadMapNetConnectCallback callback,
+                                 void *context) {
+
+   ConnectCallback = callback;
+   ConnectContext = context;
+
+   return &ConnectCallback;
+}
+
+void roadmap_net_cancel_connect (void *context) {
+}
+
+int roadmap_net_send (RoadMapSocket s, const void *data, int length, int wait) {
+
+   return length;
+}
+
+void roadmap_net_close (RoadMapSocket s) {
+}
+
+int roadmap_net_get_fd (RoadMapSocket s) {
+
+   return 1;
+}
+
+BOOL socket_async_receive (RoadMapSocket s,
+                           void *data,
+                           int size,
+                           CB_OnDataReceive cbOnDataReceive,
+                           void *context) {
+
+   ReceiveCallback = cbOnDataReceive;
+   ReceiveBuffer = data;
+   ReceiveSize = size;
+   ReceiveContext = context;
+
+   return TRUE;
+}
+
+void socket_async_receive_end (RoadMapSocket s) {
+}
+
+
+/* --- One parser per tag --- */
+
+static const char *Tags[] = {
+   "RC", "AddUser", "AddAlert", "AddAlertComment", "RmAlert", "SystemMessage",
+   "UpgradeClient", "AddRoadInfo", "RoadInfoGeom", "RoadInfoSegments", "RmRoadInfo",
+   "BridgeToRes", "ReportAlertRes", "ReportTrafficRes", "PostAlertCommentRes",
+   "MapUpdateTime", "GeoLocation", "UpdateUserPoints", "RoutingResponseCode",
+   "RoutingResponse", "RoutePoints", "RouteSegments", "EventOnRoute", "SuggestReroute",
+   "GeoServerConfig", "ServerConfig", "AddCustomBonus", "AddBonus", "RmBonus",
+   "CollectBonusRes", "OpenMessageTicker", "UpdateConfig", "UserGroups",
+   "OpenMoodSelection", "AddExternalPoiType", "AddExternalPoi", "RmExternalPoi",
+   "SetExternalPoiDrawOrder", "ThumbsUpRes", "UpdateAlert", "UpdateInboxCount",
+   "ThumbsUpReceived", "AddBonusTemplate"
+};
+
+#define TAG_COUNT       ((int) (sizeof (Tags) / sizeof (Tags[0])))
+#define TAG_ADD_USER    1
+#define TAG_ADD_ALERT   2
+
+static int ParsedLines;
+static int Misdispatched;
+
+/* Every line starts with the index of its tag */
+static const char *parse_line (int tag, const char *data, BOOL *more_data_needed) {
+
+   const char *end = strchr (data, '\n');
+
+   if (atoi (data) != tag) Misdispatched++;
+   ParsedLines++;
+
+   *more_data_needed = FALSE;
+   return end ? end : data + strlen (data);
+}
+
+#define PARSER(i) \
+   static const char *parse_##i (const char *data, void *context, \
+                                 BOOL *more_data_needed, roadmap_result *rc) { \
+      return parse_line (i, data, more_data_needed); \
+   }
+
+PARSER(0)  PARSER(1)  PARSER(2)  PARSER(3)  PARSER(4)  PARSER(5)  PARSER(6)
+PARSER(7)  PARSER(8)  PARSER(9)  PARSER(10) PARSER(11) PARSER(12) PARSER(13)
+PARSER(14) PARSER(15) PARSER(16) PARSER(17) PARSER(18) PARSER(19) PARSER(20)
+PARSER(21) PARSER(22) PARSER(23) PARSER(24) PARSER(25) PARSER(26) PARSER(27)
+PARSER(28) PARSER(29) PARSER(30) PARSER(31) PARSER(32) PARSER(33) PARSER(34)
+PARSER(35) PARSER(36) PARSER(37) PARSER(38) PARSER(39) PARSER(40) PARSER(41)
+PARSER(42)
+
+static CB_OnWSTResponse Parsers[] = {
+   parse_0,  parse_1,  parse_2,  parse_3,  parse_4,  parse_5,  parse_6,
+   parse_7,  parse_8,  parse_9,  parse_10, parse_11, parse_12, parse_13,
+   parse_14, parse_15, parse_16, parse_17, parse_18, parse_19, parse_20,
+   parse_21, parse_22, parse_23, parse_24, parse_25, parse_26, parse_27,
+   parse_28, parse_29, parse_30, parse_31, parse_32, parse_33, parse_34,
+   parse_35, parse_36, parse_37, parse_38, parse_39, parse_40, parse_41,
+   parse_42
+};
+
+static wst_parser ParserTable[TAG_COUNT];
+
+
+/* --- The benchmark --- */
+
+static int Completed;
+static roadmap_result CompletedResult;
+
+static void on_completed (void *context, roadmap_result res) {
+
+   Completed++;
+   CompletedResult = res;
+}
+
+
+/* Percentage of AddUser and AddAlert lines, the others use any tag */
+static void build_response (int busy) {
+
+   char header[128];
+   char *body;
+   int body_size = 0;
+   int header_size;
+   int i;
+
+   free (Response);
+
+   body = malloc (LineCount * 80 + 1);
+   roadmap_check_allocated (body);
+
+   for (i = 0; i < LineCount; i++) {
+
+      int tag;
+      int choice = rand () % 100;
+
+      if (choice < busy / 2) tag = TAG_ADD_USER;
+      else if (choice < busy) tag = TAG_ADD_ALERT;
+      else tag = rand () % TAG_COUNT;
+
+      body_size += sprintf (body + body_size, "%s,%d,%d,%d,%d,user%d,%d\n",
+                            Tags[tag], tag, i, 32000000 + rand () % 100000,
+                            34000000 + rand () % 100000, rand () % 1000, rand () % 360);
+   }
+
+   header_size = sprintf (header, "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n", body_size);
+
+   Response = malloc (header_size + body_size + 1);
+   roadmap_check_allocated (Response);
+
+   memcpy (Response, header, header_size);
+   memcpy (Response + header_size, body, body_size + 1);
+   ResponseSize = header_size + body_size;
+
+   free (body);
+}
+
+
+static void run_transaction (wst_handle session) {
+
+   ReceiveCallback = NULL;
+   ResponseSent = 0;
+
+   TEST_CHECK (wst_start_trans (session, 0, "Bench", WEBSVC_NO_TYPE, ParserTable, TAG_COUNT,
+                                on_completed, NULL, "Bench,%d", 1));
+
+   ConnectCallback ((RoadMapSocket) &ConnectCallback, ConnectContext, succeeded);
+
+   while (ReceiveCallback && ResponseSent < ResponseSize) {
+
+      CB_OnDataReceive callback = ReceiveCallback;
+      int size = ResponseSize - ResponseSent;
+
+      if (size > ReceiveSize) size = ReceiveSize;
+      if (size > RECEIVE_CHUNK) size = RECEIVE_CHUNK;
+
+      memcpy (ReceiveBuffer, Response + ResponseSent, size);
+      ResponseSent += size;
+
+      ReceiveCallback = NULL;
+      callback (ReceiveBuffer, size, ReceiveContext);
+   }
+}
+
+
+static void run (wst_handle session, const char *name, int busy) {
+
+   double start;
+   double elapsed;
+   int i;
+
+   build_response (busy);
+
+   Completed = 0;
+   ParsedLines = 0;
+
+   start = test_time_ms ();
+
+   for (i = 0; i < TransCount; i++) run_transaction (session);
+
+   elapsed = test_time_ms () - start;
+
+   printf ("%-6s %8.1f ms  %6.1f ns/line\n",
+           name, elapsed, elapsed * 1000000.0 / ((double) TransCount * LineCount));
+
+   TEST_CHECK (Completed == TransCount);
+   TEST_CHECK (CompletedResult == succeeded);
+   TEST_CHECK (ParsedLines == TransCount * LineCount);
+}
+
+
+int main (int argc, char **argv) {
+
+   wst_handle session;
+   int i;
+
+   if (argc > 1) LineCount = atoi (argv[1]);
+   if (argc > 2) TransCount = atoi (argv[2]);
+   if (LineCount < 1 || TransCount < 1) {
+      fprintf (stderr, "Usage: %s [lines [transactions]]\n", argv[0]);
+      return 1;
+   }
+
+   for (i = 0; i < TAG_COUNT; i++) {
+      ParserTable[i].tag = Tags[i];
+      ParserTable[i].parser = Parsers[i];
+   }
+
+   srand (1);
+
+   session = wst_init ("http://localhost:80/rtserver", NULL, NULL, NULL, "binary/octet-stream");
+   TEST_CHECK (session != NULL);
+
+   printf ("%d transactions of %d lines, %d tags\n", TransCount, LineCount, TAG_COUNT);
+
+   run (session, "busy", 90);
+   run (session, "mixed", 0);
+
+   TEST_CHECK (Misdispatched == 0);
+
+   wst_term (session);
+   free (Response);
+
+   return test_result ("bench_wst_parser");
+}
@@ -0,0 +1,521 @@
+/* bench_wst_partial.c - Response lines which arrive in pieces.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   ReadFieldFromString() and cyclic_buffer_get_line_end() are checked on
+ *   their own first. Then the real RoadInfoGeom parser, registered for
+ *   partial lines, gets responses over a fake socket: a short response
+ *   split in two and in three at every offset, so that a split lands in
+ *   the middle of each field and a resumed geometry line is split again,
+ *   and a geometry line longer than the receive buffer in network sized
+ *   chunks. A geometry line for an unknown road info must be skipped up to
+ *   its end, and the lines after it still parsed.
+ *
+ *   Usage: bench_wst_partial [coordinates]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_net.h"
+#include "websvc_trans/websvc_trans.h"
+#include "websvc_trans/socket_async_receive.h"
+#include "websvc_trans/string_parser.h"
+#include "websvc_trans/cyclic_buffer.h"
+#include "Realtime/RealtimeTrafficInfo.h"
+#include "test_stubs.h"
+
+#define RECEIVE_CHUNK   4096
+
+#define GEOM_ID         7
+#define GEOM_ID_SHORT   8
+#define GEOM_ID_UNKNOWN 99
+
+#define SHORT_COORDS    6
+
+const char *RoadInfoGeom (const char *pNext, void *pContext,
+                          BOOL *more_data_needed, roadmap_result *rc);
+
+
+/* --- A socket which receives the response --- */
+
+static char *Response = NULL;
+static int   ResponseSize;
+static int   ResponseSent;
+
+static RoadMapNetConnectCallback ConnectCallback;
+static void *ConnectContext;
+
+static CB_OnDataReceive ReceiveCallback;
+static char *ReceiveBuffer;
+static int   ReceiveSize;
+static void *ReceiveContext;
+
+void *roadmap_net_connect_async (const char *protocol,
+                                 const char *name,
+                                 const char *resolved_name,
+                                 time_t update_time,
+                                 int default_port,
+                                 int flags,
+                                 RoadMapNetConnectCallback callback,
+                                 void *context) {
+
+   ConnectCallback = callback;
+   ConnectContext = context;
+
+   return &ConnectCallback;
+}
+
+void roadmap_net_cancel_connect (void *context) {
+}
+
+int roadmap_net_send (RoadMapSocket s, const void *data, int length, int wait) {
+
+   return length;
+}
+
+void roadmap_net_close (RoadMapSocket s) {
+}
+
+int roadmap_net_get_fd (RoadMapSocket s) {
+
+   return 1;
+}
+
+BOOL socket_async_receive (RoadMapSocket s,
+                           void *data,
+                           int size,
+                           CB_OnDataReceive cbOnDataReceive,
+                           void *context) {
+
+   ReceiveCallback = cbOnDataReceive;
+   ReceiveBuffer = data;
+   ReceiveSize = size;
+   ReceiveContext = context;
+
+   return TRUE;
+}
+
+void socket_async_receive_end (RoadMapSocket s) {
+}
+
+
+/* --- The road info records --- */
+
+static RTTrafficInfo Records[2];
+static RTTrafficInfo Updated[2];
+static int UpdatedCount[2];
+
+RTTrafficInfo *RTTrafficInfo_RecordByID (int iInfoID) {
+
+   if (iInfoID == GEOM_ID) return Records;
+   if (iInfoID == GEOM_ID_SHORT) return Records + 1;
+
+   return NULL;
+}
+
+BOOL RTTrafficInfo_UpdateGeometry (RTTrafficInfo *pTrafficInfo) {
+
+   int i = (int) (pTrafficInfo - Records);
+
+   Updated[i] = *pTrafficInfo;
+   UpdatedCount[i]++;
+
+   return TRUE;
+}
+
+
+/* --- The other lines of the response --- */
+
+static int UserLines;
+static int UserErrors;
+
+/* "AddUser,<n>,user<n>": each field must come whole */
+static const char *parse_user (const char *data, void *context,
+                               BOOL *more_data_needed, roadmap_result *rc) {
+
+   string_field field;
+   char name[32];
+   int id;
+
+   data = ReadFieldFromString (data, ",", &field, 1);
+   if (!data || !StringFieldToInt (&field, &id)) {
+      UserErrors++;
+      *rc = err_parser_unexpected_data;
+      return NULL;
+   }
+
+   data = ReadFieldFromString (data, "\r\n", &field, 1);
+   snprintf (name, sizeof (name), "user%d", id);
+
+   if (!data || field.size != (int) strlen (name) || strncmp (field.data, name, field.size)) {
+      UserErrors++;
+      *rc = err_parser_unexpected_data;
+      return NULL;
+   }
+
+   UserLines++;
+   *more_data_needed = FALSE;
+
+   return data;
+}
+
+static wst_parser ParserTable[] = {
+   { "AddUser",      parse_user   },
+   { "RoadInfoGeom", RoadInfoGeom }
+};
+
+
+/* --- ReadFieldFromString and the cyclic buffer --- */
+
+static void test_fields (void) {
+
+   string_field field;
+   const char *text;
+   BOOL value;
+   int number;
+
+   text = "12,34";
+   TEST_CHECK (ReadFieldFromString (text, ",", &field, 1) == text + 3);
+   TEST_CHECK (field.data == text && field.size == 2);
+
+   /* Not terminated: the rest of the field did not arrive yet */
+   TEST_CHECK (ReadFieldFromString ("12", ",", &field, 1) == NULL);
+   TEST_CHECK (ReadFieldFromString ("", ",", &field, 1) == NULL);
+   TEST_CHECK (ReadFieldFromString (NULL, ",", &field, 1) == NULL);
+
+   text = ",,5";
+   TEST_CHECK (ReadFieldFromString (text, ",", &field, 1) == text + 1);
+   TEST_CHECK (field.size == 0);
+   TEST_CHECK (ReadFieldFromString (text, ",", &field, TRIM_ALL_CHARS) == text + 2);
+
+   text = "-3\r\nAddUser";
+   TEST_CHECK (ReadFieldFromString (text, ",\r\n", &field, TRIM_ALL_CHARS) == text + 4);
+   TEST_CHECK (StringFieldToInt (&field, &number) && number == -3);
+
+   field.data = "007";
+   field.size = 3;
+   TEST_CHECK (StringFieldToInt (&field, &number) && number == 7);
+   field.size = 0;
+   TEST_CHECK (!StringFieldToInt (&field, &number));
+   field.data = "-";
+   field.size = 1;
+   TEST_CHECK (!StringFieldToInt (&field, &number));
+   field.data = "4x";
+   field.size = 2;
+   TEST_CHECK (!StringFieldToInt (&field, &number));
+
+   text = "T,F\n";
+   text = ReadBoolFromString (text, ",\r\n", &value, 1);
+   TEST_CHECK (text && value);
+   text = ReadBoolFromString (text, ",\r\n", &value, 1);
+   TEST_CHECK (text && !value && !*text);
+}
+
+
+/* As on_data_received() does it */
+static void buffer_receive (cyclic_buffer *buffer, const char *data) {
+
+   int size = strlen (data);
+
+   cyclic_buffer_recycle (buffer);
+   memcpy (buffer->next_read, data, size);
+   buffer->read_size += size;
+   buffer->buffer[buffer->read_size] = '\0';
+}
+
+static void test_line_end (void) {
+
+   static cyclic_buffer buffer;
+   const char *end;
+
+   cyclic_buffer_init (&buffer);
+
+   buffer_receive (&buffer, "AddUser,1");
+   TEST_CHECK (cyclic_buffer_get_line_end (&buffer) == NULL);
+   TEST_CHECK (buffer.line_scanned == 9);
+
+   /* Only the new data is searched */
+   buffer.buffer[3] = '\n';
+   buffer_receive (&buffer, ",user1\nAdd");
+   end = cyclic_buffer_get_line_end (&buffer);
+   TEST_CHECK (end == buffer.buffer + 15);
+   buffer.buffer[3] = 'U';
+
+   /* The next line starts after the processed data */
+   cyclic_buffer_update_processed_data (&buffer, end + 1, NULL);
+   TEST_CHECK (cyclic_buffer_get_line_end (&buffer) == NULL);
+   TEST_CHECK (buffer.line_scanned == 19);
+
+   /* The scanned offset moves with the data */
+   buffer_receive (&buffer, "User,2\n");
+   TEST_CHECK (!strcmp (buffer.buffer, "AddUser,2\n"));
+   TEST_CHECK (buffer.line_scanned == 3);
+   TEST_CHECK (cyclic_buffer_get_line_end (&buffer) == buffer.buffer + 9);
+
+   /* All processed: the buffer starts over */
+   cyclic_buffer_update_processed_data (&buffer, buffer.buffer + 10, NULL);
+   buffer_receive (&buffer, "RC");
+   TEST_CHECK (buffer.line_scanned == 0);
+   TEST_CHECK (cyclic_buffer_get_line_end (&buffer) == NULL);
+}
+
+
+/* --- The transactions --- */
+
+static int Completed;
+static roadmap_result CompletedResult;
+
+static void on_completed (void *context, roadmap_result res) {
+
+   Completed++;
+   CompletedResult = res;
+}
+
+static RoadMapPosition *Geometry;
+static int GeometryCount;
+
+static int add_geometry (char *body, int id, int count, int seed) {
+
+   RoadMapPosition position = {0, 0};
+   int size;
+   int i;
+
+   size = sprintf (body, "RoadInfoGeom,%d,%d", id, count * 2);
+
+   srand (seed);
+   for (i = 0; i < count; i++) {
+
+      int longitude = rand () % 2000 - 1000;
+      int latitude = rand () % 2000 - 1000;
+
+      position.longitude += longitude;
+      position.latitude += latitude;
+      if (id == GEOM_ID && i < GeometryCount) Geometry[i] = position;
+
+      size += sprintf (body + size, ",%d,%d", longitude, latitude);
+   }
+
+   return size + sprintf (body + size, "\r\n");
+}
+
+static void build_response (int coords) {
+
+   char header[128];
+   char *body;
+   int body_size = 0;
+   int header_size;
+
+   free (Response);
+
+   body = malloc (coords * 24 + 1024);
+   roadmap_check_allocated (body);
+
+   body_size += sprintf (body + body_size, "AddUser,1,user1\n");
+   if (coords) {
+      body_size += add_geometry (body + body_size, GEOM_ID, coords, 1);
+      body_size += add_geometry (body + body_size, GEOM_ID_UNKNOWN, coords, 2);
+      body_size += sprintf (body + body_size, "AddUser,2,user2\n");
+   }
+   body_size += add_geometry (body + body_size, GEOM_ID_SHORT, SHORT_COORDS, 3);
+   body_size += sprintf (body + body_size, "AddUser,3,user3\n");
+
+   header_size = sprintf (header, "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n", body_size);
+
+   Response = malloc (header_size + body_size + 1);
+   roadmap_check_allocated (Response);
+
+   memcpy (Response, header, header_size);
+   memcpy (Response + header_size, body, body_size + 1);
+   ResponseSize = header_size + body_size;
+
+   free (body);
+}
+
+/* Sends the response, cut at the given offsets and then in chunks */
+static void run_transaction (wst_handle session, const int *cuts, int cut_count, int chunk) {
+
+   int cut = 0;
+
+   memset (UpdatedCount, 0, sizeof (UpdatedCount));
+   memset (Updated, 0, sizeof (Updated));
+   UserLines = 0;
+   UserErrors = 0;
+   Completed = 0;
+
+   ReceiveCallback = NULL;
+   ResponseSent = 0;
+
+   TEST_CHECK (wst_start_trans (session, 0, "Bench", WEBSVC_NO_TYPE, ParserTable, 2,
+                                on_completed, NULL, "Bench,%d", 1));
+
+   ConnectCallback ((RoadMapSocket) &ConnectCallback, ConnectContext, succeeded);
+
+   while (ReceiveCallback && ResponseSent < ResponseSize) {
+
+      CB_OnDataReceive callback = ReceiveCallback;
+      int size = ResponseSize - ResponseSent;
+
+      if (cut < cut_count) size = cuts[cut++] - ResponseSent;
+      else if (size > chunk) size = chunk;
+      if (size > ReceiveSize) size = ReceiveSize;
+
+      memcpy (ReceiveBuffer, Response + ResponseSent, size);
+      ResponseSent += size;
+
+      ReceiveCallback = NULL;
+      callback (ReceiveBuffer, size, ReceiveContext);
+   }
+}
+
+static int check_short (void) {
+
+   RoadMapPosition position = {0, 0};
+   int ok;
+   int i;
+
+   ok = UpdatedCount[1] == 1 &&
+        Updated[1].iNumGeometryPoints == SHORT_COORDS &&
+        UserErrors == 0 &&
+        Completed == 1;
+
+   srand (3);
+   for (i = 0; ok && i < SHORT_COORDS; i++) {
+
+      position.longitude += rand () % 2000 - 1000;
+      position.latitude += rand () % 2000 - 1000;
+
+      ok = Updated[1].geometry[i].longitude == position.longitude &&
+           Updated[1].geometry[i].latitude == position.latitude;
+   }
+
+   return ok;
+}
+
+/* The short response, split once and twice at every offset */
+static void test_splits (wst_handle session) {
+
+   int body;
+   int cuts[2];
+   int failed = 0;
+   int runs = 0;
+   int i;
+   int j;
+
+   build_response (0);
+   body = strstr (Response, "\r\n\r\n") - Response + 4;
+
+   for (i = body; i < ResponseSize; i++) {
+
+      cuts[0] = i;
+      run_transaction (session, cuts, 1, ResponseSize);
+      runs++;
+
+      if (!check_short () || UserLines != 2 || CompletedResult != succeeded) failed++;
+
+      for (j = i + 1; j < ResponseSize; j++) {
+
+         cuts[1] = j;
+         run_transaction (session, cuts, 2, ResponseSize);
+         runs++;
+
+         if (!check_short () || UserLines != 2 || CompletedResult != succeeded) failed++;
+      }
+   }
+
+   printf ("%d bytes split at every offset: %d of %d transactions failed\n",
+           ResponseSize - body, failed, runs);
+
+   TEST_CHECK (failed == 0);
+}
+
+/* Geometry lines longer than the receive buffer */
+static void test_long_lines (wst_handle session, int coords, int chunk) {
+
+   double start;
+   double elapsed;
+   int i;
+
+   build_response (coords);
+
+   start = test_time_ms ();
+   run_transaction (session, NULL, 0, chunk);
+   elapsed = test_time_ms () - start;
+
+   printf ("%d coordinates per line, %5d byte chunks: %8.2f ms  %6.1f ns/byte\n",
+           coords, chunk, elapsed, elapsed * 1000000.0 / ResponseSize);
+
+   TEST_CHECK (ResponseSize > CYCLIC_BUFFER_SIZE * 2);
+   TEST_CHECK (Completed == 1);
+
+   /* The unknown road info fails the transaction, the rest is parsed */
+   TEST_CHECK (CompletedResult == err_parser_failed);
+   TEST_CHECK (UserLines == 3);
+   TEST_CHECK (check_short ());
+
+   TEST_CHECK (UpdatedCount[0] == 1);
+   TEST_CHECK (Updated[0].iNumGeometryPoints == GeometryCount);
+
+   for (i = 0; i < GeometryCount; i++) {
+      if (Updated[0].geometry[i].longitude != Geometry[i].longitude ||
+          Updated[0].geometry[i].latitude != Geometry[i].latitude) break;
+   }
+   TEST_CHECK (i == GeometryCount);
+}
+
+
+int main (int argc, char **argv) {
+
+   wst_handle session;
+   int coords = 10000;
+
+   if (argc > 1) coords = atoi (argv[1]);
+   if (coords < CYCLIC_BUFFER_SIZE / 8) {
+      fprintf (stderr, "Usage: %s [coordinates]\n", argv[0]);
+      return 1;
+   }
+
+   test_fields ();
+   test_line_end ();
+
+   GeometryCount = coords < RT_TRAFFIC_INFO_MAX_GEOM ? coords : RT_TRAFFIC_INFO_MAX_GEOM;
+   Geometry = malloc (GeometryCount * sizeof (RoadMapPosition));
+   roadmap_check_allocated (Geometry);
+
+   session = wst_init ("http://localhost:80/rtserver", NULL, NULL, NULL, "binary/octet-stream");
+   TEST_CHECK (session != NULL);
+   TEST_CHECK (wst_register_partial_lines_parser (RoadInfoGeom));
+
+   test_splits (session);
+   test_long_lines (session, coords, 1);
+   test_long_lines (session, coords, 1000);
+   test_long_lines (session, coords, RECEIVE_CHUNK);
+
+   wst_term (session);
+   free (Response);
+   free (Geometry);
+
+   return test_result ("bench_wst_partial");
+}
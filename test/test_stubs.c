@@ -0,0 +1,89 @@
+/* test_stubs.c - The few RoadMap services the test programs link against.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * SYNOPSYS:
+ *
+ *   See test_stubs.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <sys/time.h>
+
+#include "roadmap.h"
+#include "test_stubs.h"
+
+static int TestFailures = 0;
+
+
+void roadmap_log (int level, const char *source, int line, const char *format, ...) {
+
+   va_list ap;
+
+   if (level < ROADMAP_MESSAGE_ERROR && !getenv ("TEST_VERBOSE")) return;
+
+   va_start (ap, format);
+   fprintf (stderr, "%s:%d: ", source, line);
+   vfprintf (stderr, format, ap);
+   fprintf (stderr, "\n");
+   va_end (ap);
+
+   if (level >= ROADMAP_MESSAGE_FATAL) exit (1);
+}
+
+
+void roadmap_check_allocated_with_source_line
+                (const char *source, int line, const void *allocated) {
+
+   if (allocated == NULL) {
+      fprintf (stderr, "%s:%d: no more memory\n", source, line);
+      exit (1);
+   }
+}
+
+
+double test_time_ms (void) {
+
+   struct timeval now;
+
+   gettimeofday (&now, NULL);
+
+   return now.tv_sec * 1000.0 + now.tv_usec / 1000.0;
+}
+
+
+void test_check (int condition, const char *source, int line, const char *what) {
+
+   if (!condition) {
+      fprintf (stderr, "%s:%d: FAILED: %s\n", source, line, what);
+      TestFailures++;
+   }
+}
+
+
+int test_result (const char *name) {
+
+   printf ("%s: %s\n", name, TestFailures ? "FAILED" : "ok");
+
+   return TestFailures ? 1 : 0;
+}
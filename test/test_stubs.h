@@ -0,0 +1,41 @@
+/* test_stubs.h - Helpers shared by the test and benchmark programs.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2009 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The programs of this directory link a module with stubs of the rest
+ *   of RoadMap. roadmap_log() prints errors only, unless TEST_VERBOSE is
+ *   set in the environment.
+ */
+
+#ifndef _TEST_STUBS__H_
+#define _TEST_STUBS__H_
+
+double test_time_ms (void);
+
+#define TEST_CHECK(c) test_check ((c), __FILE__, __LINE__, #c)
+void test_check (int condition, const char *source, int line, const char *what);
+
+/* Prints the outcome and returns the exit code of the program */
+int test_result (const char *name);
+
+#endif // _TEST_STUBS__H_
@@ -8,6 +8,9 @@
  *   TODO:: Rename to dnsresolver ?
  *   TODO:  Rename domain entry to resolver entry ?
  *
+ *   Lookups are done by a fixed pool of worker threads, fed from a bounded job queue.
+ *   Each domain has a single table entry: concurrent requests for it wait on the same lookup,
+ *   and the result (success or failure) is cached in the entry for a limited time.
  */
 #include "roadmap.h"
 #include "roadmap_hash.h"
@@ -17,7 +20,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <netdb.h>
-#include <signal.h>
+#include <sys/socket.h>
 
 //======================== Local defines =========================
 
@@ -30,6 +33,11 @@
 #define RSLV_RETRY_COUNT            5
 #define RSLV_RETRY_PERIOD           30000             // 30 sec
 
+#define RSLV_WORKER_COUNT           4
+#define RSLV_QUEUE_SIZE             ( 2 * RSLV_TABLE_SIZE )
+#define RSLV_POSITIVE_TTL           300               // sec. The system resolver does not expose the record TTL
+#define RSLV_NEGATIVE_TTL           30                // sec
+
 #define RSLV_MSG_RETRY_INDEX_SHIFT  8
 #define RSLV_MSG_ENTRY_ID_MASK      0x00FF
 #define RSLV_MSG_RETRY_INDEX_MASK   0xFF00
@@ -48,45 +56,75 @@ typedef ResolverRequest_t *ResolverRequest;
 
 typedef struct
 {
-//   int busy __attribute__ ((aligned(32)));   // Ensure this variable is aligned. Necessary to ensure the read/write is atomic-wise (one cycle)
-   int busy;
+   int busy;                                 // Lookup in progress
    char domain[RSLV_DOMAIN_NAME_MAX_LEN];    // Domain to resolve
    in_addr_t ip_addr;                        // Resolved address. Note: This is updated in resolver thread
 
-   pthread_t         thread_id;
    time_t            start_time;
-   int               retry_index  __attribute__ ((aligned(32)));    // Ensure this variable is atomic-wise (one cycle) read/write
-                                                                    // Current retry number starting from 0
+   time_t            expire_time;            // The cached result (ip_addr) is valid until this time
+   int               retry_index;            // Identifies the current lookup. Wraps in the message bits.
+                                             // Never reset, so a late result of an entry reused for another domain is dismissed
+   int               retry_count;            // Retries of the current lookup
    int               request_count;
    ResolverRequest_t requests[RSLV_REQUEST_MAX_NUM];
 } ResolverEntry_t;
 
 typedef ResolverEntry_t* ResolverEntry;
-#define RSLV_ENTRY_INITIALIZER         { 0, {0}, INADDR_NONE, 0, 0, 0, 0, {{NULL, NULL}} }
+
+typedef struct
+{
+   int entry_id;
+   int retry_idx;
+} ResolverJob_t;
 
 //======================== Globals ========================
 
 static ResolverEntry_t  sgResolverTable[RSLV_TABLE_SIZE];
 static RoadMapHash*    sgResolverHash = NULL;
 
+// Job queue shared with the workers. The mutex also protects the ip_addr and retry_index of the entries
+static pthread_mutex_t  sgResolverMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   sgResolverCond = PTHREAD_COND_INITIALIZER;
+static ResolverJob_t    sgResolverQueue[RSLV_QUEUE_SIZE];
+static int              sgResolverQueueHead = 0;
+static int              sgResolverQueueCount = 0;
+static BOOL             sgResolverShutdown = FALSE;
+
 //======================== Local Declarations ========================
 static ResolverEntry _find_entry( const char* domain );
 static void *_resolver( void* params );
 static int _find_empty( void );
 static void _start_resolver( const char* domain, ResolverRequestCb callback, const void* context );
+static BOOL _queue_resolver( int entry_id );
+static void _add_request( ResolverEntry entry, ResolverRequestCb callback, const void* context );
 static void _watchdog( void );
 static void _reset_entry( ResolverEntry entry );
 static void _reset_table( void );
-static BOOL _restart_resolver( int entry_id );
 
 /*
  ******************************************************************************
  */
 void resolver_init( void )
 {
+   int i, res;
+   pthread_t thread_id;
+
    sgResolverHash = roadmap_hash_new( "RESOLVER TABLE", RSLV_TABLE_SIZE );
    roadmap_main_set_periodic( RSLV_WATCHDOG_TIMEOUT, _watchdog );
    _reset_table();
+
+   sgResolverShutdown = FALSE;
+
+   for ( i = 0; i < RSLV_WORKER_COUNT; ++i )
+   {
+      res = pthread_create( &thread_id, NULL, _resolver, NULL );
+      if ( res != 0 )
+      {
+         roadmap_log( ROADMAP_ERROR, "Error starting resolver thread. Error: %d ( %s )", res, strerror( res ) );
+         continue;
+      }
+      pthread_detach( thread_id );
+   }
 }
 
 /*
@@ -94,7 +132,16 @@ void resolver_init( void )
  */
 void resolver_shutdown( void )
 {
+   // The workers may be blocked in the system resolver - they are not waited for
+   pthread_mutex_lock( &sgResolverMutex );
+   sgResolverShutdown = TRUE;
+   sgResolverQueueCount = 0;
+   pthread_cond_broadcast( &sgResolverCond );
+   pthread_mutex_unlock( &sgResolverMutex );
+
+   roadmap_main_remove_periodic( _watchdog );
    roadmap_hash_free( sgResolverHash );
+   sgResolverHash = NULL;
 }
 /*
  ******************************************************************************
@@ -107,14 +154,20 @@ void resolver_handler( int msg )
    ResolverEntry entry = &sgResolverTable[entry_id];
    ResolverRequestCb cb;
    const void *ctx;
-   struct in_addr addr = {entry->ip_addr};
-   time_t timeout = time( NULL ) - entry->start_time;
+   struct in_addr addr;
+   time_t now = time( NULL );
+   int request_count;
+   ResolverRequest_t requests[RSLV_REQUEST_MAX_NUM];
+
+   pthread_mutex_lock( &sgResolverMutex );
+   addr.s_addr = entry->ip_addr;
+   pthread_mutex_unlock( &sgResolverMutex );
 
-   roadmap_log( ROADMAP_INFO, "Resolver handler is called for entry %d. Domain '%s' is resolved to %s (%s) within: %d msec.\n" \
+   roadmap_log( ROADMAP_INFO, "Resolver handler is called for entry %d. Domain '%s' is resolved to %s (%s) within: %d sec.\n" \
          "Current retry index: %d, reported retry index: %d",
          entry_id, entry->domain, inet_ntoa( addr ),
-         entry->ip_addr == INADDR_NONE ? "Failure" : "Success",
-         timeout, entry->retry_index, retry_idx );
+         addr.s_addr == INADDR_NONE ? "Failure" : "Success",
+         (int) ( now - entry->start_time ), entry->retry_index, retry_idx );
 
    if ( retry_idx != entry->retry_index )
    {
@@ -123,44 +176,41 @@ void resolver_handler( int msg )
       return;
    }
 
-   // If any retries remain - give a chance
-   if ( entry->ip_addr == INADDR_NONE ) //Failure
+   if ( entry->busy ) // Lookup result. Otherwise the requests wait for a cached failure
    {
-      if ( entry->retry_index < RSLV_RETRY_COUNT )
+      // If any retries remain - give a chance
+      if ( addr.s_addr == INADDR_NONE ) //Failure
       {
-         // AGA TODO:: Apply retry after timeout ?
-         // Now the intention is to apply retry after timeout
-         // Check can be added for the time passed from the last handler thread start
-         if ( _restart_resolver( entry_id ) )
-            return;
-      }
-      else
-      {
-         roadmap_log( ROADMAP_ERROR, "Failure in resolving domain: %s. No more retries - giving up",
-                        entry->domain );
+         if ( entry->retry_count < RSLV_RETRY_COUNT )
+         {
+            entry->retry_count++;
+            if ( _queue_resolver( entry_id ) )
+               return;
+         }
+         else
+         {
+            roadmap_log( ROADMAP_ERROR, "Failure in resolving domain: %s. No more retries - giving up",
+                           entry->domain );
+         }
       }
+
+      entry->busy = 0;  // Not busy any more
+      entry->expire_time = now + ( ( addr.s_addr == INADDR_NONE ) ? RSLV_NEGATIVE_TTL : RSLV_POSITIVE_TTL );
    }
 
-   for ( i = 0; i < entry->request_count; ++i )
+   // The callbacks may issue new requests
+   request_count = entry->request_count;
+   memcpy( requests, entry->requests, request_count * sizeof( ResolverRequest_t ) );
+   entry->request_count = 0;
+
+   for ( i = 0; i < request_count; ++i )
    {
-      cb = entry->requests[i].cb;
-      ctx = entry->requests[i].context;
+      cb = requests[i].cb;
+      ctx = requests[i].context;
 
       if ( cb )
-         cb( ctx, entry->ip_addr );
-   }
-
-   if ( entry->ip_addr == INADDR_NONE ) // Failure
-   {
-      _reset_entry( entry );
-   }
-   else  // Add to hash
-   {
-      entry->busy = 0;  // Not busy any more
-      entry->request_count = 0;
-      roadmap_hash_add( sgResolverHash, roadmap_hash_string( entry->domain ), entry_id );
+         cb( ctx, addr.s_addr );
    }
-
 }
 
 /*
@@ -172,7 +222,7 @@ in_addr_t resolver_find( const char* domain )
    ResolverEntry entry = NULL;
    entry = _find_entry( domain );
 
-   if ( entry && !entry->busy )
+   if ( entry && !entry->busy && ( time( NULL ) < entry->expire_time ) )
    {
       ip_addr = entry->ip_addr;
    }
@@ -191,20 +241,28 @@ in_addr_t resolver_request( const char* domain, ResolverRequestCb callback, cons
 
    if ( entry )
    {
+      int entry_id = entry - sgResolverTable;
+
       if ( entry->busy > 0 ) // In process
       {
-         if ( entry->request_count < RSLV_REQUEST_MAX_NUM )
-         {
-            ResolverRequest request = &entry->requests[entry->request_count];
-            request->cb = callback;
-            request->context = context;
-            entry->request_count++;
-         }
-         else // TODO:: Add error notification
+         _add_request( entry, callback, context );
+      }
+      else if ( time( NULL ) >= entry->expire_time ) // Expired - look it up again
+      {
+         _add_request( entry, callback, context );
+         entry->busy = 1;
+         entry->retry_count = 0;
+         if ( !_queue_resolver( entry_id ) )
          {
-            roadmap_log( ROADMAP_ERROR, "Too many requests for the domain %s resolving", domain );
+            entry->busy = 0;
+            roadmap_main_post_resolver_result( RSLV_MSG_BUILD( entry_id, entry->retry_index ) );
          }
       }
+      else if ( entry->ip_addr == INADDR_NONE ) // Cached failure - reported asynchronously, as a lookup would
+      {
+         _add_request( entry, callback, context );
+         roadmap_main_post_resolver_result( RSLV_MSG_BUILD( entry_id, entry->retry_index ) );
+      }
       else
       {
          ip_addr = entry->ip_addr;
@@ -245,76 +303,79 @@ static ResolverEntry _find_entry( const char* domain )
 }
 /*
  ******************************************************************************
- * Android workaround due to absence of pthread_cancel
  */
-
-static void _resolver_exit_handler(int sig)
+static in_addr_t _lookup( const char* domain )
 {
-   pthread_exit(0);
+   in_addr_t ip_addr = INADDR_NONE;
+   struct addrinfo hints;
+   struct addrinfo *result = NULL;
+
+   if ( isdigit( domain[0] ) )
+   {
+      return inet_addr( domain );
+   }
+
+   // getaddrinfo is reentrant, unlike gethostbyname
+   memset( &hints, 0, sizeof( hints ) );
+   hints.ai_family = AF_INET;
+   hints.ai_socktype = SOCK_STREAM;
+
+   if ( getaddrinfo( domain, NULL, &hints, &result ) == 0 && result )
+   {
+      ip_addr = ( (struct sockaddr_in*) result->ai_addr )->sin_addr.s_addr;
+   }
+
+   if ( result )
+      freeaddrinfo( result );
+
+   return ip_addr;
 }
 /*
  ******************************************************************************
  */
 static void *_resolver( void* params )
 {
-   int entry_id = (int) params;
-   ResolverEntry entry = &sgResolverTable[entry_id];
-   struct hostent *host = NULL;
-   in_addr_t ip_addr = INADDR_NONE;
-   struct sigaction actions;
-   int retry_idx;
-   int msg;
+   ResolverJob_t job;
+   ResolverEntry entry;
+   char domain[RSLV_DOMAIN_NAME_MAX_LEN];
+   in_addr_t ip_addr;
 
-   // This is very important to save the retry_index here. It's used to match thread and resolving request
-   // For example If the thread will stuck on gethostbyname
-   // But afterwards will send the message just before being killed due to timeout, the retry_idx in the sgResolverTable[entry_id]
-   // will be already different.
-   retry_idx = entry->retry_index;
+   pthread_mutex_lock( &sgResolverMutex );
 
-   // AGA DEBUG
-//   roadmap_log( ROADMAP_WARNING, "Started resolver for: %s. Retry: %d. Thread id: %ld",
-//         entry->domain, entry->retry_index, pthread_self() );
-/*
- * AGA Comment. No pthread_cancel in android - using _kill ( SIGTERM )
- * instead
- */
+   while ( !sgResolverShutdown )
+   {
+      if ( sgResolverQueueCount == 0 )
+      {
+         pthread_cond_wait( &sgResolverCond, &sgResolverMutex );
+         continue;
+      }
 
-//   pthread_setcancelstate( PTHREAD_CANCEL_ENABLE, NULL );
-//   pthread_setcanceltype( PTHREAD_CANCEL_ASYNCHRONOUS, NULL );
+      job = sgResolverQueue[sgResolverQueueHead];
+      sgResolverQueueHead = ( sgResolverQueueHead + 1 ) % RSLV_QUEUE_SIZE;
+      sgResolverQueueCount--;
 
-   memset( &actions, 0, sizeof(actions) );
-   sigemptyset( &actions.sa_mask );
-   actions.sa_flags = 0;
-   actions.sa_handler = _resolver_exit_handler;
-   sigaction( SIGTERM, &actions, NULL );
+      // This is very important to check the retry_index here. It's used to match the job and the resolving request
+      // For example if the watchdog already gave up on this lookup, or the entry was reused.
+      entry = &sgResolverTable[job.entry_id];
+      if ( entry->retry_index != job.retry_idx )
+         continue;
 
-   if ( isdigit( entry->domain[0] ) )
-   {
-      ip_addr = inet_addr( entry->domain );
-   }
-   else
-   {
-      struct in_addr addr;
-      host = gethostbyname( entry->domain );
+      strncpy_safe( domain, entry->domain, sizeof( domain ) );
 
-      if ( host )
-      {
-         memcpy ( &addr , host->h_addr, host->h_length );
-         ip_addr = addr.s_addr;
-      }
-   }
+      pthread_mutex_unlock( &sgResolverMutex );
+      ip_addr = _lookup( domain );
+      pthread_mutex_lock( &sgResolverMutex );
 
-   // Cancellation point !!!!
-   if ( entry->retry_index != retry_idx )
-   {
-      return NULL;
-   }
+      if ( sgResolverShutdown || entry->retry_index != job.retry_idx )
+         continue;
+
+      entry->ip_addr = ip_addr;
 
-   entry->ip_addr = ip_addr;
+      // Notify the main thread on completion
+      roadmap_main_post_resolver_result( RSLV_MSG_BUILD( job.entry_id, job.retry_idx ) );
+   }
 
-   // Notify the main thread on completion
-   msg = RSLV_MSG_BUILD( entry_id, retry_idx );
-   roadmap_main_post_resolver_result( msg );
+   pthread_mutex_unlock( &sgResolverMutex );
 
    return NULL;
 }
@@ -324,81 +385,129 @@ static void *_resolver( void* params )
  */
 static void _start_resolver( const char* domain, ResolverRequestCb callback, const void* context )
 {
-   pthread_t thread_id;
-   int res;
    int entry_id = _find_empty();
-   ResolverEntry entry = &sgResolverTable[entry_id];
-   if ( entry_id >= 0 )
+   ResolverEntry entry;
+
+   if ( entry_id < 0 )
    {
+      roadmap_log( ROADMAP_ERROR, "Cannot find empty entry for the new domain: %s", domain );
+      return;
+   }
 
-      // Post the request
-      entry->busy = 1;
-      entry->start_time = time( NULL );
-      entry->request_count = 1;
-      entry->requests[0].cb = callback;
-      entry->requests[0].context = context;
-      strncpy_safe( entry->domain, domain, sizeof( entry->domain ) );
-      res = pthread_create( &thread_id, NULL, _resolver, (void*) entry_id );
-      entry->thread_id = thread_id;
+   entry = &sgResolverTable[entry_id];
 
-      roadmap_log( ROADMAP_INFO, "Started resolver thread %ld with result %d. Domain '%s'. Callback: 0x%x",
-            entry->thread_id, res, domain, callback );
+   // Post the request
+   entry->busy = 1;
+   entry->retry_count = 0;
+   entry->request_count = 0;
+   _add_request( entry, callback, context );
+   strncpy_safe( entry->domain, domain, sizeof( entry->domain ) );
 
-      if ( res < 0 )
-      {
-         _reset_entry( entry );
-         roadmap_log( ROADMAP_ERROR, "Error starting thread. Error: %d ( %s )", errno, strerror( errno ) );
-      }
-   }
-   else
+   // In the hash while in process - concurrent requests wait on this lookup
+   roadmap_hash_add( sgResolverHash, roadmap_hash_string( entry->domain ), entry_id );
+
+   roadmap_log( ROADMAP_INFO, "Queueing resolver for domain '%s' (entry %d). Callback: 0x%x",
+         domain, entry_id, callback );
+
+   if ( !_queue_resolver( entry_id ) )
    {
-      roadmap_log( ROADMAP_ERROR, "Cannot find empty entry for the new domain: %s", domain );
+      // Reported as a failure - cached for the negative TTL
+      entry->busy = 0;
+      entry->expire_time = time( NULL ) + RSLV_NEGATIVE_TTL;
+      roadmap_main_post_resolver_result( RSLV_MSG_BUILD( entry_id, entry->retry_index ) );
    }
 }
 
 /*
  ******************************************************************************
  */
-static BOOL _restart_resolver( int entry_id )
+static BOOL _queue_resolver( int entry_id )
 {
-   pthread_t thread_id;
-   int res;
    ResolverEntry entry = &sgResolverTable[entry_id];
-   // Post the request
-   entry->busy = 1;
+   ResolverJob_t *job;
+   BOOL res = FALSE;
+
+   pthread_mutex_lock( &sgResolverMutex );
+
    entry->start_time = time( NULL );
-   entry->retry_index++;
+   entry->retry_index = ( entry->retry_index + 1 ) & ( RSLV_MSG_RETRY_INDEX_MASK >> RSLV_MSG_RETRY_INDEX_SHIFT );
    entry->ip_addr = INADDR_NONE;
-   res = pthread_create( &thread_id, NULL, _resolver, (void*) entry_id );
-   entry->thread_id = thread_id;
 
-   roadmap_log( ROADMAP_INFO, "Retry: %d. Restarted resolver thread %d with result %d. Domain '%s'.",
-         entry->retry_index, entry->thread_id, res, entry->domain );
+   if ( sgResolverQueueCount < RSLV_QUEUE_SIZE )
+   {
+      job = &sgResolverQueue[( sgResolverQueueHead + sgResolverQueueCount ) % RSLV_QUEUE_SIZE];
+      job->entry_id = entry_id;
+      job->retry_idx = entry->retry_index;
+      sgResolverQueueCount++;
+      pthread_cond_signal( &sgResolverCond );
+      res = TRUE;
+   }
 
-   if ( res != 0 )
+   pthread_mutex_unlock( &sgResolverMutex );
+
+   if ( !res )
    {
-      _reset_entry( entry );
-      roadmap_log( ROADMAP_ERROR, "Error restarting thread. Error: %d ( %s )", errno, strerror( errno ) );
+      roadmap_log( ROADMAP_ERROR, "Resolver queue is full. Cannot resolve domain '%s'", entry->domain );
    }
-   return ( res == 0 );
+   else
+   {
+      roadmap_log( ROADMAP_INFO, "Retry: %d. Queued resolver for domain '%s'.",
+            entry->retry_count, entry->domain );
+   }
+
+   return res;
 }
 
+/*
+ ******************************************************************************
+ */
+static void _add_request( ResolverEntry entry, ResolverRequestCb callback, const void* context )
+{
+   if ( entry->request_count < RSLV_REQUEST_MAX_NUM )
+   {
+      ResolverRequest request = &entry->requests[entry->request_count];
+      request->cb = callback;
+      request->context = context;
+      entry->request_count++;
+   }
+   else // TODO:: Add error notification
+   {
+      roadmap_log( ROADMAP_ERROR, "Too many requests for the domain %s resolving", entry->domain );
+   }
+}
 
 /*
  ******************************************************************************
+ * Returns a free entry, or else the entry which expired first. Entries with
+ * pending requests are never reused.
  */
 static int _find_empty( void )
 {
-   int i = -1;
+   int i;
+   int oldest = -1;
    ResolverEntry entry = NULL;
 
    for ( i = 0; i < RSLV_TABLE_SIZE; ++i )
    {
       entry = &sgResolverTable[i];
       if ( !entry->busy && !entry->domain[0] )
-         break;
+         return i;
+
+      if ( entry->busy || entry->request_count > 0 )
+         continue;
+
+      if ( oldest < 0 || entry->expire_time < sgResolverTable[oldest].expire_time )
+         oldest = i;
    }
-   return i;
+
+   if ( oldest >= 0 )
+   {
+      entry = &sgResolverTable[oldest];
+      roadmap_hash_remove( sgResolverHash, roadmap_hash_string( entry->domain ), oldest );
+      _reset_entry( entry );
+   }
+
+   return oldest;
 }
 /*
  ******************************************************************************
@@ -410,19 +519,21 @@ static void _reset_entry( ResolverEntry entry )
       entry->busy = 0;
       entry->domain[0] = 0;
       entry->ip_addr = INADDR_NONE;
+      entry->expire_time = 0;
       entry->request_count = 0;
-      entry->retry_index = 0;
+      entry->retry_count = 0;
    }
 }
 /*
  ******************************************************************************
+ * A worker blocked in the system resolver cannot be interrupted: the lookup is
+ * given up (its late result will be dismissed) and retried on another worker.
  */
 static void _watchdog( void )
 {
    int i;
    ResolverEntry entry;
    time_t timeout;
-   int res;
    int msg;
 
    for ( i = 0; i < RSLV_TABLE_SIZE; ++i )
@@ -436,16 +547,8 @@ static void _watchdog( void )
       if ( timeout < RSLV_HANDLER_TIMEOUT ) // Still has time to work
          continue;
 
-      roadmap_log( ROADMAP_WARNING, "Timeout passed in resolving domain '%s'. Cancelling thread: %d",
-            entry->domain, entry->thread_id );
-
-//      pthread_cancel( entry->thread_id );
-      if ( ( res = pthread_kill( entry->thread_id, SIGTERM ) ) != 0 )
-      {
-         roadmap_log( ROADMAP_ERROR, "Error cancelling resolver thread %d, error = %d (%s)",
-               entry->thread_id, res, strerror( res ) );
-      }
-      pthread_join( entry->thread_id, NULL );  // Wait for the thread to completely terminate
+      roadmap_log( ROADMAP_WARNING, "Timeout passed in resolving domain '%s'. Giving up retry %d",
+            entry->domain, entry->retry_count );
 
       msg = RSLV_MSG_BUILD( i, entry->retry_index );
       resolver_handler( msg );
@@ -54,6 +54,7 @@
 #include "../websvc_trans/web_date_format.h"
 #include "roadmap_main.h"
 #include "roadmap_ssl.h"
+#include "roadmap_net_reactor.h"
 
 #if defined(ANDROID) || defined(GTK)
 #define __SSL__
@@ -81,6 +82,10 @@ static RoadMapConfigDescriptor RoadMapConfigNetCompressEnabled =
 static int  RoadMapNetNumConnects;
 static BOOL RoadMapNetCompressEnabled = FALSE;
 
+#ifdef ROADMAP_NET_EPOLL
+static RoadMapIO RoadMapNetReactorIO;
+#endif
+
 static const char* GetProxyAddress() {
 #ifdef IPHONE
    return (roadmap_main_get_proxy ("http://www.waze.com"));
@@ -110,7 +115,7 @@ static void check_connect_timeout (void) {
 
    time_t timeout = time(NULL) - CONNECT_TIMEOUT_SEC;
 
-   while ((io = roadmap_main_output_timedout(timeout))) {
+   while ((io = roadmap_net_io_output_timedout(timeout))) {
       RoadMapNetData *data = io->context;
       RoadMapSocket s = io->os.socket;
       RoadMapIO retry_io = *io;
@@ -132,7 +137,7 @@ static void check_connect_timeout (void) {
       roadmap_log(ROADMAP_ERROR, "Connect time out (%d)", s->s);
       reuse_connect_io = s->connect_io;
       s->connect_io = NULL;
-      roadmap_main_remove_input(io);
+      roadmap_net_io_remove_input(io);
       roadmap_net_close(s);      
 
       if (retry_io.retry_params.num_retries < 2) {
@@ -170,13 +175,18 @@ static void connect_callback (RoadMapSocket s, RoadMapNetData *data) {
    RoadMapNetNumConnects--;
 
    if (RoadMapNetNumConnects == 0) {
-      roadmap_main_remove_periodic(check_connect_timeout);
+      roadmap_net_io_remove_periodic(check_connect_timeout);
    }
    
    if ((s != ROADMAP_INVALID_SOCKET) && *data->packet) {
       if (!s->is_secured) {
+#ifdef ROADMAP_NET_EPOLL
+         if( -1 == roadmap_net_reactor_send(s->s, data->packet,
+                                            (int)strlen(data->packet))) {
+#else
          if( -1 == roadmap_net_send(s, data->packet,
                                     (int)strlen(data->packet), 1)) {
+#endif
             roadmap_log( ROADMAP_ERROR, "roadmap_net callback (HTTP) - Failed to send the 'POST' packet");
             roadmap_net_close(s);
             s = ROADMAP_INVALID_SOCKET;
@@ -229,7 +239,7 @@ static void io_connect_callback (RoadMapIO *io) {
          free(io->retry_params.resolved_name);
       }
       
-      roadmap_main_remove_input(io);
+      roadmap_net_io_remove_input(io);
    }
 
    if (!s->is_secured) {
@@ -383,7 +393,7 @@ static int create_async_connection (RoadMapIO *io, struct sockaddr *addr) {
       }
    }
 
-   roadmap_main_set_output(io, io_connect_callback, TRUE);
+   roadmap_net_io_set_output(io, io_connect_callback, TRUE);
    RoadMapNetNumConnects++;
 
    if (res == 0) {
@@ -393,7 +403,7 @@ static int create_async_connection (RoadMapIO *io, struct sockaddr *addr) {
    }
 
    if (RoadMapNetNumConnects == 1) {
-      roadmap_main_set_periodic(CONNECT_TIMEOUT_SEC * 1000 /2, check_connect_timeout);
+      roadmap_net_io_set_periodic(CONNECT_TIMEOUT_SEC * 1000 /2, check_connect_timeout);
    }
 
    return 0;
@@ -544,7 +554,7 @@ static void *roadmap_net_connect_internal (const char *protocol, const char *nam
       RoadMapNetNumConnects++;
 
       if (RoadMapNetNumConnects == 1) {
-         roadmap_main_set_periodic(CONNECT_TIMEOUT_SEC * 1000 /2, check_connect_timeout);
+         roadmap_net_io_set_periodic(CONNECT_TIMEOUT_SEC * 1000 /2, check_connect_timeout);
       }
 #endif
 
@@ -628,14 +638,14 @@ void roadmap_net_cancel_connect (RoadMapIO *io) {
    }
    
    roadmap_log(ROADMAP_DEBUG, "Cancelling async connect request (%d)", s->s);
-   roadmap_main_remove_input(io);
+   roadmap_net_io_remove_input(io);
    roadmap_net_close(s);
    free(data);
    
    RoadMapNetNumConnects--;
    
    if (RoadMapNetNumConnects == 0) {
-      roadmap_main_remove_periodic(check_connect_timeout);
+      roadmap_net_io_remove_periodic(check_connect_timeout);
    }
 }
 
@@ -645,6 +655,14 @@ int roadmap_net_send_async( RoadMapSocket s, const void *data, int length )
    int old_flags;
    int result;
 
+#ifdef ROADMAP_NET_EPOLL
+   // Whatever the socket does not take now is flushed by the reactor
+   if ( !s->is_secured )
+   {
+      return roadmap_net_reactor_send( s->s, data, length );
+   }
+#endif
+
    old_flags = fcntl(s->s, F_GETFL, 0);
 
    // Set the socket non blocking
@@ -694,6 +712,13 @@ int roadmap_net_send (RoadMapSocket s, const void *data, int length, int wait) {
       return roadmap_net_send_ssl( s, data, length, wait);
    }
 
+#ifdef ROADMAP_NET_EPOLL
+   /* Keep the order of the data already queued by roadmap_net_send_async */
+   if (roadmap_net_reactor_pending(s->s) > 0) {
+      return roadmap_net_reactor_send(s->s, data, length);
+   }
+#endif
+
    FD_ZERO(&fds);
    FD_SET(s->s, &fds);
 
@@ -818,6 +843,9 @@ void roadmap_net_close (RoadMapSocket s) {
    if (s->connect_io)
    free(s->connect_io);
    if (s->is_secured) roadmap_ssl_close (s->ssl_ctx);
+#ifdef ROADMAP_NET_EPOLL
+   roadmap_net_reactor_close (s->s);
+#endif
    close (s->s);
    if (s->compress_ctx) roadmap_http_comp_close(s->compress_ctx);
    free(s);
@@ -876,11 +904,27 @@ BOOL roadmap_net_get_compress_enabled( void )
 }
 
 
+#ifdef ROADMAP_NET_EPOLL
+static void on_reactor_ready (RoadMapIO *io) {
+   roadmap_net_reactor_dispatch (0);
+}
+#endif
+
+
 void roadmap_net_shutdown (void) {
 
    const char* netcompress_cfg_value = RoadMapNetCompressEnabled ? "yes" : "no";
    roadmap_config_set( &RoadMapConfigNetCompressEnabled, netcompress_cfg_value );
    roadmap_net_mon_destroy();
+
+#ifdef ROADMAP_NET_EPOLL
+   if (RoadMapNetReactorIO.subsystem == ROADMAP_IO_NET) {
+      roadmap_main_remove_input (&RoadMapNetReactorIO);
+      free (RoadMapNetReactorIO.os.socket);
+      RoadMapNetReactorIO.subsystem = ROADMAP_IO_INVALID;
+   }
+   roadmap_net_reactor_shutdown ();
+#endif
 }
 
 void roadmap_net_initialize (void) {
@@ -889,6 +933,19 @@ void roadmap_net_initialize (void) {
    RoadMapNetCompressEnabled = roadmap_config_match( &RoadMapConfigNetCompressEnabled, "yes" );
 
    roadmap_net_mon_start ();
+
+#ifdef ROADMAP_NET_EPOLL
+   /* The main loop waits on the reactor only, whatever the number of sockets */
+   if (roadmap_net_reactor_initialize ()) {
+      RoadMapSocket reactor = calloc (1, sizeof(struct roadmap_socket_t));
+      roadmap_check_allocated(reactor);
+      reactor->s = roadmap_net_reactor_fd ();
+
+      RoadMapNetReactorIO.subsystem = ROADMAP_IO_NET;
+      RoadMapNetReactorIO.os.socket = reactor;
+      roadmap_main_set_input (&RoadMapNetReactorIO, on_reactor_ready);
+   }
+#endif
 }
 
 int roadmap_net_socket_secured (RoadMapSocket s) {
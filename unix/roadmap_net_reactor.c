@@ -0,0 +1,640 @@
+/* roadmap_net_reactor.c - epoll based event loop for the network sockets.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2008 Ehud Shabtai
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * SYNOPSYS:
+ *
+ *   See roadmap_net_reactor.h
+ *
+ *   Each socket has an entry, indexed by its descriptor. Entries are only
+ *   released on shutdown, so a RoadMapIO pointer handed to a callback stays
+ *   valid after the socket is closed. Every epoll event carries the
+ *   generation of the entry it was registered for, so an event for a
+ *   descriptor which was closed and reused in the same dispatch is ignored.
+ */
+
+#ifdef ROADMAP_NET_EPOLL
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "roadmap.h"
+#include "roadmap_net.h"
+#include "roadmap_net_mon.h"
+#include "roadmap_net_reactor.h"
+
+#define REACTOR_MAX_EVENTS    64
+#define REACTOR_MAX_IOV       64
+#define REACTOR_MAX_PERIODIC  16
+
+#define REACTOR_TIMER_KEY     ((uint64_t)-1)
+#define REACTOR_KEY(fd,gen)   (((uint64_t)(gen) << 32) | (uint32_t)(fd))
+
+typedef struct roadmap_reactor_buffer_t {
+   struct roadmap_reactor_buffer_t *next;
+   int  length;
+   int  offset;
+   char data[1];
+} RoadMapReactorBuffer;
+
+typedef struct {
+   RoadMapIO      input_io;
+   RoadMapInput   input_callback;
+
+   RoadMapIO      output_io;
+   RoadMapInput   output_callback;
+   time_t         connect_start;
+
+   RoadMapReactorBuffer *queue_head;
+   RoadMapReactorBuffer *queue_tail;
+   int            queued;
+   BOOL           failed;
+
+   unsigned int   events;       /* As registered in the epoll set */
+   unsigned int   generation;
+} RoadMapReactorEntry;
+
+typedef struct {
+   RoadMapCallback callback;
+   int             interval;
+   long long       deadline;    /* Monotonic, in milliseconds */
+} RoadMapReactorPeriodic;
+
+static int RoadMapReactorEpoll = -1;
+static int RoadMapReactorTimer = -1;
+
+static RoadMapReactorEntry **RoadMapReactorEntries;
+static int RoadMapReactorEntriesSize;
+static int RoadMapReactorConnecting;
+
+static RoadMapReactorPeriodic RoadMapReactorPeriodics[REACTOR_MAX_PERIODIC];
+static int RoadMapReactorPeriodicCount;
+
+
+static long long reactor_now (void) {
+
+   struct timespec now;
+
+   clock_gettime (CLOCK_MONOTONIC, &now);
+   return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+static RoadMapReactorEntry *reactor_entry (int fd, BOOL create) {
+
+   if (fd < 0) return NULL;
+
+   if (fd >= RoadMapReactorEntriesSize) {
+
+      int size = RoadMapReactorEntriesSize ? RoadMapReactorEntriesSize : 64;
+
+      if (!create) return NULL;
+
+      while (size <= fd) size *= 2;
+
+      RoadMapReactorEntries =
+         realloc (RoadMapReactorEntries, size * sizeof(RoadMapReactorEntry *));
+      roadmap_check_allocated(RoadMapReactorEntries);
+
+      memset (RoadMapReactorEntries + RoadMapReactorEntriesSize, 0,
+              (size - RoadMapReactorEntriesSize) * sizeof(RoadMapReactorEntry *));
+      RoadMapReactorEntriesSize = size;
+   }
+
+   if (RoadMapReactorEntries[fd] == NULL && create) {
+      RoadMapReactorEntries[fd] = calloc (1, sizeof(RoadMapReactorEntry));
+      roadmap_check_allocated(RoadMapReactorEntries[fd]);
+   }
+
+   return RoadMapReactorEntries[fd];
+}
+
+
+static int reactor_io_fd (RoadMapIO *io) {
+
+   if (io->subsystem != ROADMAP_IO_NET) {
+      roadmap_log (ROADMAP_ERROR, "Reactor only supports network IO (%d)",
+                   io->subsystem);
+      return -1;
+   }
+
+   return roadmap_net_get_fd (io->os.socket);
+}
+
+
+static void reactor_update (int fd, RoadMapReactorEntry *entry) {
+
+   struct epoll_event event;
+   unsigned int events = 0;
+   int op;
+
+   if (entry->input_callback) events |= EPOLLIN;
+   if (entry->output_callback || entry->queue_head) events |= EPOLLOUT;
+
+   if (events == entry->events) return;
+
+   /* Errors and hangups are always reported, so a socket nobody waits on
+    * is taken out of the set rather than left with an empty mask.
+    */
+   if (events == 0) {
+      op = EPOLL_CTL_DEL;
+   } else if (entry->events == 0) {
+      op = EPOLL_CTL_ADD;
+   } else {
+      op = EPOLL_CTL_MOD;
+   }
+
+   memset (&event, 0, sizeof(event));
+   event.events = events;
+   event.data.u64 = REACTOR_KEY(fd, entry->generation);
+
+   if (epoll_ctl (RoadMapReactorEpoll, op, fd, &event) < 0) {
+      roadmap_log (ROADMAP_ERROR, "epoll_ctl(%d) failed on %d: %s",
+                   op, fd, strerror(errno));
+      return;
+   }
+
+   entry->events = events;
+}
+
+
+static void reactor_free_queue (RoadMapReactorEntry *entry) {
+
+   while (entry->queue_head) {
+      RoadMapReactorBuffer *buffer = entry->queue_head;
+      entry->queue_head = buffer->next;
+      free (buffer);
+   }
+
+   entry->queue_tail = NULL;
+   entry->queued = 0;
+}
+
+
+/* Sends as much of the queue as the socket takes, in one call */
+static int reactor_flush (int fd, RoadMapReactorEntry *entry) {
+
+   struct iovec iov[REACTOR_MAX_IOV];
+   struct msghdr msg;
+   RoadMapReactorBuffer *buffer;
+   int count = 0;
+   int res;
+
+   for (buffer = entry->queue_head;
+        buffer && count < REACTOR_MAX_IOV;
+        buffer = buffer->next) {
+
+      iov[count].iov_base = buffer->data + buffer->offset;
+      iov[count].iov_len = buffer->length - buffer->offset;
+      count++;
+   }
+
+   if (count == 0) return 0;
+
+   memset (&msg, 0, sizeof(msg));
+   msg.msg_iov = iov;
+   msg.msg_iovlen = count;
+
+   res = sendmsg (fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+   if (res < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+
+      roadmap_log (ROADMAP_ERROR, "Error sending queued data on %d: (%d) %s",
+                   fd, errno, strerror(errno));
+      roadmap_net_mon_error("Error in send - data.");
+
+      reactor_free_queue (entry);
+      entry->failed = TRUE;
+      return -1;
+   }
+
+   roadmap_net_mon_send(res);
+   entry->queued -= res;
+
+   while (res > 0) {
+
+      buffer = entry->queue_head;
+
+      if (res < buffer->length - buffer->offset) {
+         buffer->offset += res;
+         break;
+      }
+
+      res -= buffer->length - buffer->offset;
+      entry->queue_head = buffer->next;
+      free (buffer);
+   }
+
+   if (entry->queue_head == NULL) entry->queue_tail = NULL;
+
+   return 0;
+}
+
+
+static void reactor_arm_timer (void) {
+
+   struct itimerspec spec;
+   long long deadline = 0;
+   int i;
+
+   for (i = 0; i < RoadMapReactorPeriodicCount; ++i) {
+      if (deadline == 0 || RoadMapReactorPeriodics[i].deadline < deadline) {
+         deadline = RoadMapReactorPeriodics[i].deadline;
+      }
+   }
+
+   /* A zero it_value disarms the timer */
+   memset (&spec, 0, sizeof(spec));
+   spec.it_value.tv_sec = deadline / 1000;
+   spec.it_value.tv_nsec = (deadline % 1000) * 1000000;
+
+   if (timerfd_settime (RoadMapReactorTimer, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+      roadmap_log (ROADMAP_ERROR, "timerfd_settime failed: %s", strerror(errno));
+   }
+}
+
+
+static void reactor_run_timers (void) {
+
+   uint64_t expirations;
+   long long now;
+   int i;
+
+   if (read (RoadMapReactorTimer, &expirations, sizeof(expirations)) < 0 &&
+       errno != EAGAIN) {
+      roadmap_log (ROADMAP_ERROR, "timerfd read failed: %s", strerror(errno));
+   }
+
+   now = reactor_now ();
+
+   /* A callback may add or remove timers, so the scan starts over after
+    * each call. The deadline is moved first so no timer runs twice.
+    */
+   for (i = 0; i < RoadMapReactorPeriodicCount; ++i) {
+
+      RoadMapReactorPeriodic *periodic = RoadMapReactorPeriodics + i;
+
+      if (periodic->deadline <= now) {
+
+         RoadMapCallback callback = periodic->callback;
+
+         periodic->deadline += periodic->interval;
+         if (periodic->deadline <= now) periodic->deadline = now + periodic->interval;
+
+         (*callback) ();
+         i = -1;
+      }
+   }
+
+   reactor_arm_timer ();
+}
+
+
+BOOL roadmap_net_reactor_initialize (void) {
+
+   struct epoll_event event;
+
+   if (RoadMapReactorEpoll >= 0) return TRUE;
+
+   RoadMapReactorEpoll = epoll_create1 (EPOLL_CLOEXEC);
+   if (RoadMapReactorEpoll < 0) {
+      roadmap_log (ROADMAP_ERROR, "epoll_create failed: %s", strerror(errno));
+      return FALSE;
+   }
+
+   RoadMapReactorTimer =
+      timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+   if (RoadMapReactorTimer < 0) {
+      roadmap_log (ROADMAP_ERROR, "timerfd_create failed: %s", strerror(errno));
+      close (RoadMapReactorEpoll);
+      RoadMapReactorEpoll = -1;
+      return FALSE;
+   }
+
+   memset (&event, 0, sizeof(event));
+   event.events = EPOLLIN;
+   event.data.u64 = REACTOR_TIMER_KEY;
+   epoll_ctl (RoadMapReactorEpoll, EPOLL_CTL_ADD, RoadMapReactorTimer, &event);
+
+   return TRUE;
+}
+
+
+void roadmap_net_reactor_shutdown (void) {
+
+   int i;
+
+   if (RoadMapReactorEpoll < 0) return;
+
+   for (i = 0; i < RoadMapReactorEntriesSize; ++i) {
+      if (RoadMapReactorEntries[i]) {
+         reactor_free_queue (RoadMapReactorEntries[i]);
+         free (RoadMapReactorEntries[i]);
+      }
+   }
+
+   free (RoadMapReactorEntries);
+   RoadMapReactorEntries = NULL;
+   RoadMapReactorEntriesSize = 0;
+   RoadMapReactorConnecting = 0;
+   RoadMapReactorPeriodicCount = 0;
+
+   close (RoadMapReactorTimer);
+   close (RoadMapReactorEpoll);
+   RoadMapReactorTimer = -1;
+   RoadMapReactorEpoll = -1;
+}
+
+
+int roadmap_net_reactor_fd (void) {
+   return RoadMapReactorEpoll;
+}
+
+
+int roadmap_net_reactor_dispatch (int timeout) {
+
+   struct epoll_event events[REACTOR_MAX_EVENTS];
+   int count;
+   int i;
+
+   count = epoll_wait (RoadMapReactorEpoll, events, REACTOR_MAX_EVENTS, timeout);
+
+   if (count < 0) {
+      if (errno == EINTR) return 0;
+      roadmap_log (ROADMAP_ERROR, "epoll_wait failed: %s", strerror(errno));
+      return -1;
+   }
+
+   for (i = 0; i < count; ++i) {
+
+      uint64_t key = events[i].data.u64;
+      unsigned int ready = events[i].events;
+      unsigned int generation = (unsigned int)(key >> 32);
+      int fd = (int)(key & 0xFFFFFFFF);
+      RoadMapReactorEntry *entry;
+
+      if (key == REACTOR_TIMER_KEY) {
+         reactor_run_timers ();
+         continue;
+      }
+
+      entry = reactor_entry (fd, FALSE);
+      if (entry == NULL || entry->generation != generation) continue;
+
+      if (ready & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+
+         if (entry->queue_head) reactor_flush (fd, entry);
+
+         if (entry->output_callback) {
+            (*entry->output_callback) (&entry->output_io);
+
+            /* The callback may have closed the socket */
+            if (entry->generation != generation) continue;
+         }
+      }
+
+      if ((ready & (EPOLLIN | EPOLLERR | EPOLLHUP)) && entry->input_callback) {
+         (*entry->input_callback) (&entry->input_io);
+         if (entry->generation != generation) continue;
+      }
+
+      reactor_update (fd, entry);
+   }
+
+   return count;
+}
+
+
+void roadmap_net_reactor_set_input (RoadMapIO *io, RoadMapInput callback) {
+
+   int fd = reactor_io_fd (io);
+   RoadMapReactorEntry *entry = reactor_entry (fd, TRUE);
+
+   if (entry == NULL) return;
+
+   entry->input_io = *io;
+   entry->input_callback = callback;
+
+   reactor_update (fd, entry);
+}
+
+
+void roadmap_net_reactor_set_output (RoadMapIO *io, RoadMapInput callback,
+                                     BOOL is_connect) {
+
+   int fd = reactor_io_fd (io);
+   RoadMapReactorEntry *entry = reactor_entry (fd, TRUE);
+
+   if (entry == NULL) return;
+
+   if (entry->connect_start) RoadMapReactorConnecting--;
+
+   entry->output_io = *io;
+   entry->output_callback = callback;
+   entry->connect_start = is_connect ? time(NULL) : 0;
+
+   if (entry->connect_start) RoadMapReactorConnecting++;
+
+   reactor_update (fd, entry);
+}
+
+
+void roadmap_net_reactor_remove_input (RoadMapIO *io) {
+
+   int fd = reactor_io_fd (io);
+   RoadMapReactorEntry *entry = reactor_entry (fd, FALSE);
+
+   if (entry == NULL) return;
+
+   if (entry->connect_start) RoadMapReactorConnecting--;
+
+   entry->input_callback = NULL;
+   entry->output_callback = NULL;
+   entry->connect_start = 0;
+
+   reactor_update (fd, entry);
+}
+
+
+RoadMapIO *roadmap_net_reactor_output_timedout (time_t timeout) {
+
+   int i;
+
+   if (RoadMapReactorConnecting == 0) return NULL;
+
+   for (i = 0; i < RoadMapReactorEntriesSize; ++i) {
+
+      RoadMapReactorEntry *entry = RoadMapReactorEntries[i];
+
+      if (entry && entry->output_callback &&
+          entry->connect_start && (timeout > entry->connect_start)) {
+         return &entry->output_io;
+      }
+   }
+
+   return NULL;
+}
+
+
+void roadmap_net_reactor_set_periodic (int interval, RoadMapCallback callback) {
+
+   int i;
+
+   for (i = 0; i < RoadMapReactorPeriodicCount; ++i) {
+      if (RoadMapReactorPeriodics[i].callback == callback) break;
+   }
+
+   if (i == RoadMapReactorPeriodicCount) {
+
+      if (i == REACTOR_MAX_PERIODIC) {
+         roadmap_log (ROADMAP_ERROR, "Too many periodic callbacks");
+         return;
+      }
+      RoadMapReactorPeriodicCount++;
+   }
+
+   RoadMapReactorPeriodics[i].callback = callback;
+   RoadMapReactorPeriodics[i].interval = interval;
+   RoadMapReactorPeriodics[i].deadline = reactor_now () + interval;
+
+   reactor_arm_timer ();
+}
+
+
+void roadmap_net_reactor_remove_periodic (RoadMapCallback callback) {
+
+   int i;
+
+   for (i = 0; i < RoadMapReactorPeriodicCount; ++i) {
+
+      if (RoadMapReactorPeriodics[i].callback == callback) {
+
+         RoadMapReactorPeriodicCount--;
+         RoadMapReactorPeriodics[i] =
+            RoadMapReactorPeriodics[RoadMapReactorPeriodicCount];
+
+         reactor_arm_timer ();
+         return;
+      }
+   }
+}
+
+
+int roadmap_net_reactor_send (int fd, const void *data, int length) {
+
+   RoadMapReactorEntry *entry = reactor_entry (fd, TRUE);
+   RoadMapReactorBuffer *buffer;
+   int total = length;
+
+   if (entry == NULL || entry->failed) return -1;
+
+   /* Nothing waiting: try to hand it over to the socket right away */
+   if (entry->queue_head == NULL) {
+
+      int res = send (fd, data, length, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+      if (res < 0) {
+         if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            roadmap_log (ROADMAP_ERROR, "Error sending data: (%d) %s",
+                         errno, strerror(errno));
+            roadmap_net_mon_error("Error in send - data.");
+            return -1;
+         }
+         res = 0;
+      }
+
+      if (res > 0) roadmap_net_mon_send(res);
+      if (res == length) return total;
+
+      data = (const char *)data + res;
+      length -= res;
+
+   } else if (entry->queued + length > ROADMAP_REACTOR_MAX_QUEUED) {
+
+      roadmap_log (ROADMAP_ERROR, "Send queue of %d is full (%d bytes)",
+                   fd, entry->queued);
+      return -1;
+   }
+
+   buffer = malloc (sizeof(RoadMapReactorBuffer) + length);
+   roadmap_check_allocated(buffer);
+
+   memcpy (buffer->data, data, length);
+   buffer->length = length;
+   buffer->offset = 0;
+   buffer->next = NULL;
+
+   if (entry->queue_tail) {
+      entry->queue_tail->next = buffer;
+   } else {
+      entry->queue_head = buffer;
+   }
+   entry->queue_tail = buffer;
+   entry->queued += length;
+
+   reactor_update (fd, entry);
+
+   return total;
+}
+
+
+int roadmap_net_reactor_pending (int fd) {
+
+   RoadMapReactorEntry *entry = reactor_entry (fd, FALSE);
+
+   return entry ? entry->queued : 0;
+}
+
+
+void roadmap_net_reactor_close (int fd) {
+
+   RoadMapReactorEntry *entry = reactor_entry (fd, FALSE);
+
+   if (entry == NULL) return;
+
+   if (entry->events) {
+      epoll_ctl (RoadMapReactorEpoll, EPOLL_CTL_DEL, fd, NULL);
+   }
+
+   if (entry->connect_start) RoadMapReactorConnecting--;
+
+   reactor_free_queue (entry);
+
+   entry->input_callback = NULL;
+   entry->output_callback = NULL;
+   entry->connect_start = 0;
+   entry->failed = FALSE;
+   entry->events = 0;
+   entry->generation++;
+}
+
+#endif // ROADMAP_NET_EPOLL
@@ -16,6 +16,7 @@ void cyclic_buffer_init( cyclic_buffer_ptr this)
    //   Internal usage:
    this->next_read      = this->buffer;
    this->free_size      = CYCLIC_BUFFER_SIZE;
+   this->line_scanned   = 0;
 }
 
 //   Recylce buffer before going into the next 'read' statement
@@ -33,6 +34,7 @@ void cyclic_buffer_recycle( cyclic_buffer_ptr this)
       //   Internal usage:
       this->next_read = this->buffer;
       this->free_size = CYCLIC_BUFFER_SIZE;
+      this->line_scanned = 0;
    }
    else
    {
@@ -47,6 +49,11 @@ void cyclic_buffer_recycle( cyclic_buffer_ptr this)
 
          this->buffer[remained]  = '\0';     // Terminate string with a NULL
          this->read_size         = remained; // Update buffer size to unprocessed-buffer size
+
+         //   Scanned data moved with the rest:
+         this->line_scanned     -= this->read_processed;
+         if( this->line_scanned < 0)
+            this->line_scanned = 0;
       }
 
       //   Internal usage:
@@ -86,3 +93,21 @@ const char* cyclic_buffer_get_unprocessed_data(
 {
    return this->buffer + this->read_processed;
 }
+
+const char* cyclic_buffer_get_line_end(
+                              cyclic_buffer_ptr this)
+{
+   int         scan_from = this->line_scanned;
+   const char* line_end;
+
+   if( scan_from < this->read_processed)
+      scan_from = this->read_processed;
+
+   line_end = memchr( this->buffer + scan_from, '\n', this->read_size - scan_from);
+
+   //   Next time - only scan what will be added:
+   if( !line_end)
+      this->line_scanned = this->read_size;
+
+   return line_end;
+}
@@ -41,6 +41,7 @@ typedef struct tag_cyclic_buffer
    //   Internal usage:
    char* next_read;
    int   free_size;
+   int   line_scanned;
 
 }  cyclic_buffer, *cyclic_buffer_ptr;
 
@@ -56,6 +57,10 @@ typedef struct tag_cyclic_buffer
 //                      This value is incremented-only during the transaction
 //
 // When (data_processed == data_size) transaction completed
+//
+// o  line_scanned   - Offset in 'buffer' up to which the unprocessed data is
+//                      known not to hold a '\n'. Lets a partially received
+//                      line be searched only in its newly received part.
 
 void  cyclic_buffer_init   (  cyclic_buffer_ptr this);
 void  cyclic_buffer_recycle(  cyclic_buffer_ptr this);
@@ -65,4 +70,7 @@ void  cyclic_buffer_update_processed_data(
                               const char*       data_to_skip);
 const char* cyclic_buffer_get_unprocessed_data(
                               cyclic_buffer_ptr this);
+//   End ('\n') of the first unprocessed line, or NULL if it was not received yet
+const char* cyclic_buffer_get_line_end(
+                              cyclic_buffer_ptr this);
 #endif   //   __CYCLIC_BUFFER_H__
@@ -19,11 +19,14 @@
 
 
 #include <string.h>
+#include <stdlib.h>
 #include "../roadmap_main.h"
+#include "../roadmap_hash.h"
+#include "../roadmap_net_reactor.h"
 
 #include "socket_async_receive.h"
 
-#define  RECEIVER_QUEUE_SIZE     (20)
+#define  RECEIVER_QUEUE_SIZE     (20)  // Initial size; grows as needed
 
 typedef struct tag_sar_info
 {
@@ -32,6 +35,8 @@ typedef struct tag_sar_info
    int               iSize;
    CB_OnDataReceive  cbOnDataReceive;
    void*             pContext;
+   int               iIndex;
+   int               iNextFree;
 
 }  sar_info, *sar_info_ptr;
 
@@ -40,27 +45,32 @@ typedef struct tag_sar_info
 #endif
 
 INLINE_DEC void SAR_ReceiveInfo_Init( sar_info_ptr this)
-{ memset( this, 0, sizeof(sar_info));}
+{
+   int iIndex = this->iIndex;
+   memset( this, 0, sizeof(sar_info));
+   this->iIndex   = iIndex;
+}
 
-static   sar_info   AsyncJobs[RECEIVER_QUEUE_SIZE];
+// Jobs are indexed by the socket, and never move: 'IO.context' points
+// to the job, so the callback does not have to look it up.
+static   sar_info_ptr*  AsyncJobs      = NULL;
+static   int            AsyncJobsSize  = 0;
+static   int            AsyncJobsFree  = -1;
+static   RoadMapHash*   AsyncJobsHash  = NULL;
+
+#define  SAR_SOCKET_KEY(_s_)     ((int)(((size_t)(_s_)) >> 3))
 
 static void on_socket_has_data( RoadMapIO* io)
 {
-   int            i  = 0;
    sar_info_ptr   pDI= NULL;
    
    assert(io);
    if( !io)
       return;
 
-   for( i=0; i<RECEIVER_QUEUE_SIZE; i++)
-      if(roadmap_io_same(&(AsyncJobs[i].IO), io))
-      {
-         pDI = &(AsyncJobs[i]);
-         break;
-      }
+   pDI = (sar_info_ptr)io->context;
    
-   if( !pDI)
+   if( !pDI || !roadmap_io_same( &(pDI->IO), io))
    {
       // Socket must be found...
       assert( 0 && "socket_async_receive::on_socket_has_data() - UNEXPECTED");
@@ -75,24 +85,70 @@ sar_info_ptr find_receive_info( const RoadMapSocket s)
 {
    int i;
    
-   if( !s || (ROADMAP_INVALID_SOCKET == s))
+   if( !s || (ROADMAP_INVALID_SOCKET == s) || !AsyncJobsHash)
       return NULL;
    
-   for( i=0; i<RECEIVER_QUEUE_SIZE; i++)
-      if( s == AsyncJobs[i].IO.os.socket)
-         return &(AsyncJobs[i]);
+   for( i =  roadmap_hash_get_first( AsyncJobsHash, SAR_SOCKET_KEY(s));
+        i >= 0;
+        i =  roadmap_hash_get_next( AsyncJobsHash, i))
+      if( s == AsyncJobs[i]->IO.os.socket)
+         return AsyncJobs[i];
    
    return NULL;
 }
 
+static sar_info_ptr alloc_receive_info( const RoadMapSocket s)
+{
+   sar_info_ptr   pDI;
+   
+   if( AsyncJobsFree < 0)
+   {
+      int i;
+      int iSize = AsyncJobsSize? (AsyncJobsSize * 2): RECEIVER_QUEUE_SIZE;
+      
+      AsyncJobs = realloc( AsyncJobs, iSize * sizeof(sar_info_ptr));
+      roadmap_check_allocated( AsyncJobs);
+      
+      if( !AsyncJobsHash)
+         AsyncJobsHash = roadmap_hash_new( "socket_async_receive", iSize);
+      else
+         roadmap_hash_resize( AsyncJobsHash, iSize);
+      
+      // Chain the new jobs on the free list, lowest index first
+      for( i=iSize-1; i>=AsyncJobsSize; i--)
+      {
+         AsyncJobs[i] = calloc( 1, sizeof(sar_info));
+         roadmap_check_allocated( AsyncJobs[i]);
+         
+         AsyncJobs[i]->iIndex    = i;
+         AsyncJobs[i]->iNextFree = AsyncJobsFree;
+         AsyncJobsFree           = i;
+      }
+      
+      AsyncJobsSize = iSize;
+   }
+   
+   pDI            = AsyncJobs[AsyncJobsFree];
+   AsyncJobsFree  = pDI->iNextFree;
+   
+   pDI->IO.os.socket = s;
+   roadmap_hash_add( AsyncJobsHash, SAR_SOCKET_KEY(s), pDI->iIndex);
+   
+   return pDI;
+}
+
 void socket_async_receive_end( RoadMapSocket s)
 {
    sar_info_ptr  pDI = find_receive_info( s);
    
    if( pDI)
    {
-      roadmap_main_remove_input( &(pDI->IO));
+      roadmap_net_io_remove_input( &(pDI->IO));
+      roadmap_hash_remove( AsyncJobsHash, SAR_SOCKET_KEY(s), pDI->iIndex);
       SAR_ReceiveInfo_Init( pDI);
+      
+      pDI->iNextFree = AsyncJobsFree;
+      AsyncJobsFree  = pDI->iIndex;
    }
 }
 
@@ -109,34 +165,18 @@ BOOL socket_async_receive(  RoadMapSocket     s,
       return FALSE;
 
    if( !pDI)   // First time round?
-   {
-      int i; 
-      
-      for( i=0; i<RECEIVER_QUEUE_SIZE; i++)
-      {
-         if( (NULL == AsyncJobs[i].cbOnDataReceive) && (0 == AsyncJobs[i].IO.os.socket))
-         {
-            pDI = &(AsyncJobs[i]);
-            break;
-         }
-      }
-      
-      if( !pDI)
-      {
-         assert( 0 && "socket_async_receive::socket_async_receive() - QUEUE IS FULL");
-         return FALSE;
-      }
-   }
+      pDI = alloc_receive_info( s);
   
    pDI->IO.os.socket    = s;
    pDI->IO.subsystem    = ROADMAP_IO_NET;
+   pDI->IO.context      = pDI;
    pDI->pData           = data;
    pDI->iSize           = size;
    pDI->cbOnDataReceive = on_data_received;
    pDI->pContext        = context;
 
    if( set_input) {
-         roadmap_main_set_input( &(pDI->IO), on_socket_has_data);
+         roadmap_net_io_set_input( &(pDI->IO), on_socket_has_data);
    }
 
    return TRUE;
@@ -220,6 +220,90 @@ const char*   ReadDoubleFromString(
 }
 
 
+//   Method:   ReadFieldFromString
+//
+//   Abstract: Locate the next field in a string, without copying it
+//
+//   Return:   If the field is terminated, return the end of string processed.
+//             If end-of-string is reached before a termination char, return NULL
+//
+const char*   ReadFieldFromString(
+               const char*    szStr,               //   [in]      Source string
+               const char*    szValueTermination,  //   [in]      Field termination
+               string_field*  pField,              //   [out]     Output field
+               int            iTrimCount)          //   [in]      TRIM_ALL_CHARS, DO_NOT_TRIM, or 'n'
+{
+   const char* szEnd;
+
+   if( !szStr || !szValueTermination || !(*szValueTermination))
+      return NULL;
+
+   szEnd = szStr;
+   while( (*szEnd) && (NULL == strchr( szValueTermination, (*szEnd))))
+      szEnd++;
+
+   if( !(*szEnd))
+      return NULL;
+
+   pField->data = szStr;
+   pField->size = (int)(szEnd - szStr);
+
+   return EatChars( szEnd, szValueTermination, iTrimCount);
+}
+
+BOOL StringFieldToInt( const string_field* pField, int* pValue)
+{
+   const char* szStr = pField->data;
+   const char* szEnd = pField->data + pField->size;
+   BOOL        bMinus= FALSE;
+   int         iValue= 0;
+
+   if( (szStr < szEnd) && ('-' == (*szStr)))
+   {
+      bMinus = TRUE;
+      szStr++;
+   }
+
+   if( szStr == szEnd)
+      return FALSE;
+
+   while( szStr < szEnd)
+   {
+      if( ((*szStr) < '0') || ('9' < (*szStr)))
+         return FALSE;
+
+      iValue *= 10;
+      iValue += ((*szStr) - '0');
+      szStr++;
+   }
+
+   (*pValue) = bMinus? -iValue: iValue;
+   return TRUE;
+}
+
+//   Method:   ReadBoolFromString
+//
+//   Abstract: Read a 'T'/'F' flag from a string, without copying it
+//
+//   Remarks:   As with 'ExtractNetworkString', a value ending the string is accepted
+//
+const char*   ReadBoolFromString(
+               const char* szStr,               //   [in]      Source string
+               const char* szValueTermination,  //   [in]      Value termination
+               BOOL*       pValue,              //   [out]     Output value
+               int         iTrimCount)          //   [in]      TRIM_ALL_CHARS, DO_NOT_TRIM, or 'n'
+{
+   if( !szStr || !szValueTermination || !(*szValueTermination))
+      return NULL;
+
+   (*pValue) = ('T' == (*szStr));
+
+   return EatChars( SkipChars( szStr, szValueTermination, TRIM_ALL_CHARS),
+                    szValueTermination,
+                    iTrimCount);
+}
+
+
 //   Method:   ExtractString
 //
 //   Abstract: Copy string, until end of string, or until one termination-characters is reached
@@ -98,6 +98,56 @@ const char*   ReadDoubleFromString(
                int         iTrimCount);         //   [in]      TRIM_ALL_CHARS, DO_NOT_TRIM, or 'n'
 
 
+////////////////////////////////////
+//   Method:   ReadFieldFromString
+//
+//   Abstract: Locate the next field in a string, without copying it
+//
+//   Return:   If the field is terminated, return the end of string processed.
+//             If end-of-string is reached before a termination char, return NULL;
+//             When parsing data as it arrives this means the field is not complete yet.
+//
+//   Parameters:
+//
+//      o   szStr             - [in]      Source string
+//      o   szValueTermination- [in]      Characters that terminate the field
+//      o   pField            - [out]     The field, pointing into 'szStr'
+//      o   iTrimCount        - [in]      Remove additional termination chars from 'szStr'
+//
+//   Remarks:   Escape sequences are not decoded; Use 'ExtractNetworkString' for text fields
+//
+typedef struct tag_string_field
+{
+   const char* data;
+   int         size;
+
+}  string_field;
+
+const char*   ReadFieldFromString(
+               const char*    szStr,               //   [in]      Source string
+               const char*    szValueTermination,  //   [in]      Field termination
+               string_field*  pField,              //   [out]     Output field
+               int            iTrimCount);         //   [in]      TRIM_ALL_CHARS, DO_NOT_TRIM, or 'n'
+
+//   Integer value of a field; Returns FALSE if the field is not a number
+BOOL  StringFieldToInt( const string_field* pField, int* pValue);
+
+////////////////////////////////////
+//   Method:   ReadBoolFromString
+//
+//   Abstract: Read a 'T'/'F' flag from a string, without copying it.
+//             Any value starting with 'T' is TRUE.
+//
+//   Return:   If succeeds, return the end of string processed.
+//             If fails, return NULL
+//
+const char*   ReadBoolFromString(
+               const char* szStr,               //   [in]      Source string
+               const char* szValueTermination,  //   [in]      Value termination
+               BOOL*       pValue,              //   [out]     Output value
+               int         iTrimCount);         //   [in]      TRIM_ALL_CHARS, DO_NOT_TRIM, or 'n'
+
+
 ////////////////////////////
 //   Method:   ExtractString
 //
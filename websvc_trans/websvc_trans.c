@@ -139,6 +139,7 @@ static void wst_context_reset( wst_context_ptr this, int use_ack)
 
 /* Receive:       */
 /*11*/   cyclic_buffer_init(        &(this->CB));
+         this->resume_parser        = NULL;
 /*12*/
    if (use_ack)
       this->http_parser_state    = http_not_acked;
@@ -1153,6 +1154,179 @@ static transaction_result OnHTTPHeader( cyclic_buffer_ptr CB, http_parsing_state
    return trans_succeeded;      //   Quit loop
 }
 
+// Case insensitive hash of a response tag (FNV-1a):
+static unsigned int wst_tag_hash( const char* tag)
+{
+   unsigned int hash = 2166136261U;
+
+   while( *tag)
+   {
+      unsigned char c = (unsigned char)*tag++;
+
+      if( ('A' <= c) && (c <= 'Z'))
+         c += 'a' - 'A';
+
+      hash ^= c;
+      hash *= 16777619U;
+   }
+
+   return hash;
+}
+
+static BOOL wst_tag_equal( const char* tag, const char* parser_tag)
+{
+#ifdef _WIN32
+   return (0 == _stricmp( tag, parser_tag));
+#else
+   return (0 == roadmap_string_compare_ignore_case( tag, parser_tag));
+#endif
+}
+
+static void wst_dispatch_build(  wst_dispatch*        table,
+                                 const wst_parser_ptr parsers,
+                                 int                  parsers_count)
+{
+   int i;
+
+   memset( table, 0, sizeof(wst_dispatch));
+   table->parsers       = parsers;
+   table->parsers_count = parsers_count;
+
+   for( i=0; i<parsers_count; i++)
+   {
+      unsigned int slot;
+
+      if( !parsers[i].tag || !parsers[i].tag[0])
+      {
+         // The first entry without a tag is the default parser:
+         if( !table->def_parser)
+            table->def_parser = parsers[i].parser;
+         continue;
+      }
+
+      // Only tags preceding the default parser enable tag parsing:
+      if( !table->def_parser)
+         table->have_tags = TRUE;
+
+      slot = wst_tag_hash( parsers[i].tag) & (WST_DISPATCH_SLOTS - 1);
+      while( table->slots[slot])
+      {
+         // First entry wins on duplicated tags:
+         if( wst_tag_equal( parsers[i].tag, parsers[table->slots[slot] - 1].tag))
+            break;
+
+         slot = (slot + 1) & (WST_DISPATCH_SLOTS - 1);
+      }
+
+      if( !table->slots[slot])
+         table->slots[slot] = (unsigned char)(i + 1);
+   }
+}
+
+static wst_dispatch* wst_dispatch_get( wst_context_ptr      session,
+                                       const wst_parser_ptr parsers,
+                                       int                  parsers_count)
+{
+   wst_dispatch*  table;
+   int            i;
+
+   for( i=0; i<WST_DISPATCH_TABLES; i++)
+   {
+      table = &(session->dispatch[i]);
+
+      if( (table->parsers == parsers) && (table->parsers_count == parsers_count))
+         return table;
+   }
+
+   // Not known yet - replace the oldest table:
+   table = &(session->dispatch[session->dispatch_next]);
+   session->dispatch_next = (session->dispatch_next + 1) % WST_DISPATCH_TABLES;
+
+   wst_dispatch_build( table, parsers, parsers_count);
+
+   return table;
+}
+
+static const wst_parser* wst_dispatch_find( const wst_dispatch* table, const char* tag)
+{
+   unsigned int slot = wst_tag_hash( tag) & (WST_DISPATCH_SLOTS - 1);
+
+   while( table->slots[slot])
+   {
+      const wst_parser* entry = &(table->parsers[table->slots[slot] - 1]);
+
+      if( wst_tag_equal( tag, entry->tag))
+         return entry;
+
+      slot = (slot + 1) & (WST_DISPATCH_SLOTS - 1);
+   }
+
+   return NULL;
+}
+
+static CB_OnWSTResponse gs_partial_lines_parsers[WST_PARTIAL_LINES_PARSERS];
+static int              gs_partial_lines_parsers_count = 0;
+
+BOOL wst_register_partial_lines_parser( CB_OnWSTResponse parser)
+{
+   if( WST_PARTIAL_LINES_PARSERS == gs_partial_lines_parsers_count)
+   {
+      assert(0);
+      return FALSE;
+   }
+
+   gs_partial_lines_parsers[gs_partial_lines_parsers_count++] = parser;
+   return TRUE;
+}
+
+static BOOL wst_takes_partial_lines( CB_OnWSTResponse parser)
+{
+   int i;
+
+   for( i=0; i<gs_partial_lines_parsers_count; i++)
+      if( gs_partial_lines_parsers[i] == parser)
+         return TRUE;
+
+   return FALSE;
+}
+
+BOOL wst_register_parsers(wst_handle           h,
+                          const wst_parser_ptr parsers,
+                          int                  parsers_count)
+{
+   wst_context_ptr session = (wst_context_ptr)h;
+
+   if( !session)
+      return FALSE;
+
+   if( !parsers || (parsers_count < WST_MIN_PARSERS_COUNT) || (WST_MAX_PARSERS_COUNT < parsers_count))
+   {
+      assert(0);
+      return FALSE;
+   }
+
+   wst_dispatch_get( session, parsers, parsers_count);
+   return TRUE;
+}
+
+// Partial lines parser which drops the rest of a line, after its own parser failed:
+static const char* wst_skip_line(  /* IN  */   const char*       data,
+                                   /* IN  */   void*             context,
+                                   /* OUT */   BOOL*             more_data_needed,
+                                   /* OUT */   roadmap_result*   rc)
+{
+   const char* line_end = strchr( data, '\n');
+
+   if( !line_end)
+   {
+      (*more_data_needed) = TRUE;
+      return data + strlen( data);
+   }
+
+   (*more_data_needed) = FALSE;
+   return line_end + 1;
+}
+
 static transaction_result OnCustomResponse( wst_context_ptr session)
 {
    char                 tag[WST_RESPONSE_TAG_MAXSIZE+1];
@@ -1161,12 +1335,13 @@ static transaction_result OnCustomResponse( wst_context_ptr session)
    int                  parsers_count     = session->active_item.parsers_count;
    const char*          next              = NULL;
    const char*          last              = NULL;   //   For logging
+   const wst_dispatch*  dispatch;
+   const wst_parser*    entry;
    CB_OnWSTResponse     parser            = NULL;
-   CB_OnWSTResponse     def_parser        = NULL;
-   BOOL                 have_tags         = FALSE;
+   BOOL                 partial_line      = FALSE;
+   BOOL                 partial_parser    = FALSE;
    BOOL                 more_data_needed  = FALSE;
    int                  buffer_size;
-   int                  i;
    roadmap_result		rc						= succeeded;
 
    assert(session);
@@ -1174,22 +1349,15 @@ static transaction_result OnCustomResponse( wst_context_ptr session)
    assert(parsers);
    assert(parsers_count);
 
-   // Select default parser:
-   for( i=0; i<parsers_count; i++)
-   {
-      if( parsers[i].tag && parsers[i].tag[0])
-         have_tags = TRUE;
-      else
-      {
-         def_parser= parsers[i].parser;
-         break;
-      }
-   }
+   // Tag lookup table (also selects the default parser):
+   dispatch = wst_dispatch_get( session, parsers, parsers_count);
    
    //   As long as we have data - keep on parsing:
    while( CB->read_size > CB->read_processed )
    {
       parser            = NULL;
+      partial_line      = FALSE;
+      partial_parser    = FALSE;
       more_data_needed  = FALSE;
 
       //   Set pointer:
@@ -1209,12 +1377,30 @@ static transaction_result OnCustomResponse( wst_context_ptr session)
       // Save last position:
       last = next;
 
+      if( session->resume_parser)
+      {
+         //   Continue the line which the parser did not finish:
+         parser            = session->resume_parser;
+         partial_parser    = TRUE;
+         more_data_needed  = TRUE;
+         strcpy( tag, "(continued)");
+         goto call_parser;
+      }
+
       //   In order to parse a full statement we must have a full line:
       ///[BOOKMARK]:[NOTE]:[PAZ] - WEBSVC_TRANS - Assuming each command is terminated with '\n'
-      if( NULL == strchr( next, '\n'))
-         return trans_in_progress;   //   Continue reading...
+      if( NULL == cyclic_buffer_get_line_end( CB))
+      {
+         string_field field;
+
+         //   ...unless the tag is known, and its parser takes partial lines:
+         if( !dispatch->have_tags || !ReadFieldFromString( next, ",\r\n", &field, DO_NOT_TRIM))
+            return trans_in_progress;   //   Continue reading...
+
+         partial_line = TRUE;
+      }
 
-      if( have_tags)
+      if( dispatch->have_tags)
       {
          //   Read next tag:
          buffer_size = WST_RESPONSE_TAG_MAXSIZE;
@@ -1226,6 +1412,9 @@ static transaction_result OnCustomResponse( wst_context_ptr session)
                            1);            // [in]     Remove additional termination chars
 
          next = EatChars( next, "\r\n", TRIM_ALL_CHARS);
+         if( partial_line && next && !(*next))
+            return trans_in_progress;   //   Nothing but the tag yet
+
          if( !next || !(*next))
          {
             roadmap_log( ROADMAP_ERROR, "WST::OnCustomResponse() - Failed to read server-response tag from packet location '%s'", last);
@@ -1233,19 +1422,15 @@ static transaction_result OnCustomResponse( wst_context_ptr session)
          }
 
          //   Find parser:
-         parser = NULL;
-         for( i=0; i<parsers_count; i++)
+         entry = wst_dispatch_find( dispatch, tag);
+         if( entry)
          {
-            #ifdef _WIN32
-               if( parsers[i].tag && (0 ==   _stricmp( tag, parsers[i].tag)))
-            #else
-               if( parsers[i].tag && (0 ==   roadmap_string_compare_ignore_case( tag, parsers[i].tag)))
-            #endif
-            {
-               parser = parsers[i].parser;
-               break;
-            }
+            parser         = entry->parser;
+            partial_parser = wst_takes_partial_lines( parser);
          }
+
+         if( partial_line && !partial_parser)
+            return trans_in_progress;   //   Continue reading...
       }
 
       if( parser)
@@ -1253,12 +1438,12 @@ static transaction_result OnCustomResponse( wst_context_ptr session)
          cyclic_buffer_update_processed_data( CB, next, NULL);
       else
       {
-         if( def_parser)
+         if( dispatch->def_parser)
          {
             // "tag" was not found, thus the string "tag" was not used.
             //    Go-back on the stream, and send "tag" as well:
             cyclic_buffer_update_processed_data( CB, last, NULL);
-            parser = def_parser;
+            parser = dispatch->def_parser;
          }
          else
          {
@@ -1269,9 +1454,11 @@ static transaction_result OnCustomResponse( wst_context_ptr session)
          }
       }
 
+call_parser:
       //   Activate the appropriate server-request handler function:
       next = cyclic_buffer_get_unprocessed_data( CB);
       next = parser( next, session->active_item.context, &more_data_needed, &rc);
+      session->resume_parser = NULL;
       
       if (session->http_parser_state != http_parse_completed) {
          //current request was removed from queue and replaced by a new request
@@ -1290,6 +1477,13 @@ static transaction_result OnCustomResponse( wst_context_ptr session)
          //[SRUL] Instead of failing the transaction, move on to next line
          next = SkipChars( last, "\r\n", TRIM_ALL_CHARS);
          //return trans_failed;
+
+         //   The rest of the line was not received yet - skip it as it arrives:
+         if( partial_parser && !(*next))
+         {
+            parser            = wst_skip_line;
+            more_data_needed  = TRUE;
+         }
       }
 
       if( succeeded == session->rc)
@@ -1300,6 +1494,14 @@ static transaction_result OnCustomResponse( wst_context_ptr session)
       if( more_data_needed)
       {
          roadmap_log( ROADMAP_DEBUG, "WST::OnCustomResponse() - Tag '%s' is asking for more data. Exiting method", tag);
+
+         //   Drop what a partial lines parser used, and call it again with the rest:
+         if( partial_parser)
+         {
+            cyclic_buffer_update_processed_data( CB, next, NULL);
+            session->resume_parser = parser;
+         }
+
          return trans_in_progress;  // User is asking for more data...
       }
 
@@ -1309,7 +1511,12 @@ static transaction_result OnCustomResponse( wst_context_ptr session)
 
 
 	assert( CB->read_size == CB->read_processed );
-    return ((succeeded == session->rc) ? trans_succeeded : trans_failed); 
+
+   //   A line which failed does not stop the parsing (see above); Fail once all the data was read:
+   if( (succeeded != session->rc) && (CB->data_processed + CB->read_size < CB->data_size))
+      return trans_in_progress;
+
+    return ((succeeded == session->rc) ? trans_succeeded : trans_failed);
 }
 
 void http_response_status_init( http_response_status* this)
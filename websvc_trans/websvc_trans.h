@@ -31,6 +31,16 @@ wst_handle  wst_init( const char* service_name, const char* secured_service_name
                      const char* service_v2_suffix, const char* content_type);
 void        wst_term( wst_handle h);
 
+// Optional: build the tag lookup table of a parsers array ahead of its first
+// transaction. Tables are otherwise built when the array is first used.
+BOOL        wst_register_parsers(wst_handle           session,
+                                 const wst_parser_ptr parsers,
+                                 int                  parsers_count);
+
+// Lets 'parser' handle its lines as they arrive, so they are not limited
+// by the receive buffer size (see 'CB_OnWSTResponse').
+BOOL        wst_register_partial_lines_parser( CB_OnWSTResponse parser);
+
 BOOL        wst_start_trans(wst_handle           session,       // Session object
                             int                  flags,         // Session flags
                             const char*          action,        // (/<service_name>/)<ACTION>
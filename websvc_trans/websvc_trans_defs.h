@@ -42,6 +42,9 @@
 #define  WST_WEBSERVICE_METHOD_MAX_SIZE      (0xFF)
 #define  WST_MIN_PARSERS_COUNT               ( 1)
 #define  WST_MAX_PARSERS_COUNT               (45)
+#define  WST_DISPATCH_SLOTS                  (128) // Power of 2, at least twice WST_MAX_PARSERS_COUNT
+#define  WST_DISPATCH_TABLES                 (4)   // Parser arrays remembered per session
+#define  WST_PARTIAL_LINES_PARSERS           (8)
 
 #define WEBSVC_FLAG_SECURED                  0x0001
 #define WEBSVC_FLAG_V2                       0x0002
@@ -123,6 +126,13 @@ typedef void (*CB_OnWSTCompleted)( void* context, roadmap_result res);
 //                               to "cbs".
 //    On failure     -  NULL
 //                      In this case parsing is stopped and transaction fails.
+//
+// Partial lines:
+//    A parser registered with 'wst_register_partial_lines_parser' is also called before the end
+//    of its line was received. It parses the complete fields it has, returns
+//    a pointer past them, and sets 'more_data_needed'. It is then called again
+//    with the rest of the line, with 'more_data_needed' already set on entry,
+//    and keeps its own state between the calls.
 typedef const char* (*CB_OnWSTResponse)(  /* IN  */   const char*       data,
                                           /* IN  */   void*             context,
                                           /* OUT */   BOOL*             more_data_needed,
@@ -136,6 +146,18 @@ typedef struct tag_wst_parser
 
 }  wst_parser, *wst_parser_ptr;
 
+// Tag lookup table of one parsers array, built once per session.
+// Slots hold (index+1) into 'parsers', zero marks an empty slot.
+typedef struct tag_wst_dispatch
+{
+   const wst_parser*    parsers;
+   int                  parsers_count;
+   CB_OnWSTResponse     def_parser;
+   BOOL                 have_tags;
+   unsigned char        slots[WST_DISPATCH_SLOTS];
+
+}  wst_dispatch;
+
 #include "../websvc_trans/websvc_trans_queue.h"
 
 typedef struct tag_wst_context
@@ -165,6 +187,9 @@ typedef struct tag_wst_context
 /*12*/   http_parsing_state   http_parser_state;
 /*13*/   //wst_parser_ptr       parsers;
 /*14*/   //int                  parsers_count;
+         wst_dispatch         dispatch[WST_DISPATCH_TABLES];
+         int                  dispatch_next;
+         CB_OnWSTResponse     resume_parser; // Parser of an unfinished line
 
 /* Completion:    */
 /*15*/   //CB_OnWSTCompleted    cbOnWSTCompleted;